@@ -1,9 +1,57 @@
 #include "ast.h"
 
+#include <new>
+
 namespace zenith
 {
 	namespace compiler
 	{
 		int AstNode::indentLevel = 0;
+
+		// nodes are created by parsers on several threads at once
+		static thread_local util::Arena *currentArena = nullptr;
+
+		// in front of every node, the arena it came from or nullptr
+		struct alignas(std::max_align_t) NodeHeader
+		{
+			util::Arena *arena;
+		};
+
+		AstArenaScope::AstArenaScope(util::Arena *arena)
+		{
+			previous = currentArena;
+			currentArena = arena;
+		}
+
+		AstArenaScope::~AstArenaScope()
+		{
+			currentArena = previous;
+		}
+
+		util::Arena *AstArenaScope::current()
+		{
+			return currentArena;
+		}
+
+		void *AstNode::operator new(size_t size)
+		{
+			void *memory = (currentArena != nullptr) ?
+				currentArena->allocate(sizeof(NodeHeader) + size) :
+				::operator new(sizeof(NodeHeader) + size);
+
+			auto *header = (NodeHeader*)memory;
+			header->arena = currentArena;
+			return header + 1;
+		}
+
+		void AstNode::operator delete(void *ptr)
+		{
+			if (ptr == nullptr)
+				return;
+
+			auto *header = (NodeHeader*)ptr - 1;
+			if (header->arena == nullptr)
+				::operator delete(header);
+		}
 	}
-}
\ No newline at end of file
+}
@@ -8,6 +8,9 @@
 
 #include "operators.h"
 #include "src_location.h"
+#include "symbols.h"
+#include "tokens.h"
+#include "../util/arena.h"
 
 namespace zenith
 {
@@ -102,6 +105,20 @@ namespace zenith
 			virtual void accept(ForLoopAst *node) = 0;
 		};
 
+		/* While a scope is alive, nodes created on this thread are allocated
+		   from its arena. The parser opens one on the arena of the module it parses. */
+		class AstArenaScope
+		{
+		private:
+			util::Arena *previous;
+
+		public:
+			AstArenaScope(util::Arena *arena);
+			~AstArenaScope();
+
+			static util::Arena *current();
+		};
+
 		struct AstNode
 		{
 		protected:
@@ -118,7 +135,7 @@ namespace zenith
 
 		public:
 			AstNode *module = nullptr;
-			std::pair<std::string, ClassAst*> self = {"", nullptr};
+			std::pair<SymbolId, ClassAst*> self = { NO_SYMBOL, nullptr };
 
 			SourceLocation location;
 			AstNodeType nodeType;
@@ -130,13 +147,25 @@ namespace zenith
 				this->nodeType = nodeType;
 			}
 
+			virtual ~AstNode() {}
+
 			virtual std::string str() = 0;
+
+			/* Allocated from the current AstArenaScope if there is one, otherwise
+			   from the heap. Memory of arena nodes is freed with the arena. */
+			static void *operator new(size_t size);
+			static void operator delete(void *ptr);
 		};
 
 		struct ModuleAst : public AstNode
 		{
 			std::string moduleName;
+			// holds the nodes of the module, so it has to outlive them
+			util::Arena arena;
 			std::vector<std::unique_ptr<AstNode>> children;
+			// kept when function bodies were skipped by the parser, see Parser::setPreParse()
+			std::vector<Token> tokens;
+			std::shared_ptr<const std::string> tokenText;
 
 			ModuleAst(SourceLocation location, const std::string &moduleName)
 				: AstNode(location, this, AST_MODULE)
@@ -682,6 +711,9 @@ namespace zenith
 			std::vector<std::string> arguments;
 			std::unique_ptr<AstNode> block;
 			bool isNative;
+			// token range of a body that is yet to be parsed, see Parser::parseBody()
+			int bodyBegin = -1;
+			int bodyEnd = -1;
 
 			FunctionDefinitionAst(SourceLocation location, 
 				AstNode *module,
@@ -711,7 +743,9 @@ namespace zenith
 				if (!isNative)
 				{
 					result += "\n";
-					result += block->str();
+					result += block != nullptr ?
+						block->str() :
+						tabIndent(indentLevel, "(not parsed)");
 				}
 
 				indentLevel--;
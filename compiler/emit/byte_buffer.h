@@ -0,0 +1,53 @@
+#ifndef __ZENITH_COMPILER_EMIT_BYTE_BUFFER_H__
+#define __ZENITH_COMPILER_EMIT_BYTE_BUFFER_H__
+
+#include <string>
+#include <cstddef>
+
+namespace zenith
+{
+	namespace compiler
+	{
+		/* Growable buffer that bytecode is serialized into before being
+		   written out in one go. */
+		class ByteBuffer
+		{
+		private:
+			std::string bytes;
+
+		public:
+			ByteBuffer()
+			{
+				// most modules fit without growing
+				bytes.reserve(4096);
+			}
+
+			void write(const char *data, size_t size)
+			{
+				bytes.append(data, size);
+			}
+
+			template <typename T>
+			void write(const T &value)
+			{
+				write(reinterpret_cast<const char*>(&value), sizeof(T));
+			}
+
+			/* Overwrite what was written at 'offset'. */
+			template <typename T>
+			void patch(size_t offset, const T &value)
+			{
+				bytes.replace(offset, sizeof(T), reinterpret_cast<const char*>(&value), sizeof(T));
+			}
+
+			size_t size() const { return bytes.size(); }
+			const char *data() const { return bytes.data(); }
+
+			const std::string &str() const { return bytes; }
+			void clear() { bytes.clear(); }
+			void swap(ByteBuffer &other) { bytes.swap(other.bytes); }
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,384 @@
+#include "code_generator.h"
+#include "emitter.h"
+
+#include <algorithm>
+
+namespace zenith
+{
+	namespace compiler
+	{
+		CodeGenerator::CodeGenerator(ByteBuffer &buffer, ImageWriter &image, InstructionWriter &writer, EmitStats &stats)
+			: buffer(buffer), image(image), writer(writer), stats(stats)
+		{
+		}
+
+		void CodeGenerator::clear()
+		{
+			functions.clear();
+			positions.clear();
+		}
+
+		void CodeGenerator::count(Instruction instruction, size_t start)
+		{
+			stats.add(instruction, buffer.size() - start);
+		}
+
+		void CodeGenerator::writeBlockPosition()
+		{
+			if (writer.getEncoding() == ENCODING_FIXED)
+				positions.push_back(buffer.size());
+
+			// the block starts right after this instruction
+			writer.writePosition(buffer.size() + sizeof(uint64_t));
+		}
+
+		void CodeGenerator::layout(const std::vector<Range> &ranges)
+		{
+			// where each range is now, and where it is moved to
+			std::vector<std::pair<Range, size_t>> moves;
+			ByteBuffer code;
+
+			for (auto &&range : ranges)
+			{
+				if (range.first == range.second)
+					continue;
+
+				moves.push_back({ range, code.size() });
+				code.write(buffer.data() + range.first, range.second - range.first);
+			}
+
+			std::sort(moves.begin(), moves.end());
+
+			auto relocate = [&moves](size_t offset) -> size_t
+			{
+				// the last range that starts at or before 'offset'
+				auto it = std::upper_bound(moves.begin(), moves.end(), offset,
+					[](size_t value, const std::pair<Range, size_t> &move) { return value < move.first.first; });
+				--it;
+
+				return it->second + (offset - it->first.first);
+			};
+
+			for (auto &&offset : positions)
+			{
+				offset = relocate(offset);
+				code.patch(offset, (uint64_t)(offset + sizeof(uint64_t)));
+			}
+
+			for (auto &&function : functions)
+			{
+				size_t instruction = relocate(function.instruction);
+
+				function.body = function.body - function.instruction + instruction;
+				function.instruction = instruction;
+			}
+
+			// the function table is in the order of the code
+			std::sort(functions.begin(), functions.end(), [](const Function &a, const Function &b)
+			{
+				return a.instruction < b.instruction;
+			});
+
+			buffer.swap(code);
+		}
+
+		void CodeGenerator::finish()
+		{
+			for (auto &&function : functions)
+				image.addFunction(function.name, function.body);
+		}
+
+		void CodeGenerator::increaseBlockLevel()
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_INC_BLOCK_LEVEL);
+			count(Instruction::CMD_INC_BLOCK_LEVEL, start);
+		}
+
+		void CodeGenerator::decreaseBlockLevel()
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_DEC_BLOCK_LEVEL);
+			count(Instruction::CMD_DEC_BLOCK_LEVEL, start);
+		}
+
+		void CodeGenerator::increaseReadLevel()
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_INC_READ_LEVEL);
+			count(Instruction::CMD_INC_READ_LEVEL, start);
+		}
+
+		void CodeGenerator::decreaseReadLevel()
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_DEC_READ_LEVEL);
+			count(Instruction::CMD_DEC_READ_LEVEL, start);
+		}
+
+		void CodeGenerator::leaveBlock()
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_LEAVE_BLOCK);
+			count(Instruction::CMD_LEAVE_BLOCK, start);
+		}
+
+		void CodeGenerator::stackPopObject(const std::string &varName, int whichStack)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_STACK_POP_OBJECT);
+			writer.writeInt((int32_t)whichStack);
+			writer.writeString(varName);
+			count(Instruction::CMD_STACK_POP_OBJECT, start);
+		}
+
+		void CodeGenerator::createBlock(unsigned int blockId, BlockType blockType, unsigned int parentId)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_CREATE_BLOCK);
+			writer.writeInt((int32_t)blockId);
+			writer.writeInt((int32_t)blockType);
+			writer.writeInt((int32_t)parentId);
+			writeBlockPosition();
+			count(Instruction::CMD_CREATE_BLOCK, start);
+		}
+
+		void CodeGenerator::goToBlock(unsigned int blockId)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_GO_TO_BLOCK);
+			writer.writeInt(blockId);
+			count(Instruction::CMD_GO_TO_BLOCK, start);
+		}
+
+		void CodeGenerator::goToIfTrue(unsigned int blockId)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_GO_TO_IF_TRUE);
+			writer.writeInt(blockId);
+			count(Instruction::CMD_GO_TO_IF_TRUE, start);
+		}
+
+		void CodeGenerator::goToIfFalse(unsigned int blockId)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_GO_TO_IF_FALSE);
+			writer.writeInt(blockId);
+			count(Instruction::CMD_GO_TO_IF_FALSE, start);
+		}
+
+		void CodeGenerator::addMember(const std::string &name)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_ADD_MEMBER);
+			writer.writeString(name);
+			count(Instruction::CMD_ADD_MEMBER, start);
+		}
+
+		void CodeGenerator::loadMember(const std::string &name)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_LOAD_MEMBER);
+			writer.writeString(name);
+			count(Instruction::CMD_LOAD_MEMBER, start);
+		}
+
+		void CodeGenerator::invoke()
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_INVOKE);
+			count(Instruction::CMD_INVOKE, start);
+		}
+
+		void CodeGenerator::callNativeFunction(unsigned int blockId, const std::string &name, unsigned int numArgs)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_CALL_NATIVE_FUNCTION);
+			writer.writeInt(blockId);
+			writer.writeInt(numArgs);
+			writer.writeString(name);
+			count(Instruction::CMD_CALL_NATIVE_FUNCTION, start);
+		}
+
+		void CodeGenerator::createFunction(const std::string &funName)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_CREATE_FUNCTION);
+			writer.writeString(funName);
+			writeBlockPosition();
+
+			// the body follows this instruction
+			functions.push_back({ funName, start, buffer.size() });
+			count(Instruction::CMD_CREATE_FUNCTION, start);
+		}
+
+		void CodeGenerator::createNativeClassInstance(const std::string &className)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_CREATE_NATIVE_CLASS_INSTANCE);
+			writer.writeString(className);
+			count(Instruction::CMD_CREATE_NATIVE_CLASS_INSTANCE, start);
+		}
+
+		void CodeGenerator::leaveFunction()
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_LEAVE_FUNCTION);
+			count(Instruction::CMD_LEAVE_FUNCTION, start);
+		}
+
+		void CodeGenerator::pushFunctionChain()
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_PUSH_FUNCTION_CHAIN);
+			count(Instruction::CMD_PUSH_FUNCTION_CHAIN, start);
+		}
+
+		void CodeGenerator::popFunctionChain()
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_POP_FUNCTION_CHAIN);
+			count(Instruction::CMD_POP_FUNCTION_CHAIN, start);
+		}
+
+		void CodeGenerator::ifStatement()
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_IF_STATEMENT);
+			count(Instruction::CMD_IF_STATEMENT, start);
+		}
+
+		void CodeGenerator::elseStatement()
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_ELSE_STATEMENT);
+			count(Instruction::CMD_ELSE_STATEMENT, start);
+		}
+
+		void CodeGenerator::leaveIfStatement()
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_LEAVE_IF_STATEMENT);
+			count(Instruction::CMD_LEAVE_IF_STATEMENT, start);
+		}
+
+		void CodeGenerator::leaveElseStatement()
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_LEAVE_ELSE_STATEMENT);
+			count(Instruction::CMD_LEAVE_ELSE_STATEMENT, start);
+		}
+
+		void CodeGenerator::varAddProperty(const std::string &varName, const std::string &propertyName)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_ADD_PROPERTY);
+			writer.writeString(varName);
+			writer.writeString(propertyName);
+			count(Instruction::CMD_ADD_PROPERTY, start);
+		}
+
+		void CodeGenerator::varPushProperty(const std::string &varName, const std::string &propertyName)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_PUSH_PROPERTY);
+			writer.writeString(varName);
+			writer.writeString(propertyName);
+			count(Instruction::CMD_PUSH_PROPERTY, start);
+		}
+
+		void CodeGenerator::createVariable(VarType varType, const std::string &varName)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_CREATE_VAR);
+			writer.writeInt((int32_t)varType);
+			writer.writeString(varName);
+			count(Instruction::CMD_CREATE_VAR, start);
+		}
+
+		void CodeGenerator::clearVariable(const std::string &varName)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_CLEAR_VAR);
+			writer.writeString(varName);
+			count(Instruction::CMD_CLEAR_VAR, start);
+		}
+
+		void CodeGenerator::deleteVariable(const std::string &varName)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_DELETE_VAR);
+			writer.writeString(varName);
+			count(Instruction::CMD_DELETE_VAR, start);
+		}
+
+		void CodeGenerator::loopBreak(int levelsToSkip)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_LOOP_BREAK);
+			writer.writeInt((int32_t)levelsToSkip);
+			count(Instruction::CMD_LOOP_BREAK, start);
+		}
+
+		void CodeGenerator::loopContinue(int levelsToSkip)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_LOOP_CONTINUE);
+			writer.writeInt((int32_t)levelsToSkip);
+			count(Instruction::CMD_LOOP_CONTINUE, start);
+		}
+
+		void CodeGenerator::loadVariable(const std::string &varName)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_LOAD_VARIABLE);
+			writer.writeString(varName);
+			count(Instruction::CMD_LOAD_VARIABLE, start);
+		}
+
+		void CodeGenerator::loadInteger(long value)
+		{
+			size_t start = buffer.size();
+			writer.writeInteger(value);
+			count(Instruction::CMD_LOAD_INTEGER, start);
+		}
+
+		void CodeGenerator::loadFloat(double value)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_LOAD_FLOAT);
+			buffer.write(value);
+			count(Instruction::CMD_LOAD_FLOAT, start);
+		}
+
+		void CodeGenerator::loadString(const std::string &value)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_LOAD_STRING);
+			writer.writeString(value);
+			count(Instruction::CMD_LOAD_STRING, start);
+		}
+
+		void CodeGenerator::loadNull()
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_LOAD_NULL);
+			count(Instruction::CMD_LOAD_NULL, start);
+		}
+
+		void CodeGenerator::opPush(int whichStack)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(Instruction::CMD_OP_PUSH);
+			writer.writeInt((int32_t)whichStack);
+			count(Instruction::CMD_OP_PUSH, start);
+		}
+
+		void CodeGenerator::op(Instruction operation)
+		{
+			size_t start = buffer.size();
+			writer.writeOpcode(operation);
+			count(operation, start);
+		}
+	}
+}
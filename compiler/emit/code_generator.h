@@ -0,0 +1,104 @@
+#ifndef __ZENITH_COMPILER_EMIT_CODE_GENERATOR_H__
+#define __ZENITH_COMPILER_EMIT_CODE_GENERATOR_H__
+
+#include <vector>
+#include <string>
+#include <utility>
+#include <cstdint>
+
+#include "byte_buffer.h"
+#include "image_writer.h"
+#include "instruction_writer.h"
+#include "../../enums.h"
+
+namespace zenith
+{
+	namespace compiler
+	{
+		struct EmitStats;
+
+		/* Writes the instructions of a module into its code buffer as they are
+		   compiled, in a single pass. Code that was compiled out of order is
+		   moved into place with layout(), which fixes up the positions in it. */
+		class CodeGenerator
+		{
+		public:
+			// a run of code, from the first offset up to the second
+			typedef std::pair<size_t, size_t> Range;
+
+		private:
+			struct Function
+			{
+				std::string name;
+				// where its instruction and its body start
+				size_t instruction;
+				uint64_t body;
+			};
+
+			ByteBuffer &buffer;
+			ImageWriter &image;
+			InstructionWriter &writer;
+			EmitStats &stats;
+
+			// added to the image by finish(), once they are where they will stay
+			std::vector<Function> functions;
+			// offsets of the block positions written in the fixed encoding
+			std::vector<size_t> positions;
+
+			void count(Instruction instruction, size_t start);
+			void writeBlockPosition();
+
+		public:
+			CodeGenerator(ByteBuffer &buffer, ImageWriter &image, InstructionWriter &writer, EmitStats &stats);
+
+			/* Offset in the code that the next instruction is written at. */
+			size_t position() const { return buffer.size(); }
+
+			void clear();
+			/* Reorder the code as 'ranges', which together cover all of it. */
+			void layout(const std::vector<Range> &ranges);
+			/* Add the functions that were written to the function table of the image. */
+			void finish();
+
+			void increaseBlockLevel();
+			void decreaseBlockLevel();
+			void increaseReadLevel();
+			void decreaseReadLevel();
+			void leaveBlock();
+			void stackPopObject(const std::string &varName, int whichStack);
+			void createBlock(unsigned int blockId, BlockType blockType, unsigned int parentId);
+			void goToBlock(unsigned int blockId);
+			void goToIfTrue(unsigned int blockId);
+			void goToIfFalse(unsigned int blockId);
+			void addMember(const std::string &name);
+			void loadMember(const std::string &name);
+			void invoke();
+			void callNativeFunction(unsigned int blockId, const std::string &name, unsigned int numArgs);
+			void createFunction(const std::string &funName);
+			void createNativeClassInstance(const std::string &className);
+			void leaveFunction();
+			void pushFunctionChain();
+			void popFunctionChain();
+			void ifStatement();
+			void elseStatement();
+			void leaveIfStatement();
+			void leaveElseStatement();
+			void createVariable(VarType varType, const std::string &varName);
+			void varAddProperty(const std::string &varName, const std::string &propertyName);
+			void varPushProperty(const std::string &varName, const std::string &propertyName);
+			void clearVariable(const std::string &varName);
+			void deleteVariable(const std::string &varName);
+			void loopBreak(int levelsToSkip);
+			void loopContinue(int levelsToSkip);
+			void loadVariable(const std::string &varName);
+			void loadInteger(long value);
+			void loadFloat(double value);
+			void loadString(const std::string &value);
+			void loadNull();
+			void opPush(int whichStack);
+			void op(Instruction operation);
+		};
+	}
+}
+
+#endif
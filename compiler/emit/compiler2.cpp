@@ -198,9 +198,7 @@ namespace zenith
 						t.close();
 
 						Lexer lexer(str, importModulePath);
-						auto tokens = lexer.scan();
-
-						Parser parser(tokens, lexer.state);
+						Parser parser(lexer);
 						auto unit = parser.parse();
 
 						if (state.modules.find(unit->moduleName) == state.modules.end())
@@ -1,9 +1,6 @@
 #include "default_handler.h"
 
 #include <algorithm>
-#include <fstream>
-
-#include "bytecode.h"
 
 #include "../lexer.h"
 #include "../parser.h"
@@ -16,10 +13,12 @@ namespace zenith
 		const std::string DefaultAstHandler::SELF_GLOBAL = "$_self_global"; // used to access outside members from within a class
 		const int DefaultAstHandler::LEVEL_GLOBAL = -1; // global variables are on this level
 
-		DefaultAstHandler::DefaultAstHandler(ParserState &state)
+		DefaultAstHandler::DefaultAstHandler(ParserState &state, CodeGenerator &code)
+			: state(state), code(code)
 		{
-			this->state = state;
-			this->self = { SELF_DEFAULT, nullptr };
+			this->selfDefault = symbols.intern(SELF_DEFAULT);
+			this->selfGlobal = symbols.intern(SELF_GLOBAL);
+			this->self = { selfDefault, nullptr };
 			levels[level] = Level();
 		}
 
@@ -28,6 +27,7 @@ namespace zenith
 			functionDefBlockIds.clear();
 			nativeFunctions.clear();
 			externalModules.clear();
+			nativeModules.clear();
 		}
 
 		void DefaultAstHandler::accept(ModuleAst *node)
@@ -36,6 +36,103 @@ namespace zenith
 
 			for (int i = 0; i < node->children.size(); i++)
 				accept(node->children[i].get());
+
+			if (lazyFunctions)
+				compileCalledFunctions();
+		}
+
+		void DefaultAstHandler::compileCalledFunctions()
+		{
+			// bodies are written after the module, then moved to where their functions are defined
+			std::map<size_t, std::vector<CodeGenerator::Range>> bodies;
+			size_t moduleEnd = code.position();
+
+			// compiling a body may call more functions
+			for (size_t i = 0; i < calledFunctions.size(); i++)
+			{
+				auto *node = calledFunctions[i];
+				auto &deferred = deferredFunctions[node];
+
+				size_t begin = code.position();
+				compileDeferredFunction(node, deferred);
+				deferred.compiled = true;
+
+				bodies[deferred.position].push_back({ begin, code.position() });
+			}
+
+			if (bodies.empty())
+				return;
+
+			std::vector<CodeGenerator::Range> ranges;
+			size_t from = 0;
+			for (auto &&at : bodies)
+			{
+				ranges.push_back({ from, at.first });
+				ranges.insert(ranges.end(), at.second.begin(), at.second.end());
+				from = at.first;
+			}
+			ranges.push_back({ from, moduleEnd });
+
+			code.layout(ranges);
+		}
+
+		void DefaultAstHandler::compileDeferredFunction(FunctionDefinitionAst *node, const DeferredFunction &deferred)
+		{
+			// the body is compiled against the scope it was defined in, as it is
+			// when compiled in place, so what was declared after it stays out of scope
+			Level &global = levels[LEVEL_GLOBAL];
+			Level hidden;
+			std::unordered_map<SymbolId, ClassAst*> hiddenClasses;
+
+			for (size_t i = deferred.visible; i < globalDeclarations.size(); i++)
+			{
+				SymbolId name = globalDeclarations[i];
+
+				auto variable = global.variableNames.find(name);
+				if (variable != global.variableNames.end())
+				{
+					hidden.variableNames.insert(*variable);
+					global.variableNames.erase(variable);
+				}
+
+				auto function = global.functionDeclarations.find(name);
+				if (function != global.functionDeclarations.end())
+				{
+					hidden.functionDeclarations.insert(*function);
+					global.functionDeclarations.erase(function);
+				}
+
+				auto classType = classTypes.find(name);
+				if (classType != classTypes.end())
+				{
+					hiddenClasses.insert(*classType);
+					classTypes.erase(classType);
+				}
+			}
+
+			compileFunction(node, deferred.symbol);
+
+			global.variableNames.insert(hidden.variableNames.begin(), hidden.variableNames.end());
+			global.functionDeclarations.insert(hidden.functionDeclarations.begin(), hidden.functionDeclarations.end());
+			classTypes.insert(hiddenClasses.begin(), hiddenClasses.end());
+		}
+
+		void DefaultAstHandler::declareGlobal(SymbolId name)
+		{
+			if (level == LEVEL_GLOBAL)
+				globalDeclarations.push_back(name);
+		}
+
+		size_t DefaultAstHandler::getNumUncompiledFunctions() const
+		{
+			size_t count = 0;
+			for (auto &&deferred : deferredFunctions)
+			{
+				if (!deferred.second.compiled)
+					count++;
+			}
+
+			return count;
 		}
 
 		void DefaultAstHandler::accept(AstNode *node)
@@ -46,76 +143,76 @@ namespace zenith
 			switch (node->nodeType)
 			{
 			case AST_IMPORTS:
-				accept(dynamic_cast<ImportsAst*>(node));
+				accept(static_cast<ImportsAst*>(node));
 				break;
 			case AST_IMPORT:
-				accept(dynamic_cast<ImportAst*>(node));
+				accept(static_cast<ImportAst*>(node));
 				break;
 			case AST_STATEMENT:
-				accept(dynamic_cast<StatementAst*>(node));
+				accept(static_cast<StatementAst*>(node));
 				break;
 			case AST_BLOCK:
-				accept(dynamic_cast<BlockAst*>(node));
+				accept(static_cast<BlockAst*>(node));
 				break;
 			case AST_EXPRESSION:
-				accept(dynamic_cast<ExpressionAst*>(node));
+				accept(static_cast<ExpressionAst*>(node));
 				break;
 			case AST_BINARY_OPERATION:
-				accept(dynamic_cast<BinaryOperationAst*>(node));
+				accept(static_cast<BinaryOperationAst*>(node));
 				break;
 			case AST_UNARY_OPERATION:
-				accept(dynamic_cast<UnaryOperationAst*>(node));
+				accept(static_cast<UnaryOperationAst*>(node));
 				break;
 			case AST_MEMBER_ACCESS:
-				accept(dynamic_cast<MemberAccessAst*>(node));
+				accept(static_cast<MemberAccessAst*>(node));
 				break;
 			case AST_VARIABLE_DECLARATION:
-				accept(dynamic_cast<VariableDeclarationAst*>(node));
+				accept(static_cast<VariableDeclarationAst*>(node));
 				break;
 			case AST_VARIABLE:
-				accept(dynamic_cast<VariableAst*>(node));
+				accept(static_cast<VariableAst*>(node));
 				break;
 			case AST_INTEGER:
-				accept(dynamic_cast<IntegerAst*>(node));
+				accept(static_cast<IntegerAst*>(node));
 				break;
 			case AST_FLOAT:
-				accept(dynamic_cast<FloatAst*>(node));
+				accept(static_cast<FloatAst*>(node));
 				break;
 			case AST_STRING:
-				accept(dynamic_cast<StringAst*>(node));
+				accept(static_cast<StringAst*>(node));
 				break;
 			case AST_TRUE:
-				accept(dynamic_cast<TrueAst*>(node));
+				accept(static_cast<TrueAst*>(node));
 				break;
 			case AST_FALSE:
-				accept(dynamic_cast<FalseAst*>(node));
+				accept(static_cast<FalseAst*>(node));
 				break;
 			case AST_NULL:
-				accept(dynamic_cast<NullAst*>(node));
+				accept(static_cast<NullAst*>(node));
 				break;
 			case AST_SELF:
-				accept(dynamic_cast<SelfAst*>(node));
+				accept(static_cast<SelfAst*>(node));
 				break;
 			case AST_NEW:
-				accept(dynamic_cast<NewAst*>(node));
+				accept(static_cast<NewAst*>(node));
 				break;
 			case AST_FUNCTION_DEFINITION:
-				accept(dynamic_cast<FunctionDefinitionAst*>(node));
+				accept(static_cast<FunctionDefinitionAst*>(node));
 				break;
 			case AST_FUNCTION_CALL:
-				accept(dynamic_cast<FunctionCallAst*>(node));
+				accept(static_cast<FunctionCallAst*>(node));
 				break;
 			case AST_CLASS:
-				accept(dynamic_cast<ClassAst*>(node));
+				accept(static_cast<ClassAst*>(node));
 				break;
 			case AST_RETURN_STATEMENT:
-				accept(dynamic_cast<ReturnStatementAst*>(node));
+				accept(static_cast<ReturnStatementAst*>(node));
 				break;
 			case AST_IF_STATEMENT:
-				accept(dynamic_cast<IfStatementAst*>(node));
+				accept(static_cast<IfStatementAst*>(node));
 				break;
 			case AST_FOR_LOOP:
-				accept(dynamic_cast<ForLoopAst*>(node));
+				accept(static_cast<ForLoopAst*>(node));
 				break;
 			default:
 				state.errors.push_back({ INTERNAL_ERROR, node->location });
@@ -146,24 +243,22 @@ namespace zenith
 				// Check if the module has already been imported
 				if (externalModules.find(importModulePath) == externalModules.end())
 				{
-					std::ifstream t(importModulePath);
+					std::string str;
 
-					if (!t.is_open())
+					if (!Lexer::readSource(importModulePath, str))
 						state.errors.push_back({ MODULE_NOT_FOUND, node->location, node->value });
 					else
 					{
-						std::string str((std::istreambuf_iterator<char>(t)),
-							std::istreambuf_iterator<char>());
-
-						t.close();
-
-						Lexer lexer(str, importModulePath);
-						auto tokens = lexer.scan();
-
-						Parser parser(tokens, lexer.state);
+						Lexer lexer(std::move(str), importModulePath);
+						Parser parser(lexer);
+						parser.setPreParse(preParse);
 						auto unit = parser.parse();
 
-						if (!isIdentifier(unit->moduleName))
+						if (nativeModules.find(unit->moduleName) != nativeModules.end())
+						{
+							// compiled ahead of time, its functions are called natively
+						}
+						else if (!isModule(unit->moduleName))
 						{
 							externalModules[importModulePath] = std::move(unit);
 
@@ -171,7 +266,12 @@ namespace zenith
 								state.errors.push_back(error);
 
 							for (std::unique_ptr<AstNode> &child : externalModules[importModulePath]->children)
-								accept(child.get());
+							{
+								if (inlineImports)
+									accept(child.get());
+								else
+									declare(child.get());
+							}
 						}
 						else // module's identifier has already been declared
 							state.errors.push_back({ MODULE_ALREADY_DEFINED, node->location, unit->moduleName });
@@ -180,6 +280,48 @@ namespace zenith
 			}
 		}
 
+		std::vector<std::string> DefaultAstHandler::getImportedFiles() const
+		{
+			std::vector<std::string> files;
+			for (auto &&module : externalModules)
+				files.push_back(module.first);
+
+			return files;
+		}
+
+		void DefaultAstHandler::declare(AstNode *node)
+		{
+			switch (node->nodeType)
+			{
+			case AST_FUNCTION_DEFINITION:
+			{
+				auto *definition = dynamic_cast<FunctionDefinitionAst*>(node);
+				SymbolId name = makeIdentifier(definition->module, definition->self,
+					definition->name, definition->arguments.size());
+
+				levels[level].functionDeclarations.insert({ name, definition });
+				declareGlobal(name);
+				break;
+			}
+			case AST_VARIABLE_DECLARATION:
+			{
+				auto *declaration = dynamic_cast<VariableDeclarationAst*>(node);
+				SymbolId name = makeIdentifier(declaration->module, declaration->self, declaration->name);
+
+				levels[level].variableNames.insert({ name, { false, nullptr } });
+				declareGlobal(name);
+				break;
+			}
+			case AST_CLASS:
+				// only records the type
+				accept(static_cast<ClassAst*>(node));
+				break;
+			default:
+				// statements and the module's own imports are its own business
+				break;
+			}
+		}
+
 		void DefaultAstHandler::accept(StatementAst *node)
 		{
 		}
@@ -195,7 +337,7 @@ namespace zenith
 			accept(node->value.get());
 
 			if (node->shouldClearStack)
-				addCommand<OpClear>();
+				code.op(Instruction::CMD_OP_CLEAR);
 		}
 
 		void DefaultAstHandler::accept(BinaryOperationAst *node)
@@ -209,23 +351,23 @@ namespace zenith
 			switch (node->op)
 			{
 			case OP_POWER:
-				addCommand<OpBinaryPow>();
+				code.op(Instruction::CMD_OP_POW);
 				break;
 			case OP_MULTIPLY:
-				addCommand<OpBinaryMul>();
+				code.op(Instruction::CMD_OP_MUL);
 				break;
 			case OP_INT_DIVIDE:
 			case OP_DIVIDE:
-				addCommand<OpBinaryDiv>();
+				code.op(Instruction::CMD_OP_DIV);
 				break;
 			case OP_MODULUS:
-				addCommand<OpBinaryMod>();
+				code.op(Instruction::CMD_OP_MOD);
 				break;
 			case OP_ADD:
-				addCommand<OpBinaryAdd>();
+				code.op(Instruction::CMD_OP_ADD);
 				break;
 			case OP_SUBTRACT:
-				addCommand<OpBinarySub>();
+				code.op(Instruction::CMD_OP_SUB);
 				break;
 				/*case OP_BINARY_XOR:
 				addCommand<OpBinaryBitXor>();
@@ -237,16 +379,16 @@ namespace zenith
 				addCommand<OpBinaryBitOr>();
 				break;*/
 			case OP_AND:
-				addCommand<OpBinaryAnd>();
+				code.op(Instruction::CMD_OP_AND);
 				break;
 			case OP_OR:
-				addCommand<OpBinaryOr>();
+				code.op(Instruction::CMD_OP_OR);
 				break;
 			case OP_EQUALS:
-				addCommand<OpBinaryEql>();
+				code.op(Instruction::CMD_OP_EQL);
 				break;
 			case OP_NOT_EQUAL:
-				addCommand<OpBinaryNotEql>();
+				code.op(Instruction::CMD_OP_NEQL);
 				break;
 				/*case OP_OUTPUT:
 				addCommand<OpBinaryOut>();
@@ -255,20 +397,20 @@ namespace zenith
 				addCommand<OpBinaryIn>();
 				break;*/
 			case OP_LESS:
-				addCommand<OpBinaryLT>();
+				code.op(Instruction::CMD_OP_LT);
 				break;
 			case OP_GREATER:
-				addCommand<OpBinaryGT>();
+				code.op(Instruction::CMD_OP_GT);
 				break;
 			case OP_GREATER_OR_EQUAL:
-				addCommand<OpBinaryGTE>();
+				code.op(Instruction::CMD_OP_GTE);
 				break;
 			case OP_LESS_OR_EQUAL:
-				addCommand<OpBinaryLTE>();
+				code.op(Instruction::CMD_OP_LTE);
 				break;
 			case OP_ASSIGN:
 			{
-				addCommand<OpBinaryAssign>();
+				code.op(Instruction::CMD_OP_ASSIGN);
 
 				if ((left->nodeType == AST_VARIABLE ||
 					left->nodeType == AST_MEMBER_ACCESS))
@@ -284,7 +426,7 @@ namespace zenith
 			}
 			case OP_ADD_ASSIGN:
 			{
-				addCommand<OpBinaryAddAssign>();
+				code.op(Instruction::CMD_OP_ADD_ASSIGN);
 
 				// cannot assign a value to a number or string, etc.
 				if (!(left->nodeType == AST_VARIABLE ||
@@ -295,7 +437,7 @@ namespace zenith
 			}
 			case OP_SUBTRACT_ASSIGN:
 			{
-				addCommand<OpBinarySubAssign>();
+				code.op(Instruction::CMD_OP_SUB_ASSIGN);
 
 				// cannot assign a value to a number or string, etc.
 				if (!(left->nodeType == AST_VARIABLE ||
@@ -306,7 +448,7 @@ namespace zenith
 			}
 			case OP_MULTIPLY_ASSIGN:
 			{
-				addCommand<OpBinaryMulAssign>();
+				code.op(Instruction::CMD_OP_MUL_ASSIGN);
 
 				// cannot assign a value to a number or string, etc.
 				if (!(left->nodeType == AST_VARIABLE ||
@@ -317,7 +459,7 @@ namespace zenith
 			}
 			case OP_DIVIDE_ASSIGN:
 			{
-				addCommand<OpBinaryDivAssign>();
+				code.op(Instruction::CMD_OP_DIV_ASSIGN);
 
 				// cannot assign a value to a number or string, etc.
 				if (!(left->nodeType == AST_VARIABLE ||
@@ -353,13 +495,13 @@ namespace zenith
 			switch (node->op)
 			{
 			case OP_NOT:
-				addCommand<OpUnaryNot>();
+				code.op(Instruction::CMD_OP_UNARY_NOT);
 				break;
 			case OP_ADD:
-				addCommand<OpUnaryPos>();
+				code.op(Instruction::CMD_OP_UNARY_POS);
 				break;
 			case OP_SUBTRACT:
-				addCommand<OpUnaryMinus>();
+				code.op(Instruction::CMD_OP_UNARY_NEG);
 				break;
 			default:
 				state.errors.push_back({ ILLEGAL_OPERATOR,
@@ -389,7 +531,7 @@ namespace zenith
 
 		void DefaultAstHandler::accept(VariableDeclarationAst *node)
 		{
-			std::string identName = makeIdentifier(node->module,
+			SymbolId identName = makeIdentifier(node->module,
 				node->self,
 				node->name);
 
@@ -402,7 +544,8 @@ namespace zenith
 			else
 			{
 				levels[level].variableNames.insert({ identName, {false, nullptr} });
-				addCommand<VarCreate>(VAR_TYPE_ANY, identName);
+				declareGlobal(identName);
+				code.createVariable(VAR_TYPE_ANY, symbols.mangle(identName));
 
 				if (node->assignment != nullptr)
 					accept(node->assignment.get());
@@ -411,44 +554,44 @@ namespace zenith
 
 		void DefaultAstHandler::accept(VariableAst *node)
 		{
-			std::string identName = makeIdentifier(node->module, node->self, node->name);
+			SymbolId identName = makeIdentifier(node->module, node->self, node->name);
 
 			if (!varInScope(identName))
 				state.errors.push_back({ UNDECLARED_IDENTIFIER,
 					node->location,
 					node->name });
 			else
-				addCommand<LoadVariable>(identName);
+				code.loadVariable(symbols.mangle(identName));
 		}
 
 		void DefaultAstHandler::accept(IntegerAst *node)
 		{
-			addCommand<LoadInteger>(node->value);
+			code.loadInteger(node->value);
 		}
 
 		void DefaultAstHandler::accept(FloatAst *node)
 		{
-			addCommand<LoadFloat>(node->value);
+			code.loadFloat(node->value);
 		}
 
 		void DefaultAstHandler::accept(StringAst *node)
 		{
-			addCommand<LoadString>(node->value);
+			code.loadString(node->value);
 		}
 
 		void DefaultAstHandler::accept(TrueAst *node)
 		{
-			addCommand<LoadInteger>(1);
+			code.loadInteger(1);
 		}
 
 		void DefaultAstHandler::accept(FalseAst *node)
 		{
-			addCommand<LoadInteger>(0);
+			code.loadInteger(0);
 		}
 
 		void DefaultAstHandler::accept(NullAst *node)
 		{
-			addCommand<LoadNull>();
+			code.loadNull();
 		}
 
 		void DefaultAstHandler::accept(SelfAst *node)
@@ -459,12 +602,12 @@ namespace zenith
 			else
 			{
 				// load the variable that "self" refers to
-				std::string &selfName = self.first;
+				SymbolId selfName = self.first;
 
 				if (!varInScope(selfName))
 					state.errors.push_back({ SELF_NOT_DEFINED, node->location });
 				else
-					addCommand<LoadVariable>(selfName);
+					code.loadVariable(symbols.mangle(selfName));
 			}
 		}
 
@@ -487,17 +630,17 @@ namespace zenith
 					else
 						classInstanceId[classType] += 1;
 
-					std::string mangledClassName = makeIdentifier(constructorAst->module,
+					SymbolId mangledClassName = makeIdentifier(constructorAst->module,
 						constructorAst->self,
 						classType);
 
 					bool isAnonClass = node->identifier.empty();
 
-					std::string mangledClassInstance = makeIdentifier(node->module,
+					SymbolId mangledClassInstance = makeIdentifier(node->module,
 						node->self,
 						(!isAnonClass) ?
 						node->identifier :
-						(mangledClassName + std::to_string(classInstanceId[classType])));
+						(symbols.mangle(mangledClassName) + std::to_string(classInstanceId[classType])));
 
 					auto it = classTypes.find(mangledClassName);
 					if (it != classTypes.end())
@@ -512,7 +655,7 @@ namespace zenith
 							{
 								state.errors.push_back({ UNDECLARED_IDENTIFIER,
 									node->location,
-									mangledClassInstance });
+									symbols.mangle(mangledClassInstance) });
 							}
 							else
 							{
@@ -528,7 +671,7 @@ namespace zenith
 							currentLevel.variableNames.insert({ mangledClassInstance, {true, it->second} });
 
 						// TODO: Load an actual wrapper to what class type this is
-						addCommand<LoadString>(classType);
+						code.loadString(classType);
 
 						// create class instance
 						self = { mangledClassInstance, it->second };
@@ -538,12 +681,12 @@ namespace zenith
 							{
 								auto *varDecl = dynamic_cast<VariableDeclarationAst*>(member.get());
 								// testing adding object member
-								addCommand<AddMember>(varDecl->name);
+								code.addMember(varDecl->name);
 							}
 
 							accept(member.get());
 						}
-						self = { SELF_DEFAULT, nullptr };
+						self = { selfDefault, nullptr };
 					}
 					else
 						state.errors.push_back({ UNKNOWN_CLASS_TYPE, node->location, classType });
@@ -555,7 +698,7 @@ namespace zenith
 
 		void DefaultAstHandler::accept(FunctionDefinitionAst *node)
 		{
-			std::string mangledName = makeIdentifier(node->module, node->self, node->name, node->arguments.size());
+			SymbolId mangledName = makeIdentifier(node->module, node->self, node->name, node->arguments.size());
 
 			FunctionDefinitionAst *tmpNode = nullptr;
 			if ((fnInScope(mangledName, node->arguments.size(), tmpNode) == FN_FOUND) ||
@@ -568,58 +711,72 @@ namespace zenith
 			}
 			else
 			{
-				levels[level].functionDeclarations.push_back({ mangledName, node });
+				levels[level].functionDeclarations.insert({ mangledName, node });
+				declareGlobal(mangledName);
 
 			/*	functionDefBlockIds[node] = blockIdNum;
 				addCommand<CreateBlock>(FUNCTION_BLOCK,
 					blockIdNum++,
 					level);*/
 
-				addCommand<CreateFunction>(mangledName);
+				if (lazyFunctions && level == LEVEL_GLOBAL && node->self.second == nullptr)
+					deferredFunctions[node] = { mangledName, code.position(), globalDeclarations.size(), false };
+				else
+					compileFunction(node, mangledName);
+			}
+		}
 
-				auto *fnBody = dynamic_cast<BlockAst*>(node->block.get());
+		void DefaultAstHandler::compileFunction(FunctionDefinitionAst *node, SymbolId name)
+		{
+			code.createFunction(symbols.mangle(name));
 
-				if (fnBody != nullptr)
-				{
-					// add return statement
-					if (fnBody->children.size() == 0 ||
-						fnBody->children.back()->nodeType != AST_RETURN_STATEMENT)
-					{
-						auto returnValue = std::make_unique<NullAst>(node->block->location, node->module);
-						auto returnStatement = std::make_unique<ReturnStatementAst>(node->block->location,
-							node->module,
-							std::move(returnValue));
-						fnBody->addChild(std::move(returnStatement));
-					}
+			if (node->bodyBegin != -1)
+				Parser::parseBody(node, state.errors);
 
-					increaseBlock(FUNCTION_BLOCK);
+			auto *fnBody = dynamic_cast<BlockAst*>(node->block.get());
 
-					for (int i = node->arguments.size() - 1; i >= 0; i--)
-					{
-						const std::string &str = node->arguments[i];
-						// mangle argument variable
-						std::string mangledArg = makeIdentifier(node->module, node->self, str);
+			if (fnBody != nullptr)
+			{
+				// add return statement
+				if (fnBody->children.size() == 0 ||
+					fnBody->children.back()->nodeType != AST_RETURN_STATEMENT)
+				{
+					auto returnValue = std::make_unique<NullAst>(node->block->location, node->module);
+					auto returnStatement = std::make_unique<ReturnStatementAst>(node->block->location,
+						node->module,
+						std::move(returnValue));
+					fnBody->addChild(std::move(returnStatement));
+				}
 
-						levels[level].variableNames.insert({ mangledArg, {false, nullptr} });
+				increaseBlock(FUNCTION_BLOCK);
 
-						addCommand<VarCreate>(VAR_TYPE_ANY, mangledArg);
-						addCommand<StackPopObject>(mangledArg, STACK_FUNCTION_PARAM);
-					}
+				for (int i = node->arguments.size() - 1; i >= 0; i--)
+				{
+					const std::string &str = node->arguments[i];
+					// mangle argument variable
+					SymbolId argName = makeIdentifier(node->module, node->self, str);
+					const std::string &mangledArg = symbols.mangle(argName);
 
-					accept(fnBody);
-					decreaseBlock();
+					levels[level].variableNames.insert({ argName, {false, nullptr} });
+
+					code.createVariable(VAR_TYPE_ANY, mangledArg);
+					code.stackPopObject(mangledArg, STACK_FUNCTION_PARAM);
 				}
+
+				accept(fnBody);
+				decreaseBlock();
 			}
 		}
 
 		void DefaultAstHandler::accept(FunctionCallAst *node)
 		{
 			FunctionDefinitionAst *definition = nullptr;
-			std::string mangledName = makeIdentifier(node->module, node->self, node->name, node->arguments.size());
+			SymbolId mangledName = makeIdentifier(node->module, node->self, node->name, node->arguments.size());
 			ReturnMessage msg = fnInScope(mangledName, node->arguments.size(), definition);
 
 			if (msg == FN_NOT_FOUND)
-				state.errors.push_back({ FUNCTION_NOT_FOUND, node->location, node->name + " (" + unmangleIdentifier(mangledName) + ")" });
+				state.errors.push_back({ FUNCTION_NOT_FOUND, node->location,
+					node->name + " (" + unmangleIdentifier(symbols.mangle(mangledName)) + ")" });
 			else if (msg == FN_TOO_MANY_ARGS)
 				state.errors.push_back({ TOO_MANY_ARGS, node->location, node->name });
 			else if (msg == FN_TOO_FEW_ARGS)
@@ -630,11 +787,11 @@ namespace zenith
 				for (int i = node->arguments.size() - 1; i >= 0; i--)
 				{
 					// must temporarily increase block level to avoid conflicts
-					addCommand<IncreaseReadLevel>();
+					code.increaseReadLevel();
 					increaseBlock(UNDEFINED_BLOCK);
 
 					accept(node->arguments[i].get());
-					addCommand<OpPush>(STACK_FUNCTION_PARAM);
+					code.opPush(STACK_FUNCTION_PARAM);
 
 					decreaseBlock();
 				}
@@ -642,20 +799,28 @@ namespace zenith
 				// Call the function. The variable name is passed so that it can be set to the result
 				if (!definition->isNative)
 				{
-					addCommand<LoadVariable>(mangledName);
-					addCommand<Invoke>();
+					auto deferred = deferredFunctions.find(definition);
+					if (deferred != deferredFunctions.end() && !deferred->second.compiled)
+					{
+						// compiled once, at the end of the module
+						deferred->second.compiled = true;
+						calledFunctions.push_back(definition);
+					}
+
+					code.loadVariable(symbols.mangle(mangledName));
+					code.invoke();
 				}
 				else
-					addCommand<CallNativeFunction>(node->name,
-						functionDefBlockIds[definition],
+					code.callNativeFunction(functionDefBlockIds[definition],
+						nativeNames[definition],
 						definition->arguments.size());
 			}
 		}
 
 		void DefaultAstHandler::accept(ClassAst *node)
 		{
-			std::string mangledName = makeIdentifier(node->module, 
-				node->self, 
+			SymbolId mangledName = makeIdentifier(node->module,
+				node->self,
 				node->name);
 
 			if (isIdentifier(mangledName) || isModule(node->name))
@@ -665,17 +830,20 @@ namespace zenith
 					node->name));
 			}
 			else
+			{
 				// add the class type for later use
 				classTypes.insert({ mangledName, node });
+				declareGlobal(mangledName);
+			}
 		}
 
 		void DefaultAstHandler::accept(IfStatementAst *node)
 		{
 			accept(node->cond_expr.get());
 
-			addCommand<IfStatement>();
-			addCommand<CreateBlock>(IF_STATEMENT_BLOCK,
-				blockIdNum++,
+			code.ifStatement();
+			code.createBlock(blockIdNum++,
+				IF_STATEMENT_BLOCK,
 				level);
 
 			increaseBlock(IF_STATEMENT_BLOCK);
@@ -684,7 +852,7 @@ namespace zenith
 
 			if (node->elseStatement != nullptr)
 			{
-				addCommand<ElseStatement>();
+				code.elseStatement();
 				increaseBlock(ELSE_STATEMENT_BLOCK);
 				accept(node->elseStatement.get());
 				decreaseBlock();
@@ -694,7 +862,7 @@ namespace zenith
 		void DefaultAstHandler::accept(ReturnStatementAst *node)
 		{
 			accept(node->value.get());
-			addCommand<OpPush>(STACK_FUNCTION_CALLBACK);
+			code.opPush(STACK_FUNCTION_CALLBACK);
 
 			int startLevel = level;
 			Level *tmpFrame = &levels[startLevel];
@@ -703,29 +871,31 @@ namespace zenith
 				tmpFrame->type != FUNCTION_BLOCK)
 			{
 				//TODO: clear vars from block
-				addCommand<LeaveBlock>();
+				code.leaveBlock();
 
 				tmpFrame = &levels[--startLevel];
 			}
 			//TODO: clear vars from final block
-			addCommand<LeaveFunction>();
+			code.leaveFunction();
 		}
 
 		void DefaultAstHandler::accept(ForLoopAst *node)
 		{
 			// temporarily increase block level to avoid conflicts
-			addCommand<IncreaseReadLevel>();
+			code.increaseReadLevel();
 			increaseBlock(UNDEFINED_BLOCK);
 
 			if (node->init_expr != nullptr)
 				accept(node->init_expr.get());
 
-			addCommand<CreateBlock>(LABEL_BLOCK,
-				blockIdNum++,
+			// nested blocks also take ids, so remember the one of the loop header
+			int labelId = blockIdNum++;
+			code.createBlock(labelId,
+				LABEL_BLOCK,
 				level);
 
 			accept(node->cond_expr.get());
-			addCommand<IfStatement>();
+			code.ifStatement();
 
 			increaseBlock(IF_STATEMENT_BLOCK);
 			accept(node->block.get());
@@ -734,7 +904,7 @@ namespace zenith
 				accept(node->inc_expr.get());
 
 			decreaseBlock();
-			addCommand<GoToIfTrue>(blockIdNum - 1);
+			code.goToIfTrue(labelId);
 			decreaseBlock();
 		}
 
@@ -743,11 +913,11 @@ namespace zenith
 		{
 			auto *defaultModule = dynamic_cast<ModuleAst*>(node->module);
 
-			std::pair<std::string, ClassAst*> defaultSelf = self;
+			std::pair<SymbolId, ClassAst*> defaultSelf = self;
 			if (node->self.second)
 				defaultSelf = node->self;
 
-			std::string mangledName;
+			SymbolId mangledName;
 			bool isModuleName = false, 
 				isSelfRef = false, 
 				isVariableName = false, 
@@ -766,7 +936,7 @@ namespace zenith
 					// TODO: maybe add a warning that it is
 					// redundant to mention module name?
 					isModuleName = true;
-					defaultSelf = { SELF_GLOBAL, nullptr };
+					defaultSelf = { selfGlobal, nullptr };
 				}
 				else
 				{
@@ -776,11 +946,19 @@ namespace zenith
 						{
 							isModuleName = true;
 							defaultModule = module.second.get();
-							defaultSelf = { SELF_GLOBAL, nullptr };
+							defaultSelf = { selfGlobal, nullptr };
 
 							break;
 						}
 					}
+
+					auto nativeModule = nativeModules.find(leftAst->name);
+					if (!isModuleName && nativeModule != nativeModules.end())
+					{
+						isModuleName = true;
+						defaultModule = nativeModule->second.get();
+						defaultSelf = { selfGlobal, nullptr };
+					}
 				}
 
 				// search for variable
@@ -878,16 +1056,16 @@ namespace zenith
 					return true;
 			}
 
-			return false;
+			return nativeModules.find(name) != nativeModules.end();
 		}
 
-		bool DefaultAstHandler::varInScope(const std::string &name)
+		bool DefaultAstHandler::varInScope(SymbolId name)
 		{
 			VariableInfo dummyInfo;
 			return varInScope(name, dummyInfo);
 		}
 
-		bool DefaultAstHandler::varInScope(const std::string &name,
+		bool DefaultAstHandler::varInScope(SymbolId name,
 			VariableInfo &outInfo)
 		{
 			int startLevel = level;
@@ -909,7 +1087,7 @@ namespace zenith
 			return false;
 		}
 
-		int DefaultAstHandler::getVarLevel(const std::string &name)
+		int DefaultAstHandler::getVarLevel(SymbolId name)
 		{
 			int startLevel = level;
 
@@ -929,7 +1107,7 @@ namespace zenith
 			return LEVEL_GLOBAL - 1;
 		}
 
-		ReturnMessage DefaultAstHandler::fnInScope(const std::string &name, int nArgs, FunctionDefinitionAst *&out)
+		ReturnMessage DefaultAstHandler::fnInScope(SymbolId name, int nArgs, FunctionDefinitionAst *&out)
 		{
 			ReturnMessage status = FN_NOT_FOUND;
 
@@ -938,19 +1116,18 @@ namespace zenith
 			{
 				Level &currentLevel = levels.at(startLevel);
 
-				for (auto &&def : currentLevel.functionDeclarations)
+				auto it = currentLevel.functionDeclarations.find(name);
+				if (it != currentLevel.functionDeclarations.end())
 				{
-					if (def.first == name)
+					auto *def = it->second;
+					if (def->arguments.size() < nArgs)
+						status = FN_TOO_MANY_ARGS;
+					else if (def->arguments.size() > nArgs)
+						status = FN_TOO_FEW_ARGS;
+					else
 					{
-						if (def.second->arguments.size() < nArgs)
-							status = FN_TOO_MANY_ARGS;
-						else if (def.second->arguments.size() > nArgs)
-							status = FN_TOO_FEW_ARGS;
-						else
-						{
-							out = def.second;
-							return FN_FOUND;
-						}
+						out = def;
+						return FN_FOUND;
 					}
 				}
 
@@ -966,32 +1143,27 @@ namespace zenith
 			frame.type = type;
 			levels[++level] = frame;
 
-			addCommand<IncreaseBlockLevel>();
+			code.increaseBlockLevel();
 		}
 
 		void DefaultAstHandler::decreaseBlock()
 		{
 			levels[level--] = Level();
-			addCommand<DecreaseBlockLevel>();
+			code.decreaseBlockLevel();
 		}
 
-		std::string DefaultAstHandler::makeIdentifier(AstNode *moduleAst,
-			std::pair<std::string, ClassAst*> memberOf,
+		SymbolId DefaultAstHandler::makeIdentifier(AstNode *moduleAst,
+			std::pair<SymbolId, ClassAst*> memberOf,
 			const std::string &original,
 			int numArguments)
 		{
 			if (!moduleAst || moduleAst->nodeType != AST_MODULE)
 				throw std::runtime_error("Invalid module");
 
-			auto *module = dynamic_cast<ModuleAst*>(moduleAst);
-			if (!module)
-				throw std::runtime_error("Not a module");
-
-			std::string result("$");
-			result += "_M" + module->moduleName;
+			auto *module = static_cast<ModuleAst*>(moduleAst);
 
-			std::pair<std::string, ClassAst*> clazz = { "", nullptr };
-			if (memberOf.first != SELF_GLOBAL)
+			std::pair<SymbolId, ClassAst*> clazz = { NO_SYMBOL, nullptr };
+			if (memberOf.first != selfGlobal)
 			{
 				if (!memberOf.second)
 					clazz = self;
@@ -1003,15 +1175,10 @@ namespace zenith
 				}
 			}
 
-			if (clazz.second != nullptr)
-				result += "_C" + clazz.first;
-
-			result += "_I" + original;
-
-			if (numArguments > 0)
-				result += "_A" + std::to_string(numArguments);
-
-			return result;
+			return symbols.intern(symbols.intern(module->moduleName),
+				(clazz.second != nullptr) ? clazz.first : NO_SYMBOL,
+				symbols.intern(original),
+				numArguments);
 		}
 
 		std::string DefaultAstHandler::unmangleIdentifier(const std::string &mangled)
@@ -1072,11 +1239,9 @@ namespace zenith
 		}
 
 		// is this identifier already created in an accessible scope?
-		bool DefaultAstHandler::isIdentifier(const std::string &name, bool thisScopeOnly)
+		bool DefaultAstHandler::isIdentifier(SymbolId name, bool thisScopeOnly)
 		{
-			if (isModule(name))
-				return true;
-
+			// module names are plain names, never those of a declaration
 			if (thisScopeOnly)
 			{
 				auto &currentLevel = levels[level];
@@ -1088,14 +1253,8 @@ namespace zenith
 				else
 				{
 					// search functions
-					auto elt = std::find_if(currentLevel.functionDeclarations.begin(),
-						currentLevel.functionDeclarations.end(),
-						[&name](const std::pair<std::string, FunctionDefinitionAst*> &element)
-					{
-						return element.first == name;
-					});
-
-					if (elt != currentLevel.functionDeclarations.end())
+					if (currentLevel.functionDeclarations.find(name)
+						!= currentLevel.functionDeclarations.end())
 						return true;
 					else
 					{
@@ -1124,7 +1283,8 @@ namespace zenith
 
 		void DefaultAstHandler::defineFunction(const std::string &name,
 			const std::string &moduleName,
-			size_t numArgs)
+			size_t numArgs,
+			bool qualified)
 		{
 			std::vector<std::string> args;
 			for (size_t i = 0; i < numArgs; i++)
@@ -1133,10 +1293,8 @@ namespace zenith
 				args.push_back(arg);
 			}
 
-			std::string mangledName = "$_M" + moduleName + "_I" + name;
-
-			if (numArgs > 0)
-				mangledName += "_A" + std::to_string(numArgs);
+			SymbolId symbol = symbols.intern(symbols.intern(moduleName), NO_SYMBOL, symbols.intern(name), (int)numArgs);
+			std::string mangledName = symbols.mangle(symbol);
 
 			std::unique_ptr<FunctionDefinitionAst> definition
 				= std::make_unique<FunctionDefinitionAst>(SourceLocation(-1, -1, ""),
@@ -1147,11 +1305,15 @@ namespace zenith
 					true);
 
 			nativeFunctions.push_back(std::move(definition));
-			levels[level].functionDeclarations.push_back({ mangledName, nativeFunctions.back().get() });
+			levels[level].functionDeclarations.insert({ symbol, nativeFunctions.back().get() });
+
+			nativeNames[nativeFunctions.back().get()] = qualified ? mangledName : name;
+			if (qualified && nativeModules.find(moduleName) == nativeModules.end())
+				nativeModules[moduleName] = std::make_unique<ModuleAst>(SourceLocation(-1, -1, ""), moduleName);
 
 			functionDefBlockIds[nativeFunctions.back().get()] = blockIdNum;
-			addCommand<CreateBlock>(FUNCTION_BLOCK,
-				blockIdNum++,
+			code.createBlock(blockIdNum++,
+				FUNCTION_BLOCK,
 				level);
 		}
 	}
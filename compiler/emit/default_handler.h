@@ -4,11 +4,13 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <utility>
 
-#include "bytecode.h"
+#include "code_generator.h"
 #include "../ast.h"
 #include "../state.h"
+#include "../symbols.h"
 
 namespace zenith
 {
@@ -29,22 +31,31 @@ namespace zenith
 
 		struct Level
 		{
-			// maps the 'mangled' function names to their definitions
-			std::vector<
-				std::pair<
-					std::string, 
-					FunctionDefinitionAst*
-				>
+			// maps the functions declared on this level to their definitions
+			std::unordered_map<
+				SymbolId,
+				FunctionDefinitionAst*
 			> functionDeclarations;
-			// holds all variable names
-			std::map<
-					std::string,
-					VariableInfo
+			// holds all variables
+			std::unordered_map<
+				SymbolId,
+				VariableInfo
 			> variableNames;
 			// is it a function, if statement, loop, etc.
 			BlockType type;
 		};
 
+		/* A global function whose body is only compiled once something calls it. */
+		struct DeferredFunction
+		{
+			SymbolId symbol;
+			// where in the code the function is created
+			size_t position;
+			// the global declarations made up to and including it, its body only sees those
+			size_t visible;
+			bool compiled;
+		};
+
 		enum ReturnMessage
 		{
 			FN_NOT_FOUND,
@@ -59,8 +70,6 @@ namespace zenith
 		class DefaultAstHandler : public AstHandler
 		{
 		private:
-			BytecodeCommandList commandList;
-
 			std::vector<
 				std::shared_ptr<
 				FunctionDefinitionAst
@@ -73,10 +82,17 @@ namespace zenith
 					ModuleAst
 				>
 			> externalModules;
+			// modules whose functions are all native, they replace imports of the same name
+			std::map<
+				std::string,
+				std::unique_ptr<
+					ModuleAst
+				>
+			> nativeModules;
 			ModuleAst *mainModule;
 
-			std::map<
-				std::string, 
+			std::unordered_map<
+				SymbolId,
 				ClassAst*
 			> classTypes;
 
@@ -86,64 +102,97 @@ namespace zenith
 			> classInstanceId;
 
 			std::pair<
-				std::string, 
+				SymbolId,
 				ClassAst*
 			> self;
 
+			// identifiers are looked up by id, and only mangled when they are emitted
+			SymbolTable symbols;
+
 			static const std::string SELF_DEFAULT, SELF_GLOBAL;
+			SymbolId selfDefault, selfGlobal;
 			static const int LEVEL_GLOBAL;
 
 			int blockIdNum = 0;
+			// when false, only the declarations of imported modules are taken
+			bool inlineImports = true;
+
+			// when true, global functions are compiled once a call to them is compiled
+			bool lazyFunctions = false;
+			// when true, imported modules are parsed without their function bodies
+			bool preParse = false;
+			std::map<FunctionDefinitionAst*, DeferredFunction> deferredFunctions;
+			// global declarations in the order they were made
+			std::vector<SymbolId> globalDeclarations;
+			// deferred functions that have been called, waiting to be compiled
+			std::vector<FunctionDefinitionAst*> calledFunctions;
 			std::map<FunctionDefinitionAst*, int> functionDefBlockIds;
+			// the name a native function is bound under in the VM
+			std::map<FunctionDefinitionAst*, std::string> nativeNames;
 
 			int level = -1;
 			std::map<int, Level> levels;
 
 			bool isModule(const std::string &name);
 
-			bool varInScope(const std::string &name);
-			bool varInScope(const std::string &name, 
+			bool varInScope(SymbolId name);
+			bool varInScope(SymbolId name,
 				VariableInfo &outInfo);
-			int getVarLevel(const std::string &name);
-			ReturnMessage fnInScope(const std::string &name, 
+			int getVarLevel(SymbolId name);
+			ReturnMessage fnInScope(SymbolId name,
 				int nArgs, 
 				FunctionDefinitionAst *&out);
 
-			ParserState state;
+			// borrowed from the emitter
+			ParserState &state;
+			CodeGenerator &code;
+
+			/* Declare a top level node of a module that is compiled separately. */
+			void declare(AstNode *node);
+
+			void compileFunction(FunctionDefinitionAst *node, SymbolId name);
+			void compileCalledFunctions();
+			void compileDeferredFunction(FunctionDefinitionAst *node, const DeferredFunction &deferred);
+			/* Record a declaration at the global level, for the deferred functions made after it. */
+			void declareGlobal(SymbolId name);
 
 			void increaseBlock(BlockType type);
 			void decreaseBlock();
 
-			std::string makeIdentifier(AstNode *moduleAst, 
-				std::pair<std::string, ClassAst*> memberOf,
+			SymbolId makeIdentifier(AstNode *moduleAst,
+				std::pair<SymbolId, ClassAst*> memberOf,
 				const std::string &original,
 				int numArguments = 0);
 			std::string unmangleIdentifier(const std::string &mangled);
-			bool isIdentifier(const std::string &name, 
+			bool isIdentifier(SymbolId name,
 				bool thisScopeOnly=false);
 
 			AstNode *loopMemberAccess(MemberAccessAst *node);
 
-			template <typename T, typename ... Args>
-			typename std::enable_if<std::is_base_of<BytecodeCommand, T>::value, void>::type
-				addCommand(Args... args)
-			{
-				auto tPtr = std::make_shared<T>(args...);
-				commandList.push_back(tPtr);
-			}
-
 		public:
-			DefaultAstHandler(ParserState &state);
+			DefaultAstHandler(ParserState &state, CodeGenerator &code);
 			~DefaultAstHandler();
 
 			void accept(ModuleAst *node);
 
 			ParserState &getState() { return state; }
-			BytecodeCommandList &getCommands() { return commandList; }
-
+			/* Compile imported modules into this one, or leave them to be linked in. */
+			void setInlineImports(bool inlineImports) { this->inlineImports = inlineImports; }
+			/* Leave out the bodies of global functions that are never called. */
+			void setLazyFunctions(bool lazyFunctions) { this->lazyFunctions = lazyFunctions; }
+			size_t getNumDeferredFunctions() const { return deferredFunctions.size(); }
+			size_t getNumUncompiledFunctions() const;
+			/* Parse function bodies of imported modules only when they are compiled. */
+			void setPreParse(bool preParse) { this->preParse = preParse; }
+			/* Paths of the files that were imported while compiling. */
+			std::vector<std::string> getImportedFiles() const;
+
+			/* Declare a native function. A qualified one is a member of its own module,
+			   which is called as module.name() and bound under its mangled name. */
 			void defineFunction(const std::string &name, 
 				const std::string &moduleName, 
-				size_t numArgs);
+				size_t numArgs,
+				bool qualified = false);
 
 		protected:
 			void accept(AstNode *node);
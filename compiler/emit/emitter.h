@@ -5,10 +5,14 @@
 #include <string>
 #include <map>
 #include <fstream>
+#include <ostream>
 #include <stdint.h>
 #include <memory>
 
-#include "bytecode.h"
+#include "byte_buffer.h"
+#include "image_writer.h"
+#include "instruction_writer.h"
+#include "code_generator.h"
 #include "../state.h"
 #include "../../enums.h"
 #include "../ast.h"
@@ -17,92 +21,100 @@ namespace zenith
 {
 	namespace compiler
 	{
-		struct BlockCreate
-		{
-			int32_t blockId;
-			int32_t blockType;
-			int32_t parentId;
-			uint64_t blockPos;
-		};
-
 		struct ExternalFunctionDefine
 		{
 			std::string name;
 			std::string moduleName;
 			size_t nArgs;
+			// called as a member of its module, and bound under its mangled name
+			bool qualified;
+		};
+
+		enum OpcodeClass
+		{
+			OPCODE_CLASS_BLOCK,
+			OPCODE_CLASS_BRANCH,
+			OPCODE_CLASS_VARIABLE,
+			OPCODE_CLASS_CONSTANT,
+			OPCODE_CLASS_OPERATOR,
+			OPCODE_CLASS_FUNCTION,
+
+			NUM_OPCODE_CLASSES
+		};
+
+		/* Instructions and bytes emitted, by class of opcode. */
+		struct EmitStats
+		{
+			size_t count[NUM_OPCODE_CLASSES] = {};
+			size_t bytes[NUM_OPCODE_CLASSES] = {};
+
+			static OpcodeClass classOf(Instruction instruction);
+
+			void add(Instruction instruction, size_t numBytes);
+			void print(std::ostream &os) const;
 		};
 
 		class Emitter
 		{
 		private:
-			std::ofstream filestream;
-			std::vector<BlockCreate> block_creates;
-			int appendOffset; /* the offset will be incremented every time createBlock() is called,
-								because in the end we will have to append to file. */
-			bool hideVariableNames;
-			bool closed;
-			bool append;
-			bool bigEndian;
-			bool writeLabelsToBeginning;
-
-			std::streampos lastPosition;
+			ByteBuffer buffer;
+			ImageWriter image;
+			InstructionWriter writer;
+			// the finished image, once emit() has succeeded
+			std::string imageBytes;
+			bool debugInfo;
+			bool compress;
+			bool object;
+			bool lazyFunctions;
+			bool preParse;
+			size_t numLazyFunctions;
+			size_t numUncompiledFunctions;
+			EmitStats stats;
+			// the handler compiles the module through it, straight into 'buffer'
+			CodeGenerator generator;
 
 			ModuleAst *unit;
-			ParserState state;
+			// borrowed from the parser, errors of the module are added to it
+			ParserState &state;
 
 			std::vector<ExternalFunctionDefine> externalFunctions;
+			// files imported by the module, as of the last emit()
+			std::vector<std::string> dependencies;
 
 		public:
+			/* 'unit' and 'state' are borrowed, and must outlive the emitter. */
 			Emitter(ModuleAst *unit, ParserState &state);
-			~Emitter();
-
-			std::streampos getLastPosition() { return lastPosition; }
 
+			/* Emit the module into an image in memory, see getImage(). */
+			bool emit();
+			/* Emit the module and also write its image to 'filepath'. */
 			bool emit(const std::string &filepath);
 
-			void defineFunction(ExternalFunctionDefine func) { externalFunctions.push_back(func); }
+			const std::string &getImage() const { return imageBytes; }
+			/* The emitted module as an image, compressed or not regardless of setCompression(). */
+			std::string buildImage(bool compressed) const { return image.write(buffer, compressed); }
+			const EmitStats &getStats() const { return stats; }
+			const std::vector<std::string> &getDependencies() const { return dependencies; }
 
-		private:
-			void close();
-
-			void increaseBlockLevel();
-			void decreaseBlockLevel();
-			void increaseReadLevel();
-			void decreaseReadLevel();
-			void leaveBlock();
-			void stackPopObject(std::string &varName, int whichStack);
-			void createBlock(unsigned int blockId, BlockType blockType, unsigned int parentId);
-			void goToBlock(unsigned int blockId);
-			void goToIfTrue(unsigned int blockId);
-			void goToIfFalse(unsigned int blockId);
-			void createClass(unsigned int blockId);
-			void addMember(const std::string &name);
-			void loadMember(const std::string &name);
-			void invoke();
-			void callNativeFunction(unsigned int blockId, const std::string &name, unsigned int numArgs);
-			void createFunction(const std::string &funName);
-			void createNativeClassInstance(const std::string &className);
-			void leaveFunction();
-			void pushFunctionChain();
-			void popFunctionChain();
-			void ifStatement();
-			void elseStatement();
-			void leaveIfStatement();
-			void leaveElseStatement();
-			void createVariable(VarType varType, const std::string &varName);
-			void varAddProperty(const std::string &varName, const std::string &propertyName);
-			void varPushProperty(const std::string &varName, const std::string &propertyName);
-			void clearVariable(const std::string &varName);
-			void deleteVariable(const std::string &varName);
-			void loopBreak(int levelsToSkip);
-			void loopContinue(int levelsToSkip);
-			void loadVariable(const std::string &varName);
-			void loadInteger(long value);
-			void loadFloat(double value);
-			void loadString(const std::string &value);
-			void loadNull();
-			void opPush(int whichStack);
-			void op(Instruction operation);
+			BytecodeEncoding getEncoding() const { return writer.getEncoding(); }
+			void setEncoding(BytecodeEncoding encoding) { writer.setEncoding(encoding); }
+			/* Record the source file and module name in a debug section. */
+			void setDebugInfo(bool debugInfo) { this->debugInfo = debugInfo; }
+			/* Compress the code and constant sections of the image. */
+			void setCompression(bool compress) { this->compress = compress; }
+			/* Emit an object image, leaving imported modules to the Linker. */
+			void setObject(bool object) { this->object = object; }
+			/* Only compile global functions that are called. Ignored for object images,
+			   whose functions may be called by the modules importing them. */
+			void setLazyFunctions(bool lazyFunctions) { this->lazyFunctions = lazyFunctions; }
+			// global functions whose compilation was deferred, and how many of them were never called
+			size_t getNumLazyFunctions() const { return numLazyFunctions; }
+			size_t getNumUncompiledFunctions() const { return numUncompiledFunctions; }
+			/* Parse the function bodies of imported modules only when they are compiled. */
+			void setPreParse(bool preParse) { this->preParse = preParse; }
+
+			void defineFunction(ExternalFunctionDefine func) { externalFunctions.push_back(func); }
+			const std::vector<ExternalFunctionDefine> &getExternalFunctions() const { return externalFunctions; }
 		};
 	}
 }
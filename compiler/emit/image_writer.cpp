@@ -0,0 +1,166 @@
+#include "image_writer.h"
+
+#include <cstring>
+
+#include "../../util/lz.h"
+
+namespace zenith
+{
+	namespace compiler
+	{
+		using namespace runtime;
+
+		static void align(ByteBuffer &out)
+		{
+			static const char padding[IMAGE_ALIGNMENT] = { 0 };
+
+			size_t remainder = out.size() % IMAGE_ALIGNMENT;
+			if (remainder != 0)
+				out.write(padding, IMAGE_ALIGNMENT - remainder);
+		}
+
+		ImageWriter::ImageWriter()
+		{
+			hasDebugInfo = false;
+			debugInfo = { 0, 0 };
+			object = false;
+		}
+
+		uint32_t ImageWriter::addConstant(const std::string &str)
+		{
+			auto it = constantIndices.find(str);
+			if (it != constantIndices.end())
+				return it->second;
+
+			uint32_t index = (uint32_t)constants.size();
+			constants.push_back(str);
+			constantIndices[str] = index;
+
+			return index;
+		}
+
+		void ImageWriter::addFunction(const std::string &name, uint64_t position)
+		{
+			functions.push_back({ position, addConstant(name), 0 });
+		}
+
+		void ImageWriter::setDebugInfo(const std::string &sourcePath, const std::string &moduleName)
+		{
+			hasDebugInfo = true;
+			debugInfo.sourcePath = addConstant(sourcePath);
+			debugInfo.moduleName = addConstant(moduleName);
+		}
+
+		void ImageWriter::addImport(const std::string &path)
+		{
+			imports.push_back({ addConstant(path), 0 });
+		}
+
+		void ImageWriter::clear()
+		{
+			constants.clear();
+			constantIndices.clear();
+			functions.clear();
+			imports.clear();
+			hasDebugInfo = false;
+		}
+
+		std::string ImageWriter::write(const ByteBuffer &code, bool compress) const
+		{
+			// constant pool: count, offsets from the start of the section, strings
+			ByteBuffer pool;
+			uint32_t count = (uint32_t)constants.size();
+			pool.write(count);
+
+			uint32_t offset = (uint32_t)(sizeof(uint32_t) * (1 + constants.size()));
+			for (auto &&str : constants)
+			{
+				pool.write(offset);
+				offset += (uint32_t)str.length() + 1;
+			}
+			for (auto &&str : constants)
+				pool.write(str.c_str(), str.length() + 1);
+
+			ByteBuffer functionTable;
+			for (auto &&function : functions)
+				functionTable.write(function);
+
+			std::vector<SectionEntry> sections;
+			std::vector<std::string> contents;
+
+			sections.push_back({ SECTION_CODE, 0, 0, 0 });
+			contents.push_back(code.str());
+			sections.push_back({ SECTION_FUNCTIONS, 0, 0, 0 });
+			contents.push_back(functionTable.str());
+			sections.push_back({ SECTION_CONSTANTS, 0, 0, 0 });
+			contents.push_back(pool.str());
+			if (hasDebugInfo)
+			{
+				sections.push_back({ SECTION_DEBUG, 0, 0, 0 });
+				contents.push_back(std::string((const char*)&debugInfo, sizeof(debugInfo)));
+			}
+			if (object)
+			{
+				ByteBuffer importTable;
+				for (auto &&entry : imports)
+					importTable.write(entry);
+
+				sections.push_back({ SECTION_IMPORTS, 0, 0, 0 });
+				contents.push_back(importTable.str());
+			}
+
+			for (size_t i = 0; i < sections.size(); i++)
+			{
+				// the code and the strings are where the repetition is
+				bool compressible = (sections[i].type == SECTION_CODE || sections[i].type == SECTION_CONSTANTS);
+
+				if (compress && compressible)
+				{
+					CompressedSection prefix = { contents[i].size() };
+
+					std::string packed((const char*)&prefix, sizeof(prefix));
+					packed += util::lz::compress(contents[i].data(), contents[i].size());
+
+					if (packed.size() < contents[i].size())
+					{
+						sections[i].flags |= SECTION_COMPRESSED;
+						contents[i] = std::move(packed);
+					}
+				}
+
+				sections[i].size = contents[i].size();
+			}
+
+			// place the sections after the header and section table
+			uint64_t position = sizeof(ImageHeader) + sections.size() * sizeof(SectionEntry);
+			for (auto &section : sections)
+			{
+				position = (position + IMAGE_ALIGNMENT - 1) / IMAGE_ALIGNMENT * IMAGE_ALIGNMENT;
+				section.offset = position;
+				position += section.size;
+			}
+
+			ImageHeader header;
+			std::memset(&header, 0, sizeof(header));
+			std::memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+			header.version = IMAGE_VERSION;
+			header.byteOrder = IMAGE_BYTE_ORDER;
+			header.numSections = (uint32_t)sections.size();
+			header.flags = object ? IMAGE_OBJECT : 0;
+			header.size = position;
+
+			ByteBuffer out;
+			out.write(header);
+			for (auto &&section : sections)
+				out.write(section);
+
+			for (auto &&section : contents)
+			{
+				align(out);
+				out.write(section.data(), section.size());
+			}
+
+			return out.str();
+		}
+	}
+}
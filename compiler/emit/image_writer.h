@@ -0,0 +1,53 @@
+#ifndef __ZENITH_COMPILER_EMIT_IMAGE_WRITER_H__
+#define __ZENITH_COMPILER_EMIT_IMAGE_WRITER_H__
+
+#include <map>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "byte_buffer.h"
+#include "../../runtime/image.h"
+
+namespace zenith
+{
+	namespace compiler
+	{
+		/* Collects the function table, constant pool and debug information
+		   of a module and lays them out as a bytecode image around its code. */
+		class ImageWriter
+		{
+		private:
+			std::vector<std::string> constants;
+			std::map<std::string, uint32_t> constantIndices;
+
+			std::vector<runtime::FunctionEntry> functions;
+			std::vector<runtime::ImportEntry> imports;
+			bool object;
+
+			bool hasDebugInfo;
+			runtime::DebugInfo debugInfo;
+
+		public:
+			ImageWriter();
+
+			/* Index of 'str' in the constant pool, adding it the first time. */
+			uint32_t addConstant(const std::string &str);
+			void addFunction(const std::string &name, uint64_t position);
+			void setDebugInfo(const std::string &sourcePath, const std::string &moduleName);
+			/* Mark the image as an object, to be linked with the files it imports. */
+			void setObject(bool object) { this->object = object; }
+			void addImport(const std::string &path);
+
+			size_t getNumConstants() const { return constants.size(); }
+
+			void clear();
+
+			/* The image, with 'code' as its code section. With 'compress', the
+			   code and constant sections are compressed when that makes them smaller. */
+			std::string write(const ByteBuffer &code, bool compress = false) const;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,191 @@
+#include "instruction_writer.h"
+
+#include "../../runtime/instruction.h"
+
+namespace zenith
+{
+	namespace compiler
+	{
+		InstructionWriter::InstructionWriter(ByteBuffer &buffer, ImageWriter &image, BytecodeEncoding encoding)
+			: buffer(buffer), image(image), encoding(encoding)
+		{
+		}
+
+		void InstructionWriter::writeHeader()
+		{
+			buffer.write(BYTECODE_MAGIC, sizeof(BYTECODE_MAGIC));
+
+			uint8_t version = (uint8_t)encoding;
+			buffer.write(version);
+		}
+
+		void InstructionWriter::writeOpcode(Instruction ins)
+		{
+			if (encoding != ENCODING_FIXED)
+			{
+				uint8_t opcode = (uint8_t)(ins - CMD_INC_BLOCK_LEVEL);
+				buffer.write(opcode);
+			}
+			else
+			{
+				int32_t type = ins;
+				buffer.write(type);
+			}
+		}
+
+		void InstructionWriter::writeInt(int32_t value)
+		{
+			if (encoding != ENCODING_FIXED)
+			{
+				// unsigned LEB128; block ids, counts and types are never negative
+				uint32_t bits = (uint32_t)value;
+				do
+				{
+					uint8_t byte = bits & 0x7F;
+					bits >>= 7;
+					if (bits != 0)
+						byte |= 0x80;
+					buffer.write(byte);
+				} while (bits != 0);
+			}
+			else
+				buffer.write(value);
+		}
+
+		void InstructionWriter::writeLong(long value)
+		{
+			if (encoding != ENCODING_FIXED)
+			{
+				// signed LEB128, the same on every platform
+				int64_t bits = value;
+				bool more = true;
+				while (more)
+				{
+					uint8_t byte = bits & 0x7F;
+					bits >>= 7;
+
+					if ((bits == 0 && (byte & 0x40) == 0) || (bits == -1 && (byte & 0x40) != 0))
+						more = false;
+					else
+						byte |= 0x80;
+
+					buffer.write(byte);
+				}
+			}
+			else
+				buffer.write(value);
+		}
+
+		void InstructionWriter::writeString(const std::string &str)
+		{
+			if (encoding == ENCODING_POOLED)
+				writeInt((int32_t)image.addConstant(str));
+			else if (encoding == ENCODING_COMPACT)
+			{
+				// the length is enough, no terminator
+				writeInt((int32_t)str.length());
+				buffer.write(str.data(), str.length());
+			}
+			else
+			{
+				int32_t len = str.length() + 1;
+				buffer.write(len);
+				buffer.write(str.c_str(), len);
+			}
+		}
+
+		void InstructionWriter::writePosition(uint64_t position)
+		{
+			// in the compact encoding the position is implied, see InstructionDecoder
+			if (encoding == ENCODING_FIXED)
+				buffer.write(position);
+		}
+
+		void InstructionWriter::writeInteger(long value)
+		{
+			if (encoding != ENCODING_FIXED && value >= 0 && value < COMPACT_SMALL_INT_COUNT)
+			{
+				// small integers are carried in the opcode byte
+				uint8_t opcode = (uint8_t)(COMPACT_LOAD_SMALL_INT + value);
+				buffer.write(opcode);
+				return;
+			}
+
+			writeOpcode(Instruction::CMD_LOAD_INTEGER);
+			writeLong(value);
+		}
+
+		bool InstructionWriter::write(const runtime::DecodedInstruction &d)
+		{
+			switch (d.ins)
+			{
+			case Instruction::CMD_CREATE_BLOCK:
+				writeOpcode(d.ins);
+				writeInt(d.arg0);
+				writeInt(d.arg1);
+				writeInt(d.arg2);
+				// the block starts right after this instruction
+				writePosition(buffer.size() + sizeof(uint64_t));
+				break;
+			case Instruction::CMD_CREATE_FUNCTION:
+				writeOpcode(d.ins);
+				writeString(d.name);
+				// so does the body of a function
+				writePosition(buffer.size() + sizeof(uint64_t));
+				image.addFunction(d.name, buffer.size());
+				break;
+			case Instruction::CMD_STACK_POP_OBJECT:
+			case Instruction::CMD_CREATE_VAR:
+				writeOpcode(d.ins);
+				writeInt(d.arg0);
+				writeString(d.name);
+				break;
+			case Instruction::CMD_GO_TO_BLOCK:
+			case Instruction::CMD_GO_TO_IF_TRUE:
+			case Instruction::CMD_GO_TO_IF_FALSE:
+			case Instruction::CMD_LOOP_BREAK:
+			case Instruction::CMD_LOOP_CONTINUE:
+			case Instruction::CMD_OP_PUSH:
+				writeOpcode(d.ins);
+				writeInt(d.arg0);
+				break;
+			case Instruction::CMD_CALL_NATIVE_FUNCTION:
+				writeOpcode(d.ins);
+				writeInt(d.arg0);
+				writeInt(d.arg1);
+				writeString(d.name);
+				break;
+			case Instruction::CMD_CREATE_NATIVE_CLASS_INSTANCE:
+			case Instruction::CMD_ADD_MEMBER:
+			case Instruction::CMD_LOAD_MEMBER:
+			case Instruction::CMD_CLEAR_VAR:
+			case Instruction::CMD_DELETE_VAR:
+			case Instruction::CMD_LOAD_STRING:
+			case Instruction::CMD_LOAD_VARIABLE:
+				writeOpcode(d.ins);
+				writeString(d.name);
+				break;
+			case Instruction::CMD_LOAD_INTEGER:
+				writeInteger(d.intValue);
+				break;
+			case Instruction::CMD_LOAD_FLOAT:
+				writeOpcode(d.ins);
+				buffer.write(d.floatValue);
+				break;
+			case Instruction::CMD_ADD_PROPERTY:
+			case Instruction::CMD_PUSH_PROPERTY:
+				// two strings, never decoded
+				return false;
+			default:
+				if (d.ins < CMD_INC_BLOCK_LEVEL || d.ins > CMD_OP_DIV_ASSIGN)
+					return false;
+
+				// no operands
+				writeOpcode(d.ins);
+				break;
+			}
+
+			return true;
+		}
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef __ZENITH_COMPILER_EMIT_INSTRUCTION_WRITER_H__
+#define __ZENITH_COMPILER_EMIT_INSTRUCTION_WRITER_H__
+
+#include <string>
+#include <cstdint>
+
+#include "byte_buffer.h"
+#include "image_writer.h"
+#include "../../enums.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		struct DecodedInstruction;
+	}
+
+	namespace compiler
+	{
+		/* Writes instructions to a buffer in one of the bytecode encodings.
+		   Pooled strings and function positions go to 'image'. */
+		class InstructionWriter
+		{
+		private:
+			ByteBuffer &buffer;
+			ImageWriter &image;
+			BytecodeEncoding encoding;
+
+		public:
+			InstructionWriter(ByteBuffer &buffer, ImageWriter &image, BytecodeEncoding encoding);
+
+			BytecodeEncoding getEncoding() const { return encoding; }
+			void setEncoding(BytecodeEncoding encoding) { this->encoding = encoding; }
+
+			void writeHeader();
+			void writeOpcode(Instruction ins);
+			void writeInt(int32_t value);
+			void writeLong(long value);
+			void writeString(const std::string &str);
+			void writePosition(uint64_t position);
+			/* A whole CMD_LOAD_INTEGER, using the short form when it fits. */
+			void writeInteger(long value);
+
+			/* Write an instruction read from another stream. Block and function
+			   positions are recomputed for this one.
+			   Returns false if the instruction cannot be written. */
+			bool write(const runtime::DecodedInstruction &d);
+		};
+	}
+}
+
+#endif
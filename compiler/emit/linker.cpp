@@ -0,0 +1,215 @@
+#include "linker.h"
+#include "byte_buffer.h"
+#include "image_writer.h"
+#include "instruction_writer.h"
+
+#include <map>
+#include <set>
+
+#include "../../runtime/instruction.h"
+#include "../../runtime/bytereader.h"
+
+namespace zenith
+{
+	namespace compiler
+	{
+		using namespace runtime;
+
+		struct LinkedModule
+		{
+			std::vector<DecodedInstruction> code;
+			// the function each instruction belongs to, -1 for the top level
+			std::vector<int> owners;
+			// index in 'code' of each function's CREATE_FUNCTION
+			std::vector<size_t> functions;
+			int32_t numBlocks = 0;
+		};
+
+		static bool readModule(const BytecodeImage &object, LinkedModule &module, std::string &error)
+		{
+			auto reader = object.createReader();
+			auto *stream = reader.get();
+
+			if (!InstructionDecoder::readHeader(stream))
+			{
+				error = "Object was emitted with an unsupported encoding";
+				return false;
+			}
+
+			// functions being defined, with the block level their body returns to
+			std::vector<std::pair<int, int>> open;
+			int depth = 0;
+
+			while (stream->position() < stream->max())
+			{
+				DecodedInstruction d;
+				if (!InstructionDecoder::next(stream, d))
+				{
+					error = "Object has an unrecognized instruction at position " + std::to_string(d.position);
+					return false;
+				}
+
+				// nested functions go along with the function they are in
+				int owner = open.empty() ? -1 : open.front().first;
+
+				if (d.ins == Instruction::CMD_CREATE_FUNCTION)
+				{
+					if (open.empty())
+						owner = (int)module.functions.size();
+
+					open.push_back({ owner, depth });
+					module.functions.push_back(module.code.size());
+				}
+				else if (d.ins == Instruction::CMD_INC_BLOCK_LEVEL)
+					depth++;
+				else if (d.ins == Instruction::CMD_DEC_BLOCK_LEVEL)
+				{
+					depth--;
+					if (!open.empty() && open.back().second == depth)
+						open.pop_back();
+				}
+				else if (d.ins == Instruction::CMD_CREATE_BLOCK && d.arg0 >= module.numBlocks)
+					module.numBlocks = d.arg0 + 1;
+
+				module.code.push_back(d);
+				module.owners.push_back(owner);
+			}
+
+			return true;
+		}
+
+		Linker::Linker(BytecodeEncoding encoding)
+		{
+			this->encoding = encoding;
+			this->strip = true;
+			this->numStripped = 0;
+		}
+
+		bool Linker::link(std::string &out, std::string &error, bool compress)
+		{
+			std::vector<LinkedModule> modules(objects.size());
+			for (size_t i = 0; i < objects.size(); i++)
+			{
+				if (!readModule(*objects[i], modules[i], error))
+					return false;
+			}
+
+			// (module, function) pairs that are kept
+			std::set<std::pair<size_t, int>> live;
+
+			if (strip)
+			{
+				// functions are called by loading them as variables, so any name counts as a use
+				std::map<std::string, std::vector<std::pair<size_t, int>>> definitions;
+				for (size_t m = 0; m < modules.size(); m++)
+				{
+					for (size_t f = 0; f < modules[m].functions.size(); f++)
+					{
+						auto &d = modules[m].code[modules[m].functions[f]];
+						if (modules[m].owners[modules[m].functions[f]] == (int)f)
+							definitions[d.name].push_back({ m, (int)f });
+					}
+				}
+
+				std::vector<std::pair<size_t, int>> work;
+				std::set<std::string> used;
+
+				auto use = [&](const std::string &name)
+				{
+					if (!used.insert(name).second)
+						return;
+
+					auto it = definitions.find(name);
+					if (it == definitions.end())
+						return;
+
+					for (auto &&function : it->second)
+					{
+						if (live.insert(function).second)
+							work.push_back(function);
+					}
+				};
+
+				// start from the top level of every module
+				for (size_t m = 0; m < modules.size(); m++)
+				{
+					for (size_t i = 0; i < modules[m].code.size(); i++)
+					{
+						auto &d = modules[m].code[i];
+						if (modules[m].owners[i] == -1 && !d.name.empty())
+							use(d.name);
+					}
+				}
+
+				while (!work.empty())
+				{
+					auto function = work.back();
+					work.pop_back();
+
+					auto &module = modules[function.first];
+					for (size_t i = module.functions[function.second]; i < module.code.size() &&
+						module.owners[i] == function.second; i++)
+					{
+						auto &d = module.code[i];
+						if (d.ins != Instruction::CMD_CREATE_FUNCTION && !d.name.empty())
+							use(d.name);
+					}
+				}
+			}
+
+			ByteBuffer buffer;
+			ImageWriter image;
+			InstructionWriter writer(buffer, image, encoding);
+			writer.writeHeader();
+
+			numStripped = 0;
+			int32_t blockBase = 0;
+
+			for (size_t m = 0; m < modules.size(); m++)
+			{
+				auto &module = modules[m];
+
+				for (size_t i = 0; i < module.code.size(); i++)
+				{
+					int owner = module.owners[i];
+					if (strip && owner != -1 && live.find({ m, owner }) == live.end())
+					{
+						if (i == module.functions[owner])
+							numStripped++;
+						continue;
+					}
+
+					// every module numbers its blocks from 0
+					DecodedInstruction d = module.code[i];
+					switch (d.ins)
+					{
+					case Instruction::CMD_CREATE_BLOCK:
+						d.arg0 += blockBase;
+						if (d.arg2 != -1)
+							d.arg2 += blockBase;
+						break;
+					case Instruction::CMD_GO_TO_BLOCK:
+					case Instruction::CMD_GO_TO_IF_TRUE:
+					case Instruction::CMD_GO_TO_IF_FALSE:
+					case Instruction::CMD_CALL_NATIVE_FUNCTION:
+						d.arg0 += blockBase;
+						break;
+					default:
+						break;
+					}
+
+					if (!writer.write(d))
+					{
+						error = "Object has an instruction that cannot be linked at position " + std::to_string(d.position);
+						return false;
+					}
+				}
+
+				blockBase += module.numBlocks;
+			}
+
+			out = image.write(buffer, compress);
+			return true;
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef __ZENITH_COMPILER_EMIT_LINKER_H__
+#define __ZENITH_COMPILER_EMIT_LINKER_H__
+
+#include <vector>
+#include <string>
+
+#include "../../enums.h"
+#include "../../runtime/image.h"
+
+namespace zenith
+{
+	namespace compiler
+	{
+		/* Links object images, each compiled from one module, into a single
+		   image that can run. Functions are created when the top level of their
+		   module runs, so modules are laid out in the order they are added,
+		   and every module must be added after the ones it imports.
+
+		   Block ids are renumbered to be unique across modules. Functions that
+		   nothing refers to by name are left out, unless stripping is turned off. */
+		class Linker
+		{
+		private:
+			std::vector<const runtime::BytecodeImage*> objects;
+			BytecodeEncoding encoding;
+			bool strip;
+			size_t numStripped;
+
+		public:
+			Linker(BytecodeEncoding encoding);
+
+			void add(const runtime::BytecodeImage &object) { objects.push_back(&object); }
+			void setStripping(bool strip) { this->strip = strip; }
+
+			/* Returns false and sets 'error' if an object could not be read. */
+			bool link(std::string &out, std::string &error, bool compress = false);
+
+			size_t getNumModules() const { return objects.size(); }
+			size_t getNumStripped() const { return numStripped; }
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,180 @@
+#include "module_cache.h"
+
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#include "../../util/sha256.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace zenith
+{
+	namespace compiler
+	{
+		// the digest of a file, or false if it cannot be read
+		static bool hashFile(const std::string &path, std::string &digest)
+		{
+			std::ifstream file(path, std::ifstream::binary);
+			if (!file.is_open())
+				return false;
+
+			std::stringstream contents;
+			contents << file.rdbuf();
+			if (file.bad())
+				return false;
+
+			std::string str = contents.str();
+			digest = util::sha256Hex(str.data(), str.size());
+
+			return true;
+		}
+
+		// a name no other writer uses, so that entries being written never mix
+		static std::string tempSuffix()
+		{
+			static std::atomic<unsigned> counter(0);
+
+#ifdef _WIN32
+			long pid = (long)_getpid();
+#else
+			long pid = (long)getpid();
+#endif
+			return "." + std::to_string(pid) + "." + std::to_string(counter++) + ".tmp";
+		}
+
+		ModuleCache::ModuleCache(const std::string &directory)
+		{
+			this->directory = directory;
+
+			// fails harmlessly when it already exists
+#ifdef _WIN32
+			_mkdir(directory.c_str());
+#else
+			mkdir(directory.c_str(), 0755);
+#endif
+		}
+
+		std::string ModuleCache::entryPath(const std::string &key) const
+		{
+			return directory + "/" + key + ".zcache";
+		}
+
+		std::string ModuleCache::makeKey(const std::string &source, const std::string &filename,
+			const std::string &options)
+		{
+			// imports are resolved relative to the module, so its path is part of the key;
+			// each part is on its own line after its length, so parts cannot run together
+			std::string material = std::to_string(MODULE_CACHE_VERSION) + "\n" +
+				std::to_string(filename.size()) + "\n" + filename + "\n" +
+				std::to_string(options.size()) + "\n" + options + "\n" +
+				util::sha256Hex(source.data(), source.size());
+
+			return util::sha256Hex(material.data(), material.size());
+		}
+
+		bool ModuleCache::load(const std::string &key, std::string &image) const
+		{
+			std::ifstream file(entryPath(key), std::ifstream::binary);
+			if (!file.is_open())
+				return false;
+
+			CacheEntryHeader header;
+			if (!file.read((char*)&header, sizeof(header)) ||
+				std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+				header.version != MODULE_CACHE_VERSION)
+				return false;
+
+			for (uint32_t i = 0; i < header.numDependencies; i++)
+			{
+				std::string storedDigest(CACHE_DIGEST_SIZE, '\0');
+				uint32_t pathLength;
+				if (!file.read(&storedDigest[0], CACHE_DIGEST_SIZE) ||
+					!file.read((char*)&pathLength, sizeof(pathLength)))
+					return false;
+
+				std::string path(pathLength, '\0');
+				if (!file.read(&path[0], pathLength))
+					return false;
+
+				std::string digest;
+				if (!hashFile(path, digest) || digest != storedDigest)
+					return false;
+			}
+
+			// the image is the rest of the file
+			auto imageStart = file.tellg();
+			file.seekg(0, std::ifstream::end);
+			if ((uint64_t)(file.tellg() - imageStart) != header.imageSize)
+				return false;
+			file.seekg(imageStart);
+
+			image.resize((size_t)header.imageSize);
+			if (!file.read(&image[0], image.size()))
+				return false;
+
+			return true;
+		}
+
+		void ModuleCache::store(const std::string &key, const std::vector<std::string> &dependencies,
+			const std::string &image) const
+		{
+			// an entry without the digest of a dependency could never be checked
+			std::vector<std::string> digests(dependencies.size());
+			for (size_t i = 0; i < dependencies.size(); i++)
+			{
+				if (!hashFile(dependencies[i], digests[i]))
+					return;
+			}
+
+			std::string path = entryPath(key);
+			std::string tempPath = path + tempSuffix();
+
+			{
+				std::ofstream file(tempPath, std::ofstream::binary);
+				if (!file.is_open())
+					return;
+
+				CacheEntryHeader header;
+				std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+				header.version = MODULE_CACHE_VERSION;
+				header.numDependencies = (uint32_t)dependencies.size();
+				header.reserved = 0;
+				header.imageSize = image.size();
+				file.write((const char*)&header, sizeof(header));
+
+				for (size_t i = 0; i < dependencies.size(); i++)
+				{
+					uint32_t pathLength = (uint32_t)dependencies[i].length();
+					file.write(digests[i].data(), CACHE_DIGEST_SIZE);
+					file.write((const char*)&pathLength, sizeof(pathLength));
+					file.write(dependencies[i].data(), pathLength);
+				}
+
+				file.write(image.data(), image.size());
+
+				if (!file.good())
+				{
+					file.close();
+					std::remove(tempPath.c_str());
+					return;
+				}
+			}
+
+			// replace the entry in one step, so another process never reads half of it
+#ifdef _WIN32
+			std::remove(path.c_str());
+#endif
+			if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+				std::remove(tempPath.c_str());
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef __ZENITH_COMPILER_EMIT_MODULE_CACHE_H__
+#define __ZENITH_COMPILER_EMIT_MODULE_CACHE_H__
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace zenith
+{
+	namespace compiler
+	{
+		// bump whenever the same source would be compiled to different code
+		const uint32_t MODULE_CACHE_VERSION = 2;
+		// SHA-256 in hex, for keys and the contents of dependencies
+		const size_t CACHE_DIGEST_SIZE = 64;
+
+		/* Entry file layout:
+
+		     CacheEntryHeader
+		     per dependency: digest of its contents, uint32 path length, path
+		     the image
+		*/
+		const char CACHE_MAGIC[4] = { 'Z', 'E', 'N', 'C' };
+
+		struct CacheEntryHeader
+		{
+			char magic[4];
+			uint32_t version;
+			uint32_t numDependencies;
+			uint32_t reserved;
+			uint64_t imageSize;
+		};
+
+		/* Compiled module images kept in a directory, so that a module whose
+		   source has not changed is not lexed, parsed and emitted again.
+		   An entry is keyed by the main module, the options it was compiled with
+		   and the compiler version. The files it imported are stored with it
+		   and hashed again on every lookup, so editing any of them invalidates it.
+		   The directory may be shared, so everything is compared by SHA-256. */
+		class ModuleCache
+		{
+		private:
+			std::string directory;
+
+			std::string entryPath(const std::string &key) const;
+
+		public:
+			ModuleCache(const std::string &directory);
+
+			static std::string makeKey(const std::string &source, const std::string &filename,
+				const std::string &options);
+
+			/* The image stored under 'key', if its dependencies are unchanged. */
+			bool load(const std::string &key, std::string &image) const;
+			/* Nothing is stored if a dependency cannot be read. */
+			void store(const std::string &key, const std::vector<std::string> &dependencies,
+				const std::string &image) const;
+		};
+	}
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "errors.h"
 
 #include <iostream>
+#include <algorithm>
 
 namespace zenith
 {
@@ -36,7 +37,8 @@ namespace zenith
 			{ MODULE_NOT_FOUND, "Module '%' could not be found" },
 			{ MODULE_ALREADY_DEFINED, "Module '%' has already been defined" },
 			{ IMPORT_OUTSIDE_GLOBAL, "Import not allowed outside of global scope"},
-			{ SELF_NOT_DEFINED, "'self' not allowed outside of a class" }
+			{ SELF_NOT_DEFINED, "'self' not allowed outside of a class" },
+			{ NOT_SUPPORTED, "% is not supported by this compiler" }
 		};
 
 		void Error::display()
@@ -54,5 +56,24 @@ namespace zenith
 		{
 			return location.line < other.location.line;
 		}
+
+		void displayErrors(const std::vector<Error> &errors)
+		{
+			// map the filepath to vector of errors
+			std::map<std::string, std::vector<Error>> errorMap;
+
+			for (auto &&it : errors)
+				errorMap[it.location.file()].push_back(it);
+
+			for (auto it = errorMap.rbegin(); it != errorMap.rend(); ++it)
+			{
+				std::sort(it->second.begin(), it->second.end());
+
+				std::cout << "Errors in file: " << it->first << "\n";
+
+				for (auto &&error : it->second)
+					error.display();
+			}
+		}
 	}
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include <sstream> 
 #include <iostream>
 #include "src_location.h"
@@ -41,7 +42,8 @@ namespace zenith
 			MODULE_NOT_FOUND,
 			MODULE_ALREADY_DEFINED,
 			IMPORT_OUTSIDE_GLOBAL,
-			SELF_NOT_DEFINED
+			SELF_NOT_DEFINED,
+			NOT_SUPPORTED
 		};
 
 		struct Error
@@ -86,12 +88,17 @@ namespace zenith
 				this->type = type;
 				this->location = location;
 
-				makeErrorMessage(errorMessages[type].c_str(), args...);
+				// modules may be compiled on several threads, so the table is only read
+				auto it = errorMessages.find(type);
+				makeErrorMessage((it != errorMessages.end()) ? it->second.c_str() : "", args...);
 			}
 
 			void display();
 			bool operator<(const Error &other);
 		};
+
+		/* Display errors grouped by file, in order of line. */
+		void displayErrors(const std::vector<Error> &errors);
 	}
 }
 
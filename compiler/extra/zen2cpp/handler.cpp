@@ -2,13 +2,12 @@
 
 #include <sstream>
 #include <fstream>
+#include <iomanip>
 #include <algorithm>
 
 #include "../../lexer.h"
 #include "../../parser.h"
 
-// This tool is experimental and should not be used
-
 namespace zenith
 {
 	namespace compiler
@@ -18,26 +17,102 @@ namespace zenith
 			Zen2CppHandler::Zen2CppHandler(ParserState &state)
 			{
 				this->state = state;
+
+				levels[level] = Level();
 			}
 
 			Zen2CppHandler::~Zen2CppHandler()
 			{
-
+				functionIdents.clear();
+				nativeFunctions.clear();
+				externalModules.clear();
 			}
 
 			void Zen2CppHandler::accept(ModuleAst *node)
 			{
-				append("int main() {\n\n");
-				levels[++level] = Level();
+				rootModule = node->moduleName;
+				moduleNames.insert(node->moduleName);
 
 				for (int i = 0; i < node->children.size(); i++)
 					accept(node->children[i].get());
+			}
 
-				append("\n\n");
-				indent();
-				append("return 0;\n");
-				--level;
-				append("}\n");
+			void Zen2CppHandler::defineFunction(const std::string &name,
+				const std::string &moduleName,
+				size_t numArgs)
+			{
+				std::vector<std::string> args;
+				for (size_t i = 0; i < numArgs; i++)
+					args.push_back("arg" + std::to_string(i));
+
+				std::unique_ptr<FunctionDefinitionAst> definition
+					= std::make_unique<FunctionDefinitionAst>(SourceLocation(-1, -1, ""),
+						nullptr,
+						name,
+						args,
+						nullptr,
+						true);
+
+				nativeFunctions.push_back(std::move(definition));
+				levels[0].functionDeclarations.push_back({ moduleName + "." + name, nativeFunctions.back().get() });
+			}
+
+			std::string Zen2CppHandler::getOutput(bool sharedLibrary) const
+			{
+				std::stringstream ss;
+
+				ss << "// Generated by zen2cpp\n";
+				ss << "#include <functional>\n\n";
+				ss << "#include \"zen2cpp_runtime.h\"\n\n";
+				ss << "using namespace zenith;\n\n";
+				ss << declarations.str() << "\n";
+				ss << functions.str();
+
+				ss << "static aot::Value zen_main()\n{\n";
+				ss << mainBody.str();
+				ss << "\treturn aot::Value();\n}\n\n";
+
+				if (sharedLibrary)
+				{
+					// the VM calls the global functions of the module through the native binding interface
+					for (auto *fn : exportedFunctions)
+					{
+						const std::string &ident = functionIdents.at(fn);
+
+						ss << "static aot::Value w_" << ident << "(const std::vector<aot::Value> &args)\n{\n";
+						ss << "\treturn " << ident << "(";
+						for (size_t i = 0; i < fn->arguments.size(); i++)
+							ss << (i != 0 ? ", " : "") << "args[" << i << "]";
+						ss << ");\n}\n\n";
+					}
+
+					ss << "static const aot::ModuleFunction zen_functions[] =\n{\n";
+					for (auto *fn : exportedFunctions)
+					{
+						ss << "\t{ \"" << fn->name << "\", " << fn->arguments.size()
+							<< ", &w_" << functionIdents.at(fn) << " },\n";
+					}
+					ss << "\t{ nullptr, 0, nullptr }\n};\n\n";
+
+					ss << "static void zen_init()\n{\n\tzen_main();\n}\n\n";
+
+					ss << "ZEN_AOT_EXPORT const aot::ModuleExports *zen_aot_module()\n{\n";
+					ss << "\tstatic const aot::ModuleExports exports =\n\t{\n";
+					ss << "\t\taot::MODULE_ABI_VERSION, \"" << rootModule << "\", zen_functions, "
+						<< exportedFunctions.size() << ", &zen_init\n\t};\n\n";
+					ss << "\treturn &exports;\n}\n";
+
+					return ss.str();
+				}
+
+				ss << "int main()\n{\n";
+				ss << "\ttry\n\t{\n\t\tzen_main();\n\t}\n";
+				ss << "\tcatch (const std::exception &e)\n\t{\n";
+				ss << "\t\tstd::cout << \"Runtime error: \" << e.what() << \"\\n\";\n";
+				ss << "\t\treturn 1;\n\t}\n\n";
+				ss << "\treturn 0;\n}\n";
+
+				return ss.str();
 			}
 
 			void Zen2CppHandler::accept(AstNode *node)
@@ -97,12 +172,21 @@ namespace zenith
 				case AstNodeType::AST_NULL:
 					accept(dynamic_cast<NullAst*>(node));
 					break;
+				case AstNodeType::AST_SELF:
+					accept(dynamic_cast<SelfAst*>(node));
+					break;
+				case AstNodeType::AST_NEW:
+					accept(dynamic_cast<NewAst*>(node));
+					break;
 				case AstNodeType::AST_FUNCTION_DEFINITION:
 					accept(dynamic_cast<FunctionDefinitionAst*>(node));
 					break;
 				case AstNodeType::AST_FUNCTION_CALL:
 					accept(dynamic_cast<FunctionCallAst*>(node));
 					break;
+				case AstNodeType::AST_CLASS:
+					accept(dynamic_cast<ClassAst*>(node));
+					break;
 				case AstNodeType::AST_RETURN_STATEMENT:
 					accept(dynamic_cast<ReturnStatementAst*>(node));
 					break;
@@ -126,7 +210,7 @@ namespace zenith
 
 			void Zen2CppHandler::accept(ImportAst *node)
 			{
-				if (level != -1)
+				if (level != 0)
 					state.errors.push_back({ ErrorType::IMPORT_OUTSIDE_GLOBAL, node->location });
 
 				if (node->isModuleImport)
@@ -152,18 +236,22 @@ namespace zenith
 							t.close();
 
 							Lexer lexer(str, importModulePath);
-							auto tokens = lexer.scan();
-
-							Parser parser(tokens, lexer.state);
+							Parser parser(lexer);
 							auto unit = parser.parse();
 
-							externalModules[importModulePath] = std::move(unit);
+							if (moduleNames.find(unit->moduleName) == moduleNames.end())
+							{
+								moduleNames.insert(unit->moduleName);
+								externalModules[importModulePath] = std::move(unit);
 
-							for (auto &&error : parser.state.errors)
-								state.errors.push_back(error);
+								for (auto &&error : parser.state.errors)
+									state.errors.push_back(error);
 
-							for (std::unique_ptr<AstNode> &child : externalModules[importModulePath]->children)
-								accept(child.get());
+								for (std::unique_ptr<AstNode> &child : externalModules[importModulePath]->children)
+									accept(child.get());
+							}
+							else // module's identifier has already been declared
+								state.errors.push_back({ ErrorType::MODULE_ALREADY_DEFINED, node->location, unit->moduleName });
 						}
 					}
 				}
@@ -175,22 +263,22 @@ namespace zenith
 
 			void Zen2CppHandler::accept(BlockAst *node)
 			{
-				for (int i = 0; i < node->children.size(); i++)
-				{
-					indent();
-
-					if (node->children[i])
-					{
-						accept(node->children[i].get());
-
-						append(";\n");
-					}
-				}
+				for (auto &&child : node->children)
+					accept(child.get());
 			}
 
 			void Zen2CppHandler::accept(ExpressionAst *node)
 			{
-				accept(node->value.get());
+				if (node->shouldClearStack)
+				{
+					// the value is discarded, so this is a statement of its own
+					std::string value = expression(node->value.get());
+
+					indent();
+					append(value + ";\n");
+				}
+				else
+					accept(node->value.get());
 			}
 
 			void Zen2CppHandler::accept(BinaryOperationAst *node)
@@ -199,116 +287,106 @@ namespace zenith
 				auto &left = node->left;
 				auto &right = node->right;
 
-				accept(left.get());
+				const char *fn = nullptr;
+				bool isAssignment = false;
 
 				switch (op)
 				{
+				case Operator::OP_POWER:
+					fn = "pow";
+					break;
 				case Operator::OP_MULTIPLY:
-					append("*");
+					fn = "mul";
 					break;
 				case Operator::OP_INT_DIVIDE:
 				case Operator::OP_DIVIDE:
-					append("/");
+					fn = "div";
 					break;
 				case Operator::OP_MODULUS:
-					append("%");
+					fn = "mod";
 					break;
 				case Operator::OP_ADD:
-					append("+");
+					fn = "add";
 					break;
 				case Operator::OP_SUBTRACT:
-				  append("-");
-					break;
-					/*case Operator::OP_BINARY_XOR:
-					addCommand<OpBinaryBitXor>();
-					break;
-					case Operator::OP_BINARY_AND:
-					addCommand<OpBinaryBitAnd>();
+					fn = "sub";
 					break;
-					case Operator::OP_BINARY_OR:
-					addCommand<OpBinaryBitOr>();
-					break;*/
 				case Operator::OP_AND:
-					append("&&");
+					fn = "logicalAnd";
 					break;
 				case Operator::OP_OR:
-					append("||");
+					fn = "logicalOr";
 					break;
 				case Operator::OP_EQUALS:
-					append("==");
+					fn = "eql";
 					break;
 				case Operator::OP_NOT_EQUAL:
-					append("!=");
+					fn = "notEql";
 					break;
-					/*case Operator::OP_OUTPUT:
-					addCommand<OpBinaryOut>();
-					break;
-					case Operator::OP_INPUT:
-					addCommand<OpBinaryIn>();
-					break;*/
 				case Operator::OP_LESS:
-					append("<");
+					fn = "less";
 					break;
 				case Operator::OP_GREATER:
-					append(">");
+					fn = "greater";
 					break;
 				case Operator::OP_GREATER_OR_EQUAL:
-					append(">=");
+					fn = "greaterEql";
 					break;
 				case Operator::OP_LESS_OR_EQUAL:
-					append("<=");
+					fn = "lessEql";
 					break;
 				case Operator::OP_ASSIGN:
-					append("=");
+					fn = "assign";
+					isAssignment = true;
 					break;
 				case Operator::OP_ADD_ASSIGN:
-					append("+=");
+					fn = "addAssign";
+					isAssignment = true;
 					break;
 				case Operator::OP_SUBTRACT_ASSIGN:
-					append("-=");
+					fn = "subAssign";
+					isAssignment = true;
 					break;
 				case Operator::OP_MULTIPLY_ASSIGN:
-					append("*=");
+					fn = "mulAssign";
+					isAssignment = true;
 					break;
 				case Operator::OP_DIVIDE_ASSIGN:
-					append("/=");
-					break;
-					/*case Operator::OP_MODULUS_ASSIGN:
-					addCommand<OpBinaryModAssign>();
-					break;
-					case Operator::OP_BINARY_AND_ASSIGN:
-					addCommand<OpBinaryBitAndAssign>();
+					fn = "divAssign";
+					isAssignment = true;
 					break;
-					case Operator::OP_BINARY_XOR_ASSIGN:
-					addCommand<OpBinaryBitXorAssign>();
-					break;
-					case Operator::OP_BINARY_OR_ASSIGN:
-					addCommand<OpBinaryBitOrAssign>();
-					break;*/
 				default:
 					state.errors.push_back(Error(ErrorType::ILLEGAL_OPERATOR, node->location, getOperatorStr(op)));
-					break;
+					return;
+				}
+
+				if (isAssignment)
+				{
+					std::string target = assignTarget(left.get());
+					append(std::string("aot::") + fn + "(" + target + ", " + expression(right.get()) + ")");
+				}
+				else
+				{
+					std::string leftStr = expression(left.get());
+					append(std::string("aot::") + fn + "({ " + leftStr + ", " + expression(right.get()) + " })");
 				}
-				accept(right.get());
 			}
 
 			void Zen2CppHandler::accept(UnaryOperationAst *node)
 			{
 				Operator op = node->op;
-				auto &val = node->value;
-
-				accept(val.get());
+				std::string value = expression(node->value.get());
 
 				switch (op)
 				{
 				case Operator::OP_NOT:
-					append("!");
+					append("aot::logicalNot(" + value + ")");
 					break;
 				case Operator::OP_ADD:
-					append("+");
+					append(value);
 					break;
 				case Operator::OP_SUBTRACT:
-					append("-");
+					append("aot::negate(" + value + ")");
 					break;
 				default:
 					state.errors.push_back(Error(ErrorType::ILLEGAL_OPERATOR, node->location, getOperatorStr(op)));
@@ -318,15 +396,28 @@ namespace zenith
 
 			void Zen2CppHandler::accept(MemberAccessAst *node)
 			{
+				// only members of modules can be accessed, there are no objects
+				auto *leftAst = dynamic_cast<VariableAst*>(node->left.get());
+				auto *next = node->right.get();
 
+				if (leftAst != nullptr && moduleNames.find(leftAst->name) != moduleNames.end() &&
+					next != nullptr && (next->nodeType == AST_VARIABLE || next->nodeType == AST_FUNCTION_CALL))
+				{
+					memberModule = leftAst->name;
+					accept(next);
+					memberModule.clear();
+				}
+				else
+					state.errors.push_back({ ErrorType::NOT_SUPPORTED, node->location, "Member access" });
 			}
 
 			void Zen2CppHandler::accept(VariableDeclarationAst *node)
 			{
 				Level &currentLevel = levels[level];
+				std::string name = qualify(node, node->name);
 
-				if (std::find(currentLevel.variableNames.begin(), currentLevel.variableNames.end(), node->name)
-					!= currentLevel.variableNames.end())
+				if (currentLevel.variableNames.find(name) != currentLevel.variableNames.end() ||
+					moduleNames.find(node->name) != moduleNames.end())
 				{
 					state.errors.push_back(Error(ErrorType::REDECLARED_IDENTIFIER,
 						node->location,
@@ -334,65 +425,278 @@ namespace zenith
 				}
 				else
 				{
-					currentLevel.variableNames.push_back(node->name);
-					append(std::string("Any ") + node->name);
+					std::string ident;
+
+					if (level == 0)
+					{
+						ident = "g_" + moduleOf(node) + "_" + node->name;
+						declarations << "static aot::Value " << ident << ";\n";
+					}
+					else
+					{
+						ident = "v_" + node->name;
+						indent();
+						append("aot::Value " + ident + ";\n");
+					}
+
+					currentLevel.variableNames[name] = ident;
+
+					if (node->assignment != nullptr)
+					{
+						std::string value = expression(node->assignment.get());
+
+						indent();
+						append(value + ";\n");
+					}
 				}
 			}
 
 			void Zen2CppHandler::accept(VariableAst *node)
 			{
-				if (!varInScope(node->name))
+				std::string ident;
+
+				if (!varInScope(qualify(node, node->name), ident))
 					state.errors.push_back(Error(ErrorType::UNDECLARED_IDENTIFIER, node->location, node->name));
 				else
-					append(node->name);
+					append(ident);
 			}
 
 			void Zen2CppHandler::accept(IntegerAst *node)
 			{
-				append(node->value);
+				append("aot::Value(" + std::to_string(node->value) + "L)");
 			}
 
 			void Zen2CppHandler::accept(FloatAst *node)
 			{
-				append(node->value);
+				std::stringstream ss;
+				ss << std::setprecision(17) << node->value;
+
+				std::string value = ss.str();
+				if (value.find_first_of(".e") == std::string::npos)
+					value += ".0";
+
+				append("aot::Value(" + value + ")");
 			}
 
 			void Zen2CppHandler::accept(StringAst *node)
 			{
-				append(std::string("std::string(\"") + node->value + "\")");
+				append(stringConstant(node->value));
 			}
 
 			void Zen2CppHandler::accept(TrueAst *node)
 			{
-				append("true");
+				append("aot::Value(1L)");
 			}
 
 			void Zen2CppHandler::accept(FalseAst *node)
 			{
-				append("false");
+				append("aot::Value(0L)");
 			}
 
 			void Zen2CppHandler::accept(NullAst *node)
 			{
-				append("nullptr");
+				append("aot::Value()");
+			}
+
+			void Zen2CppHandler::accept(SelfAst *node)
+			{
+				state.errors.push_back({ ErrorType::NOT_SUPPORTED, node->location, "'self'" });
+			}
+
+			void Zen2CppHandler::accept(NewAst *node)
+			{
+				state.errors.push_back({ ErrorType::NOT_SUPPORTED, node->location, "'new'" });
 			}
 
 			void Zen2CppHandler::accept(FunctionDefinitionAst *node)
 			{
+				std::string name = qualify(node, node->name);
+				size_t nArgs = node->arguments.size();
+
+				FunctionDefinitionAst *tmpNode = nullptr;
+				std::string tmpIdent;
+
+				if (fnInScope(name, nArgs, tmpNode) == FN_FOUND ||
+					varInScope(name, tmpIdent) ||
+					moduleNames.find(node->name) != moduleNames.end())
+				{
+					state.errors.push_back(Error(ErrorType::REDECLARED_IDENTIFIER,
+						node->location,
+						node->name));
+					return;
+				}
+
+				levels[level].functionDeclarations.push_back({ name, node });
+
+				std::string params, types;
+				for (size_t i = 0; i < nArgs; i++)
+				{
+					if (i != 0)
+					{
+						params += ", ";
+						types += ", ";
+					}
+					params += "aot::Value v_" + node->arguments[i];
+					types += "aot::Value";
+				}
+
+				if (level == 0)
+				{
+					// global functions are defined at file scope
+					std::string moduleName = moduleOf(node);
+					std::string ident = "f_" + moduleName + "_" + node->name + "_" + std::to_string(nArgs);
+					functionIdents[node] = ident;
+
+					if (moduleName == rootModule)
+						exportedFunctions.push_back(node);
+
+					declarations << "static aot::Value " << ident << "(" << params << ");\n";
+
+					std::stringstream body;
+					auto *lastOutput = cppOutput;
+					int lastIndent = indentLevel;
+
+					cppOutput = &body;
+					indentLevel = 0;
+
+					append("static aot::Value " + ident + "(" + params + ")\n");
+					functionBody(node, "");
+
+					cppOutput = lastOutput;
+					indentLevel = lastIndent;
+
+					functions << body.str() << "\n";
+				}
+				else
+				{
+					// nested functions are lambdas that can see the enclosing locals
+					std::string ident = "l_" + node->name + "_" + std::to_string(nArgs);
+					functionIdents[node] = ident;
+
+					indent();
+					append("std::function<aot::Value(" + types + ")> " + ident + ";\n");
+					indent();
+					append(ident + " = [&](" + params + ") -> aot::Value\n");
+					functionBody(node, ";");
+				}
+			}
+
+			void Zen2CppHandler::functionBody(FunctionDefinitionAst *node, const char *terminator)
+			{
+				auto *fnBody = dynamic_cast<BlockAst*>(node->block.get());
+
+				increaseBlock(BlockType::FUNCTION_BLOCK);
+
+				for (auto &&arg : node->arguments)
+					levels[level].variableNames[qualify(node, arg)] = "v_" + arg;
+
+				if (fnBody != nullptr)
+				{
+					accept(fnBody);
 
+					// add return statement
+					if (fnBody->children.empty() || fnBody->children.back() == nullptr ||
+						fnBody->children.back()->nodeType != AST_RETURN_STATEMENT)
+					{
+						indent();
+						append("return aot::Value();\n");
+					}
+				}
+
+				decreaseBlock(terminator);
 			}
 
 			void Zen2CppHandler::accept(FunctionCallAst *node)
 			{
+				std::string name = qualify(node, node->name);
+				size_t nArgs = node->arguments.size();
+
+				FunctionDefinitionAst *definition = nullptr;
+				ReturnMessage msg = fnInScope(name, nArgs, definition);
+
+				if (msg == FN_NOT_FOUND)
+					state.errors.push_back({ ErrorType::FUNCTION_NOT_FOUND, node->location, node->name + " (" + name + ")" });
+				else if (msg == FN_TOO_MANY_ARGS)
+					state.errors.push_back({ ErrorType::TOO_MANY_ARGS, node->location, node->name });
+				else if (msg == FN_TOO_FEW_ARGS)
+					state.errors.push_back({ ErrorType::TOO_FEW_ARGS, node->location, node->name });
+				else if (msg == FN_FOUND)
+				{
+					std::vector<std::string> args;
+					size_t numComputed = 0;
+
+					for (auto &&arg : node->arguments)
+					{
+						args.push_back(expression(arg.get()));
+
+						AstNode *value = arg.get();
+						if (value->nodeType == AST_EXPRESSION)
+							value = dynamic_cast<ExpressionAst*>(value)->value.get();
+
+						switch (value->nodeType)
+						{
+						case AST_INTEGER:
+						case AST_FLOAT:
+						case AST_STRING:
+						case AST_TRUE:
+						case AST_FALSE:
+						case AST_NULL:
+							break;
+						default:
+							numComputed++;
+							break;
+						}
+					}
+
+					// the VM evaluates arguments from last to first, so keep that
+					// order whenever more than one of them could have side effects
+					bool reorder = (numComputed > 1);
+
+					std::string argList;
+					for (size_t i = 0; i < nArgs; i++)
+					{
+						if (i != 0)
+							argList += ", ";
+						argList += reorder ? ("a" + std::to_string(i)) : args[i];
+					}
+
+					std::string call;
+					if (definition->isNative)
+					{
+						std::string cache = "n_" + definition->name + "_" + std::to_string(nArgs);
+						if (nativeCaches.insert(cache).second)
+							declarations << "static aot::NativeFunction " << cache << " = nullptr;\n";
+
+						call = "aot::callNative(" + cache + ", \"" + definition->name + "\", { " + argList + " })";
+					}
+					else
+						call = functionIdents[definition] + "(" + argList + ")";
+
+					if (reorder)
+					{
+						std::string result = "[&]() -> aot::Value { ";
+						for (size_t i = nArgs; i-- > 0;)
+							result += "aot::Value a" + std::to_string(i) + " = " + args[i] + "; ";
+						result += "return " + call + "; }()";
+
+						append(result);
+					}
+					else
+						append(call);
+				}
+			}
 
+			void Zen2CppHandler::accept(ClassAst *node)
+			{
+				state.errors.push_back({ ErrorType::NOT_SUPPORTED, node->location, "Class '" + node->name + "'" });
 			}
 
 			void Zen2CppHandler::accept(IfStatementAst *node)
 			{
+				std::string condition = expression(node->cond_expr.get());
+
 				indent();
-				append("if (");
-				accept(node->cond_expr.get());
-				append(")\n");
+				append("if (aot::truthy(" + condition + "))\n");
 
 				increaseBlock(BlockType::IF_STATEMENT_BLOCK);
 				accept(node->block.get());
@@ -410,27 +714,130 @@ namespace zenith
 
 			void Zen2CppHandler::accept(ReturnStatementAst *node)
 			{
+				std::string value = (node->value != nullptr)
+					? expression(node->value.get())
+					: std::string("aot::Value()");
 
+				indent();
+				append("return " + value + ";\n");
 			}
 
 			void Zen2CppHandler::accept(ForLoopAst *node)
 			{
+				// the initializer is scoped to the loop
+				increaseBlock(BlockType::UNDEFINED_BLOCK);
+
+				if (node->init_expr != nullptr)
+					accept(node->init_expr.get());
+
+				std::string condition = expression(node->cond_expr.get());
+
+				indent();
+				append("while (aot::truthy(" + condition + "))\n");
+
+				increaseBlock(BlockType::IF_STATEMENT_BLOCK);
+				accept(node->block.get());
+
+				if (node->inc_expr != nullptr)
+				{
+					std::string increment = expression(node->inc_expr.get());
+
+					indent();
+					append(increment + ";\n");
+				}
+
+				decreaseBlock();
+				decreaseBlock();
+			}
+
+			std::string Zen2CppHandler::expression(AstNode *node)
+			{
+				std::stringstream ss;
+				auto *lastOutput = cppOutput;
+
+				cppOutput = &ss;
+				accept(node);
+				cppOutput = lastOutput;
+
+				return ss.str();
+			}
+
+			std::string Zen2CppHandler::assignTarget(AstNode *node)
+			{
+				if (node != nullptr && node->nodeType == AST_MEMBER_ACCESS)
+				{
+					auto *next = dynamic_cast<MemberAccessAst*>(node)->right.get();
+					if (next != nullptr && next->nodeType == AST_VARIABLE)
+						return expression(node);
+				}
+				else if (node != nullptr && node->nodeType == AST_VARIABLE)
+					return expression(node);
+
+				// cannot assign a value to a number or string, etc.
+				state.errors.push_back({ ErrorType::ILLEGAL_EXPRESSION, node ? node->location : SourceLocation(-1, -1, "") });
+				return "";
+			}
+
+			std::string Zen2CppHandler::stringConstant(const std::string &value)
+			{
+				auto it = stringConstants.find(value);
+				if (it != stringConstants.end())
+					return it->second;
+
+				std::string ident = "s_" + std::to_string(stringConstants.size());
+				stringConstants[value] = ident;
+
+				std::stringstream escaped;
+				for (unsigned char c : value)
+				{
+					if (c == '"' || c == '\\')
+						escaped << '\\' << c;
+					else if (c == '\n')
+						escaped << "\\n";
+					else if (c == '\t')
+						escaped << "\\t";
+					else if (c < 0x20 || c >= 0x7f)
+						escaped << '\\' << std::oct << std::setw(3) << std::setfill('0') << (int)c << std::dec;
+					else
+						escaped << c;
+				}
+
+				declarations << "static const aot::Value " << ident << "(\"" << escaped.str() << "\");\n";
+
+				return ident;
+			}
+
+			std::string Zen2CppHandler::moduleOf(AstNode *node)
+			{
+				if (!memberModule.empty())
+				{
+					// the left side of a member access named the module
+					std::string name = memberModule;
+					memberModule.clear();
+					return name;
+				}
 
+				auto *module = dynamic_cast<ModuleAst*>(node->module);
+				return (module != nullptr) ? module->moduleName : "";
+			}
+
+			std::string Zen2CppHandler::qualify(AstNode *node, const std::string &name)
+			{
+				return moduleOf(node) + "." + name;
 			}
 
-			bool Zen2CppHandler::varInScope(const std::string &name)
+			bool Zen2CppHandler::varInScope(const std::string &name, std::string &outIdent)
 			{
 				int startLevel = level;
 
-				while (startLevel >= -1)
+				while (startLevel >= 0)
 				{
 					Level &currentLevel = levels.at(startLevel);
 
-					if (std::find(currentLevel.variableNames.begin(),
-						currentLevel.variableNames.end(),
-						name)
-						!= currentLevel.variableNames.end())
+					auto it = currentLevel.variableNames.find(name);
+					if (it != currentLevel.variableNames.end())
 					{
+						outIdent = it->second;
 						return true;
 					}
 
@@ -445,7 +852,7 @@ namespace zenith
 				int startLevel = level;
 				ReturnMessage status = FN_NOT_FOUND;
 
-				while (startLevel >= -1)
+				while (startLevel >= 0)
 				{
 					Level &currentLevel = levels.at(startLevel);
 
@@ -479,15 +886,17 @@ namespace zenith
 				Level frame;
 				frame.type = type;
 				levels[++level] = frame;
+				indentLevel++;
 			}
 
-			void Zen2CppHandler::decreaseBlock()
+			void Zen2CppHandler::decreaseBlock(const char *terminator)
 			{
 				levels[level--] = Level();
+				indentLevel--;
 
 				indent();
-				append("}\n");
+				append(std::string("}") + terminator + "\n");
 			}
 		}
 	}
-}
\ No newline at end of file
+}
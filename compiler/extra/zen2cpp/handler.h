@@ -5,6 +5,7 @@
 #include <sstream>
 #include <string>
 #include <map>
+#include <set>
 #include <utility>
 
 #include "../../ast.h"
@@ -16,9 +17,10 @@ namespace zenith {
 		namespace zen2cpp {
 			struct Level
 			{
-				// maps the 'mangled' function names to their definitions
-				std::map<std::string, FunctionDefinitionAst*> functionDeclarations;
-				std::vector<std::string> variableNames;
+				// maps the module qualified function names to their definitions
+				std::vector<std::pair<std::string, FunctionDefinitionAst*>> functionDeclarations;
+				// maps the module qualified variable names to their C++ identifiers
+				std::map<std::string, std::string> variableNames;
 
 				BlockType type;
 			};
@@ -34,38 +36,71 @@ namespace zenith {
 				VAR_FOUND
 			};
 
+			/* Translates a module and the modules it imports into a single C++
+			   translation unit, built on top of zen2cpp_runtime.h. Global variables
+			   and functions become file scope definitions, nested functions become
+			   lambdas and the top level statements make up zen_main(). */
 			class Zen2CppHandler : public AstHandler
 			{
 			private:
-				std::stringstream cppOutput;
+				// file scope declarations: globals, constants and prototypes
+				std::stringstream declarations;
+				// definitions of the global functions
+				std::stringstream functions;
+				// body of zen_main()
+				std::stringstream mainBody;
+
+				// where the code being generated goes
+				std::stringstream *cppOutput = &mainBody;
+				int indentLevel = 1;
 
 				std::map<std::string, std::unique_ptr<ModuleAst>> externalModules;
+				std::set<std::string> moduleNames;
+				std::string rootModule;
+
+				std::vector<std::unique_ptr<FunctionDefinitionAst>> nativeFunctions;
 
-				int blockIdNum = 0;
-				std::map<FunctionDefinitionAst*, int> functionDefBlockIds;
+				// C++ identifiers of the functions that have been defined
+				std::map<FunctionDefinitionAst*, std::string> functionIdents;
+				// global functions of the root module, in order of definition
+				std::vector<FunctionDefinitionAst*> exportedFunctions;
+				std::set<std::string> nativeCaches;
+				std::map<std::string, std::string> stringConstants;
 
-				int level = -1; // todo: map module name to levels
+				// module named on the left of a member access, used for its right side
+				std::string memberModule;
+
+				int level = 0; // todo: map module name to levels
 				std::map<int, Level> levels;
 
-				bool varInScope(const std::string &name);
+				bool varInScope(const std::string &name, std::string &outIdent);
 				ReturnMessage fnInScope(const std::string &name, int nArgs, FunctionDefinitionAst *&out);
 
 				ParserState state;
 
 				void increaseBlock(BlockType type);
-				void decreaseBlock();
+				void decreaseBlock(const char *terminator = "");
+
+				std::string moduleOf(AstNode *node);
+				std::string qualify(AstNode *node, const std::string &name);
 
-				void indent(int nSpaces = 2)
+				/* Generate the code of an expression into a string. */
+				std::string expression(AstNode *node);
+				std::string assignTarget(AstNode *node);
+				std::string stringConstant(const std::string &value);
+
+				void functionBody(FunctionDefinitionAst *node, const char *terminator);
+
+				void indent()
 				{
-					for (int i = 0; i < (level + 1); i++)
-						for (int j = 0; j < nSpaces; j++)
-							cppOutput << " ";
+					for (int i = 0; i < indentLevel; i++)
+						(*cppOutput) << "\t";
 				}
 
 				template <typename T>
 				void append(T t)
 				{
-					cppOutput << t;
+					(*cppOutput) << t;
 				}
 
 			public:
@@ -74,9 +109,16 @@ namespace zenith {
 
 				void accept(ModuleAst *node);
 
+				/* Declare a function that is provided by the native binding table. */
+				void defineFunction(const std::string &name,
+					const std::string &moduleName,
+					size_t numArgs);
+
 				ParserState &getState() { return state; }
 
-				std::string getOutput() const { return cppOutput.str(); }
+				/* The complete translation unit. A shared library exports the global
+				   functions of the module instead of defining main(). */
+				std::string getOutput(bool sharedLibrary = false) const;
 
 			protected:
 				void accept(AstNode *node);
@@ -96,8 +138,11 @@ namespace zenith {
 				void accept(TrueAst *node);
 				void accept(FalseAst *node);
 				void accept(NullAst *node);
+				void accept(SelfAst *node);
+				void accept(NewAst *node);
 				void accept(FunctionDefinitionAst *node);
 				void accept(FunctionCallAst *node);
+				void accept(ClassAst *node);
 				void accept(IfStatementAst *node);
 				void accept(ReturnStatementAst *node);
 				void accept(ForLoopAst *node);
@@ -106,4 +151,4 @@ namespace zenith {
 	}
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,154 @@
+#include "zen2cpp.h"
+#include "handler.h"
+
+#include <cstdlib>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach-o/dyld.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace zenith
+{
+	namespace compiler
+	{
+		namespace zen2cpp
+		{
+			static std::string quote(const std::string &path)
+			{
+				return "\"" + path + "\"";
+			}
+
+			static const char *RUNTIME_HEADER = "zen2cpp_runtime.h";
+
+			// the directory of the running executable, where the runtime header is installed
+			static std::string executableDirectory()
+			{
+				std::string path;
+#ifdef _WIN32
+				char buffer[MAX_PATH];
+				DWORD length = GetModuleFileNameA(nullptr, buffer, MAX_PATH);
+				if (length != 0 && length < MAX_PATH)
+					path.assign(buffer, length);
+#elif defined(__APPLE__)
+				char buffer[4096];
+				uint32_t size = sizeof(buffer);
+				if (_NSGetExecutablePath(buffer, &size) == 0)
+					path = buffer;
+#else
+				char buffer[4096];
+				ssize_t length = readlink("/proc/self/exe", buffer, sizeof(buffer));
+				if (length > 0 && (size_t)length < sizeof(buffer))
+					path.assign(buffer, (size_t)length);
+#endif
+
+				size_t pos = path.find_last_of("/\\");
+				return (pos != std::string::npos) ? path.substr(0, pos) : ".";
+			}
+
+			Zen2Cpp::Zen2Cpp(ModuleAst *unit, ParserState &state, const AotOptions &options)
+			{
+				this->unit = unit;
+				this->state = state;
+				this->options = options;
+
+				if (this->options.includeDir.empty())
+					this->options.includeDir = executableDirectory();
+			}
+
+			bool Zen2Cpp::translate(const std::string &cppPath)
+			{
+				Zen2CppHandler handler(state);
+
+				for (ExternalFunctionDefine func : externalFunctions)
+					handler.defineFunction(func.name, func.moduleName, func.nArgs);
+
+				handler.accept(unit);
+				state = handler.getState();
+
+				if (state.errors.size() == 0)
+				{
+					std::ofstream file(cppPath);
+					if (!file.is_open())
+					{
+						std::cout << "Could not open file: " << cppPath << "\n";
+						return false;
+					}
+
+					file << handler.getOutput(options.sharedLibrary);
+					return true;
+				}
+
+				displayErrors(state.errors);
+				return false;
+			}
+
+			bool Zen2Cpp::compile(const std::string &cppPath, const std::string &outPath)
+			{
+				std::string header = options.includeDir + "/" + RUNTIME_HEADER;
+				if (!std::ifstream(header).good())
+				{
+					std::cout << "Could not find " << RUNTIME_HEADER << " in " << options.includeDir <<
+						", give the directory containing it with --aot-include=DIR\n";
+					return false;
+				}
+
+				std::string compiler = options.compiler;
+				if (compiler.empty())
+				{
+					const char *env = std::getenv("CXX");
+#ifdef _WIN32
+					compiler = (env != nullptr) ? env : "cl";
+#else
+					compiler = (env != nullptr) ? env : "c++";
+#endif
+				}
+
+				std::string command = compiler + " ";
+#ifdef _WIN32
+				if (compiler == "cl")
+				{
+					command += (options.flags.empty() ? "/nologo /O2 /EHsc" : options.flags);
+					if (options.sharedLibrary)
+						command += " /LD";
+					command += " /I" + quote(options.includeDir) + " " + quote(cppPath) + " /Fe" + quote(outPath);
+				}
+				else
+#endif
+				{
+					command += (options.flags.empty() ? "-O2 -std=c++14" : options.flags);
+					if (options.sharedLibrary)
+						command += " -shared -fPIC";
+					command += " -I" + quote(options.includeDir) + " " + quote(cppPath) + " -o " + quote(outPath);
+				}
+
+				if (std::system(command.c_str()) != 0)
+				{
+					std::cout << "Native compilation failed: " << command << "\n";
+					return false;
+				}
+
+				return true;
+			}
+
+			int Zen2Cpp::run(const std::string &exePath)
+			{
+				std::string path = exePath;
+#ifndef _WIN32
+				// not searched for in PATH
+				if (path.find('/') == std::string::npos)
+					path = "./" + path;
+#endif
+
+				std::cout.flush();
+				return std::system(quote(path).c_str());
+			}
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef __ZEN2CPP_ZEN2CPP_H__
+#define __ZEN2CPP_ZEN2CPP_H__
+
+#include <vector>
+#include <string>
+
+#include "../../ast.h"
+#include "../../state.h"
+#include "../../emit/emitter.h"
+
+namespace zenith {
+	namespace compiler {
+		namespace zen2cpp {
+			struct AotOptions
+			{
+				// command used to compile the generated code, $CXX or the platform default if empty
+				std::string compiler;
+				// directory containing zen2cpp_runtime.h, the executable's directory if empty
+				std::string includeDir;
+				std::string flags;
+				// build a shared library that the VM can load, instead of a program
+				bool sharedLibrary = false;
+			};
+
+			/* Compiles a module ahead of time: the module is translated to C++,
+			   which is then built into an executable by the system compiler. */
+			class Zen2Cpp
+			{
+			private:
+				ModuleAst *unit;
+				ParserState state;
+				AotOptions options;
+
+				std::vector<ExternalFunctionDefine> externalFunctions;
+
+			public:
+				Zen2Cpp(ModuleAst *unit, ParserState &state, const AotOptions &options);
+
+				void defineFunction(ExternalFunctionDefine func) { externalFunctions.push_back(func); }
+
+				/* Write the translation unit to 'cppPath'. Errors in the module are
+				   displayed, and nothing is written. */
+				bool translate(const std::string &cppPath);
+				/* Build the translation unit into the executable or shared library 'outPath'. */
+				bool compile(const std::string &cppPath, const std::string &outPath);
+
+				/* Run a compiled program, returning its exit code. */
+				static int run(const std::string &exePath);
+			};
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,378 @@
+#ifndef __ZEN2CPP_RUNTIME_H__
+#define __ZEN2CPP_RUNTIME_H__
+
+/* Runtime support for programs generated by zen2cpp. This header is included
+   by the generated translation unit only, so it must not depend on anything
+   else in the compiler or the VM. */
+
+#include <map>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define ZEN_AOT_EXPORT extern "C" __declspec(dllexport)
+#else
+#define ZEN_AOT_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+namespace zenith
+{
+	namespace aot
+	{
+		enum ValueType
+		{
+			VALUE_NULL,
+			VALUE_INTEGER,
+			VALUE_FLOAT,
+			VALUE_STRING
+		};
+
+		/* A dynamically typed value, with the same conversions as the
+		   objects of the VM. */
+		struct Value
+		{
+			ValueType type;
+
+			long i;
+			double f;
+			std::shared_ptr<const std::string> s;
+
+			Value() : type(VALUE_NULL), i(0), f(0.0) {}
+			Value(int value) : type(VALUE_INTEGER), i(value), f(0.0) {}
+			Value(long value) : type(VALUE_INTEGER), i(value), f(0.0) {}
+			Value(double value) : type(VALUE_FLOAT), i(0), f(value) {}
+			Value(const std::string &value)
+				: type(VALUE_STRING), i(0), f(0.0), s(std::make_shared<const std::string>(value)) {}
+			Value(const char *value)
+				: type(VALUE_STRING), i(0), f(0.0), s(std::make_shared<const std::string>(value)) {}
+
+			bool isArithmetic() const { return type == VALUE_INTEGER || type == VALUE_FLOAT; }
+
+			std::string str() const
+			{
+				switch (type)
+				{
+				case VALUE_INTEGER:
+					return std::to_string(i);
+				case VALUE_FLOAT:
+					return std::to_string(f);
+				case VALUE_STRING:
+					return *s;
+				default:
+					return "null";
+				}
+			}
+
+			std::string typeStr() const
+			{
+				switch (type)
+				{
+				case VALUE_INTEGER:
+					return "integer";
+				case VALUE_FLOAT:
+					return "float";
+				case VALUE_STRING:
+					return "string";
+				default:
+					return "null";
+				}
+			}
+		};
+
+		/* Operands of a binary operation. Brace initialization evaluates the
+		   left operand before the right one, as the VM does. */
+		struct Operands
+		{
+			Value left;
+			Value right;
+		};
+
+		inline std::runtime_error conversionError(const Value &left, const Value &right)
+		{
+			return std::runtime_error("No conversion found between types '" +
+				left.typeStr() + "' and '" + right.typeStr() + "'");
+		}
+
+		inline std::runtime_error conversionError(const Value &value)
+		{
+			return std::runtime_error("No conversion found for type '" + value.typeStr() + "'");
+		}
+
+		/* Applies 'fn' to two numbers. The result has the type of the left
+		   operand, so an integer combined with a float is truncated. */
+		template <typename Fn>
+		inline Value arithmetic(const Operands &o, Fn fn)
+		{
+			const Value &l = o.left, &r = o.right;
+
+			if (l.type == VALUE_INTEGER)
+			{
+				if (r.type == VALUE_INTEGER)
+					return Value((long)fn(l.i, r.i));
+				else if (r.type == VALUE_FLOAT)
+					return Value((long)fn((double)l.i, r.f));
+			}
+			else if (l.type == VALUE_FLOAT)
+			{
+				if (r.type == VALUE_INTEGER)
+					return Value((double)fn(l.f, (double)r.i));
+				else if (r.type == VALUE_FLOAT)
+					return Value((double)fn(l.f, r.f));
+			}
+
+			throw conversionError(l, r);
+		}
+
+		template <typename Fn>
+		inline Value integral(const Operands &o, Fn fn)
+		{
+			if (o.left.type != VALUE_INTEGER || o.right.type != VALUE_INTEGER)
+				throw conversionError(o.left, o.right);
+
+			return Value((long)fn(o.left.i, o.right.i));
+		}
+
+		/* Comparisons give 0 or 1 in the type of the left operand; two
+		   strings compare to an integer. */
+		template <typename Fn>
+		inline Value compare(const Operands &o, Fn fn)
+		{
+			if (o.left.type == VALUE_STRING && o.right.type == VALUE_STRING)
+				return Value((long)fn(*o.left.s, *o.right.s));
+
+			return arithmetic(o, fn);
+		}
+
+		inline Value add(const Operands &o)
+		{
+			if (o.left.type == VALUE_STRING)
+				return Value(*o.left.s + o.right.str());
+
+			return arithmetic(o, [](auto a, auto b) { return a + b; });
+		}
+
+		inline Value sub(const Operands &o)
+		{
+			return arithmetic(o, [](auto a, auto b) { return a - b; });
+		}
+
+		inline Value mul(const Operands &o)
+		{
+			return arithmetic(o, [](auto a, auto b) { return a * b; });
+		}
+
+		inline Value div(const Operands &o)
+		{
+			if (o.left.type == VALUE_INTEGER && o.right.type == VALUE_INTEGER && o.right.i == 0)
+				throw std::runtime_error("Division by zero");
+
+			return arithmetic(o, [](auto a, auto b) { return a / b; });
+		}
+
+		inline Value pow(const Operands &o)
+		{
+			return arithmetic(o, [](auto a, auto b) { return std::pow(a, b); });
+		}
+
+		inline Value mod(const Operands &o)
+		{
+			if (o.left.type == VALUE_INTEGER && o.right.type == VALUE_INTEGER && o.right.i == 0)
+				throw std::runtime_error("Division by zero");
+
+			return integral(o, [](long a, long b) { return a % b; });
+		}
+
+		inline Value logicalAnd(const Operands &o)
+		{
+			return integral(o, [](long a, long b) { return a && b; });
+		}
+
+		inline Value logicalOr(const Operands &o)
+		{
+			return integral(o, [](long a, long b) { return a || b; });
+		}
+
+		inline Value eql(const Operands &o)
+		{
+			return compare(o, [](const auto &a, const auto &b) { return a == b; });
+		}
+
+		inline Value notEql(const Operands &o)
+		{
+			return compare(o, [](const auto &a, const auto &b) { return a != b; });
+		}
+
+		inline Value less(const Operands &o)
+		{
+			return compare(o, [](const auto &a, const auto &b) { return a < b; });
+		}
+
+		inline Value greater(const Operands &o)
+		{
+			return compare(o, [](const auto &a, const auto &b) { return a > b; });
+		}
+
+		inline Value lessEql(const Operands &o)
+		{
+			return compare(o, [](const auto &a, const auto &b) { return a <= b; });
+		}
+
+		inline Value greaterEql(const Operands &o)
+		{
+			return compare(o, [](const auto &a, const auto &b) { return a >= b; });
+		}
+
+		inline Value logicalNot(const Value &value)
+		{
+			if (value.type == VALUE_INTEGER)
+				return Value((long)!value.i);
+			else if (value.type == VALUE_FLOAT)
+				return Value((double)!value.f);
+
+			throw conversionError(value);
+		}
+
+		inline Value negate(const Value &value)
+		{
+			if (value.type == VALUE_INTEGER)
+				return Value(-value.i);
+			else if (value.type == VALUE_FLOAT)
+				return Value(-value.f);
+
+			throw conversionError(value);
+		}
+
+		inline bool truthy(const Value &value)
+		{
+			switch (value.type)
+			{
+			case VALUE_INTEGER:
+				return value.i != 0;
+			case VALUE_FLOAT:
+				return value.f != 0.0;
+			case VALUE_STRING:
+				return !value.s->empty();
+			default:
+				return false;
+			}
+		}
+
+		inline Value &assign(Value &left, const Value &right)
+		{
+			left = right;
+			return left;
+		}
+
+		inline Value &addAssign(Value &left, const Value &right)
+		{
+			return assign(left, add({ left, right }));
+		}
+
+		inline Value &subAssign(Value &left, const Value &right)
+		{
+			return assign(left, sub({ left, right }));
+		}
+
+		inline Value &mulAssign(Value &left, const Value &right)
+		{
+			return assign(left, mul({ left, right }));
+		}
+
+		inline Value &divAssign(Value &left, const Value &right)
+		{
+			return assign(left, div({ left, right }));
+		}
+
+		typedef Value(*NativeFunction)(const std::vector<Value> &args);
+
+		/* Native functions that generated code may call, by name and number
+		   of arguments. 'print' is always bound. */
+		class NativeTable
+		{
+		private:
+			std::map<std::pair<std::string, size_t>, NativeFunction> functions;
+
+			static Value print(const std::vector<Value> &args)
+			{
+				std::cout << args[0].str() << "\n";
+				return Value();
+			}
+
+			NativeTable()
+			{
+				bind("print", 1, &print);
+			}
+
+		public:
+			static NativeTable &instance()
+			{
+				static NativeTable table;
+				return table;
+			}
+
+			void bind(const std::string &name, size_t nArgs, NativeFunction fn)
+			{
+				functions[{ name, nArgs }] = fn;
+			}
+
+			NativeFunction find(const std::string &name, size_t nArgs) const
+			{
+				auto it = functions.find({ name, nArgs });
+				return (it != functions.end()) ? it->second : nullptr;
+			}
+		};
+
+		/* Binds a native function when the program starts, e.g.
+		   static NativeBinding sqrtBinding("sqrt", 1, &sqrtImpl); */
+		struct NativeBinding
+		{
+			NativeBinding(const std::string &name, size_t nArgs, NativeFunction fn)
+			{
+				NativeTable::instance().bind(name, nArgs, fn);
+			}
+		};
+
+		/* Calls a native function, looking it up the first time through 'cache'. */
+		inline Value callNative(NativeFunction &cache, const char *name, const std::vector<Value> &args)
+		{
+			if (cache == nullptr)
+			{
+				cache = NativeTable::instance().find(name, args.size());
+				if (cache == nullptr)
+					throw std::runtime_error(std::string("Native function '") + name + "' is not bound");
+			}
+
+			return cache(args);
+		}
+
+		// bumped whenever ModuleExports or Value change layout
+		const int MODULE_ABI_VERSION = 1;
+
+		struct ModuleFunction
+		{
+			const char *name;
+			size_t nArgs;
+			NativeFunction fn;
+		};
+
+		/* What a module compiled as a shared library exports to the VM, through
+		   zen_aot_module(). 'init' runs the top level statements of the module. */
+		struct ModuleExports
+		{
+			int abiVersion;
+			const char *moduleName;
+			const ModuleFunction *functions;
+			size_t numFunctions;
+			void(*init)();
+		};
+
+		typedef const ModuleExports *(*ModuleEntry)();
+	}
+}
+
+#endif
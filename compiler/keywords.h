@@ -4,6 +4,9 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
 
 namespace zenith
 {
@@ -55,72 +58,85 @@ namespace zenith
 			KW_DELETE
 		};
 
-		const std::map<std::string, Keyword> keywords =
+		const int NUM_KEYWORDS = KW_DELETE + 1;
+		const size_t MAX_KEYWORD_LENGTH = 9;
+
+		// in the order of Keyword
+		constexpr const char *keywordNames[NUM_KEYWORDS] =
+		{
+			"if", "else", "do", "while", "for", "foreach", "switch", "case",
+			"break", "continue", "default", "return", "goto", "try", "catch", "throw",
+			"class", "enum", "struct", "void", "true", "false", "null", "var",
+			"static", "public", "private", "protected", "const", "fn", "super", "module",
+			"package", "typeof", "is", "as", "cast", "import", "self", "new",
+			"delete"
+		};
+
+		/* Perfect hash of the keywords: the first, second and last characters and
+		   the length, multiplied into the top bits. No two keywords share a slot;
+		   a keyword that is added needs a free one, or a new multiplier. */
+		const uint32_t KEYWORD_HASH_MULTIPLIER = 0xBC8741E1u;
+		const int KEYWORD_HASH_BITS = 6;
+
+		constexpr uint32_t keywordHash(const char *str, size_t length)
 		{
-			{ "if", KW_IF },
-			{ "else", KW_ELSE },
-			{ "do", KW_DO },
-			{ "while", KW_WHILE },
-			{ "for", KW_FOR },
-			{ "foreach", KW_FOREACH },
-			{ "switch", KW_SWITCH },
-			{ "case", KW_CASE },
-			{ "break", KW_BREAK },
-			{ "continue", KW_CONTINUE },
-			{ "default", KW_DEFAULT },
-			{ "return", KW_RETURN },
-			{ "goto", KW_GOTO },
-			{ "try", KW_TRY },
-			{ "catch", KW_CATCH },
-			{ "throw", KW_THROW },
-			{ "class", KW_CLASS },
-			{ "enum", KW_ENUM },
-			{ "struct", KW_STRUCT },
-			{ "void", KW_VOID },
-			{ "true", KW_TRUE },
-			{ "false", KW_FALSE },
-			{ "null", KW_NULL },
-			{ "var", KW_VAR },
-			{ "static", KW_STATIC },
-			{ "public", KW_PUBLIC },
-			{ "private", KW_PRIVATE },
-			{ "protected", KW_PROTECTED },
-			{ "const", KW_CONST },
-			{ "fn", KW_FUNCTION },
-			{ "super", KW_SUPER },
-			{ "module", KW_MODULE },
-			{ "package", KW_PACKAGE },
-			{ "typeof", KW_TYPEOF },
-			{ "is", KW_IS },
-			{ "as", KW_AS },
-			{ "cast", KW_CAST },
-			{ "import", KW_IMPORT },
-			{ "self", KW_SELF },
-			{ "new", KW_NEW },
-			{ "delete", KW_DELETE }
+			return (uint32_t)(((uint32_t)(uint8_t)str[0] |
+				((uint32_t)(uint8_t)str[1] << 8) |
+				((uint32_t)(uint8_t)str[length - 1] << 16) |
+				((uint32_t)length << 24)) * KEYWORD_HASH_MULTIPLIER) >> (32 - KEYWORD_HASH_BITS);
+		}
+
+		// the keyword in each slot of the hash, or -1
+		constexpr signed char keywordSlots[1 << KEYWORD_HASH_BITS] =
+		{
+			10, -1, 37, 25, 17, -1, 18, 23, 22, -1, 20, 31, -1, -1, 0, 30,
+			-1, 40, -1, 29, 14, 8, 27, -1, -1, 15, -1, 13, 34, -1, -1, -1,
+			-1, 36, 35, -1, 9, 12, 6, 2, 39, -1, 7, 5, -1, -1, 24, 4,
+			21, -1, 19, 28, 38, -1, 26, 32, 33, 11, -1, -1, 1, 16, 3, -1
 		};
 
+		constexpr size_t keywordLength(const char *str)
+		{
+			return (*str != '\0') ? 1 + keywordLength(str + 1) : 0;
+		}
+
+		constexpr bool keywordSlotsValid(int kw = 0)
+		{
+			return kw == NUM_KEYWORDS ||
+				(keywordSlots[keywordHash(keywordNames[kw], keywordLength(keywordNames[kw]))] == kw &&
+					keywordSlotsValid(kw + 1));
+		}
+
+		static_assert(keywordSlotsValid(), "Every keyword must hash to its own slot in keywordSlots");
+
 		inline const std::string &getKeywordStr(Keyword kw)
 		{
-			auto it = std::find_if(keywords.begin(), keywords.end(),
-				[&kw](const std::pair<std::string, Keyword> &item) {
-				return item.second == kw;
-			});
+			static const std::vector<std::string> strings(keywordNames, keywordNames + NUM_KEYWORDS);
 
-			if (it == keywords.end())
+			if (kw < 0 || kw >= NUM_KEYWORDS)
 				throw std::out_of_range("Keyword has no string equivalent");
 
-			return it->first;
+			return strings[kw];
 		}
 
-		inline const Keyword getKeyword(const std::string &str)
+		inline Keyword getKeyword(const char *str, size_t length)
 		{
-			auto it = keywords.find(str);
+			if (length < 2 || length > MAX_KEYWORD_LENGTH)
+				return Keyword::KW_INVALID;
 
-			if (it == keywords.end())
+			int kw = keywordSlots[keywordHash(str, length)];
+			if (kw == -1 || keywordLength(keywordNames[kw]) != length ||
+				std::memcmp(keywordNames[kw], str, length) != 0)
+			{
 				return Keyword::KW_INVALID;
-			else
-				return it->second;
+			}
+
+			return (Keyword)kw;
+		}
+
+		inline Keyword getKeyword(const std::string &str)
+		{
+			return getKeyword(str.data(), str.size());
 		}
 	}
 }
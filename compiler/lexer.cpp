@@ -2,38 +2,303 @@
 
 #include "operators.h"
 #include "keywords.h"
+#include "scan.h"
+
+#include "../util/thread_pool.h"
+
+#include <fstream>
+#include <cstring>
 
 namespace zenith
 {
 	namespace compiler
 	{
-		Lexer::Lexer(const std::string &source, const std::string &filepath)
+		Lexer::Lexer(std::string source, const std::string &filepath)
 		{
-			this->state.source = source;
-			state.location.file = filepath;
-			state.position = 0;
 			state.sourceLen = source.length();
+			state.source = std::make_shared<std::string>(std::move(source));
+			state.position = 0;
 			state.location = SourceLocation(0, 0, filepath);
+
+			currentChunk = 0;
+			chunk = nullptr;
+		}
+
+		Lexer::Lexer(std::shared_ptr<std::string> source, Chunk *chunk, const SourceLocation &location)
+		{
+			state.source = std::move(source);
+			state.position = chunk->begin;
+			state.sourceLen = chunk->end;
+			state.location = location;
+
+			currentChunk = 0;
+			this->chunk = chunk;
+		}
+
+		bool Lexer::readSource(const std::string &path, std::string &source)
+		{
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if (!file.is_open())
+				return false;
+
+			// one read into a buffer of the right size
+			source.resize((size_t)file.tellg());
+			file.seekg(0);
+			file.read(&source[0], source.size());
+
+			return true;
+		}
+
+		Token Lexer::makeToken(TokenType type, int start)
+		{
+			return{ type, (uint32_t)start, (uint32_t)(state.position - start), state.location };
+		}
+
+		Token Lexer::makeToken(TokenType type, const std::string &text)
+		{
+			if (chunk != nullptr)
+			{
+				// other chunks are reading the source, it is appended to once they are done
+				Token token = { type, (uint32_t)(state.source->size() + chunk->literals.size()),
+					(uint32_t)text.size(), state.location };
+				chunk->literals.append(text);
+				return token;
+			}
+
+			Token token = { type, (uint32_t)state.source->size(), (uint32_t)text.size(), state.location };
+			state.source->append(text);
+			return token;
+		}
+
+		std::vector<int> Lexer::splitChunks(const char *data, size_t size, size_t numChunks)
+		{
+			std::vector<int> starts = { 0 };
+
+			const char *p = data;
+			const char *end = data + size;
+			const char *target = data + size / numChunks;
+
+			auto skip = [&](size_t n)
+			{
+				p = ((size_t)(end - p) > n) ? p + n : end;
+			};
+
+			// 'at' follows a line break that is not inside of a token
+			auto split = [&](const char *at)
+			{
+				if (at >= target && at < end)
+				{
+					starts.push_back((int)(at - data));
+					target = data + size / numChunks * starts.size();
+				}
+			};
+
+			// the same as the lexer, as far as strings and comments go
+			while (p < end && starts.size() < numChunks)
+			{
+				const char *run = p;
+				p += scan::until(p, end, '"', '\'', '/');
+
+				while (target < p && starts.size() < numChunks)
+				{
+					const char *from = (target > run) ? target : run;
+					auto *lineBreak = (const char*)std::memchr(from, '\n', p - from);
+					if (lineBreak == nullptr)
+						break;
+
+					split(lineBreak + 1);
+				}
+
+				if (p >= end || *p == '\0')
+					break;
+
+				char ch = *p;
+				if (ch == '/')
+				{
+					if (p + 1 < end && p[1] == '/')
+					{
+						auto *lineBreak = (const char*)std::memchr(p, '\n', end - p);
+						if (lineBreak == nullptr)
+							break;
+
+						p = lineBreak + 1;
+						split(p);
+					}
+					else if (p + 1 < end && p[1] == '*')
+					{
+						p += 2;
+						while (true)
+						{
+							auto *star = (const char*)std::memchr(p, '*', end - p);
+							p = (star != nullptr) ? star + 1 : end;
+
+							if (p >= end || *p == '/')
+								break;
+						}
+						skip(1);
+					}
+					else
+						p++;
+				}
+				else
+				{
+					bool multiline = (end - p > 2 && p[1] == ch && p[2] == ch);
+					skip(multiline ? 3 : 1);
+
+					while (true)
+					{
+						p += scan::until(p, end, ch, '\\', multiline ? ch : '\n');
+						if (p >= end || *p != '\\')
+							break;
+						skip(2);
+					}
+
+					if (p >= end || *p == '\0')
+						break;
+					// the lexer reads the delimiter, or what is there instead of it
+					skip(multiline ? 3 : 1);
+				}
+			}
+
+			return starts;
+		}
+
+		size_t Lexer::lexInChunks(size_t numThreads)
+		{
+			size_t size = (size_t)state.sourceLen;
+
+			size_t numChunks = size / MIN_CHUNK_SIZE;
+			if (numChunks > numThreads)
+				numChunks = numThreads;
+			if (numChunks < 2 || state.position != 0 || chunk != nullptr)
+				return 0;
+
+			auto starts = splitChunks(state.source->data(), size, numChunks);
+			if (starts.size() < 2)
+				return 0;
+
+			chunks.resize(starts.size());
+			for (size_t i = 0; i < chunks.size(); i++)
+			{
+				chunks[i].begin = starts[i];
+				chunks[i].end = (i + 1 < starts.size()) ? starts[i + 1] : (int)size;
+				chunks[i].next = 0;
+			}
+
+			{
+				util::ThreadPool pool(numThreads);
+
+				for (auto &&c : chunks)
+				{
+					Chunk *current = &c;
+					pool.submit([this, current]()
+					{
+						SourceLocation location = state.location;
+						location.line = 0;
+						location.column = 0;
+
+						Lexer lexer(state.source, current, location);
+
+						Token token;
+						while (lexer.next(token))
+							current->tokens.push_back(token);
+
+						current->failed = !lexer.state.errors.empty();
+						current->location = lexer.state.location;
+					});
+				}
+
+				pool.wait();
+			}
+
+			// the tokens are taken in order, so the lines and literals before each chunk are known
+			int lineBase = state.location.line;
+			for (size_t i = 0; i < chunks.size(); i++)
+			{
+				Chunk &c = chunks[i];
+
+				if (c.failed)
+				{
+					// lexed again from its start, where nothing carries over from before
+					state.position = c.begin;
+					state.location.line = lineBase;
+					state.location.column = 0;
+
+					chunks.resize(i);
+					return chunks.size();
+				}
+
+				c.lineBase = lineBase;
+				c.literalBase = (uint32_t)(state.source->size() - size);
+				state.source->append(c.literals);
+				std::string().swap(c.literals);
+
+				lineBase += c.location.line;
+				state.position = c.end;
+				state.location.line = lineBase;
+				state.location.column = c.location.column;
+			}
+
+			return chunks.size();
+		}
+
+		bool Lexer::nextFromChunk(Token &token)
+		{
+			while (currentChunk < chunks.size())
+			{
+				Chunk &c = chunks[currentChunk];
+
+				if (c.next < c.tokens.size())
+				{
+					token = c.tokens[c.next++];
+					token.location.line += c.lineBase;
+					if (token.offset >= (uint32_t)state.sourceLen)
+						token.offset += c.literalBase;
+
+					return true;
+				}
+
+				// done with it
+				std::vector<Token>().swap(c.tokens);
+				currentChunk++;
+			}
+
+			return false;
 		}
 
 		std::vector<Token> Lexer::scan()
 		{
 			std::vector<Token> tokens;
+
+			Token token;
+			while (next(token))
+				tokens.push_back(token);
+
+			return tokens;
+		}
+
+		bool Lexer::next(Token &token)
+		{
+			if (currentChunk < chunks.size() && nextFromChunk(token))
+				return true;
+
 			skipWhitespace();
 			while (peekChar() != '\0')
 			{
-				Token nextToken = this->nextToken();
-				if (nextToken.type != TokenType::TK_UNDEFINED)
-					tokens.push_back(nextToken);
-
+				token = nextToken();
 				skipWhitespace();
+
+				// comments are read as undefined tokens
+				if (token.type != TokenType::TK_UNDEFINED)
+					return true;
 			}
 
-			return tokens;
+			return false;
 		}
 
 		Token Lexer::nextToken()
 		{
+			int start = state.position;
 			char ch = peekChar();
 
 			if (ch == '\'' || ch == '"')
@@ -60,47 +325,47 @@ namespace zenith
 			else if (ch == '{')
 			{
 				readChar();
-				return{ TokenType::TK_OPEN_BRACE, "{", state.location };
+				return makeToken(TokenType::TK_OPEN_BRACE, start);
 			}
 			else if (ch == '}')
 			{
 				readChar();
-				return{ TokenType::TK_CLOSE_BRACE, "}", state.location };
+				return makeToken(TokenType::TK_CLOSE_BRACE, start);
 			}
 			else if (ch == '[')
 			{
 				readChar();
-				return{ TokenType::TK_OPEN_BRACKET, "[", state.location };
+				return makeToken(TokenType::TK_OPEN_BRACKET, start);
 			}
 			else if (ch == ']')
 			{
 				readChar();
-				return{ TokenType::TK_CLOSE_BRACKET, "]", state.location };
+				return makeToken(TokenType::TK_CLOSE_BRACKET, start);
 			}
 			else if (ch == '(')
 			{
 				readChar();
-				return{ TokenType::TK_OPEN_PARENTHESIS, "(", state.location };
+				return makeToken(TokenType::TK_OPEN_PARENTHESIS, start);
 			}
 			else if (ch == ')')
 			{
 				readChar();
-				return{ TokenType::TK_CLOSE_PARENTHESIS, ")", state.location };
+				return makeToken(TokenType::TK_CLOSE_PARENTHESIS, start);
 			}
 			else if (ch == ';')
 			{
 				readChar();
-				return{ TokenType::TK_SEMICOLON, ";", state.location };
+				return makeToken(TokenType::TK_SEMICOLON, start);
 			}
 			else if (ch == ':')
 			{
 				readChar();
-				return{ TokenType::TK_COLON, ":", state.location };
+				return makeToken(TokenType::TK_COLON, start);
 			}
 			else if (ch == ',')
 			{
 				readChar();
-				return{ TokenType::TK_COMMA, ",", state.location };
+				return makeToken(TokenType::TK_COMMA, start);
 			}
 			else
 			{
@@ -112,35 +377,28 @@ namespace zenith
 
 		Token Lexer::readNumber()
 		{
-			std::string str = "";
-			char ch = peekChar();
+			int start = state.position;
+			advance(scan::digits(current(), end()));
 
-			do
-			{
-				if (ch == '.')
-					return readFloat(str);
-
-				str += readChar();
-				ch = peekChar();
-			} while (isdigit(ch) || ch == '.');
+			if (peekChar() == '.')
+				return readFloat(start);
 
-			return{ TokenType::TK_INTEGER, str, state.location };
+			return makeToken(TokenType::TK_INTEGER, start);
 		}
 
-		Token Lexer::readFloat(std::string &str)
+		Token Lexer::readFloat(int start)
 		{
 			readChar();
-			str += ".";
 
 			char ch = peekChar();
 
 			do
 			{
-				str += readChar();
+				readChar();
 				ch = peekChar();
 			} while (isdigit(ch));
 
-			return{ TokenType::TK_FLOAT, str, state.location };
+			return makeToken(TokenType::TK_FLOAT, start);
 		}
 
 		Token Lexer::readString()
@@ -156,28 +414,39 @@ namespace zenith
 			{
 				readChar(); // eat the delimiter
 
+				int start = state.position;
+				// only built once there is an escape, otherwise the token is the source text
 				std::string str;
+				bool escaped = false;
 
-				char ch = peekChar();
-				while (ch != delimiter)
+				while (true)
 				{
-					if (ch == '\\')
+					const char *run = current();
+					size_t length = scan::until(run, end(), (char)delimiter, '\\', '\n');
+					if (escaped)
+						str.append(run, length);
+					advance(length);
+
+					if (peekChar() != '\\')
+						break;
+
+					if (!escaped)
 					{
-						readChar();
-						str += parseEscapeCode();
+						str = state.source->substr(start, state.position - start);
+						escaped = true;
 					}
-					else if (ch == '\0' || ch == '\n')
-						break;
-					else
-						str += readChar();
 
-					ch = peekChar();
+					readChar();
+					str += parseEscapeCode();
 				}
 
+				Token token = makeToken(TokenType::TK_STRING, start);
+
 				if (readChar() != delimiter)
 					state.errors.push_back({ ErrorType::UNTERMINATED_STRING_LITERAL, state.location });
 
-				return{ TokenType::TK_STRING, str, state.location };
+				token.location = state.location;
+				return escaped ? makeToken(TokenType::TK_STRING, str) : token;
 			}
 		}
 
@@ -187,24 +456,33 @@ namespace zenith
 			readChar();
 			readChar();
 
+			int start = state.position;
 			std::string str;
+			bool escaped = false;
 
-			char ch = peekChar();
-			while (ch != delimiter)
+			while (true)
 			{
-				if (ch == '\\')
+				const char *run = current();
+				size_t length = scan::until(run, end(), delimiter, '\\', delimiter);
+				if (escaped)
+					str.append(run, length);
+				advance(length);
+
+				if (peekChar() != '\\')
+					break;
+
+				if (!escaped)
 				{
-					readChar();
-					str += parseEscapeCode();
+					str = state.source->substr(start, state.position - start);
+					escaped = true;
 				}
-				else if (ch == '\0')
-					break;
-				else
-					str += readChar();
 
-				ch = peekChar();
+				readChar();
+				str += parseEscapeCode();
 			}
 
+			Token token = makeToken(TokenType::TK_STRING, start);
+
 			if (!(readChar() == delimiter &&
 				readChar() == delimiter &&
 				readChar() == delimiter))
@@ -212,87 +490,75 @@ namespace zenith
 				state.errors.push_back({ ErrorType::UNTERMINATED_STRING_LITERAL, state.location });
 			}
 
-			return{ TokenType::TK_STRING, str, state.location };
+			token.location = state.location;
+			return escaped ? makeToken(TokenType::TK_STRING, str) : token;
 		}
 
 		Token Lexer::readIdentifier()
 		{
-			std::string str;
-			char ch = peekChar();
-
-			do
-			{
-				str += readChar();
-				ch = peekChar();
-			} while ((isdigit(ch) || isalpha(ch)) || ch == '_');
+			int start = state.position;
+			advance(scan::identifier(current(), end()));
 
-			Keyword kw = getKeyword(str);
+			Keyword kw = getKeyword(state.source->data() + start, state.position - start);
 			if (kw == Keyword::KW_INVALID)
-				return{ TokenType::TK_IDENTIFIER, str, state.location };
+				return makeToken(TokenType::TK_IDENTIFIER, start);
 			else
-				return{ TokenType::TK_KEYWORD, str, state.location };
+				return makeToken(TokenType::TK_KEYWORD, start);
 		}
 
 		Token Lexer::readOperator()
 		{
+			int start = state.position;
 			char ch = readChar();
+			char next = peekChar();
 
-			std::string nextTwoChars;
-			nextTwoChars += ch;
-			nextTwoChars += peekChar();
-
-			Operator op = getOperator(nextTwoChars);
+			const char nextTwoChars[2] = { ch, next };
+			Operator op = getOperator(nextTwoChars, 2);
 			if (op != Operator::OP_INVALID)
 			{
 				readChar();
-				return{ TokenType::TK_OPERATOR, nextTwoChars, state.location };
+				return makeToken(TokenType::TK_OPERATOR, start);
 			}
-			else if (nextTwoChars == "/*")
+			else if (ch == '/' && next == '*')
 			{
 				readChar();
 				readBlockComment();
-				return{ TokenType::TK_UNDEFINED, nextTwoChars, state.location };
+				return makeToken(TokenType::TK_UNDEFINED, start);
 			}
-			else if (nextTwoChars == "//")
+			else if (ch == '/' && next == '/')
 			{
 				readChar();
 				readLineComment();
-				return{ TokenType::TK_UNDEFINED, nextTwoChars, state.location };
+				return makeToken(TokenType::TK_UNDEFINED, start);
 			}
 
-			std::string strOp;
-			strOp += ch;
 			switch (ch)
 			{
 			case '.':
-				return{ TokenType::TK_DOT, strOp, state.location };
+				return makeToken(TokenType::TK_DOT, start);
 			default:
-				return{ TokenType::TK_OPERATOR, strOp, state.location };
+				return makeToken(TokenType::TK_OPERATOR, start);
 			}
 		}
 
 		void Lexer::readLineComment()
 		{
-			char ch;
-			do
-			{
-				ch = readChar();
-			} while (ch != '\0' && ch != '\n');
+			advance(scan::until(current(), end(), '\n', '\n', '\n'));
+			readChar();
 		}
 
 		void Lexer::readBlockComment()
 		{
-			while (peekChar() != '\0')
+			while (true)
 			{
-				char ch = readChar();
+				advance(scan::until(current(), end(), '*', '*', '*'));
+				if (readChar() != '*')
+					break;
 
-				if (ch == '*')
+				if (peekChar() == '/')
 				{
-					if (peekChar() == '/')
-					{
-						readChar();
-						return;
-					}
+					readChar();
+					return;
 				}
 			}
 
@@ -304,7 +570,8 @@ namespace zenith
 			if (state.position >= state.sourceLen)
 				return '\0';
 
-			if (state.source[state.position] == '\n')
+			const std::string &source = *state.source;
+			if (source[state.position] == '\n')
 			{
 				state.location.line++;
 				state.location.column = 0;
@@ -312,7 +579,33 @@ namespace zenith
 			else
 				state.location.column++;
 
-			return state.source[state.position++];
+			return source[state.position++];
+		}
+
+		void Lexer::advance(size_t n)
+		{
+			const char *run = current();
+
+			int lines = 0;
+			size_t lineStart = 0;
+			for (size_t i = 0; i < n; i++)
+			{
+				if (run[i] == '\n')
+				{
+					lines++;
+					lineStart = i + 1;
+				}
+			}
+
+			if (lines != 0)
+			{
+				state.location.line += lines;
+				state.location.column = (int)(n - lineStart);
+			}
+			else
+				state.location.column += (int)n;
+
+			state.position += (int)n;
 		}
 
 		char Lexer::peekChar(int n)
@@ -320,7 +613,7 @@ namespace zenith
 			if ((state.position + n) >= state.sourceLen)
 				return '\0';
 
-			return state.source[state.position + n];
+			return (*state.source)[state.position + n];
 		}
 
 		char Lexer::parseEscapeCode()
@@ -355,16 +648,10 @@ namespace zenith
 
 		bool Lexer::skipWhitespace()
 		{
-			bool hadNewLine = false;
-			while (isspace(peekChar()))
-			{
-				char ch = readChar();
-
-				if (ch == '\n')
-					hadNewLine = true;
-			}
+			int line = state.location.line;
+			advance(scan::whitespace(current(), end()));
 
-			return hadNewLine;
+			return state.location.line != line;
 		}
 	}
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <vector>
 #include <ctype.h>
 #include <cstdint>
+#include <memory>
 
 #include "state.h"
 
@@ -17,13 +18,61 @@ namespace zenith
 		public:
 			LexerState state;
 
-			Lexer(const std::string &source, const std::string &filepath = "");
+			Lexer(std::string source, const std::string &filepath = "");
 			std::vector<Token> scan();
+			/* The next token of the source. Returns false at the end. */
+			bool next(Token &token);
+
+			/* Read a whole file into 'source'. Returns false if it can not be opened. */
+			static bool readSource(const std::string &path, std::string &source);
+
+			/* Lex a large source up front, in chunks on 'numThreads' threads.
+			   Chunks are split at line breaks between tokens, and next() then
+			   serves their tokens in order. From a chunk that has errors on, the
+			   source is lexed as usual, so errors are the same either way. Must be
+			   called before the first token is read. Returns the number of chunks. */
+			size_t lexInChunks(size_t numThreads);
+
+			// chunks are at least this large, smaller sources are lexed on one thread
+			static const size_t MIN_CHUNK_SIZE = 1 << 20;
 
 		private:
+			struct Chunk
+			{
+				int begin;
+				int end;
+				std::vector<Token> tokens;
+				size_t next;
+				// decoded literals, kept apart until the chunks are joined
+				std::string literals;
+				// where the chunk ended, counting lines from its start
+				SourceLocation location;
+				bool failed;
+
+				// added to the lines of its tokens, and to the offsets of its literals
+				int lineBase;
+				uint32_t literalBase;
+			};
+
+			std::vector<Chunk> chunks;
+			size_t currentChunk;
+			// the chunk this lexer is lexing, when it is one of those of another
+			Chunk *chunk;
+
+			Lexer(std::shared_ptr<std::string> source, Chunk *chunk, const SourceLocation &location);
+
+			// where each chunk starts, with at most 'numChunks'
+			static std::vector<int> splitChunks(const char *data, size_t size, size_t numChunks);
+			bool nextFromChunk(Token &token);
+
+			// a token of the source read since 'start'
+			Token makeToken(TokenType type, int start);
+			// a token of text that is not in the source, which is kept after it
+			Token makeToken(TokenType type, const std::string &text);
+
 			Token nextToken();
 			Token readNumber();
-			Token readFloat(std::string &str);
+			Token readFloat(int start);
 			Token readString();
 			Token readMultilineString();
 			Token readIdentifier();
@@ -32,6 +81,12 @@ namespace zenith
 			void readLineComment();
 			void readBlockComment();
 
+			// the source is appended to, so these are not kept across makeToken
+			const char *current() const { return state.source->data() + state.position; }
+			const char *end() const { return state.source->data() + state.sourceLen; }
+			// move over 'n' characters, which may include line breaks
+			void advance(size_t n);
+
 			char readChar();
 			char peekChar(int n = 0);
 			char parseEscapeCode();
@@ -6,6 +6,9 @@
 #include <map>
 #include <utility>
 #include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
 
 namespace zenith
 {
@@ -48,42 +51,51 @@ namespace zenith
 			OP_BIT_OR_ASSIGN
 		};
 
-		static std::map<std::string, Operator> operators =
+		const int NUM_OPERATORS = OP_BIT_OR_ASSIGN + 1;
+
+		// in the order of Operator
+		constexpr const char *operatorNames[NUM_OPERATORS] =
+		{
+			"**", "*", "\\", "/", "%", "+", "-", "^",
+			"&", "|", "!", "&&", "||", "==", "!=", "<<",
+			">>", "<", ">", "<=", ">=", "++", "--", "=",
+			"+=", "-=", "*=", "/=", "%=", "&=", "^=", "|="
+		};
+
+		/* Perfect hash of the operators, which are one or two characters long.
+		   No two operators share a slot. */
+		const uint32_t OPERATOR_HASH_MULTIPLIER = 0x6309B0BBu;
+		const int OPERATOR_HASH_BITS = 6;
+
+		constexpr uint32_t operatorHash(const char *str, size_t length)
 		{
-			{"**", OP_POWER },
-			{ "*", OP_MULTIPLY },
-			{ "/", OP_INT_DIVIDE },
-			{ "\\", OP_DIVIDE },
-			{ "%", OP_MODULUS },
-			{ "+", OP_ADD },
-			{ "-", OP_SUBTRACT },
-			{ "^", OP_BIT_XOR },
-			{ "&", OP_BIT_AND },
-			{ "|", OP_BIT_OR },
-			{ "!", OP_NOT },
-			{ "&&", OP_AND },
-			{ "||", OP_OR },
-			{ "==", OP_EQUALS },
-			{ "!=", OP_NOT_EQUAL },
-			{ "<<", OP_OUTPUT },
-			{ ">>", OP_INPUT },
-			{ "<", OP_LESS },
-			{ ">", OP_GREATER },
-			{ "<=", OP_LESS_OR_EQUAL },
-			{ ">=", OP_GREATER_OR_EQUAL },
-			{ "++", OP_INCREMENT },
-			{ "--", OP_DECREMENT },
-			{ "=", OP_ASSIGN },
-			{ "+=", OP_ADD_ASSIGN },
-			{ "-=", OP_SUBTRACT_ASSIGN },
-			{ "*=", OP_MULTIPLY_ASSIGN },
-			{ "/=", OP_DIVIDE_ASSIGN },
-			{ "%=", OP_MODULUS_ASSIGN },
-			{ "&=", OP_BIT_AND_ASSIGN },
-			{ "^=", OP_BIT_XOR_ASSIGN },
-			{ "|=", OP_BIT_OR_ASSIGN }
+			return (uint32_t)(((uint32_t)(uint8_t)str[0] |
+				((length > 1) ? (uint32_t)(uint8_t)str[1] << 8 : 0)) * OPERATOR_HASH_MULTIPLIER) >> (32 - OPERATOR_HASH_BITS);
+		}
+
+		// the operator in each slot of the hash, or -1
+		constexpr signed char operatorSlots[1 << OPERATOR_HASH_BITS] =
+		{
+			29, -1, -1, -1, 14, -1, -1, 22, 11, -1, -1, 3, -1, 17, -1, 1,
+			21, 31, 20, -1, 4, 16, -1, 7, -1, -1, 6, -1, -1, -1, 15, 27,
+			-1, 19, -1, 26, -1, 2, 23, 28, 5, -1, 12, 30, 8, 25, -1, -1,
+			-1, 10, -1, -1, -1, 0, -1, -1, -1, -1, 13, -1, 24, -1, 9, 18
 		};
 
+		constexpr size_t operatorLength(const char *str)
+		{
+			return (str[1] != '\0') ? 2 : 1;
+		}
+
+		constexpr bool operatorSlotsValid(int op = 0)
+		{
+			return op == NUM_OPERATORS ||
+				(operatorSlots[operatorHash(operatorNames[op], operatorLength(operatorNames[op]))] == op &&
+					operatorSlotsValid(op + 1));
+		}
+
+		static_assert(operatorSlotsValid(), "Every operator must hash to its own slot in operatorSlots");
+
 		static std::map<Operator, int> precedenceMap =
 		{
 			{ OP_INCREMENT, 14 },{ OP_DECREMENT, 14 },{ OP_NOT, 14 },
@@ -118,25 +130,32 @@ namespace zenith
 
 		inline const std::string &getOperatorStr(Operator op)
 		{
-			auto it = std::find_if(operators.begin(), operators.end(),
-				[&op](const std::pair<std::string, Operator> &item) {
-				return item.second == op;
-			});
+			static const std::vector<std::string> strings(operatorNames, operatorNames + NUM_OPERATORS);
 
-			if (it == operators.end())
+			if (op < 0 || op >= NUM_OPERATORS)
 				throw std::out_of_range("Operator has no string equivalent");
 
-			return it->first;
+			return strings[op];
 		}
 
-		inline const Operator getOperator(const std::string &str)
+		inline Operator getOperator(const char *str, size_t length)
 		{
-			auto it = operators.find(str);
+			if (length < 1 || length > 2)
+				return Operator::OP_INVALID;
 
-			if (it == operators.end())
+			int op = operatorSlots[operatorHash(str, length)];
+			if (op == -1 || operatorLength(operatorNames[op]) != length ||
+				std::memcmp(operatorNames[op], str, length) != 0)
+			{
 				return Operator::OP_INVALID;
-			else
-				return it->second;
+			}
+
+			return (Operator)op;
+		}
+
+		inline Operator getOperator(const std::string &str)
+		{
+			return getOperator(str.data(), str.size());
 		}
 
 		inline int getPrecedence(Operator op)
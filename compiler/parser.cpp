@@ -12,11 +12,12 @@ namespace zenith
 {
 	namespace compiler
 	{
-		Parser::Parser(std::vector<Token> tokens, LexerState lexerState)
+		Parser::Parser(Lexer &lexer)
+			: stream(&lexer)
 		{
-			state.tokens = tokens;
-			state.errors = lexerState.errors;
-			this->filepath = lexerState.location.file;
+			this->lexer = &lexer;
+			state.text = lexer.state.source;
+			this->filepath = lexer.state.location.file();
 		}
 
 		std::unique_ptr<ModuleAst> Parser::parse()
@@ -31,47 +32,64 @@ namespace zenith
 				Token *ident = expect_read(TK_IDENTIFIER);
 				if (ident)
 				{
-					myModuleName = ident->value;
+					myModuleName = text(ident);
 
 					unit = std::make_unique<ModuleAst>(location(), myModuleName);
 					moduleAst = unit.get();
 
-					while (state.position < state.tokens.size())
+					// the module itself is not in its arena, it owns it
+					AstArenaScope scope(&unit->arena);
+
+					while (peek() != nullptr)
 						unit->addChild(parseStatement());
 
-					return unit;
+					// the module holds on to the tokens of the bodies that were skipped
+					if (hasUnparsedBodies)
+					{
+						unit->tokens = std::move(bodyTokens);
+						unit->tokenText = state.text;
+					}
 				}
 			}
 
 			// parse error occured
-			unit = std::make_unique<ModuleAst>(location(), myModuleName);
+			if (unit == nullptr)
+			{
+				unit = std::make_unique<ModuleAst>(location(), myModuleName);
+
+				// lex the rest, for the errors in it
+				while (read() != nullptr);
+			}
+
+			// the lexer found its errors as the tokens were pulled, they still come first
+			state.errors.insert(state.errors.begin(), lexer->state.errors.begin(), lexer->state.errors.end());
 			return unit;
 		}
 
 		SourceLocation Parser::location()
 		{
-			if (!state.tokens.empty())
-			{
-				Token *token = peek();
-				return (token ? token->location : peek(-1)->location);
-			}
+			Token *token = peek();
+			if (token == nullptr)
+				token = peek(-1);
+
+			if (token != nullptr)
+				return token->location;
 			else return{ 0, 0, filepath };
 		}
 
 		Token *Parser::peek(int n)
 		{
-			if (state.position + n < state.tokens.size())
-				return &state.tokens[state.position + n];
+			return stream.peek(n);
+		}
 
-			return nullptr;
+		std::string Parser::text(const Token *token)
+		{
+			return token ? token->str(*state.text) : "";
 		}
 
 		Token *Parser::read()
 		{
-			if (state.position >= state.tokens.size())
-				return nullptr;
-			else
-				return &state.tokens[state.position++];
+			return stream.read();
 		}
 
 		bool Parser::match(TokenType type, int n)
@@ -86,7 +104,7 @@ namespace zenith
 
 		bool Parser::match(TokenType type, const std::string &str)
 		{
-			return (match(type) && peek()->value == str);
+			return (match(type) && peek()->equals(*state.text, str));
 		}
 
 		bool Parser::match_read(TokenType type)
@@ -147,7 +165,7 @@ namespace zenith
 						state.errors.push_back({ EXPECTED_TOKEN, badToken->location, Token::asString(type) });
 						break;
 					default:
-						state.errors.push_back({ UNEXPECTED_TOKEN, badToken->location, badToken->value });
+						state.errors.push_back({ UNEXPECTED_TOKEN, badToken->location, text(badToken) });
 						break;
 					}
 				}
@@ -179,7 +197,7 @@ namespace zenith
 			if (!(current && current->type == TK_OPERATOR))
 				return -1;
 
-			Operator op = getOperator(current->value);
+			Operator op = getOperator(text(current));
 			return getPrecedence(op);
 		}
 
@@ -218,15 +236,15 @@ namespace zenith
 			if (match_read(TK_STRING, tk))
 			{
 				isModuleImport = false;
-				value = tk->value;
+				value = text(tk);
 			}
 			else if (match_read(TK_IDENTIFIER, tk))
 			{
 				isModuleImport = true;
-				value = tk->value;
+				value = text(tk);
 			}
 			else
-				state.errors.push_back({ UNEXPECTED_TOKEN, location(), read()->value });
+				state.errors.push_back({ UNEXPECTED_TOKEN, location(), text(read()) });
 
 			auto result = std::make_unique<ImportAst>(location(), moduleAst, value, localPath, isModuleImport);
 			return std::move(result);
@@ -236,7 +254,7 @@ namespace zenith
 		{
 			if (match(TK_KEYWORD))
 			{
-				const std::string &val = peek()->value;
+				std::string val = text(peek());
 
 				if (val == getKeywordStr(KW_VAR))
 					return parseVarDeclaration();
@@ -289,16 +307,16 @@ namespace zenith
 		std::unique_ptr<AstNode> Parser::parseVarDeclaration()
 		{
 			auto token = expect_read(TK_KEYWORD, getKeywordStr(KW_VAR));
-			auto identifier = peek()->value;
+			auto identifier = text(peek());
 
 			lastVariable = identifier;
 
 			std::unique_ptr<AstNode> assignment = nullptr;
 			if (peek(1)->type == TK_OPERATOR)
 			{
-				if (peek(1)->value != getOperatorStr(Operator::OP_ASSIGN))
+				if (!peek(1)->equals(*state.text, getOperatorStr(Operator::OP_ASSIGN)))
 				{
-					state.errors.push_back({ UNEXPECTED_TOKEN, location(), peek(1)->value });
+					state.errors.push_back({ UNEXPECTED_TOKEN, location(), text(peek(1)) });
 					return nullptr;
 				}
 				else
@@ -331,7 +349,7 @@ namespace zenith
 
 				auto *opToken = expect_read(TK_OPERATOR);
 
-				Operator op = getOperator(opToken->value);
+				Operator op = getOperator(text(opToken));
 
 				auto right = parseTerm();
 				if (!right)
@@ -358,7 +376,7 @@ namespace zenith
 		{
 			auto *opToken = expect_read(TK_OPERATOR);
 
-			Operator op = getOperator(opToken->value);
+			Operator op = getOperator(text(opToken));
 
 			auto value = parseTerm();
 			if (!value)
@@ -374,7 +392,8 @@ namespace zenith
 		std::unique_ptr<AstNode> Parser::parseClass()
 		{
 			auto token = expect_read(TK_KEYWORD, getKeywordStr(KW_CLASS));
-			auto ident = expect_read(TK_IDENTIFIER);
+			// copied now, the token does not outlive the members being read
+			auto identifier = text(expect_read(TK_IDENTIFIER));
 			std::vector<std::unique_ptr<AstNode>> dataMembers;
 
 			expect_read(TK_OPEN_BRACE);
@@ -385,7 +404,7 @@ namespace zenith
 
 			auto classAst = std::make_unique<ClassAst>(location(),
 				moduleAst,
-				ident->value,
+				identifier,
 				std::move(dataMembers));
 			return std::move(classAst);
 		}
@@ -405,7 +424,7 @@ namespace zenith
 		std::unique_ptr<AstNode> Parser::parseInteger()
 		{
 			auto token = expect_read(TK_INTEGER);
-			long value = atoi(token->value.c_str());
+			long value = atoi(text(token).c_str());
 
 			auto node = std::make_unique<IntegerAst>(location(), moduleAst, value);
 			return std::move(node);
@@ -414,7 +433,7 @@ namespace zenith
 		std::unique_ptr<AstNode> Parser::parseFloat()
 		{
 			auto token = expect_read(TK_FLOAT);
-			double value = atof(token->value.c_str());
+			double value = atof(text(token).c_str());
 
 			auto node = std::make_unique<FloatAst>(location(), moduleAst, value);
 			return std::move(node);
@@ -423,7 +442,7 @@ namespace zenith
 		std::unique_ptr<AstNode> Parser::parseIdentifier()
 		{
 			std::unique_ptr<AstNode> result = nullptr;
-			std::string identifier = expect_read(TK_IDENTIFIER)->value;
+			std::string identifier = text(expect_read(TK_IDENTIFIER));
 
 			if (match_read(TK_OPEN_PARENTHESIS))
 			{
@@ -446,7 +465,7 @@ namespace zenith
 
 						else if (peek()->type != TK_COMMA)
 						{
-							state.errors.push_back({ UNEXPECTED_TOKEN, location(), peek()->value });
+							state.errors.push_back({ UNEXPECTED_TOKEN, location(), text(peek()) });
 							return nullptr;
 						}
 						read();
@@ -470,7 +489,7 @@ namespace zenith
 				if (match(TK_IDENTIFIER))
 					nextIdentifier = std::move(parseIdentifier());
 				else
-					state.errors.push_back({ UNEXPECTED_TOKEN, location(), read()->value });
+					state.errors.push_back({ UNEXPECTED_TOKEN, location(), text(read()) });
 
 				result = std::make_unique<MemberAccessAst>(location(),
 					moduleAst,
@@ -485,7 +504,7 @@ namespace zenith
 		std::unique_ptr<AstNode> Parser::parseString()
 		{
 			std::unique_ptr<AstNode> result = nullptr;
-			std::string value = expect_read(TK_STRING)->value;
+			std::string value = text(expect_read(TK_STRING));
 
 			result = std::make_unique<StringAst>(location(), moduleAst, value);
 			return std::move(result);
@@ -511,18 +530,18 @@ namespace zenith
 
 		std::unique_ptr<AstNode> Parser::parseSelf()
 		{
-			std::string identifier = expect_read(TK_KEYWORD, getKeywordStr(KW_SELF))->value;
+			std::string identifier = text(expect_read(TK_KEYWORD, getKeywordStr(KW_SELF)));
 			std::unique_ptr<AstNode> result = std::make_unique<SelfAst>(location(), moduleAst);
 
 			if (match_read(TK_DOT))
 			{
 				std::unique_ptr<AstNode> nextIdentifier = nullptr;
 				
-				std::string leftStr = peek()->value;
+				std::string leftStr = text(peek());
 				if (match(TK_IDENTIFIER))
 					nextIdentifier = std::move(parseIdentifier());
 				else
-					state.errors.push_back({ UNEXPECTED_TOKEN, location(), read()->value });
+					state.errors.push_back({ UNEXPECTED_TOKEN, location(), text(read()) });
 
 				result = std::make_unique<MemberAccessAst>(location(),
 					moduleAst,
@@ -542,7 +561,7 @@ namespace zenith
 			if (match(TK_IDENTIFIER))
 				ident = std::move(parseIdentifier());
 			else
-				state.errors.push_back({ UNEXPECTED_TOKEN, location(), read()->value });
+				state.errors.push_back({ UNEXPECTED_TOKEN, location(), text(read()) });
 
 			auto newAst = std::make_unique<NewAst>(location(), 
 				moduleAst, 
@@ -593,7 +612,7 @@ namespace zenith
 				}
 			}
 			else
-				state.errors.push_back({ UNEXPECTED_TOKEN, location(), read()->value });
+				state.errors.push_back({ UNEXPECTED_TOKEN, location(), text(read()) });
 
 			return term;
 		}
@@ -630,10 +649,59 @@ namespace zenith
 			return std::move(block);
 		}
 
+		bool Parser::skipBlock()
+		{
+			int depth = 0;
+			do
+			{
+				Token *token = read();
+				if (token == nullptr)
+					return false;
+
+				// kept for parseBody()
+				bodyTokens.push_back(*token);
+
+				if (token->type == TK_OPEN_BRACE)
+					depth++;
+				else if (token->type == TK_CLOSE_BRACE)
+					depth--;
+			} while (depth > 0);
+
+			return true;
+		}
+
+		std::unique_ptr<AstNode> Parser::parseKeptBlock(const std::vector<Token> &tokens, size_t begin,
+			std::shared_ptr<const std::string> text, AstNode *module, const std::string &filepath,
+			std::vector<Error> &errors)
+		{
+			Parser parser;
+			parser.stream = TokenStream(&tokens, begin);
+			parser.state.text = text;
+			parser.moduleAst = module;
+			parser.myModuleName = static_cast<ModuleAst*>(module)->moduleName;
+			parser.filepath = filepath;
+
+			auto block = parser.parseStatement();
+			errors.insert(errors.end(), parser.state.errors.begin(), parser.state.errors.end());
+
+			return block;
+		}
+
+		void Parser::parseBody(FunctionDefinitionAst *node, std::vector<Error> &errors)
+		{
+			auto *module = static_cast<ModuleAst*>(node->module);
+
+			AstArenaScope scope(&module->arena);
+			node->block = parseKeptBlock(module->tokens, node->bodyBegin, module->tokenText,
+				module, node->location.file(), errors);
+			node->bodyBegin = -1;
+			node->bodyEnd = -1;
+		}
+
 		std::unique_ptr<AstNode> Parser::parseFunctionDefinition()
 		{
 			expect_read(TK_KEYWORD, getKeywordStr(KW_FUNCTION));
-			auto identifier = expect_read(TK_IDENTIFIER)->value;
+			auto identifier = text(expect_read(TK_IDENTIFIER));
 			expect_read(TK_OPEN_PARENTHESIS);
 
 			std::vector<std::string> arguments;
@@ -642,7 +710,7 @@ namespace zenith
 				while (true)
 				{
 					auto argToken = expect_read(TK_IDENTIFIER);
-					auto arg = argToken->value;
+					auto arg = text(argToken);
 
 					if (!argToken)
 						return nullptr;
@@ -654,7 +722,7 @@ namespace zenith
 
 					else if (peek()->type != TK_COMMA)
 					{
-						state.errors.push_back({ UNEXPECTED_TOKEN, location(), peek()->value });
+						state.errors.push_back({ UNEXPECTED_TOKEN, location(), text(peek()) });
 						return nullptr;
 					}
 					read();
@@ -663,16 +731,36 @@ namespace zenith
 			read();
 
 			std::unique_ptr<AstNode> block = nullptr;
+			int bodyBegin = (int)bodyTokens.size();
+			bool skipped = false;
 			if (peek() && peek()->type == TK_OPEN_BRACE)
-				block = std::move(parseStatement()); // read the block
+			{
+				if (!preParse)
+					block = std::move(parseStatement()); // read the block
+				else if (skipBlock())
+					skipped = true;
+				else
+				{
+					// a body that does not close is parsed, to report the error where it is
+					block = parseKeptBlock(bodyTokens, bodyBegin, state.text, moduleAst, filepath, state.errors);
+					bodyTokens.resize(bodyBegin);
+				}
+			}
 			else
-				state.errors.push_back({ UNEXPECTED_TOKEN, location(), read()->value });
+				state.errors.push_back({ UNEXPECTED_TOKEN, location(), text(read()) });
 
 			auto functionDefinitionAst = std::make_unique<FunctionDefinitionAst>(location(),
 				moduleAst,
 				identifier,
 				arguments,
 				std::move(block));
+
+			if (skipped)
+			{
+				hasUnparsedBodies = true;
+				functionDefinitionAst->bodyBegin = bodyBegin;
+				functionDefinitionAst->bodyEnd = (int)bodyTokens.size();
+			}
 			return std::move(functionDefinitionAst);
 		}
 
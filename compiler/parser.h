@@ -7,6 +7,8 @@
 
 #include "ast.h"
 #include "tokens.h"
+#include "token_stream.h"
+#include "lexer.h"
 #include "state.h"
 #include "src_location.h"
 
@@ -23,8 +25,25 @@ namespace zenith
 			std::string filepath;
 			std::string lastVariable;
 
+			Lexer *lexer = nullptr;
+			TokenStream stream;
+
+			bool preParse = false;
+			bool hasUnparsedBodies = false;
+			// tokens of the bodies skipped by the pre-parser
+			std::vector<Token> bodyTokens;
+
+			Parser() {}
+
+			static std::unique_ptr<AstNode> parseKeptBlock(const std::vector<Token> &tokens, size_t begin,
+				std::shared_ptr<const std::string> text, AstNode *module, const std::string &filepath,
+				std::vector<Error> &errors);
+
 			SourceLocation location();
 
+			// the text of a token, copied out of the source
+			std::string text(const Token *token);
+
 			Token *peek(int n = 0);
 			Token *read();
 
@@ -59,6 +78,7 @@ namespace zenith
 			std::unique_ptr<AstNode> parseUnaryOperation();
 			std::unique_ptr<AstNode> parseClass();
 			std::unique_ptr<AstNode> parseBlock();
+			bool skipBlock();
 			std::unique_ptr<AstNode> parseFunctionDefinition();
 			std::unique_ptr<AstNode> parseIfStatement();
 			std::unique_ptr<AstNode> parseReturnStatement();
@@ -67,8 +87,17 @@ namespace zenith
 		public:
 			ParserState state;
 
-			Parser(std::vector<Token> tokens, LexerState lexerState);
+			/* Tokens are pulled from 'lexer' as the parser needs them. */
+			Parser(Lexer &lexer);
 			std::unique_ptr<ModuleAst> parse();
+
+			/* Only match the braces of function bodies, leaving them to be
+			   parsed by parseBody() when the function is compiled. */
+			void setPreParse(bool preParse) { this->preParse = preParse; }
+
+			/* Parse the body of a function that was skipped by the pre-parser.
+			   Errors in the body are added to 'errors'. */
+			static void parseBody(FunctionDefinitionAst *node, std::vector<Error> &errors);
 		};
 	}
 }
@@ -0,0 +1,187 @@
+#ifndef __ZENITH_COMPILER_SCAN_H__
+#define __ZENITH_COMPILER_SCAN_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ZENITH_SCAN_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace zenith
+{
+	namespace compiler
+	{
+		/* Runs of characters the lexer skips over, found 32 (AVX2) or 16 (SSE2)
+		   bytes at a time, with the rest done one by one. Each returns how many
+		   characters from 'p' are in the run, stopping at 'end'. */
+		namespace scan
+		{
+			inline unsigned firstSet(uint32_t mask)
+			{
+#ifdef _MSC_VER
+				unsigned long index;
+				_BitScanForward(&index, mask);
+				return (unsigned)index;
+#else
+				return (unsigned)__builtin_ctz(mask);
+#endif
+			}
+
+			inline bool isIdentifierChar(char ch)
+			{
+				return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+					(ch >= '0' && ch <= '9') || ch == '_';
+			}
+
+			inline bool isSpace(char ch)
+			{
+				return ch == ' ' || (ch >= '\t' && ch <= '\r');
+			}
+
+			/* Letters, digits and underscores. */
+			inline size_t identifier(const char *p, const char *end)
+			{
+				const char *start = p;
+
+#if defined(__AVX2__)
+				while (end - p >= 32)
+				{
+					__m256i x = _mm256_loadu_si256((const __m256i*)p);
+					// setting 0x20 lowers upper case letters, and maps nothing else into a-z
+					__m256i lower = _mm256_or_si256(x, _mm256_set1_epi8(0x20));
+					__m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+						_mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+					__m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8('0' - 1)),
+						_mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), x));
+					__m256i under = _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_'));
+
+					uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(alpha, digit), under));
+					if (mask != 0xFFFFFFFFu)
+						return (p - start) + firstSet(~mask);
+					p += 32;
+				}
+#endif
+#ifdef ZENITH_SCAN_SSE2
+				while (end - p >= 16)
+				{
+					__m128i x = _mm_loadu_si128((const __m128i*)p);
+					__m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+					__m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+						_mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+					__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('0' - 1)),
+						_mm_cmplt_epi8(x, _mm_set1_epi8('9' + 1)));
+					__m128i under = _mm_cmpeq_epi8(x, _mm_set1_epi8('_'));
+
+					uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), under));
+					if (mask != 0xFFFF)
+						return (p - start) + firstSet(~mask);
+					p += 16;
+				}
+#endif
+				while (p < end && isIdentifierChar(*p))
+					p++;
+
+				return p - start;
+			}
+
+			/* Spaces, tabs and line breaks. */
+			inline size_t whitespace(const char *p, const char *end)
+			{
+				const char *start = p;
+
+#if defined(__AVX2__)
+				while (end - p >= 32)
+				{
+					__m256i x = _mm256_loadu_si256((const __m256i*)p);
+					__m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')),
+						_mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8('\t' - 1)),
+							_mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), x)));
+
+					uint32_t mask = (uint32_t)_mm256_movemask_epi8(space);
+					if (mask != 0xFFFFFFFFu)
+						return (p - start) + firstSet(~mask);
+					p += 32;
+				}
+#endif
+#ifdef ZENITH_SCAN_SSE2
+				while (end - p >= 16)
+				{
+					__m128i x = _mm_loadu_si128((const __m128i*)p);
+					__m128i space = _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')),
+						_mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8('\t' - 1)),
+							_mm_cmplt_epi8(x, _mm_set1_epi8('\r' + 1))));
+
+					uint32_t mask = (uint32_t)_mm_movemask_epi8(space);
+					if (mask != 0xFFFF)
+						return (p - start) + firstSet(~mask);
+					p += 16;
+				}
+#endif
+				while (p < end && isSpace(*p))
+					p++;
+
+				return p - start;
+			}
+
+			/* Everything up to the first 'a', 'b', 'c' or nul, for string
+			   bodies and comments. */
+			inline size_t until(const char *p, const char *end, char a, char b, char c)
+			{
+				const char *start = p;
+
+#if defined(__AVX2__)
+				while (end - p >= 32)
+				{
+					__m256i x = _mm256_loadu_si256((const __m256i*)p);
+					__m256i found = _mm256_or_si256(
+						_mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(a)), _mm256_cmpeq_epi8(x, _mm256_set1_epi8(b))),
+						_mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(c)), _mm256_cmpeq_epi8(x, _mm256_setzero_si256())));
+
+					uint32_t mask = (uint32_t)_mm256_movemask_epi8(found);
+					if (mask != 0)
+						return (p - start) + firstSet(mask);
+					p += 32;
+				}
+#endif
+#ifdef ZENITH_SCAN_SSE2
+				while (end - p >= 16)
+				{
+					__m128i x = _mm_loadu_si128((const __m128i*)p);
+					__m128i found = _mm_or_si128(
+						_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(a)), _mm_cmpeq_epi8(x, _mm_set1_epi8(b))),
+						_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(c)), _mm_cmpeq_epi8(x, _mm_setzero_si128())));
+
+					uint32_t mask = (uint32_t)_mm_movemask_epi8(found);
+					if (mask != 0)
+						return (p - start) + firstSet(mask);
+					p += 16;
+				}
+#endif
+				while (p < end && *p != a && *p != b && *p != c && *p != '\0')
+					p++;
+
+				return p - start;
+			}
+
+			/* Decimal digits. Numbers are short, so this is not vectorized. */
+			inline size_t digits(const char *p, const char *end)
+			{
+				const char *start = p;
+				while (p < end && *p >= '0' && *p <= '9')
+					p++;
+
+				return p - start;
+			}
+		}
+	}
+}
+
+#endif
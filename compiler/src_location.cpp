@@ -0,0 +1,38 @@
+#include "src_location.h"
+
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+
+namespace zenith
+{
+	namespace compiler
+	{
+		// modules are lexed on several threads at once
+		static std::mutex filesMutex;
+		// a deque, so that references to paths stay valid as more are added
+		static std::deque<std::string> filePaths = { "" };
+		static std::unordered_map<std::string, uint32_t> fileIds = { { "", 0 } };
+
+		uint32_t SourceLocation::internFile(const std::string &file)
+		{
+			std::lock_guard<std::mutex> lock(filesMutex);
+
+			auto it = fileIds.find(file);
+			if (it != fileIds.end())
+				return it->second;
+
+			uint32_t id = (uint32_t)filePaths.size();
+			filePaths.push_back(file);
+			fileIds[file] = id;
+
+			return id;
+		}
+
+		const std::string &SourceLocation::filePath(uint32_t fileId)
+		{
+			std::lock_guard<std::mutex> lock(filesMutex);
+			return filePaths[fileId];
+		}
+	}
+}
@@ -2,36 +2,37 @@
 #define __ZENITH_COMPILER_SRC_LOCATION_H__
 
 #include <string>
+#include <cstdint>
 
 namespace zenith
 {
 	namespace compiler
 	{
+		/* Every token and node has a location, so the file is stored as an
+		   index into a table of paths rather than as a copy of the path. */
 		struct SourceLocation
 		{
 			int line;
 			int column;
-			std::string file;
+			uint32_t fileId;
 
 			SourceLocation()
+				: line(0), column(0), fileId(0)
 			{
 			}
 
-			SourceLocation(const SourceLocation &other)
-			{
-				this->line = other.line;
-				this->column = other.column;
-				this->file = other.file;
-			}
-
 			SourceLocation(int line, int column, const std::string &file)
+				: line(line), column(column), fileId(internFile(file))
 			{
-				this->line = line;
-				this->column = column;
-				this->file = file;
 			}
+
+			const std::string &file() const { return filePath(fileId); }
+
+			/* The id of a path, the same for every location in that file. */
+			static uint32_t internFile(const std::string &file);
+			static const std::string &filePath(uint32_t fileId);
 		};
 	}
 }
 
-#endif
\ No newline at end of file
+#endif
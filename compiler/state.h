@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include <memory>
 
 #include "errors.h"
 #include "tokens.h"
@@ -15,9 +16,8 @@ namespace zenith
 		struct ParserState
 		{
 			std::vector<Error> errors;
-			std::vector<Token> tokens;
-
-			int position = 0;
+			// what the tokens refer to
+			std::shared_ptr<const std::string> text;
 
 			//std::string filepath;
 		};
@@ -27,7 +27,8 @@ namespace zenith
 			int position;
 			int sourceLen;
 
-			std::string source;
+			// the source, followed by string literals that had escapes to decode
+			std::shared_ptr<std::string> source;
 			std::string file;
 
 			SourceLocation location;
@@ -0,0 +1,78 @@
+#include "symbols.h"
+
+namespace zenith
+{
+	namespace compiler
+	{
+		SymbolTable::SymbolTable()
+		{
+			// id 0 is NO_SYMBOL
+			symbols.push_back({ NO_SYMBOL, NO_SYMBOL, NO_SYMBOL, 0 });
+			mangledNames.push_back("");
+			nameIds[""] = NO_SYMBOL;
+		}
+
+		SymbolId SymbolTable::intern(const std::string &name)
+		{
+			auto it = nameIds.find(name);
+			if (it != nameIds.end())
+				return it->second;
+
+			SymbolId id = (SymbolId)symbols.size();
+			symbols.push_back({ NO_SYMBOL, NO_SYMBOL, id, 0 });
+			mangledNames.push_back(name);
+			nameIds[name] = id;
+
+			return id;
+		}
+
+		SymbolId SymbolTable::intern(SymbolId module, SymbolId owner, SymbolId name, int numArguments)
+		{
+			Symbol symbol = { module, owner, name, (numArguments > 0) ? numArguments : 0 };
+
+			auto it = symbolIds.find(symbol);
+			if (it != symbolIds.end())
+				return it->second;
+
+			SymbolId id = (SymbolId)symbols.size();
+			symbols.push_back(symbol);
+			mangledNames.push_back("");
+			symbolIds[symbol] = id;
+
+			return id;
+		}
+
+		const std::string &SymbolTable::mangle(SymbolId id)
+		{
+			std::string &mangled = mangledNames[id];
+			if (!mangled.empty() || id == NO_SYMBOL)
+				return mangled;
+
+			const Symbol symbol = symbols[id];
+
+			// mangled identifiers start with a $ to prevent collision with other variables
+			std::string result("$");
+			result += "_M" + mangledNames[symbol.module];
+
+			if (symbol.owner != NO_SYMBOL)
+				result += "_C" + mangle(symbol.owner);
+
+			result += "_I" + mangledNames[symbol.name];
+
+			if (symbol.numArguments > 0)
+				result += "_A" + std::to_string(symbol.numArguments);
+
+			mangled = std::move(result);
+			return mangled;
+		}
+
+		std::string SymbolTable::mangle(const std::string &module, const std::string &name, int numArguments)
+		{
+			std::string result = "$_M" + module + "_I" + name;
+			if (numArguments > 0)
+				result += "_A" + std::to_string(numArguments);
+
+			return result;
+		}
+	}
+}
@@ -0,0 +1,80 @@
+#ifndef __ZENITH_COMPILER_SYMBOLS_H__
+#define __ZENITH_COMPILER_SYMBOLS_H__
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+namespace zenith
+{
+	namespace compiler
+	{
+		typedef uint32_t SymbolId;
+		// no symbol, e.g. a node that is not the member of anything
+		const SymbolId NO_SYMBOL = 0;
+
+		/* An identifier as the compiler resolves it: a name declared in a
+		   module, as a member of an object if 'owner' is set, and for
+		   functions with the number of arguments it takes. */
+		struct Symbol
+		{
+			SymbolId module;
+			SymbolId owner;
+			SymbolId name;
+			int numArguments;
+
+			bool operator==(const Symbol &other) const
+			{
+				return module == other.module && owner == other.owner &&
+					name == other.name && numArguments == other.numArguments;
+			}
+		};
+
+		/* Interns names and symbols as integer ids, so that scopes are keyed
+		   by ids instead of strings. A plain name is a symbol of its own, with
+		   no module. Mangled names are only made when code is emitted. */
+		class SymbolTable
+		{
+		private:
+			struct SymbolHash
+			{
+				size_t operator()(const Symbol &symbol) const
+				{
+					uint64_t key = ((uint64_t)symbol.module << 32 | symbol.owner) * 0x9E3779B97F4A7C15ull;
+					key ^= ((uint64_t)symbol.name << 32 | (uint32_t)symbol.numArguments) * 0xC2B2AE3D27D4EB4Full;
+					return (size_t)(key ^ (key >> 29));
+				}
+			};
+
+			std::vector<Symbol> symbols;
+			// plain names are their own mangled name, the rest are filled in the first time they are emitted
+			std::vector<std::string> mangledNames;
+
+			std::unordered_map<std::string, SymbolId> nameIds;
+			std::unordered_map<Symbol, SymbolId, SymbolHash> symbolIds;
+
+		public:
+			SymbolTable();
+
+			/* The id of a plain name. */
+			SymbolId intern(const std::string &name);
+			/* The id of 'name' declared in 'module', both interned names. */
+			SymbolId intern(SymbolId module, SymbolId owner, SymbolId name, int numArguments = 0);
+
+			const Symbol &get(SymbolId id) const { return symbols[id]; }
+			// the name that was declared, without its module or owner
+			const std::string &name(SymbolId id) const { return mangledNames[symbols[id].name]; }
+
+			/* The name the symbol is emitted as, $_M<module>[_C<owner>]_I<name>[_A<arguments>],
+			   or the name itself for a plain name. */
+			const std::string &mangle(SymbolId id);
+			/* The mangled name of a function declared at the top level of 'module'. */
+			static std::string mangle(const std::string &module, const std::string &name, int numArguments);
+
+			size_t size() const { return symbols.size(); }
+		};
+	}
+}
+
+#endif
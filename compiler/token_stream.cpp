@@ -0,0 +1,52 @@
+#include "token_stream.h"
+#include "lexer.h"
+
+namespace zenith
+{
+	namespace compiler
+	{
+		TokenStream::TokenStream()
+			: lexer(nullptr), tokens(nullptr), nextToken(0), position(0), available(0)
+		{
+		}
+
+		TokenStream::TokenStream(Lexer *lexer)
+			: lexer(lexer), tokens(nullptr), nextToken(0), position(0), available(0)
+		{
+		}
+
+		TokenStream::TokenStream(const std::vector<Token> *tokens, size_t begin)
+			: lexer(nullptr), tokens(tokens), nextToken(begin), position(0), available(0)
+		{
+		}
+
+		bool TokenStream::pull()
+		{
+			Token &token = ring[available % RING_SIZE];
+
+			if (lexer != nullptr)
+			{
+				if (!lexer->next(token))
+					return false;
+			}
+			else if (tokens != nullptr && nextToken < tokens->size())
+				token = (*tokens)[nextToken++];
+			else
+				return false;
+
+			available++;
+			return true;
+		}
+
+		Token *TokenStream::fill(size_t index)
+		{
+			while (available <= index)
+			{
+				if (!pull())
+					return nullptr;
+			}
+
+			return &ring[index % RING_SIZE];
+		}
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef __ZENITH_COMPILER_TOKEN_STREAM_H__
+#define __ZENITH_COMPILER_TOKEN_STREAM_H__
+
+#include <vector>
+#include <cstddef>
+
+#include "tokens.h"
+
+namespace zenith
+{
+	namespace compiler
+	{
+		class Lexer;
+
+		/* Tokens for the parser, pulled from the lexer as they are needed so
+		   that lexing and parsing go together, or read from tokens that were
+		   kept. Only the last token read and the few ahead of it are held, so a
+		   token from peek() or read() is only good until more are read. */
+		class TokenStream
+		{
+		public:
+			// the most peek() can look ahead
+			static const int MAX_LOOKAHEAD = 6;
+
+		private:
+			static const size_t RING_SIZE = 8;
+			// the last token read, the current one and those ahead of it
+			static_assert(RING_SIZE >= MAX_LOOKAHEAD + 2, "The ring must hold every token peek() can return");
+
+			Lexer *lexer;
+			const std::vector<Token> *tokens;
+			size_t nextToken;
+
+			Token ring[RING_SIZE];
+			// tokens read, and tokens taken from the source so far
+			size_t position;
+			size_t available;
+
+			bool pull();
+			Token *fill(size_t index);
+
+		public:
+			TokenStream();
+			TokenStream(Lexer *lexer);
+			TokenStream(const std::vector<Token> *tokens, size_t begin);
+
+			/* The token 'n' after the current one, or the last one read for -1.
+			   Returns nullptr past the end, and for more than MAX_LOOKAHEAD. */
+			Token *peek(int n = 0)
+			{
+				// further ahead would overwrite tokens that are still held
+				if (n > MAX_LOOKAHEAD)
+					return nullptr;
+
+				if (n < 0)
+					return (position != 0) ? &ring[(position - 1) % RING_SIZE] : nullptr;
+
+				size_t index = position + n;
+				return (index < available) ? &ring[index % RING_SIZE] : fill(index);
+			}
+
+			Token *read()
+			{
+				Token *token = peek();
+				if (token != nullptr)
+					position++;
+
+				return token;
+			}
+
+			// tokens read so far
+			size_t getPosition() const { return position; }
+		};
+	}
+}
+
+#endif
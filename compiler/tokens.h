@@ -3,6 +3,7 @@
 
 #include <string>
 #include <map>
+#include <cstdint>
 
 #include "src_location.h"
 
@@ -31,13 +32,22 @@ namespace zenith
 			TK_DOT
 		};
 
+		/* The text of a token is not copied out of the source. Tokens refer to
+		   a range of the text the lexer read them from, see LexerState::source. */
 		struct Token
 		{
 		public:
 			zenith::compiler::TokenType type;
-			std::string value;
+			uint32_t offset;
+			uint32_t length;
 			SourceLocation location;
 
+			std::string str(const std::string &text) const { return text.substr(offset, length); }
+			bool equals(const std::string &text, const std::string &other) const
+			{
+				return other.size() == length && text.compare(offset, length, other) == 0;
+			}
+
 		private:
 			static std::map<zenith::compiler::TokenType, std::string> tokenStrings;
 
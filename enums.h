@@ -123,6 +123,21 @@ namespace zenith
 		STACK_OBJECT_PROPERTY_ACCESS,
 		STACK_OBJECTS
 	};
+
+	/* Version byte of the bytecode header, picks the decoder. */
+	enum BytecodeEncoding
+	{
+		ENCODING_FIXED = 1, // 4 byte opcodes, fixed size operands
+		ENCODING_COMPACT, // 1 byte opcodes, LEB128 operands, implied block positions
+		ENCODING_POOLED // compact, with strings as indices into the image's constant pool
+	};
+
+	// bytecode starts with the magic and the encoding; files without it use the fixed encoding
+	const char BYTECODE_MAGIC[3] = { 'Z', 'E', 'N' };
+
+	// compact opcodes from here on load the integer (opcode - COMPACT_LOAD_SMALL_INT)
+	const int COMPACT_LOAD_SMALL_INT = 0x80;
+	const int COMPACT_SMALL_INT_COUNT = 0x80;
 }
 
 #endif
\ No newline at end of file
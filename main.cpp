@@ -3,18 +3,36 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <set>
+#include <map>
+#include <mutex>
+#include <functional>
 using std::cout;
 
 #include "runtime/bytereader.h"
 #include "runtime/vm.h"
+#include "runtime/aot_module.h"
+#include "runtime/image.h"
+#include "runtime/verifier.h"
 #include "runtime/any.h"
 #include "runtime/std/stdlibrary.h"
+#include "runtime/jit/baseline_jit.h"
+#include "runtime/jit/tier_manager.h"
 
 #include "compiler/parser.h"
 #include "compiler/lexer.h"
+#include "compiler/symbols.h"
 #include "compiler/emit/emitter.h"
+#include "compiler/emit/module_cache.h"
+#include "compiler/emit/linker.h"
+#include "compiler/extra/zen2cpp/zen2cpp.h"
+#include "runtime/closure/closure_compiler.h"
 
 #include "util/timer.h"
+#include "util/thread_pool.h"
+#include "util/memory.h"
+#include "util/lz.h"
+#include "util/sha256.h"
 
 #include "runtime/experimental/object.h"
 
@@ -37,12 +55,316 @@ void experimentalTests()
 	std::cout << objPtr->accessMember("x")->value<double>() << "\n";
 }
 
-void testBytecode(const std::string &str, const std::string &filename)
+struct RunOptions
 {
-	Lexer lexer(str, filename);
-	auto tokens = lexer.scan();
+	zenith::runtime::jit::JitOptions jitOptions;
+	bool tierStats = false;
+	std::vector<std::string> aotModulePaths;
 
-	Parser parser(tokens, lexer.state);
+	bool writeEmitFile = false;
+	bool emitStats = false;
+	bool debugInfo = false;
+	bool compress = false;
+	// only compile the global functions that are called
+	bool lazyFunctions = false;
+	// skip function bodies when parsing, until they are compiled
+	bool preParse = false;
+	// times loading the image this many times, compressed and not
+	int benchImage = 0;
+	// times lexing the source this many times
+	int benchLexer = 0;
+	// lex large sources in chunks, on 'jobs' threads
+	bool parallelLex = false;
+	// verify images before running them, so the VM can skip its checks
+	bool verify = true;
+	std::string verifyCachePath;
+	// compiled images are kept here between runs
+	std::string cacheDir;
+	// compile every module on its own and link them
+	bool link = false;
+	bool strip = true;
+	std::string linkOutPath;
+	// threads to compile modules on, 0 for one per core
+	size_t jobs = 0;
+	zenith::BytecodeEncoding encoding = zenith::ENCODING_POOLED;
+};
+
+bool loadAotModules(const std::vector<std::string> &paths,
+	std::vector<std::unique_ptr<AotModule>> &aotModules)
+{
+	for (auto &&path : paths)
+	{
+		std::string error;
+		auto aotModule = AotModule::load(path, error);
+		if (aotModule == nullptr)
+		{
+			cout << error << "\n";
+			return false;
+		}
+
+		aotModules.push_back(std::move(aotModule));
+	}
+
+	return true;
+}
+
+void runImage(const BytecodeImage &image, const RunOptions &options,
+	std::vector<std::unique_ptr<AotModule>> &aotModules)
+{
+	if (image.isObject())
+	{
+		cout << "Bytecode image is an object, it has to be linked with its imports to run\n";
+		return;
+	}
+
+	bool verified = false;
+	if (options.verify)
+	{
+		// images in the cache were verified by an earlier run
+		std::unique_ptr<VerifiedCache> cache;
+		std::string digest;
+		if (!options.verifyCachePath.empty())
+		{
+			cache = std::make_unique<VerifiedCache>(options.verifyCachePath);
+			digest = image.digest();
+		}
+
+		if (cache == nullptr || !cache->contains(digest))
+		{
+			std::string error;
+			if (!Verifier::verify(image, error))
+			{
+				cout << error << "\n";
+				return;
+			}
+
+			if (cache != nullptr)
+				cache->add(digest);
+		}
+
+		verified = true;
+	}
+
+	auto reader = image.createReader();
+	auto *vmState = new VMState(reader.get());
+	auto *vm = new zenith::runtime::VM(vmState);
+
+	zenith::runtime::StdLibrary::bindAll(vm);
+	for (auto &&aotModule : aotModules)
+		vm->bindModule(std::move(aotModule));
+
+	vm->enableJit(options.jitOptions);
+	vm->setVerified(verified);
+
+	vm->exec();
+
+	if (options.tierStats && vm->getTiers() != nullptr)
+		vm->getTiers()->printFunctions(std::cout);
+
+	delete vm;
+	delete vmState;
+}
+
+/* Compare how long the image takes to load, compressed and raw. */
+void benchmarkImageLoad(const Emitter &emitter, int iterations)
+{
+	const char *names[] = { "raw", "compressed" };
+
+	for (int compressed = 0; compressed < 2; compressed++)
+	{
+		std::string bytes = emitter.buildImage(compressed != 0);
+
+		zenith::util::Timer timer;
+		timer.start();
+
+		for (int i = 0; i < iterations; i++)
+		{
+			std::string error;
+			if (BytecodeImage::fromMemory(bytes, error) == nullptr)
+			{
+				cout << error << "\n";
+				return;
+			}
+		}
+
+		double elapsed = timer.elapsedTime();
+		std::cout << names[compressed] << " image: " << bytes.size() << " bytes, "
+			<< (elapsed * 1e6 / iterations) << "us per load\n";
+	}
+}
+
+/* Lex the source in chunks when it is asked for, on as many threads as 'options.jobs' allows. */
+void lexInChunks(Lexer &lexer, const RunOptions &options)
+{
+	if (options.parallelLex)
+		lexer.lexInChunks((options.jobs != 0) ? options.jobs : zenith::util::ThreadPool::defaultSize());
+}
+
+/* Lex the source over and over, to measure the throughput of the lexer. */
+void benchmarkLexer(const std::string &str, const std::string &filename, int iterations,
+	const RunOptions &options)
+{
+	size_t numTokens = 0;
+
+	zenith::util::Timer timer;
+	timer.start();
+
+	for (int i = 0; i < iterations; i++)
+	{
+		Lexer lexer(str, filename);
+		lexInChunks(lexer, options);
+
+		Token token;
+		numTokens = 0;
+		while (lexer.next(token))
+			numTokens++;
+	}
+
+	double elapsed = timer.elapsedTime();
+	double megabytes = (double)str.size() * iterations / (1024 * 1024);
+	std::cout << "lexer: " << str.size() << " bytes, " << numTokens << " tokens, "
+		<< (megabytes / elapsed) << " MB/s\n";
+}
+
+/* Decompress 'packed' into exactly 'size' bytes, returns whether it was accepted. */
+bool lzAccepts(const std::string &packed, size_t size, std::string &out)
+{
+	out.assign(size, '\0');
+	return zenith::util::lz::decompress(packed.data(), packed.size(), &out[0], out.size());
+}
+
+/* Check the codecs that images depend on, for --self-test. */
+bool selfTest()
+{
+	int failed = 0;
+	auto check = [&failed](bool passed, const std::string &name)
+	{
+		if (!passed)
+		{
+			cout << "FAILED: " << name << "\n";
+			failed++;
+		}
+	};
+
+	// literal runs, long and overlapping matches, and offsets near the 64K limit
+	std::vector<std::string> inputs = { "", "a", "abc", std::string(300, 'x'),
+		"abcabcabcabcabcabcabcabc", std::string(1000, 'y') + "z" + std::string(1000, 'y') };
+
+	std::string noise;
+	uint32_t seed = 12345;
+	for (int i = 0; i < 100000; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		noise.push_back((char)(seed >> 16));
+	}
+	inputs.push_back(noise);
+	inputs.push_back(noise.substr(0, 70000) + noise.substr(0, 70000));
+
+	std::string out;
+	for (auto &&input : inputs)
+	{
+		std::string packed = zenith::util::lz::compress(input.data(), input.size());
+		std::string name = "lz round trip of " + std::to_string(input.size()) + " bytes";
+
+		check(lzAccepts(packed, input.size(), out) && out == input, name);
+		check(!lzAccepts(packed, input.size() + 1, out), name + ", output too large");
+		if (!input.empty())
+			check(!lzAccepts(packed, input.size() - 1, out), name + ", output too small");
+
+		// a cut stream is rejected, unless all that was cut is the empty last sequence
+		bool truncated = true;
+		for (size_t cut = packed.size() > 64 ? packed.size() - 64 : 0; cut < packed.size(); cut++)
+		{
+			if (lzAccepts(packed.substr(0, cut), input.size(), out))
+				truncated = truncated && out == input;
+		}
+		check(truncated, name + ", truncated");
+	}
+
+	// a match before the start of the output, at offset 1 and at offset 0
+	check(!lzAccepts(std::string("\x00\x01\x00", 3), 4, out), "lz match before the output");
+	check(!lzAccepts(std::string("\x10" "a" "\x00\x00", 4), 5, out), "lz match at offset 0");
+	// more literals than there is input, and a length that never ends
+	check(!lzAccepts(std::string("\x50" "ab", 3), 5, out), "lz literals past the input");
+	check(!lzAccepts(std::string("\xF0\xFF\xFF", 3), 600, out), "lz unterminated length");
+	// a match ending past the output
+	check(!lzAccepts(std::string("\x1F" "a" "\x01\x00\x00", 5), 10, out), "lz match past the output");
+
+	check(zenith::util::sha256Hex("abc", 3) ==
+		"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", "sha256 of abc");
+	check(zenith::util::sha256Hex(noise.data(), 56).size() == 64, "sha256 of a two block tail");
+
+	if (failed == 0)
+		cout << "All self tests passed\n";
+
+	return failed == 0;
+}
+
+/* Run an image written by --emit, mapped rather than read. */
+void runImageFile(const std::string &filename, const RunOptions &options)
+{
+	std::string error;
+	auto image = BytecodeImage::open(filename, error);
+	if (image == nullptr)
+	{
+		cout << error << "\n";
+		return;
+	}
+
+	zenith::runtime::StdLibrary::init();
+
+	std::vector<std::unique_ptr<AotModule>> aotModules;
+	if (loadAotModules(options.aotModulePaths, aotModules))
+		runImage(*image, options, aotModules);
+}
+
+/* Everything besides the sources that changes what the module compiles to. */
+std::string cacheOptions(const RunOptions &options)
+{
+	std::string key = std::to_string(options.encoding) +
+		(options.debugInfo ? " debug" : "") + (options.compress ? " compress" : "") +
+		(options.lazyFunctions ? " lazy" : "");
+
+	// compiled modules define the native functions the module may call
+	for (auto &&path : options.aotModulePaths)
+		key += " " + path;
+
+	return key;
+}
+
+void testBytecode(std::string str, const std::string &filename, const RunOptions &options)
+{
+	std::unique_ptr<ModuleCache> cache;
+	std::string cacheKey;
+	if (!options.cacheDir.empty())
+	{
+		cache = std::make_unique<ModuleCache>(options.cacheDir);
+		cacheKey = ModuleCache::makeKey(str, filename, cacheOptions(options));
+
+		// the emitter is needed to write the file, print stats or benchmark
+		std::string bytes;
+		if (!options.writeEmitFile && !options.emitStats && options.benchImage == 0 &&
+			cache->load(cacheKey, bytes))
+		{
+			std::string error;
+			auto image = BytecodeImage::fromMemory(std::move(bytes), error);
+			if (image != nullptr)
+			{
+				zenith::runtime::StdLibrary::init();
+
+				std::vector<std::unique_ptr<AotModule>> aotModules;
+				if (loadAotModules(options.aotModulePaths, aotModules))
+					runImage(*image, options, aotModules);
+				return;
+			}
+		}
+	}
+
+	// the lexer owns the source from here on, nothing else keeps a copy
+	Lexer lexer(std::move(str), filename);
+	lexInChunks(lexer, options);
+	Parser parser(lexer);
+	parser.setPreParse(options.preParse);
 	auto unit = parser.parse();
 
 	if (unit)
@@ -56,21 +378,356 @@ void testBytecode(const std::string &str, const std::string &filename)
 		zenith::runtime::StdLibrary::init();
 		zenith::runtime::StdLibrary::defineAll(&emitter);
 
-		// Run emitted code
-		if (emitter.emit(emitFilename))
+		// Functions of compiled modules are called as native functions
+		std::vector<std::unique_ptr<AotModule>> aotModules;
+		if (!loadAotModules(options.aotModulePaths, aotModules))
+			return;
+
+		for (auto &&aotModule : aotModules)
+		{
+			auto *exports = aotModule->getExports();
+			for (size_t i = 0; i < exports->numFunctions; i++)
+				emitter.defineFunction({ exports->functions[i].name, exports->moduleName, exports->functions[i].nArgs, true });
+		}
+
+		emitter.setEncoding(options.encoding);
+		emitter.setDebugInfo(options.debugInfo);
+		emitter.setCompression(options.compress);
+		emitter.setLazyFunctions(options.lazyFunctions);
+		emitter.setPreParse(options.preParse);
+
+		// Run emitted code straight from memory, the file is only written on request
+		if (options.writeEmitFile ? emitter.emit(emitFilename) : emitter.emit())
+		{
+			if (options.emitStats)
+			{
+				emitter.getStats().print(std::cout);
+				std::cout << "\timage: " << emitter.getImage().size() << " bytes\n";
+				// lexing, parsing and emitting, the module has not run yet
+				std::cout << "\tpeak memory: " << (zenith::util::peakMemoryUsage() / 1024) << " KB\n";
+
+				if (options.lazyFunctions)
+				{
+					std::cout << "\tfunctions: " << emitter.getNumLazyFunctions() << " deferred, " <<
+						emitter.getNumUncompiledFunctions() << " never compiled\n";
+				}
+			}
+
+			if (options.benchImage > 0)
+				benchmarkImageLoad(emitter, options.benchImage);
+
+			std::string error;
+			auto image = BytecodeImage::fromMemory(emitter.getImage(), error);
+			if (image == nullptr)
+			{
+				cout << error << "\n";
+				return;
+			}
+
+			if (cache != nullptr)
+			{
+				auto dependencies = emitter.getDependencies();
+				dependencies.insert(dependencies.end(),
+					options.aotModulePaths.begin(), options.aotModulePaths.end());
+
+				cache->store(cacheKey, dependencies, emitter.getImage());
+			}
+
+			runImage(*image, options, aotModules);
+		}
+	}
+}
+
+/* Compile the module at 'path' on its own, or take it from the cache. */
+std::unique_ptr<BytecodeImage> compileObject(const std::string &path, const RunOptions &options,
+	const std::vector<std::unique_ptr<AotModule>> &aotModules, ModuleCache *cache)
+{
+	std::string str;
+	if (!Lexer::readSource(path, str))
+	{
+		cout << "File not found: " << path << "\n";
+		return nullptr;
+	}
+
+	std::string error;
+	std::string cacheKey;
+	if (cache != nullptr)
+	{
+		cacheKey = ModuleCache::makeKey(str, path, cacheOptions(options) + " object");
+
+		std::string bytes;
+		if (cache->load(cacheKey, bytes))
+		{
+			auto object = BytecodeImage::fromMemory(std::move(bytes), error);
+			if (object != nullptr)
+				return object;
+		}
+	}
+
+	Lexer lexer(std::move(str), path);
+	lexInChunks(lexer, options);
+	Parser parser(lexer);
+	parser.setPreParse(options.preParse);
+	auto unit = parser.parse();
+	if (!unit)
+		return nullptr;
+
+	Emitter emitter(unit.get(), parser.state);
+	zenith::runtime::StdLibrary::defineAll(&emitter);
+
+	for (auto &&aotModule : aotModules)
+	{
+		auto *exports = aotModule->getExports();
+		for (size_t i = 0; i < exports->numFunctions; i++)
+			emitter.defineFunction({ exports->functions[i].name, exports->moduleName, exports->functions[i].nArgs, true });
+	}
+
+	emitter.setEncoding(options.encoding);
+	emitter.setDebugInfo(options.debugInfo);
+	emitter.setObject(true);
+
+	if (!emitter.emit())
+		return nullptr;
+
+	if (cache != nullptr)
+	{
+		auto dependencies = emitter.getDependencies();
+		dependencies.insert(dependencies.end(),
+			options.aotModulePaths.begin(), options.aotModulePaths.end());
+
+		cache->store(cacheKey, dependencies, emitter.getImage());
+	}
+
+	auto object = BytecodeImage::fromMemory(emitter.getImage(), error);
+	if (object == nullptr)
+		cout << error << "\n";
+
+	return object;
+}
+
+struct CompiledModule
+{
+	std::unique_ptr<BytecodeImage> object;
+	std::vector<std::string> imports;
+};
+
+/* Compile the module at 'path' and everything it imports. Modules are
+   compiled on their own, so each is started as soon as an import of it is
+   found, on as many threads as 'options.jobs' allows. */
+bool compileModules(const std::string &path, const RunOptions &options,
+	const std::vector<std::unique_ptr<AotModule>> &aotModules, ModuleCache *cache,
+	std::map<std::string, CompiledModule> &modules)
+{
+	std::mutex mutex;
+	bool failed = false;
+
+	zenith::util::ThreadPool pool((options.jobs != 0) ? options.jobs : zenith::util::ThreadPool::defaultSize());
+
+	std::function<void(const std::string&)> compile = [&](const std::string &modulePath)
+	{
+		auto object = compileObject(modulePath, options, aotModules, cache);
+
+		std::vector<std::string> imports;
+		if (object != nullptr)
+		{
+			for (size_t i = 0; i < object->getNumImports(); i++)
+				imports.push_back(object->getConstants().get(object->getImports()[i].path));
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (object == nullptr)
+		{
+			failed = true;
+			return;
+		}
+
+		for (auto &&import : imports)
+		{
+			// an entry is made before it is compiled, so each module is only started once
+			if (modules.find(import) == modules.end())
+			{
+				modules[import];
+				pool.submit([&compile, import] { compile(import); });
+			}
+		}
+
+		modules[modulePath].object = std::move(object);
+		modules[modulePath].imports = std::move(imports);
+	};
+
+	modules[path];
+	pool.submit([&compile, &path] { compile(path); });
+	pool.wait();
+
+	return !failed;
+}
+
+/* Add the module at 'path' to the linker after everything it imports, in the
+   order of its imports, so the image is the same however compilation went. */
+void addObjects(const std::string &path, std::map<std::string, CompiledModule> &modules,
+	std::set<std::string> &visited, Linker &linker)
+{
+	if (!visited.insert(path).second)
+		return;
+
+	auto &module = modules[path];
+	for (auto &&import : module.imports)
+		addObjects(import, modules, visited, linker);
+
+	linker.add(*module.object);
+}
+
+void linkProgram(const std::string &filename, const RunOptions &options)
+{
+	zenith::runtime::StdLibrary::init();
+
+	std::vector<std::unique_ptr<AotModule>> aotModules;
+	if (!loadAotModules(options.aotModulePaths, aotModules))
+		return;
+
+	std::unique_ptr<ModuleCache> cache;
+	if (!options.cacheDir.empty())
+		cache = std::make_unique<ModuleCache>(options.cacheDir);
+
+	Linker linker(options.encoding);
+	linker.setStripping(options.strip);
+
+	std::map<std::string, CompiledModule> modules;
+	if (!compileModules(filename, options, aotModules, cache.get(), modules))
+		return;
+
+	std::set<std::string> visited;
+	addObjects(filename, modules, visited, linker);
+
+	std::string bytes, error;
+	if (!linker.link(bytes, error, options.compress))
+	{
+		cout << error << "\n";
+		return;
+	}
+
+	if (options.emitStats)
+	{
+		std::cout << "Linked " << linker.getNumModules() << " module(s), stripped "
+			<< linker.getNumStripped() << " function(s), image: " << bytes.size() << " bytes\n";
+	}
+
+	if (!options.linkOutPath.empty())
+	{
+		std::ofstream file(options.linkOutPath, std::ofstream::binary);
+		file.write(bytes.data(), bytes.size());
+	}
+
+	auto image = BytecodeImage::fromMemory(std::move(bytes), error);
+	if (image == nullptr)
+	{
+		cout << error << "\n";
+		return;
+	}
+
+	runImage(*image, options, aotModules);
+}
+
+void compileAot(std::string str, const std::string &filename,
+	const zenith::compiler::zen2cpp::AotOptions &aotOptions)
+{
+	Lexer lexer(std::move(str), filename);
+	Parser parser(lexer);
+	auto unit = parser.parse();
+
+	if (unit)
+	{
+		std::string cppFilename = unit->moduleName + ".aot.cpp";
+#ifdef _WIN32
+		std::string exeFilename = unit->moduleName + (aotOptions.sharedLibrary ? ".dll" : ".aot.exe");
+#else
+		std::string exeFilename = unit->moduleName + (aotOptions.sharedLibrary ? ".so" : ".aot");
+#endif
+
+		// the standard library declares its native functions through an emitter
+		Emitter emitter(unit.get(), parser.state);
+		zenith::runtime::StdLibrary::init();
+		zenith::runtime::StdLibrary::defineAll(&emitter);
+
+		zenith::compiler::zen2cpp::Zen2Cpp aot(unit.get(), parser.state, aotOptions);
+		for (auto &&func : emitter.getExternalFunctions())
+			aot.defineFunction(func);
+
+		if (aot.translate(cppFilename) && aot.compile(cppFilename, exeFilename))
+		{
+			if (aotOptions.sharedLibrary)
+				cout << "Compiled module: " << exeFilename << "\n";
+			else
+				zenith::compiler::zen2cpp::Zen2Cpp::run(exeFilename);
+		}
+	}
+}
+
+void runClosure(std::string str, const std::string &filename,
+	const std::vector<std::string> &aotModulePaths)
+{
+	Lexer lexer(std::move(str), filename);
+	Parser parser(lexer);
+	auto unit = parser.parse();
+
+	if (unit)
+	{
+		// the standard library declares its native functions through an emitter
+		Emitter emitter(unit.get(), parser.state);
+		zenith::runtime::StdLibrary::init();
+		zenith::runtime::StdLibrary::defineAll(&emitter);
+
+		zenith::runtime::closure::ClosureCompiler compiler(parser.state);
+		for (auto &&func : emitter.getExternalFunctions())
+			compiler.defineFunction(func.name, func.moduleName, func.nArgs);
+
+		// Functions of compiled modules are bound into the native table
+		std::vector<std::unique_ptr<AotModule>> aotModules;
+		for (auto &&path : aotModulePaths)
 		{
-			auto *reader = new zenith::runtime::FileByteReader(emitFilename);
-			auto *vmState = new VMState(reader);
-			auto *vm = new zenith::runtime::VM(vmState);
+			std::string error;
+			auto aotModule = AotModule::load(path, error);
+			if (aotModule == nullptr)
+			{
+				cout << error << "\n";
+				return;
+			}
+
+			auto *exports = aotModule->getExports();
+			for (size_t i = 0; i < exports->numFunctions; i++)
+			{
+				auto &func = exports->functions[i];
+				compiler.defineFunction(func.name, exports->moduleName, func.nArgs, true);
+				zenith::aot::NativeTable::instance().bind(SymbolTable::mangle(exports->moduleName, func.name, (int)func.nArgs),
+					func.nArgs, func.fn);
+			}
+
+			aotModule->init();
+			aotModules.push_back(std::move(aotModule));
+		}
 
-			zenith::runtime::StdLibrary::bindAll(vm);
+		compiler.accept(unit.get());
 
-			vm->exec();
+		auto program = compiler.getProgram();
+		if (program == nullptr)
+		{
+			displayErrors(compiler.getState().errors);
+			return;
+		}
 
-			delete vm;
-			delete vmState;
-			delete reader;
+		zenith::util::Timer timer;
+		timer.start();
+
+		try
+		{
+			program->run();
 		}
+		catch (const std::exception &e)
+		{
+			Exception({ e.what() }).display();
+		}
+
+		std::cout << "Execution completed in " << timer.elapsedTime() << "s\n";
 	}
 }
 
@@ -93,23 +750,123 @@ int main(int argc, char *argv[])
 	getchar();*/
 	
 	if (argc < 2)
-		cout << "Usage: " << argv[0] << " <filename> <options (not required)>\n";
+		cout << "Usage: " << argv[0] << " <filename> <options (not required)>, or --self-test\n";
+	else if (std::string(argv[1]) == "--self-test")
+		return selfTest() ? 0 : 1;
 	else
 	{
 		char *filename = argv[1];
 
-		std::ifstream t(filename);
+		std::string str;
 
-		if (!t.is_open())
+		if (!Lexer::readSource(filename, str))
 		{
 			cout << "File not found: " << filename << "\n";
 			throw std::runtime_error("File not found");
 		}
 
-		std::string str((std::istreambuf_iterator<char>(t)),
-			std::istreambuf_iterator<char>());
+		RunOptions options;
+		auto &jitOptions = options.jitOptions;
+
+		zenith::compiler::zen2cpp::AotOptions aotOptions;
+		bool aot = false;
+		bool closure = false;
+
+		for (int i = 2; i < argc; i++)
+		{
+			std::string option(argv[i]);
+
+			if (option == "--jit")
+				jitOptions.enabled = true;
+			else if (option.find("--jit-calls=") == 0)
+				jitOptions.callThreshold = std::stoul(option.substr(12));
+			else if (option.find("--jit-loops=") == 0)
+				jitOptions.backEdgeThreshold = std::stoul(option.substr(12));
+			else if (option == "--trace")
+				jitOptions.tracing = true;
+			else if (option.find("--trace-loops=") == 0)
+				jitOptions.traceThreshold = std::stoul(option.substr(14));
+			else if (option == "--tier")
+				jitOptions.tiering = true;
+			else if (option.find("--tier-calls=") == 0)
+				jitOptions.quickenCallThreshold = std::stoul(option.substr(13));
+			else if (option.find("--tier-loops=") == 0)
+				jitOptions.quickenBackEdgeThreshold = std::stoul(option.substr(13));
+			else if (option == "--tier-stats")
+				options.tierStats = jitOptions.tiering = true;
+			else if (option == "--emit")
+				options.writeEmitFile = true;
+			else if (option == "--encoding=fixed")
+				options.encoding = zenith::ENCODING_FIXED;
+			else if (option == "--encoding=compact")
+				options.encoding = zenith::ENCODING_COMPACT;
+			else if (option == "--encoding=pooled")
+				options.encoding = zenith::ENCODING_POOLED;
+			else if (option == "--compress")
+				options.compress = true;
+			else if (option == "--lazy")
+				options.lazyFunctions = true;
+			else if (option == "--pre-parse")
+				options.preParse = true;
+			else if (option.find("--bench-image=") == 0)
+				options.benchImage = std::stoi(option.substr(14));
+			else if (option.find("--bench-lexer=") == 0)
+				options.benchLexer = std::stoi(option.substr(14));
+			else if (option == "--parallel-lex")
+				options.parallelLex = true;
+			else if (option == "--debug-info")
+				options.debugInfo = true;
+			else if (option.find("--cache-dir=") == 0)
+				options.cacheDir = option.substr(12);
+			else if (option == "--link")
+				options.link = true;
+			else if (option.find("--link-out=") == 0)
+			{
+				options.link = true;
+				options.linkOutPath = option.substr(11);
+			}
+			else if (option.find("--jobs=") == 0)
+				options.jobs = std::stoul(option.substr(7));
+			else if (option == "--no-strip")
+				options.strip = false;
+			else if (option == "--no-verify")
+				options.verify = false;
+			else if (option.find("--verify-cache=") == 0)
+				options.verifyCachePath = option.substr(15);
+			else if (option == "--emit-stats")
+				options.emitStats = true;
+			else if (option == "--closure")
+				closure = true;
+			else if (option == "--aot")
+				aot = true;
+			else if (option == "--aot-lib")
+				aot = aotOptions.sharedLibrary = true;
+			else if (option.find("--load-aot=") == 0)
+				options.aotModulePaths.push_back(option.substr(11));
+			else if (option.find("--aot-include=") == 0)
+				aotOptions.includeDir = option.substr(14);
+			else if (option.find("--aot-cxx=") == 0)
+				aotOptions.compiler = option.substr(10);
+			else
+				cout << "Unknown option: " << option << "\n";
+		}
 		
-		testBytecode(str, filename);
+		if (BytecodeImage::isImage(str.data(), str.size()))
+			runImageFile(filename, options);
+		else if (options.benchLexer > 0)
+			benchmarkLexer(str, filename, options.benchLexer, options);
+		else if (aot)
+			compileAot(std::move(str), filename, aotOptions);
+		else if (closure)
+			runClosure(std::move(str), filename, options.aotModulePaths);
+		else if (options.link)
+		{
+			// every module is read again as it is compiled
+			std::string().swap(str);
+			linkProgram(filename, options);
+		}
+		else
+			testBytecode(std::move(str), filename, options);
 	}
 
 	system("pause");
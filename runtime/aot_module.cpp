@@ -0,0 +1,136 @@
+#include "aot_module.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace zenith
+{
+	namespace runtime
+	{
+		int AotFunction::f(std::stack<ObjectPtr> &paramStack, std::stack<ObjectPtr> &returnStack)
+		{
+			// the first argument is on top
+			std::vector<aot::Value> args;
+			args.reserve(numParams);
+
+			for (size_t i = 0; i < numParams; i++)
+			{
+				args.push_back(toValue(paramStack.top()));
+				paramStack.pop();
+			}
+
+			try
+			{
+				returnStack.push(toObject(fn(args)));
+			}
+			catch (const std::exception &e)
+			{
+				Exception({ e.what() }).display();
+			}
+
+			return 0;
+		}
+
+		aot::Value AotFunction::toValue(const ObjectPtr &object)
+		{
+			if (object == nullptr)
+				return aot::Value();
+			else if (object->isInteger())
+				return aot::Value(object->cast<long>());
+			else if (object->isFloat())
+				return aot::Value(object->cast<double>());
+			else if (object->isString())
+				return aot::Value(object->cast<std::string>());
+
+			Exception({ "Cannot pass a '" + object->type_str() + "' to compiled code" }).display();
+			return aot::Value();
+		}
+
+		ObjectPtr AotFunction::toObject(const aot::Value &value)
+		{
+			switch (value.type)
+			{
+			case aot::VALUE_INTEGER:
+				return std::make_shared<Object>(value.i);
+			case aot::VALUE_FLOAT:
+				return std::make_shared<Object>(value.f);
+			case aot::VALUE_STRING:
+				return std::make_shared<Object>(*value.s);
+			default:
+				return ObjectPtr(nullptr);
+			}
+		}
+
+		AotModule::AotModule(void *handle, const aot::ModuleExports *exports)
+		{
+			this->handle = handle;
+			this->exports = exports;
+		}
+
+		AotModule::~AotModule()
+		{
+#ifdef _WIN32
+			FreeLibrary((HMODULE)handle);
+#else
+			dlclose(handle);
+#endif
+		}
+
+		std::unique_ptr<AotModule> AotModule::load(const std::string &path, std::string &error)
+		{
+#ifdef _WIN32
+			HMODULE handle = LoadLibraryA(path.c_str());
+			if (handle == nullptr)
+			{
+				error = "Could not load library: " + path;
+				return nullptr;
+			}
+
+			auto entry = (aot::ModuleEntry)GetProcAddress(handle, "zen_aot_module");
+#else
+			// dlopen() only searches the library path for names without a slash
+			std::string file = (path.find('/') == std::string::npos) ? "./" + path : path;
+
+			void *handle = dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL);
+			if (handle == nullptr)
+			{
+				error = dlerror();
+				return nullptr;
+			}
+
+			auto entry = (aot::ModuleEntry)dlsym(handle, "zen_aot_module");
+#endif
+
+			const aot::ModuleExports *exports = (entry != nullptr) ? entry() : nullptr;
+
+			if (exports == nullptr)
+				error = "Not a compiled module: " + path;
+			else if (exports->abiVersion != aot::MODULE_ABI_VERSION)
+				error = "Module was compiled for a different version: " + path;
+			else
+				return std::unique_ptr<AotModule>(new AotModule((void*)handle, exports));
+
+#ifdef _WIN32
+			FreeLibrary(handle);
+#else
+			dlclose(handle);
+#endif
+			return nullptr;
+		}
+
+		void AotModule::init()
+		{
+			try
+			{
+				exports->init();
+			}
+			catch (const std::exception &e)
+			{
+				Exception({ e.what() }).display();
+			}
+		}
+	}
+}
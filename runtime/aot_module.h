@@ -0,0 +1,65 @@
+#ifndef __ZENITH_RUNTIME_AOT_MODULE_H__
+#define __ZENITH_RUNTIME_AOT_MODULE_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "experimental/object.h"
+#include "exception.h"
+#include "../interop/class.h"
+#include "../interop/function.h"
+#include "../compiler/extra/zen2cpp/zen2cpp_runtime.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		class VM;
+
+		/* A function of an ahead-of-time compiled module, called by the VM
+		   like any other native function. */
+		class AotFunction : public NativeFunctionBase
+		{
+		private:
+			aot::NativeFunction fn;
+
+		public:
+			AotFunction(size_t numParams, aot::NativeFunction fn)
+				: NativeFunctionBase(numParams) {
+				this->fn = fn;
+			}
+
+			int f(std::stack<ObjectPtr> &paramStack, std::stack<ObjectPtr> &returnStack);
+
+			static aot::Value toValue(const ObjectPtr &object);
+			static ObjectPtr toObject(const aot::Value &value);
+		};
+
+		/* A module compiled by zen2cpp as a shared library (--aot-lib),
+		   loaded into the process. */
+		class AotModule
+		{
+		private:
+			void *handle;
+			const aot::ModuleExports *exports;
+
+			AotModule(void *handle, const aot::ModuleExports *exports);
+
+		public:
+			~AotModule();
+
+			/* Load the shared library at 'path'. Returns nullptr and writes
+			   the reason to 'error' if it is not a compiled module. */
+			static std::unique_ptr<AotModule> load(const std::string &path, std::string &error);
+
+			std::string getName() const { return exports->moduleName; }
+			const aot::ModuleExports *getExports() const { return exports; }
+
+			/* Run the top level statements of the module. */
+			void init();
+		};
+	}
+}
+
+#endif
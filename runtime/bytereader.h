@@ -2,17 +2,34 @@
 #define __ZENITH_RUNTIME_BYTEREADER_H__
 
 #include <fstream>
+#include <string>
+#include <cstring>
+
+#include "../enums.h"
 
 namespace zenith
 {
 	namespace runtime
 	{
+		class ConstantPool;
+
 		class ByteReader
 		{
 		protected:
+			// set from the bytecode header
+			BytecodeEncoding encoding = ENCODING_FIXED;
+			// strings of pooled bytecode, from the image it was loaded from
+			const ConstantPool *constants = nullptr;
+
 			virtual void readBytes(char *ptr, unsigned size) = NULL;
 
 		public:
+			BytecodeEncoding getEncoding() const { return encoding; }
+			void setEncoding(BytecodeEncoding encoding) { this->encoding = encoding; }
+
+			const ConstantPool *getConstants() const { return constants; }
+			void setConstants(const ConstantPool *constants) { this->constants = constants; }
+
 			template <typename T>
 			void read(T *ptr, unsigned size = sizeof(T))
 			{
@@ -63,6 +80,11 @@ namespace zenith
 			void readBytes(char *ptr, unsigned size)
 			{
 				file->read(ptr, size);
+
+				// what could not be read is zero, never left as it was
+				size_t got = (size_t)file->gcount();
+				if (got < size)
+					std::memset(ptr + got, 0, size - got);
 				pos += size;
 			}
 
@@ -81,6 +103,74 @@ namespace zenith
 				return file->eof();
 			}
 		};
+
+		/* Reads bytecode that is already in memory, either its own copy or
+		   a view of memory owned elsewhere, e.g. a mapped image. */
+		class MemoryByteReader : public ByteReader
+		{
+		private:
+			std::string buffer;
+			const char *data;
+			size_t size;
+			size_t pos;
+			bool atEnd;
+
+		public:
+			MemoryByteReader(std::string buffer, size_t begin = 0)
+				: buffer(std::move(buffer)), pos(begin), atEnd(false)
+			{
+				data = this->buffer.data();
+				size = this->buffer.size();
+			}
+
+			MemoryByteReader(const char *data, size_t size, size_t begin = 0)
+				: data(data), size(size), pos(begin), atEnd(false)
+			{
+			}
+
+			std::streampos position() const
+			{
+				return pos;
+			}
+
+			std::streampos max() const
+			{
+				return size;
+			}
+
+			void readBytes(char *ptr, unsigned count)
+			{
+				// like a file, reading past the end sets eof, and what is missing reads as zero
+				size_t available = (pos < size) ? size - pos : 0;
+				size_t copied = (count < available) ? count : available;
+				if (count > available)
+					atEnd = true;
+
+				if (copied > 0)
+					std::memcpy(ptr, data + pos, copied);
+				if (copied < count)
+					std::memset(ptr + copied, 0, count - copied);
+				pos += count;
+			}
+
+			void skip(unsigned amount)
+			{
+				pos += amount;
+				if (pos > size)
+					atEnd = true;
+			}
+
+			void seek(unsigned long whereTo)
+			{
+				pos = whereTo;
+				atEnd = false;
+			}
+
+			bool eof() const
+			{
+				return atEnd;
+			}
+		};
 	}
 }
 
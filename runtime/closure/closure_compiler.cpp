@@ -0,0 +1,784 @@
+#include "closure_compiler.h"
+
+#include "../../compiler/lexer.h"
+#include "../../compiler/parser.h"
+#include "../../compiler/symbols.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		namespace closure
+		{
+			using namespace compiler;
+
+			template <Value(*Op)(const aot::Operands&)>
+			static Expression binary(Expression left, Expression right)
+			{
+				return [left, right](Frame &frame) { return Op({ left(frame), right(frame) }); };
+			}
+
+			template <Value&(*Op)(Value&, const Value&)>
+			static Expression assignment(Reference target, Expression value)
+			{
+				return [target, value](Frame &frame) -> Value
+				{
+					Value right = value(frame);
+					return Op(target(frame), right);
+				};
+			}
+
+			static Expression constant(const Value &value)
+			{
+				return [value](Frame &) { return value; };
+			}
+
+			ClosureCompiler::ClosureCompiler(ParserState &state)
+				: state(state)
+			{
+				program = std::make_unique<Program>();
+				contexts.push_back({ program->getMain(), { Scope() } });
+				statements = &program->getMain()->body;
+			}
+
+			void ClosureCompiler::accept(ModuleAst *node)
+			{
+				moduleNames.insert(node->moduleName);
+
+				for (auto &&child : node->children)
+					accept(child.get());
+
+				if (!state.errors.empty())
+					program = nullptr;
+			}
+
+			void ClosureCompiler::defineFunction(const std::string &name,
+				const std::string &moduleName,
+				size_t numArgs,
+				bool qualified)
+			{
+				FunctionInfo *fn = program->addFunction(qualified ? SymbolTable::mangle(moduleName, name, (int)numArgs) : name,
+					numArgs);
+				fn->isNative = true;
+
+				if (qualified)
+				{
+					moduleNames.insert(moduleName);
+					nativeModules.insert(moduleName);
+				}
+
+				contexts.front().scopes.front().functions.push_back({ moduleName + "." + name, fn });
+			}
+
+			void ClosureCompiler::accept(AstNode *node)
+			{
+				if (node == nullptr)
+					return;
+
+				switch (node->nodeType)
+				{
+				case AST_IMPORTS:
+					accept(static_cast<ImportsAst*>(node));
+					break;
+				case AST_IMPORT:
+					accept(static_cast<ImportAst*>(node));
+					break;
+				case AST_STATEMENT:
+					accept(static_cast<StatementAst*>(node));
+					break;
+				case AST_BLOCK:
+					accept(static_cast<BlockAst*>(node));
+					break;
+				case AST_EXPRESSION:
+					accept(static_cast<ExpressionAst*>(node));
+					break;
+				case AST_BINARY_OPERATION:
+					accept(static_cast<BinaryOperationAst*>(node));
+					break;
+				case AST_UNARY_OPERATION:
+					accept(static_cast<UnaryOperationAst*>(node));
+					break;
+				case AST_MEMBER_ACCESS:
+					accept(static_cast<MemberAccessAst*>(node));
+					break;
+				case AST_VARIABLE_DECLARATION:
+					accept(static_cast<VariableDeclarationAst*>(node));
+					break;
+				case AST_VARIABLE:
+					accept(static_cast<VariableAst*>(node));
+					break;
+				case AST_INTEGER:
+					accept(static_cast<IntegerAst*>(node));
+					break;
+				case AST_FLOAT:
+					accept(static_cast<FloatAst*>(node));
+					break;
+				case AST_STRING:
+					accept(static_cast<StringAst*>(node));
+					break;
+				case AST_TRUE:
+					accept(static_cast<TrueAst*>(node));
+					break;
+				case AST_FALSE:
+					accept(static_cast<FalseAst*>(node));
+					break;
+				case AST_NULL:
+					accept(static_cast<NullAst*>(node));
+					break;
+				case AST_SELF:
+					accept(static_cast<SelfAst*>(node));
+					break;
+				case AST_NEW:
+					accept(static_cast<NewAst*>(node));
+					break;
+				case AST_FUNCTION_DEFINITION:
+					accept(static_cast<FunctionDefinitionAst*>(node));
+					break;
+				case AST_FUNCTION_CALL:
+					accept(static_cast<FunctionCallAst*>(node));
+					break;
+				case AST_CLASS:
+					accept(static_cast<ClassAst*>(node));
+					break;
+				case AST_IF_STATEMENT:
+					accept(static_cast<IfStatementAst*>(node));
+					break;
+				case AST_RETURN_STATEMENT:
+					accept(static_cast<ReturnStatementAst*>(node));
+					break;
+				case AST_FOR_LOOP:
+					accept(static_cast<ForLoopAst*>(node));
+					break;
+				default:
+					state.errors.push_back({ INTERNAL_ERROR, node->location });
+					break;
+				}
+			}
+
+			void ClosureCompiler::accept(ImportsAst *node)
+			{
+				for (auto &child : node->imports)
+					accept(child.get());
+			}
+
+			void ClosureCompiler::accept(ImportAst *node)
+			{
+				if (contexts.size() != 1)
+					state.errors.push_back({ IMPORT_OUTSIDE_GLOBAL, node->location });
+
+				if (node->isModuleImport)
+					state.errors.push_back({ NOT_SUPPORTED, node->location, "Module import" });
+				else
+				{
+					// load relative file
+					auto importModulePath = node->localPath + node->value;
+
+					// Check if the module has already been imported
+					if (externalModules.find(importModulePath) == externalModules.end())
+					{
+						std::string str;
+
+						if (!Lexer::readSource(importModulePath, str))
+							state.errors.push_back({ MODULE_NOT_FOUND, node->location, node->value });
+						else
+						{
+							Lexer lexer(std::move(str), importModulePath);
+							Parser parser(lexer);
+							auto unit = parser.parse();
+
+							if (nativeModules.find(unit->moduleName) != nativeModules.end())
+							{
+								// compiled ahead of time, its functions are called natively
+							}
+							else if (moduleNames.find(unit->moduleName) == moduleNames.end())
+							{
+								moduleNames.insert(unit->moduleName);
+								externalModules[importModulePath] = std::move(unit);
+
+								for (auto &&error : parser.state.errors)
+									state.errors.push_back(error);
+
+								for (std::unique_ptr<AstNode> &child : externalModules[importModulePath]->children)
+									accept(child.get());
+							}
+							else // module's identifier has already been declared
+								state.errors.push_back({ MODULE_ALREADY_DEFINED, node->location, unit->moduleName });
+						}
+					}
+				}
+			}
+
+			void ClosureCompiler::accept(StatementAst *node)
+			{
+			}
+
+			void ClosureCompiler::accept(BlockAst *node)
+			{
+				for (auto &&child : node->children)
+					accept(child.get());
+			}
+
+			void ClosureCompiler::accept(ExpressionAst *node)
+			{
+				if (node->shouldClearStack)
+				{
+					// the value is discarded, so this is a statement of its own
+					Expression value = expression(node->value.get());
+					statements->push_back([value](Frame &frame)
+					{
+						value(frame);
+						return false;
+					});
+				}
+				else
+					accept(node->value.get());
+			}
+
+			void ClosureCompiler::accept(BinaryOperationAst *node)
+			{
+				switch (node->op)
+				{
+				case OP_ASSIGN:
+				case OP_ADD_ASSIGN:
+				case OP_SUBTRACT_ASSIGN:
+				case OP_MULTIPLY_ASSIGN:
+				case OP_DIVIDE_ASSIGN:
+				{
+					Reference target = reference(node->left.get());
+					Expression value = expression(node->right.get());
+
+					if (node->op == OP_ASSIGN)
+						expr = assignment<aot::assign>(target, value);
+					else if (node->op == OP_ADD_ASSIGN)
+						expr = assignment<aot::addAssign>(target, value);
+					else if (node->op == OP_SUBTRACT_ASSIGN)
+						expr = assignment<aot::subAssign>(target, value);
+					else if (node->op == OP_MULTIPLY_ASSIGN)
+						expr = assignment<aot::mulAssign>(target, value);
+					else
+						expr = assignment<aot::divAssign>(target, value);
+
+					return;
+				}
+				default:
+					break;
+				}
+
+				Expression left = expression(node->left.get());
+				Expression right = expression(node->right.get());
+
+				switch (node->op)
+				{
+				case OP_POWER:
+					expr = binary<aot::pow>(left, right);
+					break;
+				case OP_MULTIPLY:
+					expr = binary<aot::mul>(left, right);
+					break;
+				case OP_INT_DIVIDE:
+				case OP_DIVIDE:
+					expr = binary<aot::div>(left, right);
+					break;
+				case OP_MODULUS:
+					expr = binary<aot::mod>(left, right);
+					break;
+				case OP_ADD:
+					expr = binary<aot::add>(left, right);
+					break;
+				case OP_SUBTRACT:
+					expr = binary<aot::sub>(left, right);
+					break;
+				case OP_AND:
+					expr = binary<aot::logicalAnd>(left, right);
+					break;
+				case OP_OR:
+					expr = binary<aot::logicalOr>(left, right);
+					break;
+				case OP_EQUALS:
+					expr = binary<aot::eql>(left, right);
+					break;
+				case OP_NOT_EQUAL:
+					expr = binary<aot::notEql>(left, right);
+					break;
+				case OP_LESS:
+					expr = binary<aot::less>(left, right);
+					break;
+				case OP_GREATER:
+					expr = binary<aot::greater>(left, right);
+					break;
+				case OP_GREATER_OR_EQUAL:
+					expr = binary<aot::greaterEql>(left, right);
+					break;
+				case OP_LESS_OR_EQUAL:
+					expr = binary<aot::lessEql>(left, right);
+					break;
+				default:
+					state.errors.push_back({ ILLEGAL_OPERATOR,
+						node->location,
+						getOperatorStr(node->op) });
+					break;
+				}
+			}
+
+			void ClosureCompiler::accept(UnaryOperationAst *node)
+			{
+				Expression value = expression(node->value.get());
+
+				switch (node->op)
+				{
+				case OP_NOT:
+					expr = [value](Frame &frame) { return aot::logicalNot(value(frame)); };
+					break;
+				case OP_ADD:
+					expr = value;
+					break;
+				case OP_SUBTRACT:
+					expr = [value](Frame &frame) { return aot::negate(value(frame)); };
+					break;
+				default:
+					state.errors.push_back({ ILLEGAL_OPERATOR,
+						node->location,
+						getOperatorStr(node->op) });
+					break;
+				}
+			}
+
+			void ClosureCompiler::accept(MemberAccessAst *node)
+			{
+				// only members of modules can be accessed, there are no objects
+				auto *leftAst = dynamic_cast<VariableAst*>(node->left.get());
+				auto *next = node->right.get();
+
+				if (leftAst != nullptr && moduleNames.find(leftAst->name) != moduleNames.end() &&
+					next != nullptr && (next->nodeType == AST_VARIABLE || next->nodeType == AST_FUNCTION_CALL))
+				{
+					memberModule = leftAst->name;
+					accept(next);
+					memberModule.clear();
+				}
+				else
+					state.errors.push_back({ NOT_SUPPORTED, node->location, "Member access" });
+			}
+
+			void ClosureCompiler::accept(VariableDeclarationAst *node)
+			{
+				Scope &scope = contexts.back().scopes.back();
+				std::string name = qualify(node, node->name);
+
+				if (scope.variables.find(name) != scope.variables.end() ||
+					moduleNames.find(node->name) != moduleNames.end())
+				{
+					state.errors.push_back({ REDECLARED_IDENTIFIER,
+						node->location,
+						node->name });
+					return;
+				}
+
+				size_t slot = contexts.back().fn->numSlots++;
+				scope.variables[name] = slot;
+
+				// a variable starts out null each time its declaration runs
+				statements->push_back([slot](Frame &frame)
+				{
+					frame.slots[slot] = Value();
+					return false;
+				});
+
+				if (node->assignment != nullptr)
+				{
+					Expression value = expression(node->assignment.get());
+					statements->push_back([value](Frame &frame)
+					{
+						value(frame);
+						return false;
+					});
+				}
+			}
+
+			void ClosureCompiler::accept(VariableAst *node)
+			{
+				int hops;
+				size_t slot;
+
+				if (!varInScope(qualify(node, node->name), hops, slot))
+				{
+					state.errors.push_back({ UNDECLARED_IDENTIFIER,
+						node->location,
+						node->name });
+					return;
+				}
+
+				if (hops == 0)
+					expr = [slot](Frame &frame) { return frame.slots[slot]; };
+				else
+				{
+					Reference ref = slotReference(hops, slot);
+					expr = [ref](Frame &frame) { return ref(frame); };
+				}
+			}
+
+			void ClosureCompiler::accept(IntegerAst *node)
+			{
+				expr = constant(Value(node->value));
+			}
+
+			void ClosureCompiler::accept(FloatAst *node)
+			{
+				expr = constant(Value(node->value));
+			}
+
+			void ClosureCompiler::accept(StringAst *node)
+			{
+				expr = constant(Value(node->value));
+			}
+
+			void ClosureCompiler::accept(TrueAst *node)
+			{
+				expr = constant(Value(1L));
+			}
+
+			void ClosureCompiler::accept(FalseAst *node)
+			{
+				expr = constant(Value(0L));
+			}
+
+			void ClosureCompiler::accept(NullAst *node)
+			{
+				expr = constant(Value());
+			}
+
+			void ClosureCompiler::accept(SelfAst *node)
+			{
+				state.errors.push_back({ NOT_SUPPORTED, node->location, "'self'" });
+			}
+
+			void ClosureCompiler::accept(NewAst *node)
+			{
+				state.errors.push_back({ NOT_SUPPORTED, node->location, "'new'" });
+			}
+
+			void ClosureCompiler::accept(FunctionDefinitionAst *node)
+			{
+				std::string name = qualify(node, node->name);
+				size_t nArgs = node->arguments.size();
+
+				FunctionInfo *tmpFn = nullptr;
+				int hops;
+				size_t slot;
+
+				if (fnInScope(name, nArgs, tmpFn, hops) == FN_FOUND ||
+					varInScope(name, hops, slot) ||
+					moduleNames.find(node->name) != moduleNames.end())
+				{
+					state.errors.push_back({ REDECLARED_IDENTIFIER,
+						node->location,
+						node->name });
+					return;
+				}
+
+				FunctionInfo *fn = program->addFunction(name, nArgs);
+				contexts.back().scopes.back().functions.push_back({ name, fn });
+
+				// the body is compiled now, calls are bound to it statically
+				Scope params;
+				for (size_t i = 0; i < nArgs; i++)
+					params.variables[qualify(node, node->arguments[i])] = i;
+
+				contexts.push_back({ fn, { params } });
+
+				StatementList *lastStatements = statements;
+				statements = &fn->body;
+
+				accept(node->block.get());
+
+				statements = lastStatements;
+				contexts.pop_back();
+			}
+
+			void ClosureCompiler::accept(FunctionCallAst *node)
+			{
+				std::string name = qualify(node, node->name);
+				size_t nArgs = node->arguments.size();
+
+				FunctionInfo *fn = nullptr;
+				int hops = 0;
+
+				ReturnMessage msg = fnInScope(name, nArgs, fn, hops);
+
+				if (msg == FN_NOT_FOUND)
+					state.errors.push_back({ FUNCTION_NOT_FOUND, node->location, node->name + " (" + name + ")" });
+				else if (msg == FN_TOO_MANY_ARGS)
+					state.errors.push_back({ TOO_MANY_ARGS, node->location, node->name });
+				else if (msg == FN_TOO_FEW_ARGS)
+					state.errors.push_back({ TOO_FEW_ARGS, node->location, node->name });
+
+				if (msg != FN_FOUND)
+					return;
+
+				std::vector<Expression> args;
+				for (auto &&arg : node->arguments)
+					args.push_back(expression(arg.get()));
+
+				if (fn->isNative)
+				{
+					expr = [fn, args](Frame &frame)
+					{
+						// arguments are evaluated from last to first, as in the VM
+						std::vector<Value> values(args.size());
+						for (size_t i = args.size(); i-- > 0;)
+							values[i] = args[i](frame);
+
+						return aot::callNative(fn->native, fn->name.c_str(), values);
+					};
+				}
+				else
+				{
+					expr = [fn, args, hops](Frame &frame)
+					{
+						std::vector<Value> values(fn->numSlots);
+						for (size_t i = args.size(); i-- > 0;)
+							values[i] = args[i](frame);
+
+						// the frame of the function the callee was defined in
+						Frame *parent = &frame;
+						for (int i = 0; i < hops; i++)
+							parent = parent->parent;
+
+						return Program::call(fn, parent, std::move(values));
+					};
+				}
+			}
+
+			void ClosureCompiler::accept(ClassAst *node)
+			{
+				state.errors.push_back({ NOT_SUPPORTED, node->location, "Class '" + node->name + "'" });
+			}
+
+			void ClosureCompiler::accept(IfStatementAst *node)
+			{
+				Expression condition = expression(node->cond_expr.get());
+				StatementList ifBlock = block(node->block.get());
+				StatementList elseBlock = block(node->elseStatement.get());
+
+				statements->push_back([condition, ifBlock, elseBlock](Frame &frame)
+				{
+					if (aot::truthy(condition(frame)))
+						return Program::execute(ifBlock, frame);
+					else
+						return Program::execute(elseBlock, frame);
+				});
+			}
+
+			void ClosureCompiler::accept(ReturnStatementAst *node)
+			{
+				Expression value = (node->value != nullptr)
+					? expression(node->value.get())
+					: constant(Value());
+
+				statements->push_back([value](Frame &frame)
+				{
+					frame.result = value(frame);
+					return true;
+				});
+			}
+
+			void ClosureCompiler::accept(ForLoopAst *node)
+			{
+				// the initializer is scoped to the loop
+				contexts.back().scopes.push_back(Scope());
+
+				StatementList init;
+				StatementList *lastStatements = statements;
+				statements = &init;
+				accept(node->init_expr.get());
+				statements = lastStatements;
+
+				Expression condition = expression(node->cond_expr.get());
+				StatementList body = block(node->block.get());
+				Expression increment = (node->inc_expr != nullptr)
+					? expression(node->inc_expr.get())
+					: constant(Value());
+
+				contexts.back().scopes.pop_back();
+
+				statements->push_back([init, condition, body, increment](Frame &frame)
+				{
+					if (Program::execute(init, frame))
+						return true;
+
+					while (aot::truthy(condition(frame)))
+					{
+						if (Program::execute(body, frame))
+							return true;
+
+						increment(frame);
+					}
+
+					return false;
+				});
+			}
+
+			Expression ClosureCompiler::expression(AstNode *node)
+			{
+				expr = nullptr;
+				accept(node);
+
+				if (expr == nullptr)
+				{
+					// an error has been reported, the program will not run
+					return constant(Value());
+				}
+
+				Expression result = std::move(expr);
+				expr = nullptr;
+
+				return result;
+			}
+
+			Reference ClosureCompiler::reference(AstNode *node)
+			{
+				AstNode *target = node;
+				std::string moduleName;
+
+				if (node != nullptr && node->nodeType == AST_MEMBER_ACCESS)
+				{
+					auto *memberAccess = dynamic_cast<MemberAccessAst*>(node);
+					auto *leftAst = dynamic_cast<VariableAst*>(memberAccess->left.get());
+
+					target = memberAccess->right.get();
+					if (leftAst != nullptr && moduleNames.find(leftAst->name) != moduleNames.end())
+						moduleName = leftAst->name;
+					else
+						target = nullptr;
+				}
+
+				auto *variable = dynamic_cast<VariableAst*>(target);
+				if (target == nullptr || target->nodeType != AST_VARIABLE || variable == nullptr)
+				{
+					// cannot assign a value to a number or string, etc.
+					state.errors.push_back({ ILLEGAL_EXPRESSION, node ? node->location : SourceLocation(-1, -1, "") });
+					return [](Frame &frame) -> Value& { return frame.result; };
+				}
+
+				memberModule = moduleName;
+
+				int hops;
+				size_t slot;
+
+				if (!varInScope(qualify(variable, variable->name), hops, slot))
+				{
+					state.errors.push_back({ UNDECLARED_IDENTIFIER,
+						variable->location,
+						variable->name });
+					return [](Frame &frame) -> Value& { return frame.result; };
+				}
+
+				return slotReference(hops, slot);
+			}
+
+			StatementList ClosureCompiler::block(AstNode *node)
+			{
+				StatementList result;
+
+				contexts.back().scopes.push_back(Scope());
+				StatementList *lastStatements = statements;
+				statements = &result;
+
+				accept(node);
+
+				statements = lastStatements;
+				contexts.back().scopes.pop_back();
+
+				return result;
+			}
+
+			Reference ClosureCompiler::slotReference(int hops, size_t slot)
+			{
+				if (hops == 0)
+					return [slot](Frame &frame) -> Value& { return frame.slots[slot]; };
+
+				return [hops, slot](Frame &frame) -> Value&
+				{
+					Frame *owner = &frame;
+					for (int i = 0; i < hops; i++)
+						owner = owner->parent;
+
+					return owner->slots[slot];
+				};
+			}
+
+			std::string ClosureCompiler::moduleOf(AstNode *node)
+			{
+				if (!memberModule.empty())
+				{
+					// the left side of a member access named the module
+					std::string name = memberModule;
+					memberModule.clear();
+					return name;
+				}
+
+				auto *module = dynamic_cast<ModuleAst*>(node->module);
+				return (module != nullptr) ? module->moduleName : "";
+			}
+
+			std::string ClosureCompiler::qualify(AstNode *node, const std::string &name)
+			{
+				return moduleOf(node) + "." + name;
+			}
+
+			bool ClosureCompiler::varInScope(const std::string &name, int &hops, size_t &slot)
+			{
+				for (size_t c = contexts.size(); c-- > 0;)
+				{
+					auto &scopes = contexts[c].scopes;
+
+					for (size_t s = scopes.size(); s-- > 0;)
+					{
+						auto it = scopes[s].variables.find(name);
+						if (it != scopes[s].variables.end())
+						{
+							hops = (int)(contexts.size() - 1 - c);
+							slot = it->second;
+							return true;
+						}
+					}
+				}
+
+				return false;
+			}
+
+			ReturnMessage ClosureCompiler::fnInScope(const std::string &name, size_t nArgs,
+				FunctionInfo *&out, int &hops)
+			{
+				ReturnMessage status = FN_NOT_FOUND;
+
+				for (size_t c = contexts.size(); c-- > 0;)
+				{
+					auto &scopes = contexts[c].scopes;
+
+					for (size_t s = scopes.size(); s-- > 0;)
+					{
+						for (auto &&def : scopes[s].functions)
+						{
+							if (def.first != name)
+								continue;
+
+							if (def.second->numArgs == nArgs)
+							{
+								out = def.second;
+								hops = (int)(contexts.size() - 1 - c);
+								return FN_FOUND;
+							}
+							else if (def.second->numArgs < nArgs)
+								status = FN_TOO_MANY_ARGS;
+							else
+								status = FN_TOO_FEW_ARGS;
+						}
+					}
+				}
+
+				return status;
+			}
+		}
+	}
+}
@@ -0,0 +1,124 @@
+#ifndef __ZENITH_RUNTIME_CLOSURE_CLOSURE_COMPILER_H__
+#define __ZENITH_RUNTIME_CLOSURE_CLOSURE_COMPILER_H__
+
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+#include <memory>
+#include <utility>
+
+#include "program.h"
+
+#include "../../compiler/ast.h"
+#include "../../compiler/state.h"
+#include "../../compiler/emit/default_handler.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		namespace closure
+		{
+			/* Compiles a module straight from its AST into a tree of closures,
+			   without emitting bytecode. Names are resolved while compiling:
+			   variables become slot indices in the frame of the function they
+			   belong to, and calls are bound to their function. */
+			class ClosureCompiler : public compiler::AstHandler
+			{
+			private:
+				struct Scope
+				{
+					// module qualified names -> slot
+					std::map<std::string, size_t> variables;
+					std::vector<std::pair<std::string, FunctionInfo*>> functions;
+				};
+
+				// a function being compiled, the top level is the first
+				struct Context
+				{
+					FunctionInfo *fn;
+					std::vector<Scope> scopes;
+				};
+
+				std::unique_ptr<Program> program;
+				// borrowed from the parser
+				compiler::ParserState &state;
+
+				std::vector<Context> contexts;
+
+				// where the statements being compiled go
+				StatementList *statements;
+				// the last expression that was compiled
+				Expression expr;
+
+				std::map<std::string, std::unique_ptr<compiler::ModuleAst>> externalModules;
+				std::set<std::string> moduleNames;
+				// modules compiled ahead of time, imports of them are skipped
+				std::set<std::string> nativeModules;
+
+				// module named on the left of a member access, used for its right side
+				std::string memberModule;
+
+				std::string moduleOf(compiler::AstNode *node);
+				std::string qualify(compiler::AstNode *node, const std::string &name);
+
+				bool varInScope(const std::string &name, int &hops, size_t &slot);
+				compiler::ReturnMessage fnInScope(const std::string &name, size_t nArgs,
+					FunctionInfo *&out, int &hops);
+
+				Expression expression(compiler::AstNode *node);
+				Reference reference(compiler::AstNode *node);
+				StatementList block(compiler::AstNode *node);
+
+				static Reference slotReference(int hops, size_t slot);
+
+			public:
+				ClosureCompiler(compiler::ParserState &state);
+
+				void accept(compiler::ModuleAst *node);
+
+				/* Declare a function that is provided by the native binding table. A
+				   qualified one is called as module.name() and bound under its mangled name. */
+				void defineFunction(const std::string &name,
+					const std::string &moduleName,
+					size_t numArgs,
+					bool qualified = false);
+
+				compiler::ParserState &getState() { return state; }
+
+				/* The compiled program, once the module has been accepted without errors. */
+				std::unique_ptr<Program> getProgram() { return std::move(program); }
+
+			protected:
+				void accept(compiler::AstNode *node);
+				void accept(compiler::ImportsAst *node);
+				void accept(compiler::ImportAst *node);
+				void accept(compiler::StatementAst *node);
+				void accept(compiler::BlockAst *node);
+				void accept(compiler::ExpressionAst *node);
+				void accept(compiler::BinaryOperationAst *node);
+				void accept(compiler::UnaryOperationAst *node);
+				void accept(compiler::MemberAccessAst *node);
+				void accept(compiler::VariableDeclarationAst *node);
+				void accept(compiler::VariableAst *node);
+				void accept(compiler::IntegerAst *node);
+				void accept(compiler::FloatAst *node);
+				void accept(compiler::StringAst *node);
+				void accept(compiler::TrueAst *node);
+				void accept(compiler::FalseAst *node);
+				void accept(compiler::NullAst *node);
+				void accept(compiler::SelfAst *node);
+				void accept(compiler::NewAst *node);
+				void accept(compiler::FunctionDefinitionAst *node);
+				void accept(compiler::FunctionCallAst *node);
+				void accept(compiler::ClassAst *node);
+				void accept(compiler::IfStatementAst *node);
+				void accept(compiler::ReturnStatementAst *node);
+				void accept(compiler::ForLoopAst *node);
+			};
+		}
+	}
+}
+
+#endif
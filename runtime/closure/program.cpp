@@ -0,0 +1,53 @@
+#include "program.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		namespace closure
+		{
+			Program::Program()
+			{
+				main = addFunction("<main>", 0);
+			}
+
+			FunctionInfo *Program::addFunction(const std::string &name, size_t numArgs)
+			{
+				auto fn = std::make_unique<FunctionInfo>();
+				fn->name = name;
+				fn->numArgs = numArgs;
+				fn->numSlots = numArgs;
+
+				functions.push_back(std::move(fn));
+				return functions.back().get();
+			}
+
+			void Program::run()
+			{
+				call(main, nullptr, {});
+			}
+
+			Value Program::call(const FunctionInfo *fn, Frame *parent, std::vector<Value> &&args)
+			{
+				// the arguments take the first slots
+				args.resize(fn->numSlots);
+
+				Frame frame = { args.data(), parent, Value() };
+				execute(fn->body, frame);
+
+				return frame.result;
+			}
+
+			bool Program::execute(const StatementList &statements, Frame &frame)
+			{
+				for (auto &&statement : statements)
+				{
+					if (statement(frame))
+						return true;
+				}
+
+				return false;
+			}
+		}
+	}
+}
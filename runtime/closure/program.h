@@ -0,0 +1,73 @@
+#ifndef __ZENITH_RUNTIME_CLOSURE_PROGRAM_H__
+#define __ZENITH_RUNTIME_CLOSURE_PROGRAM_H__
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+
+#include "../../compiler/extra/zen2cpp/zen2cpp_runtime.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		namespace closure
+		{
+			using aot::Value;
+
+			/* Activation of a function. Variables live in slots that were
+			   assigned when the function was compiled; 'parent' is the frame of
+			   the function the running one was defined in. */
+			struct Frame
+			{
+				Value *slots;
+				Frame *parent;
+
+				Value result;
+			};
+
+			typedef std::function<Value(Frame &frame)> Expression;
+			typedef std::function<Value &(Frame &frame)> Reference;
+			/* Returns true when the function returns, with the value in Frame::result. */
+			typedef std::function<bool(Frame &frame)> Statement;
+
+			typedef std::vector<Statement> StatementList;
+
+			struct FunctionInfo
+			{
+				std::string name;
+				size_t numArgs = 0;
+				size_t numSlots = 0;
+
+				StatementList body;
+
+				bool isNative = false;
+				aot::NativeFunction native = nullptr;
+			};
+
+			/* A module compiled to closures, ready to run. */
+			class Program
+			{
+			private:
+				std::vector<std::unique_ptr<FunctionInfo>> functions;
+				FunctionInfo *main;
+
+			public:
+				Program();
+
+				FunctionInfo *getMain() const { return main; }
+				FunctionInfo *addFunction(const std::string &name, size_t numArgs);
+
+				/* Run the top level statements. */
+				void run();
+
+				/* Call 'fn' with the arguments in 'args', in a frame whose parent is 'parent'. */
+				static Value call(const FunctionInfo *fn, Frame *parent, std::vector<Value> &&args);
+				static bool execute(const StatementList &statements, Frame &frame);
+			};
+		}
+	}
+}
+
+#endif
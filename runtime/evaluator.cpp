@@ -7,9 +7,9 @@ namespace zenith
 {
 	namespace runtime
 	{
-		void Evaluator::push(ExpressionStack &whereTo)
+		void Evaluator::push(ExpressionStack &whereTo, bool checked)
 		{
-			if (exprStack.size() == 0)
+			if (checked && exprStack.size() == 0)
 				throw std::runtime_error("Empty stack");
 
 			auto &res = exprStack.top();
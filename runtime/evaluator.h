@@ -26,7 +26,9 @@ namespace zenith
 		public:
 			ExpressionStack &getStack() { return exprStack; }
 
-			void push(ExpressionStack &whereTo);
+			/* Push the result to 'whereTo' and clear the stack. Verified code
+			   always has a result, so it need not be checked for. */
+			void push(ExpressionStack &whereTo, bool checked = true);
 			void clear();
 
 			void loadInteger(long value);
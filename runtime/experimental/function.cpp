@@ -3,6 +3,8 @@
 #include "../module.h"
 #include "../bytereader.h"
 #include "../vm.h"
+#include "../jit/baseline_jit.h"
+#include "../jit/tier_manager.h"
 
 namespace zenith
 {
@@ -11,26 +13,81 @@ namespace zenith
 		Function::Function(unsigned long loc)
 		{
 			this->loc = loc;
+
+			calls = 0;
+			backEdges = 0;
+
+			compiled = nullptr;
+			jitAttempted = false;
+
+			tier = nullptr;
+		}
+
+		void Function::countBackEdge()
+		{
+			backEdges++;
+
+			if (tier != nullptr)
+				tier->backEdges++;
 		}
 
 		void Function::invoke(VMState *state)
 		{
+			calls++;
+
+			jit::QuickenedCode *quickened = nullptr;
+
+			auto *tiers = state->vm->getTiers();
+			if (tiers != nullptr)
+			{
+				if (tier == nullptr)
+					tier = tiers->getFunction(loc);
+
+				tiers->onCall(state, *tier);
+
+				compiled = tier->compiled;
+				quickened = tier->quickened.get();
+			}
+			else
+			{
+				auto *jit = state->vm->getJit();
+				if (jit != nullptr && !jitAttempted && jit->shouldCompile(calls, backEdges))
+				{
+					compiled = jit->compile(state, loc);
+					jitAttempted = true;
+				}
+			}
+
 			state->module->pushFunctionChain(state->stream->position());
 			state->readLevel++;
 
-			state->stream->seek(loc);
+			Function *caller = state->function;
+			state->function = this;
 
-			// read instructions till function is completed
-			while (state->stream != nullptr &&
-				(state->stream->position() < state->stream->max()))
+			if (compiled != nullptr)
+			{
+				compiled->run(state->vm, state->module);
+			}
+			else if (quickened != nullptr)
 			{
-				int32_t ins;
-				state->stream->read(&ins);
-				state->vm->handleInstruction((Instruction)ins, state->module);
-				
-				if (ins == CMD_LEAVE_FUNCTION)
-					break;
+				quickened->run(state->vm, state->module, 0);
 			}
+			else
+			{
+				state->stream->seek(loc);
+
+				// read instructions till function is completed
+				while (state->stream != nullptr &&
+					(state->stream->position() < state->stream->max()))
+				{
+					Instruction ins = state->vm->handleInstruction(state->module);
+
+					if (ins == CMD_LEAVE_FUNCTION)
+						break;
+				}
+			}
+
+			state->function = caller;
 		}
 
 		unsigned long Function::location() const
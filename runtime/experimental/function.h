@@ -10,16 +10,34 @@ namespace zenith
 {
 	namespace runtime
 	{
+		namespace jit
+		{
+			class CompiledFunction;
+			struct FunctionTier;
+		}
+
 		class Function : public Object
 		{
 		private:
 			unsigned long loc;
 
+			// hotness counters used to decide when to compile
+			unsigned long calls;
+			unsigned long backEdges;
+
+			jit::CompiledFunction *compiled;
+			bool jitAttempted;
+
+			// set when tiered execution is enabled
+			jit::FunctionTier *tier;
+
 		public:
 			Function(unsigned long);
 
 			void invoke(VMState *state);
 			unsigned long location() const;
+
+			void countBackEdge();
 		};
 
 		typedef std::shared_ptr<Function> FunctionPtr;
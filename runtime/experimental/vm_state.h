@@ -10,6 +10,7 @@ namespace zenith
 		class VM;
 		class Module;
 		class ByteReader;
+		class Function;
 
 		struct VMState
 		{
@@ -18,6 +19,9 @@ namespace zenith
 			VM *vm;
 			Module *module;
 
+			// the function currently being executed, if any
+			Function *function;
+
 			int readLevel = -1;
 
 			VMState()
@@ -25,6 +29,7 @@ namespace zenith
 				stream = nullptr;
 				vm = nullptr;
 				module = nullptr;
+				function = nullptr;
 			}
 
 			VMState(ByteReader *stream)
@@ -32,6 +37,7 @@ namespace zenith
 				this->stream = stream;
 				vm = nullptr;
 				module = nullptr;
+				function = nullptr;
 			}
 		};
 	}
@@ -46,6 +46,23 @@ namespace zenith
 			throw std::runtime_error("Value does not exist");
 		}
 
+		ObjectPtr *StackFrame::findLocal(const std::string &identifier)
+		{
+			auto elt = std::find_if(locals.begin(), locals.end(),
+				[&identifier](const std::pair<std::string, ObjectPtr> &element)
+			{
+				return element.first == identifier;
+			});
+
+			if (elt == locals.end())
+				return nullptr;
+
+			if (elt->second != nullptr)
+				return &elt->second;
+
+			throw std::runtime_error("Value does not exist");
+		}
+
 		ObjectPtr StackFrame::createLocal(const std::string &identifier)
 		{
 			#if VALUE_SEARCH_CHECKS
@@ -37,6 +37,8 @@ namespace zenith
 
 			bool hasLocal(const std::string &identifier);
 			ObjectPtr &getLocal(const std::string &identifier);
+			// like getLocal, in one search, but nullptr when there is no such local
+			ObjectPtr *findLocal(const std::string &identifier);
 			ObjectPtr createLocal(const std::string &identifier);
 			ObjectPtr createFunction(const std::string &identifier, unsigned long position);
 			void clearLocal(const std::string &identifier);
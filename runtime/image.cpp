@@ -0,0 +1,337 @@
+#include "image.h"
+#include "bytereader.h"
+
+#include "../util/lz.h"
+#include "../util/sha256.h"
+
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace zenith
+{
+	namespace runtime
+	{
+		BytecodeImage::BytecodeImage()
+		{
+			data = nullptr;
+			size = 0;
+			mapping = nullptr;
+			mappingSize = 0;
+
+			code = nullptr;
+			codeSize = 0;
+			functions = nullptr;
+			numFunctions = 0;
+			debugInfo = nullptr;
+			imports = nullptr;
+			numImports = 0;
+		}
+
+		BytecodeImage::~BytecodeImage()
+		{
+			if (mapping != nullptr)
+			{
+#ifdef _WIN32
+				UnmapViewOfFile(mapping);
+#else
+				munmap(mapping, mappingSize);
+#endif
+			}
+		}
+
+		std::unique_ptr<BytecodeImage> BytecodeImage::open(const std::string &path, std::string &error)
+		{
+			std::unique_ptr<BytecodeImage> image(new BytecodeImage());
+
+#ifdef _WIN32
+			HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+				OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE)
+			{
+				error = "Could not open file: " + path;
+				return nullptr;
+			}
+
+			LARGE_INTEGER fileSize;
+			GetFileSizeEx(file, &fileSize);
+
+			HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			CloseHandle(file);
+			if (mapping == nullptr)
+			{
+				error = "Could not map file: " + path;
+				return nullptr;
+			}
+
+			image->mapping = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+			image->mappingSize = (size_t)fileSize.QuadPart;
+#else
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0)
+			{
+				error = "Could not open file: " + path;
+				return nullptr;
+			}
+
+			struct stat st;
+			if (fstat(fd, &st) != 0 || st.st_size == 0)
+			{
+				::close(fd);
+				error = "Not a bytecode image: " + path;
+				return nullptr;
+			}
+
+			// pages are shared between every process running the same image
+			void *mapped = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			::close(fd);
+
+			image->mapping = (mapped != MAP_FAILED) ? mapped : nullptr;
+			image->mappingSize = (size_t)st.st_size;
+#endif
+
+			if (image->mapping == nullptr)
+			{
+				error = "Could not map file: " + path;
+				return nullptr;
+			}
+
+			image->data = (const char*)image->mapping;
+			image->size = image->mappingSize;
+
+			if (!image->validate(error))
+				return nullptr;
+
+			return image;
+		}
+
+		std::unique_ptr<BytecodeImage> BytecodeImage::fromMemory(std::string bytes, std::string &error)
+		{
+			std::unique_ptr<BytecodeImage> image(new BytecodeImage());
+
+			image->bytes = std::move(bytes);
+			image->data = image->bytes.data();
+			image->size = image->bytes.size();
+
+			if (!image->validate(error))
+				return nullptr;
+
+			return image;
+		}
+
+		bool BytecodeImage::isImage(const char *data, size_t size)
+		{
+			return size >= sizeof(ImageHeader) && std::memcmp(data, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) == 0;
+		}
+
+		std::string BytecodeImage::digest() const
+		{
+			return util::sha256Hex(data, size);
+		}
+
+		bool BytecodeImage::validate(std::string &error)
+		{
+			if (!isImage(data, size))
+			{
+				error = "Not a bytecode image";
+				return false;
+			}
+
+			auto *header = (const ImageHeader*)data;
+
+			if (header->byteOrder != IMAGE_BYTE_ORDER)
+			{
+				error = "Bytecode image was written on a machine of a different byte order";
+				return false;
+			}
+			if (header->version != IMAGE_VERSION)
+			{
+				error = "Unsupported bytecode image version: " + std::to_string(header->version);
+				return false;
+			}
+
+			size_t tableEnd = sizeof(ImageHeader) + (size_t)header->numSections * sizeof(SectionEntry);
+			if (header->size != size || tableEnd > size)
+			{
+				error = "Bytecode image is truncated";
+				return false;
+			}
+
+			auto *sections = (const SectionEntry*)(data + sizeof(ImageHeader));
+
+			for (uint32_t i = 0; i < header->numSections; i++)
+			{
+				const SectionEntry &section = sections[i];
+
+				if (section.offset % IMAGE_ALIGNMENT != 0 ||
+					section.offset > size || section.size > size - section.offset)
+				{
+					error = "Bytecode image has a bad section";
+					return false;
+				}
+
+				const char *start = data + section.offset;
+				uint64_t sectionSize = section.size;
+
+				if (section.flags & SECTION_COMPRESSED)
+				{
+					CompressedSection prefix;
+					if (sectionSize < sizeof(prefix))
+					{
+						error = "Bytecode image has a bad compressed section";
+						return false;
+					}
+					std::memcpy(&prefix, start, sizeof(prefix));
+
+					// no sequence expands to more than 255 times its size
+					uint64_t packedSize = sectionSize - sizeof(prefix);
+					if (prefix.rawSize > packedSize * 255)
+					{
+						error = "Bytecode image has a bad compressed section";
+						return false;
+					}
+
+					std::unique_ptr<char[]> raw(new char[(size_t)prefix.rawSize + 1]);
+					if (!util::lz::decompress(start + sizeof(prefix), (size_t)packedSize, raw.get(), (size_t)prefix.rawSize))
+					{
+						error = "Bytecode image has a bad compressed section";
+						return false;
+					}
+
+					start = raw.get();
+					sectionSize = prefix.rawSize;
+					decompressed.push_back(std::move(raw));
+				}
+
+				switch (section.type)
+				{
+				case SECTION_CODE:
+					code = start;
+					codeSize = (size_t)sectionSize;
+					break;
+				case SECTION_FUNCTIONS:
+					if (sectionSize % sizeof(FunctionEntry) != 0)
+					{
+						error = "Bytecode image has a bad function table";
+						return false;
+					}
+
+					functions = (const FunctionEntry*)start;
+					numFunctions = (size_t)(sectionSize / sizeof(FunctionEntry));
+					break;
+				case SECTION_CONSTANTS:
+				{
+					uint32_t count = 0;
+					if (sectionSize >= sizeof(uint32_t))
+						std::memcpy(&count, start, sizeof(uint32_t));
+
+					if (sectionSize < sizeof(uint32_t) * (1 + (uint64_t)count))
+					{
+						error = "Bytecode image has a bad constant pool";
+						return false;
+					}
+
+					auto *offsets = (const uint32_t*)(start + sizeof(uint32_t));
+					for (uint32_t c = 0; c < count; c++)
+					{
+						if (offsets[c] >= sectionSize)
+						{
+							error = "Bytecode image has a bad constant pool";
+							return false;
+						}
+					}
+
+					// the pool ends with a terminator, so the last string is bounded
+					if (count != 0 && start[sectionSize - 1] != '\0')
+					{
+						error = "Bytecode image has a bad constant pool";
+						return false;
+					}
+
+					constants = ConstantPool(start, offsets, count);
+					break;
+				}
+				case SECTION_DEBUG:
+					if (sectionSize < sizeof(DebugInfo))
+					{
+						error = "Bytecode image has a bad debug section";
+						return false;
+					}
+
+					debugInfo = (const DebugInfo*)start;
+					break;
+				case SECTION_IMPORTS:
+					imports = (const ImportEntry*)start;
+					numImports = (size_t)(sectionSize / sizeof(ImportEntry));
+					break;
+				default:
+					// unknown sections are skipped, newer writers may add some
+					break;
+				}
+			}
+
+			if (code == nullptr)
+			{
+				error = "Bytecode image has no code";
+				return false;
+			}
+
+			// every index into the pool and position in the code is checked here, once
+			for (size_t i = 0; i < numImports; i++)
+			{
+				if (imports[i].path >= constants.size())
+				{
+					error = "Bytecode image has a bad import table";
+					return false;
+				}
+			}
+
+			for (size_t i = 0; i < numFunctions; i++)
+			{
+				if (functions[i].name >= constants.size() || functions[i].position > codeSize ||
+					(i != 0 && functions[i].position <= functions[i - 1].position))
+				{
+					error = "Bytecode image has a bad function table";
+					return false;
+				}
+			}
+
+			if (debugInfo != nullptr &&
+				(debugInfo->sourcePath >= constants.size() || debugInfo->moduleName >= constants.size()))
+			{
+				error = "Bytecode image has a bad debug section";
+				return false;
+			}
+
+			return true;
+		}
+
+		const FunctionEntry *BytecodeImage::findFunction(uint64_t position) const
+		{
+			auto *end = functions + numFunctions;
+			auto *it = std::lower_bound(functions, end, position, [](const FunctionEntry &entry, uint64_t pos)
+			{
+				return entry.position < pos;
+			});
+
+			return (it != end && it->position == position) ? it : nullptr;
+		}
+
+		std::unique_ptr<ByteReader> BytecodeImage::createReader() const
+		{
+			auto reader = std::make_unique<MemoryByteReader>(code, codeSize);
+			reader->setConstants(&constants);
+
+			return reader;
+		}
+	}
+}
@@ -0,0 +1,174 @@
+#ifndef __ZENITH_RUNTIME_IMAGE_H__
+#define __ZENITH_RUNTIME_IMAGE_H__
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+namespace zenith
+{
+	namespace runtime
+	{
+		class ByteReader;
+
+		/* Bytecode image layout. Everything is stored in the byte order of the
+		   machine that wrote it, and sections start on IMAGE_ALIGNMENT so that a
+		   mapped image can be used in place:
+
+		     ImageHeader
+		     SectionEntry[numSections]
+		     sections...
+		*/
+		const char IMAGE_MAGIC[4] = { 'Z', 'E', 'N', 'I' };
+		const uint16_t IMAGE_VERSION = 1;
+		// reads back as 0x0201 on a machine of the other byte order
+		const uint16_t IMAGE_BYTE_ORDER = 0x0102;
+		const size_t IMAGE_ALIGNMENT = 16;
+
+		enum SectionType
+		{
+			SECTION_CODE = 1, // instruction stream, positions are relative to its start
+			SECTION_FUNCTIONS, // FunctionEntry[]
+			SECTION_CONSTANTS, // uint32 count, uint32 offsets[count], nul terminated strings
+			SECTION_DEBUG, // DebugInfo
+			SECTION_IMPORTS // ImportEntry[], of object images
+		};
+
+		enum ImageFlags
+		{
+			// compiled from one module with its imports left out, see compiler::Linker
+			IMAGE_OBJECT = 1
+		};
+
+		enum SectionFlags
+		{
+			// the section is a CompressedSection followed by util::lz data
+			SECTION_COMPRESSED = 1
+		};
+
+		struct CompressedSection
+		{
+			uint64_t rawSize;
+		};
+
+		struct ImageHeader
+		{
+			char magic[4];
+			uint16_t version;
+			uint16_t byteOrder;
+			uint32_t numSections;
+			uint32_t flags;
+			uint64_t size;
+			uint64_t reserved;
+		};
+
+		struct SectionEntry
+		{
+			uint32_t type;
+			uint32_t flags;
+			uint64_t offset;
+			uint64_t size;
+		};
+
+		struct FunctionEntry
+		{
+			uint64_t position; // of the function body in the code section
+			uint32_t name; // constant index
+			uint32_t reserved;
+		};
+
+		struct ImportEntry
+		{
+			uint32_t path; // constant index, the imported source file
+			uint32_t reserved;
+		};
+
+		struct DebugInfo
+		{
+			uint32_t sourcePath; // constant index
+			uint32_t moduleName; // constant index
+		};
+
+		/* View of the constant pool, strings are read straight from the image. */
+		class ConstantPool
+		{
+		private:
+			const char *base;
+			const uint32_t *offsets;
+			uint32_t count;
+
+		public:
+			ConstantPool() : base(nullptr), offsets(nullptr), count(0) {}
+			ConstantPool(const char *base, const uint32_t *offsets, uint32_t count)
+				: base(base), offsets(offsets), count(count) {}
+
+			uint32_t size() const { return count; }
+			const char *get(uint32_t index) const { return base + offsets[index]; }
+		};
+
+		/* A bytecode image, either mapped from a file or held in memory.
+		   Compressed sections are decompressed once, when it is loaded. */
+		class BytecodeImage
+		{
+		private:
+			std::string bytes; // owned contents, when not mapped
+			std::vector<std::unique_ptr<char[]>> decompressed;
+			const char *data;
+			size_t size;
+
+			void *mapping;
+			size_t mappingSize;
+
+			const char *code;
+			size_t codeSize;
+			const FunctionEntry *functions;
+			size_t numFunctions;
+			const DebugInfo *debugInfo;
+			const ImportEntry *imports;
+			size_t numImports;
+			ConstantPool constants;
+
+			BytecodeImage();
+
+			bool validate(std::string &error);
+
+		public:
+			~BytecodeImage();
+
+			/* Map an image file read-only. Returns nullptr and sets 'error' on failure. */
+			static std::unique_ptr<BytecodeImage> open(const std::string &path, std::string &error);
+			/* Use an image that is already in memory, e.g. straight from the emitter. */
+			static std::unique_ptr<BytecodeImage> fromMemory(std::string bytes, std::string &error);
+
+			static bool isImage(const char *data, size_t size);
+
+			/* SHA-256 of the image as it is stored, in hex, to recognize one that was seen before. */
+			std::string digest() const;
+
+			const char *getCode() const { return code; }
+			size_t getCodeSize() const { return codeSize; }
+
+			// in the order of the code, names and positions are checked when the image is loaded
+			const FunctionEntry *getFunctions() const { return functions; }
+			size_t getNumFunctions() const { return numFunctions; }
+			/* The function whose body starts at 'position', or nullptr. */
+			const FunctionEntry *findFunction(uint64_t position) const;
+
+			const ConstantPool &getConstants() const { return constants; }
+
+			/* An object image has to be linked with the modules it imports before it can run. */
+			bool isObject() const { return (((const ImageHeader*)data)->flags & IMAGE_OBJECT) != 0; }
+			const ImportEntry *getImports() const { return imports; }
+			size_t getNumImports() const { return numImports; }
+
+			// nullptr when the image was written without debug information
+			const DebugInfo *getDebugInfo() const { return debugInfo; }
+
+			/* A reader over the code section, resolving strings through the constant pool. */
+			std::unique_ptr<ByteReader> createReader() const;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,386 @@
+#include "instruction.h"
+#include "bytereader.h"
+#include "image.h"
+
+#include <cstring>
+
+namespace zenith
+{
+	namespace runtime
+	{
+		bool InstructionDecoder::readHeader(ByteReader *stream)
+		{
+			auto start = stream->position();
+
+			if (stream->max() - start > (std::streamoff)sizeof(BYTECODE_MAGIC))
+			{
+				char magic[sizeof(BYTECODE_MAGIC)];
+				stream->read(magic, sizeof(magic));
+
+				if (std::memcmp(magic, BYTECODE_MAGIC, sizeof(magic)) == 0)
+				{
+					uint8_t version;
+					stream->read(&version);
+
+					if (version != ENCODING_FIXED && version != ENCODING_COMPACT && version != ENCODING_POOLED)
+						return false;
+
+					// pooled strings can only be resolved through an image
+					if (version == ENCODING_POOLED && stream->getConstants() == nullptr)
+						return false;
+
+					stream->setEncoding((BytecodeEncoding)version);
+					return true;
+				}
+			}
+
+			// no header, written before the encoding was recorded
+			stream->seek((unsigned long)start);
+			stream->setEncoding(ENCODING_FIXED);
+
+			return true;
+		}
+
+		bool InstructionDecoder::next(ByteReader *stream, DecodedInstruction &d, bool active)
+		{
+			d.position = stream->position();
+
+			if (stream->getEncoding() != ENCODING_FIXED)
+			{
+				uint8_t opcode;
+				stream->read(&opcode);
+
+				if (opcode >= COMPACT_LOAD_SMALL_INT)
+				{
+					d.ins = CMD_LOAD_INTEGER;
+					d.intValue = opcode - COMPACT_LOAD_SMALL_INT;
+					d.next = stream->position();
+
+					return true;
+				}
+
+				d.ins = (Instruction)(CMD_INC_BLOCK_LEVEL + opcode);
+			}
+			else
+			{
+				int32_t ins;
+				stream->read(&ins);
+				d.ins = (Instruction)ins;
+			}
+
+			// an operand that ran past the end of the code is not an instruction
+			if (!decode(stream, d, active) || stream->eof())
+				return false;
+
+			d.next = stream->position();
+			return true;
+		}
+
+		bool InstructionDecoder::readString(ByteReader *stream, std::string &out, bool active)
+		{
+			if (stream->getEncoding() == ENCODING_POOLED)
+			{
+				uint32_t index = readVarint(stream);
+				const ConstantPool *constants = stream->getConstants();
+
+				if (stream->eof() || index >= constants->size())
+					return false;
+
+				if (active)
+					out = constants->get(index);
+
+				return true;
+			}
+
+			size_t len;
+			if (stream->getEncoding() == ENCODING_COMPACT)
+				len = readVarint(stream);
+			else
+			{
+				int32_t fixedLen;
+				stream->read(&fixedLen);
+
+				// the terminator is included
+				if (fixedLen <= 0)
+					return false;
+				len = (size_t)fixedLen;
+			}
+
+			if (stream->eof() || len > (size_t)(stream->max() - stream->position()))
+				return false;
+
+			if (active)
+			{
+				out.resize(len);
+				if (len != 0)
+					stream->read(&out[0], (unsigned)len);
+
+				if (stream->getEncoding() == ENCODING_FIXED)
+					out.resize(std::strlen(out.c_str()));
+			}
+			else
+				stream->skip((unsigned)len);
+
+			return true;
+		}
+
+		uint32_t InstructionDecoder::readVarint(ByteReader *stream)
+		{
+			uint32_t result = 0;
+			int shift = 0;
+			uint8_t byte;
+
+			do
+			{
+				// at the end the byte reads as zero, and the caller sees eof
+				stream->read(&byte);
+				result |= (uint32_t)(byte & 0x7F) << shift;
+				shift += 7;
+			} while ((byte & 0x80) && shift < 35 && !stream->eof());
+
+			return result;
+		}
+
+		int64_t InstructionDecoder::readSignedVarint(ByteReader *stream)
+		{
+			int64_t result = 0;
+			int shift = 0;
+			uint8_t byte;
+
+			do
+			{
+				stream->read(&byte);
+				result |= (int64_t)(byte & 0x7F) << shift;
+				shift += 7;
+			} while ((byte & 0x80) && shift < 70 && !stream->eof());
+
+			// sign extend
+			if (shift < 64 && (byte & 0x40))
+				result |= -((int64_t)1 << shift);
+
+			return result;
+		}
+
+		int32_t InstructionDecoder::readInt(ByteReader *stream)
+		{
+			return (int32_t)readVarint(stream);
+		}
+
+		bool InstructionDecoder::decode(ByteReader *stream, DecodedInstruction &d, bool active)
+		{
+			if (stream->getEncoding() != ENCODING_FIXED)
+				return decodeCompact(stream, d, active);
+
+			switch (d.ins)
+			{
+			case Instruction::CMD_INC_BLOCK_LEVEL:
+			case Instruction::CMD_DEC_BLOCK_LEVEL:
+			case Instruction::CMD_INC_READ_LEVEL:
+			case Instruction::CMD_DEC_READ_LEVEL:
+			case Instruction::CMD_PUSH_FUNCTION_CHAIN:
+			case Instruction::CMD_POP_FUNCTION_CHAIN:
+			case Instruction::CMD_INVOKE:
+			case Instruction::CMD_LEAVE_FUNCTION:
+			case Instruction::CMD_IF_STATEMENT:
+			case Instruction::CMD_ELSE_STATEMENT:
+			case Instruction::CMD_LEAVE_BLOCK:
+			case Instruction::CMD_LEAVE_IF_STATEMENT:
+			case Instruction::CMD_LEAVE_ELSE_STATEMENT:
+			case Instruction::CMD_LOAD_NULL:
+			case Instruction::CMD_OP_CLEAR:
+			case Instruction::CMD_OP_UNARY_NEG:
+			case Instruction::CMD_OP_UNARY_POS:
+			case Instruction::CMD_OP_UNARY_NOT:
+			case Instruction::CMD_OP_ADD:
+			case Instruction::CMD_OP_SUB:
+			case Instruction::CMD_OP_MUL:
+			case Instruction::CMD_OP_DIV:
+			case Instruction::CMD_OP_MOD:
+			case Instruction::CMD_OP_AND:
+			case Instruction::CMD_OP_OR:
+			case Instruction::CMD_OP_EQL:
+			case Instruction::CMD_OP_NEQL:
+			case Instruction::CMD_OP_LT:
+			case Instruction::CMD_OP_GT:
+			case Instruction::CMD_OP_LTE:
+			case Instruction::CMD_OP_GTE:
+			case Instruction::CMD_OP_ASSIGN:
+			case Instruction::CMD_OP_ADD_ASSIGN:
+			case Instruction::CMD_OP_SUB_ASSIGN:
+			case Instruction::CMD_OP_MUL_ASSIGN:
+			case Instruction::CMD_OP_DIV_ASSIGN:
+				// no operands
+				break;
+			case Instruction::CMD_CREATE_BLOCK:
+				// block positions are always registered, so always read
+				stream->read(&d.arg0);
+				stream->read(&d.arg1);
+				stream->read(&d.arg2);
+				stream->read(&d.blockPos);
+				break;
+			case Instruction::CMD_CREATE_FUNCTION:
+				if (!readString(stream, d.name, active))
+					return false;
+				if (active)
+					stream->read(&d.blockPos);
+				else
+					stream->skip(sizeof(uint64_t));
+				break;
+			case Instruction::CMD_STACK_POP_OBJECT:
+			case Instruction::CMD_CREATE_VAR:
+				if (active)
+					stream->read(&d.arg0);
+				else
+					stream->skip(sizeof(int32_t));
+				if (!readString(stream, d.name, active))
+					return false;
+				break;
+			case Instruction::CMD_GO_TO_BLOCK:
+			case Instruction::CMD_GO_TO_IF_TRUE:
+			case Instruction::CMD_GO_TO_IF_FALSE:
+			case Instruction::CMD_LOOP_BREAK:
+			case Instruction::CMD_LOOP_CONTINUE:
+			case Instruction::CMD_OP_PUSH:
+				if (active)
+					stream->read(&d.arg0);
+				else
+					stream->skip(sizeof(int32_t));
+				break;
+			case Instruction::CMD_CALL_NATIVE_FUNCTION:
+				if (active)
+				{
+					stream->read(&d.arg0);
+					stream->read(&d.arg1);
+				}
+				else
+					stream->skip(sizeof(int32_t) * 2);
+				if (!readString(stream, d.name, active))
+					return false;
+				break;
+			case Instruction::CMD_CREATE_NATIVE_CLASS_INSTANCE:
+			case Instruction::CMD_ADD_MEMBER:
+			case Instruction::CMD_LOAD_MEMBER:
+			case Instruction::CMD_CLEAR_VAR:
+			case Instruction::CMD_DELETE_VAR:
+			case Instruction::CMD_LOAD_STRING:
+			case Instruction::CMD_LOAD_VARIABLE:
+				if (!readString(stream, d.name, active))
+					return false;
+				break;
+			case Instruction::CMD_LOAD_INTEGER:
+				if (active)
+					stream->read(&d.intValue);
+				else
+					stream->skip(sizeof(long));
+				break;
+			case Instruction::CMD_LOAD_FLOAT:
+				if (active)
+					stream->read(&d.floatValue);
+				else
+					stream->skip(sizeof(double));
+				break;
+			default:
+				return false;
+			}
+
+			return true;
+		}
+
+		bool InstructionDecoder::decodeCompact(ByteReader *stream, DecodedInstruction &d, bool active)
+		{
+			// varints have to be read to be skipped, so 'active' only saves building strings
+			switch (d.ins)
+			{
+			case Instruction::CMD_CREATE_BLOCK:
+				d.arg0 = readInt(stream);
+				d.arg1 = readInt(stream);
+				d.arg2 = readInt(stream);
+				// the block starts right after its CREATE_BLOCK
+				d.blockPos = stream->position();
+				break;
+			case Instruction::CMD_CREATE_FUNCTION:
+				if (!readString(stream, d.name, active))
+					return false;
+				// so does the body of a function
+				d.blockPos = stream->position();
+				break;
+			case Instruction::CMD_STACK_POP_OBJECT:
+			case Instruction::CMD_CREATE_VAR:
+				d.arg0 = readInt(stream);
+				if (!readString(stream, d.name, active))
+					return false;
+				break;
+			case Instruction::CMD_GO_TO_BLOCK:
+			case Instruction::CMD_GO_TO_IF_TRUE:
+			case Instruction::CMD_GO_TO_IF_FALSE:
+			case Instruction::CMD_LOOP_BREAK:
+			case Instruction::CMD_LOOP_CONTINUE:
+			case Instruction::CMD_OP_PUSH:
+				d.arg0 = readInt(stream);
+				break;
+			case Instruction::CMD_CALL_NATIVE_FUNCTION:
+				d.arg0 = readInt(stream);
+				d.arg1 = readInt(stream);
+				if (!readString(stream, d.name, active))
+					return false;
+				break;
+			case Instruction::CMD_CREATE_NATIVE_CLASS_INSTANCE:
+			case Instruction::CMD_ADD_MEMBER:
+			case Instruction::CMD_LOAD_MEMBER:
+			case Instruction::CMD_CLEAR_VAR:
+			case Instruction::CMD_DELETE_VAR:
+			case Instruction::CMD_LOAD_STRING:
+			case Instruction::CMD_LOAD_VARIABLE:
+				if (!readString(stream, d.name, active))
+					return false;
+				break;
+			case Instruction::CMD_LOAD_INTEGER:
+				d.intValue = (long)readSignedVarint(stream);
+				break;
+			case Instruction::CMD_LOAD_FLOAT:
+				if (active)
+					stream->read(&d.floatValue);
+				else
+					stream->skip(sizeof(double));
+				break;
+			default:
+				// the remaining instructions have no operands
+				return (d.ins >= CMD_INC_BLOCK_LEVEL && d.ins <= CMD_OP_DIV_ASSIGN &&
+					d.ins != CMD_ADD_PROPERTY && d.ins != CMD_PUSH_PROPERTY);
+			}
+
+			return true;
+		}
+
+		bool InstructionDecoder::decodeRange(ByteReader *stream, uint64_t start, uint64_t end,
+			std::vector<DecodedInstruction> &out)
+		{
+			auto savedPos = stream->position();
+			stream->seek((unsigned long)start);
+
+			bool completed = false;
+
+			while (stream->position() < stream->max() &&
+				(end == 0 || (uint64_t)stream->position() < end))
+			{
+				DecodedInstruction d;
+				if (!next(stream, d))
+					break;
+
+				out.push_back(d);
+
+				if (end == 0 && d.ins == CMD_LEAVE_FUNCTION)
+				{
+					completed = true;
+					break;
+				}
+			}
+
+			if (end != 0)
+				completed = ((uint64_t)stream->position() == end);
+
+			stream->seek((unsigned long)savedPos);
+			return completed;
+		}
+	}
+}
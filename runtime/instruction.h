@@ -0,0 +1,71 @@
+#ifndef __ZENITH_RUNTIME_INSTRUCTION_H__
+#define __ZENITH_RUNTIME_INSTRUCTION_H__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "../enums.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		class ByteReader;
+
+		/* An instruction with its operands already read from the stream.
+		   The meaning of the generic operands depends on the instruction:
+		     arg0 - block id, stack id, variable type or levels to skip
+		     arg1 - block type or number of arguments
+		     arg2 - parent block id */
+		struct DecodedInstruction
+		{
+			Instruction ins = CMD_NONE;
+
+			int32_t arg0 = 0;
+			int32_t arg1 = 0;
+			int32_t arg2 = 0;
+			uint64_t blockPos = 0;
+
+			long intValue = 0;
+			double floatValue = 0.0;
+			std::string name;
+
+			uint64_t position = 0; // stream position of the instruction itself
+			uint64_t next = 0; // stream position of the following instruction
+		};
+
+		class InstructionDecoder
+		{
+		public:
+			/* Read the bytecode header, if there is one, and select the decoder
+			   for the stream. Returns false if the encoding is not supported. */
+			static bool readHeader(ByteReader *stream);
+
+			/* Read the instruction at the stream position with its operands,
+			   filling in d.position and d.next. */
+			static bool next(ByteReader *stream, DecodedInstruction &d, bool active = true);
+
+			/* Read the operands of d.ins from the stream. When 'active' is false,
+			   operands that would not be used are skipped instead of read.
+			   Returns false if the instruction is not recognized. */
+			static bool decode(ByteReader *stream, DecodedInstruction &d, bool active = true);
+
+			/* Decode the instructions from 'start' up to 'end'. When 'end' is 0,
+			   decoding stops after the first LEAVE_FUNCTION, which is where
+			   Function::invoke stops. The stream position is restored.
+			   Returns false if the range could not be decoded. */
+			static bool decodeRange(ByteReader *stream, uint64_t start, uint64_t end,
+				std::vector<DecodedInstruction> &out);
+
+		private:
+			static bool readString(ByteReader *stream, std::string &out, bool active);
+			static uint32_t readVarint(ByteReader *stream);
+			static int64_t readSignedVarint(ByteReader *stream);
+			static int32_t readInt(ByteReader *stream);
+			static bool decodeCompact(ByteReader *stream, DecodedInstruction &d, bool active);
+		};
+	}
+}
+
+#endif
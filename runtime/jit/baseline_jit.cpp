@@ -0,0 +1,224 @@
+#include "baseline_jit.h"
+#include "x64_emitter.h"
+
+#include "../vm.h"
+#include "../module.h"
+#include "../bytereader.h"
+#include "../experimental/vm_state.h"
+
+#include "../../util/logger.h"
+
+namespace zenith
+{
+	using namespace util;
+
+	namespace runtime
+	{
+		namespace jit
+		{
+			void CompiledFunction::run(VM *vm, Module *module) const
+			{
+				std::vector<TemplateSlot> slots(numSlots);
+				((EntryPoint)memory.data())(vm, module, slots.data());
+			}
+
+			BaselineJit::BaselineJit(const JitOptions &options)
+			{
+				this->options = options;
+				compiledCount = 0;
+			}
+
+			bool BaselineJit::isSupported()
+			{
+#if defined(__x86_64__) || defined(_M_X64)
+				return true;
+#else
+				return false;
+#endif
+			}
+
+			bool BaselineJit::shouldCompile(unsigned long calls, unsigned long backEdges) const
+			{
+				return options.enabled &&
+					(calls >= options.callThreshold || backEdges >= options.backEdgeThreshold);
+			}
+
+			CompiledFunction *BaselineJit::compile(VMState *state, unsigned long loc)
+			{
+				auto it = functions.find(loc);
+				if (it != functions.end())
+					return it->second.get();
+
+				std::unique_ptr<CompiledFunction> fn;
+
+				if (isSupported())
+				{
+					fn = std::make_unique<CompiledFunction>();
+
+					if (!InstructionDecoder::decodeRange(state->stream, loc, 0, fn->instructions) || !generate(fn.get()))
+						fn = nullptr;
+				}
+
+				if (fn != nullptr)
+				{
+					compiledCount++;
+					debug_log("JIT: compiled function at position: %d (%d instructions, %d bytes)",
+						loc, fn->numInstructions(), fn->codeSize());
+				}
+				else
+					debug_log("JIT: could not compile function at position: %d", loc);
+
+				auto *result = fn.get();
+				functions[loc] = std::move(fn);
+				return result;
+			}
+
+			bool BaselineJit::generate(CompiledFunction *fn) const
+			{
+#if defined(__x86_64__) || defined(_M_X64)
+				auto &instructions = fn->instructions;
+
+				// resolve the blocks declared inside of the function to instruction indices
+				std::map<uint64_t, size_t> indexAtPosition;
+				for (size_t i = 0; i < instructions.size(); i++)
+					indexAtPosition[instructions[i].position] = i;
+
+				std::map<int32_t, size_t> blockIndex;
+				for (auto &&d : instructions)
+				{
+					if (d.ins == CMD_CREATE_BLOCK)
+					{
+						auto it = indexAtPosition.find(d.blockPos);
+						if (it != indexAtPosition.end())
+							blockIndex[d.arg0] = it->second;
+					}
+				}
+
+				for (size_t i = 0; i < instructions.size(); i++)
+				{
+					const DecodedInstruction &d = instructions[i];
+
+					switch (d.ins)
+					{
+					case CMD_PUSH_FUNCTION_CHAIN:
+					case CMD_POP_FUNCTION_CHAIN:
+						// depends on the stream position; leave to the interpreter
+						return false;
+					case CMD_GO_TO_BLOCK:
+					case CMD_GO_TO_IF_TRUE:
+					case CMD_GO_TO_IF_FALSE:
+					{
+						auto it = blockIndex.find(d.arg0);
+						if (it == blockIndex.end())
+							return false;
+
+						// loops are left to the tracing JIT, which is entered from the interpreter
+						if (options.tracing && d.ins == CMD_GO_TO_IF_TRUE && it->second <= i)
+							return false;
+						break;
+					}
+					default:
+						break;
+					}
+				}
+
+				if (TemplateCompiler::compile(*fn))
+					return true;
+
+				fn->calls.clear();
+				fn->numSlots = 0;
+
+				X64Emitter e;
+				std::vector<size_t> labels(instructions.size());
+				std::vector<std::pair<size_t, size_t>> branches; // (patch offset, target index)
+				std::vector<size_t> exits;
+
+				e.prologue();
+
+				// every instruction becomes a call into VM::execute, except
+				// for jumps, whose targets are resolved to native branches
+				for (size_t i = 0; i < instructions.size(); i++)
+				{
+					const DecodedInstruction &d = instructions[i];
+					labels[i] = e.offset();
+
+					switch (d.ins)
+					{
+					case CMD_GO_TO_BLOCK:
+					case CMD_GO_TO_IF_TRUE:
+					case CMD_GO_TO_IF_FALSE:
+						e.callHelper((const void*)&branchHelper, &d);
+						branches.push_back({ e.jumpIfNonZero(), blockIndex[d.arg0] });
+						break;
+					case CMD_INVOKE:
+						e.callHelper((const void*)&invokeHelper, &d);
+						break;
+					case CMD_LEAVE_FUNCTION:
+						e.callHelper((const void*)&leaveFunctionHelper, &d);
+						exits.push_back(e.jump());
+						break;
+					case CMD_OP_UNARY_POS:
+						// no-op
+						break;
+					default:
+						e.callHelper((const void*)&executeHelper, &d);
+						break;
+					}
+				}
+
+				size_t exitLabel = e.offset();
+				e.epilogue();
+
+				for (auto &&branch : branches)
+					e.patch(branch.first, labels[branch.second]);
+				for (auto &&at : exits)
+					e.patch(at, exitLabel);
+
+				return fn->memory.load(e.code().data(), e.code().size());
+#else
+				return false;
+#endif
+			}
+
+			int BaselineJit::executeHelper(VM *vm, Module *module, const DecodedInstruction *d)
+			{
+				vm->execute(*d, module);
+				return 0;
+			}
+
+			int BaselineJit::branchHelper(VM *vm, Module *module, const DecodedInstruction *d)
+			{
+				if (vm->state->readLevel != vm->blockLevel)
+					return 0;
+
+				bool taken = true;
+				if (d->ins != CMD_GO_TO_BLOCK)
+				{
+					bool lastResult = module->getFrame(vm->blockLevel).getLastIfResult();
+					taken = (d->ins == CMD_GO_TO_IF_TRUE) ? lastResult : !lastResult;
+				}
+
+				if (taken)
+					vm->countBackEdge(*d, module->getSavedPositions()[d->arg0]);
+
+				return taken;
+			}
+
+			int BaselineJit::invokeHelper(VM *vm, Module *module, const DecodedInstruction *d)
+			{
+				vm->invokeCompiled(*d, module);
+				return 0;
+			}
+
+			int BaselineJit::leaveFunctionHelper(VM *vm, Module *module, const DecodedInstruction *d)
+			{
+				if (vm->state->readLevel == vm->blockLevel)
+					vm->execute(*d, module);
+				else
+					vm->state->stream->seek((unsigned long)d->next);
+
+				return 0;
+			}
+		}
+	}
+}
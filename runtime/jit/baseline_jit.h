@@ -0,0 +1,111 @@
+#ifndef __ZENITH_RUNTIME_JIT_BASELINE_JIT_H__
+#define __ZENITH_RUNTIME_JIT_BASELINE_JIT_H__
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "executable_memory.h"
+#include "template_compiler.h"
+#include "../instruction.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		class VM;
+		class Module;
+		class ByteReader;
+		struct VMState;
+
+		namespace jit
+		{
+			struct JitOptions
+			{
+				bool enabled = false;
+
+				// a function is compiled once it has been called this many times,
+				// or once loops inside of it have jumped back this many times
+				unsigned long callThreshold = 2;
+				unsigned long backEdgeThreshold = 1000;
+
+				// record and compile hot loops
+				bool tracing = false;
+				unsigned long traceThreshold = 50;
+				size_t maxTraceLength = 1000;
+				// side exits taken before the other path is recorded as a branch
+				unsigned long branchThreshold = 20;
+				size_t maxBranches = 16;
+
+				// run warm functions and loops from pre-decoded, quickened code
+				bool tiering = false;
+				unsigned long quickenCallThreshold = 2;
+				unsigned long quickenBackEdgeThreshold = 50;
+			};
+
+			/* Native code for a single function body, generated from the templates of
+			   the TemplateCompiler. Instructions without a template call into the VM's
+			   own implementation with their operands already decoded. A function the
+			   templates do not handle is compiled to such calls only, one per
+			   instruction, with jumps as native branches. */
+			class CompiledFunction
+			{
+			private:
+				typedef void(*EntryPoint)(VM *vm, Module *module, TemplateSlot *slots);
+
+				std::vector<DecodedInstruction> instructions;
+				ExecutableMemory memory;
+
+				// operands of the helper calls, and the slots each call of the function needs
+				std::vector<std::unique_ptr<TemplateCall>> calls;
+				size_t numSlots = 0;
+
+				friend class BaselineJit;
+				friend class TemplateCompiler;
+
+			public:
+				void run(VM *vm, Module *module) const;
+
+				size_t numInstructions() const { return instructions.size(); }
+				size_t codeSize() const { return memory.size(); }
+			};
+
+			class BaselineJit
+			{
+			private:
+				JitOptions options;
+
+				// function location -> compiled code (nullptr when it could not be compiled)
+				std::map<unsigned long, std::unique_ptr<CompiledFunction>> functions;
+
+				size_t compiledCount;
+
+				bool generate(CompiledFunction *fn) const;
+
+				// helpers called from generated code
+				static int executeHelper(VM *vm, Module *module, const DecodedInstruction *d);
+				static int branchHelper(VM *vm, Module *module, const DecodedInstruction *d);
+				static int invokeHelper(VM *vm, Module *module, const DecodedInstruction *d);
+				static int leaveFunctionHelper(VM *vm, Module *module, const DecodedInstruction *d);
+
+			public:
+				BaselineJit(const JitOptions &options);
+
+				const JitOptions &getOptions() const { return options; }
+
+				bool shouldCompile(unsigned long calls, unsigned long backEdges) const;
+
+				/* Compile the function starting at 'loc'. Returns nullptr if the
+				   function uses something the JIT does not handle, in which case
+				   it should keep being interpreted. */
+				CompiledFunction *compile(VMState *state, unsigned long loc);
+
+				size_t numCompiled() const { return compiledCount; }
+
+				static bool isSupported();
+			};
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include "executable_memory.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace zenith
+{
+	namespace runtime
+	{
+		namespace jit
+		{
+			ExecutableMemory::ExecutableMemory()
+			{
+				memory = nullptr;
+				_size = 0;
+			}
+
+			ExecutableMemory::~ExecutableMemory()
+			{
+				release();
+			}
+
+			bool ExecutableMemory::load(const uint8_t *code, size_t size)
+			{
+				if (size == 0)
+					return false;
+
+#ifdef _WIN32
+				void *ptr = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+				if (ptr == nullptr)
+					return false;
+
+				memcpy(ptr, code, size);
+
+				DWORD oldProtect;
+				if (!VirtualProtect(ptr, size, PAGE_EXECUTE_READ, &oldProtect))
+				{
+					VirtualFree(ptr, 0, MEM_RELEASE);
+					return false;
+				}
+
+				FlushInstructionCache(GetCurrentProcess(), ptr, size);
+#else
+				void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+				if (ptr == MAP_FAILED)
+					return false;
+
+				memcpy(ptr, code, size);
+
+				if (mprotect(ptr, size, PROT_READ | PROT_EXEC) != 0)
+				{
+					munmap(ptr, size);
+					return false;
+				}
+#endif
+
+				// code loaded before stays in place until this has succeeded
+				release();
+
+				memory = (uint8_t*)ptr;
+				_size = size;
+				return true;
+			}
+
+			void ExecutableMemory::release()
+			{
+				if (memory == nullptr)
+					return;
+
+#ifdef _WIN32
+				VirtualFree(memory, 0, MEM_RELEASE);
+#else
+				munmap(memory, _size);
+#endif
+
+				memory = nullptr;
+				_size = 0;
+			}
+		}
+	}
+}
@@ -0,0 +1,42 @@
+#ifndef __ZENITH_RUNTIME_JIT_EXECUTABLE_MEMORY_H__
+#define __ZENITH_RUNTIME_JIT_EXECUTABLE_MEMORY_H__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace zenith
+{
+	namespace runtime
+	{
+		namespace jit
+		{
+			/* A block of memory pages that are first written to
+			   and then made executable (W^X). */
+			class ExecutableMemory
+			{
+			private:
+				uint8_t *memory;
+				size_t _size;
+
+			public:
+				ExecutableMemory();
+				ExecutableMemory(const ExecutableMemory &other) = delete;
+				~ExecutableMemory();
+
+				ExecutableMemory &operator=(const ExecutableMemory &other) = delete;
+
+				/* Allocate writable memory and copy the code into it,
+				   then make it read-only and executable. On failure the
+				   code that was loaded before is kept. */
+				bool load(const uint8_t *code, size_t size);
+
+				void release();
+
+				void *data() const { return memory; }
+				size_t size() const { return _size; }
+			};
+		}
+	}
+}
+
+#endif
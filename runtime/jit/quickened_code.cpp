@@ -0,0 +1,238 @@
+#include "quickened_code.h"
+#include "tracing_jit.h"
+
+#include "../vm.h"
+#include "../module.h"
+#include "../bytereader.h"
+#include "../experimental/vm_state.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		namespace jit
+		{
+			std::unique_ptr<QuickenedCode> QuickenedCode::quickenFunction(ByteReader *stream, uint64_t loc)
+			{
+				std::vector<DecodedInstruction> decoded;
+				if (!InstructionDecoder::decodeRange(stream, loc, 0, decoded))
+					return nullptr;
+
+				auto code = std::make_unique<QuickenedCode>();
+				if (!code->prepare(decoded))
+					return nullptr;
+
+				return code;
+			}
+
+			std::unique_ptr<QuickenedCode> QuickenedCode::quickenLoop(ByteReader *stream, uint64_t header,
+				uint64_t backEdgeEnd)
+			{
+				std::vector<DecodedInstruction> decoded;
+				if (!InstructionDecoder::decodeRange(stream, header, backEdgeEnd, decoded) || decoded.empty())
+					return nullptr;
+
+				for (auto &&d : decoded)
+				{
+					// a return would have to stop the function that is running the loop
+					if (d.ins == CMD_LEAVE_FUNCTION)
+						return nullptr;
+				}
+
+				if (decoded.back().ins != CMD_GO_TO_IF_TRUE && decoded.back().ins != CMD_GO_TO_BLOCK)
+					return nullptr;
+
+				auto code = std::make_unique<QuickenedCode>();
+				if (!code->prepare(decoded))
+					return nullptr;
+
+				// the back-edge jumps to the header
+				code->instructions.back().target = 0;
+
+				return code;
+			}
+
+			bool QuickenedCode::prepare(std::vector<DecodedInstruction> &decoded)
+			{
+				if (decoded.empty())
+					return false;
+
+				instructions.reserve(decoded.size());
+				for (size_t i = 0; i < decoded.size(); i++)
+				{
+					indexAtPosition[decoded[i].position] = i;
+					instructions.push_back({ std::move(decoded[i]), -1, 0 });
+				}
+
+				end = instructions.back().d.next;
+
+				std::map<int32_t, int64_t> blockIndex;
+				std::vector<size_t> openBlocks;
+
+				for (size_t i = 0; i < instructions.size(); i++)
+				{
+					auto &d = instructions[i].d;
+
+					if (d.ins == CMD_CREATE_BLOCK)
+					{
+						auto it = indexAtPosition.find(d.blockPos);
+						if (it != indexAtPosition.end())
+							blockIndex[d.arg0] = (int64_t)it->second;
+					}
+					else if (d.ins == CMD_INC_BLOCK_LEVEL)
+						openBlocks.push_back(i);
+					else if (d.ins == CMD_DEC_BLOCK_LEVEL && !openBlocks.empty())
+					{
+						instructions[openBlocks.back()].skip = i + 1;
+						openBlocks.pop_back();
+					}
+				}
+
+				for (auto &&q : instructions)
+				{
+					if (q.d.ins == CMD_GO_TO_BLOCK || q.d.ins == CMD_GO_TO_IF_TRUE || q.d.ins == CMD_GO_TO_IF_FALSE)
+					{
+						auto it = blockIndex.find(q.d.arg0);
+						if (it != blockIndex.end())
+							q.target = it->second;
+					}
+				}
+
+				return true;
+			}
+
+			bool QuickenedCode::findIndex(uint64_t position, size_t &index) const
+			{
+				auto it = indexAtPosition.find(position);
+				if (it == indexAtPosition.end())
+					return false;
+
+				index = it->second;
+				return true;
+			}
+
+			void QuickenedCode::run(VM *vm, Module *module, size_t index) const
+			{
+				VMState *state = vm->state;
+				TracingJit *tracer = vm->tracer;
+
+				const size_t count = instructions.size();
+
+				while (index < count)
+				{
+					auto &q = instructions[index];
+					auto &d = q.d;
+
+					bool recording = (tracer != nullptr && tracer->isRecording());
+					if (recording)
+						tracer->record(vm, module, d);
+
+					bool active = (state->readLevel == vm->blockLevel);
+
+					switch (d.ins)
+					{
+					case CMD_INC_BLOCK_LEVEL:
+						// nothing inside of a block that is not read has an effect
+						if (q.skip != 0 && !recording && state->readLevel <= vm->blockLevel)
+						{
+							index = q.skip;
+							continue;
+						}
+
+						vm->execute(d, module);
+						break;
+					case CMD_DEC_BLOCK_LEVEL:
+					case CMD_CREATE_BLOCK:
+						vm->execute(d, module);
+						break;
+					case CMD_GO_TO_BLOCK:
+					case CMD_GO_TO_IF_TRUE:
+					case CMD_GO_TO_IF_FALSE:
+					{
+						if (!active)
+							break;
+
+						bool taken = true;
+						if (d.ins != CMD_GO_TO_BLOCK)
+						{
+							bool lastResult = module->getFrame(vm->blockLevel).getLastIfResult();
+							taken = (d.ins == CMD_GO_TO_IF_TRUE) ? lastResult : !lastResult;
+						}
+
+						if (!taken)
+							break;
+
+						uint64_t position = (q.target >= 0)
+							? instructions[(size_t)q.target].d.position
+							: module->getSavedPositions()[d.arg0];
+
+						vm->countBackEdge(d, position);
+
+						if (tracer != nullptr && d.ins == CMD_GO_TO_IF_TRUE && position <= d.position &&
+							tracer->onBackEdge(vm, module, d, position))
+						{
+							// the trace left the stream where execution continues
+							if (!findIndex(state->stream->position(), index))
+								return;
+
+							continue;
+						}
+
+						if (q.target >= 0)
+						{
+							index = (size_t)q.target;
+							continue;
+						}
+
+						state->stream->seek((unsigned long)position);
+						if (!findIndex(position, index))
+							return;
+
+						continue;
+					}
+					case CMD_PUSH_FUNCTION_CHAIN:
+						// pushes a position relative to the stream
+						if (active)
+						{
+							state->stream->seek((unsigned long)d.next);
+							vm->execute(d, module);
+						}
+						break;
+					case CMD_POP_FUNCTION_CHAIN:
+						if (active)
+						{
+							vm->execute(d, module);
+							if (!findIndex(state->stream->position(), index))
+								return;
+
+							continue;
+						}
+						break;
+					case CMD_INVOKE:
+						if (active)
+							vm->invokeCompiled(d, module);
+						break;
+					case CMD_LEAVE_FUNCTION:
+						// the body ends here, as in Function::invoke
+						if (active)
+							vm->execute(d, module);
+						else
+							state->stream->seek((unsigned long)d.next);
+						return;
+					case CMD_OP_UNARY_POS:
+						// no-op
+						break;
+					default:
+						if (active)
+							vm->execute(d, module);
+						break;
+					}
+
+					index++;
+				}
+
+				state->stream->seek((unsigned long)end);
+			}
+		}
+	}
+}
@@ -0,0 +1,67 @@
+#ifndef __ZENITH_RUNTIME_JIT_QUICKENED_CODE_H__
+#define __ZENITH_RUNTIME_JIT_QUICKENED_CODE_H__
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "../instruction.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		class VM;
+		class Module;
+		class ByteReader;
+
+		namespace jit
+		{
+			/* A function body or a loop, decoded once into an instruction array.
+			   Executing it does not touch the stream, except where the VM needs the
+			   stream position (calls and returns). On top of that the code is quickened:
+			   jumps are resolved to instruction indices, blocks that are entered while
+			   not being read are skipped as a whole, and instructions that are not
+			   being read are not dispatched. */
+			class QuickenedCode
+			{
+			private:
+				struct QuickenedInstruction
+				{
+					DecodedInstruction d;
+
+					// GO_TO_*: index of the target block, -1 when it is outside of this code
+					int64_t target;
+					// INC_BLOCK_LEVEL: index after the matching DEC_BLOCK_LEVEL, 0 if unknown
+					size_t skip;
+				};
+
+				std::vector<QuickenedInstruction> instructions;
+				std::map<uint64_t, size_t> indexAtPosition;
+
+				// stream position after the last instruction
+				uint64_t end;
+
+				bool prepare(std::vector<DecodedInstruction> &decoded);
+
+			public:
+				/* Decode the function starting at 'loc'. Returns nullptr if it cannot be quickened. */
+				static std::unique_ptr<QuickenedCode> quickenFunction(ByteReader *stream, uint64_t loc);
+				/* Decode the loop from its header up to and including its back-edge. */
+				static std::unique_ptr<QuickenedCode> quickenLoop(ByteReader *stream, uint64_t header,
+					uint64_t backEdgeEnd);
+
+				bool findIndex(uint64_t position, size_t &index) const;
+
+				/* Execute from 'index' until the function returns or control leaves
+				   this code. The stream is left where the interpreter continues. */
+				void run(VM *vm, Module *module, size_t index) const;
+
+				size_t size() const { return instructions.size(); }
+			};
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,1103 @@
+#include "template_compiler.h"
+#include "baseline_jit.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../vm.h"
+#include "../module.h"
+#include "../bytereader.h"
+#include "../experimental/object.h"
+#include "../experimental/vm_state.h"
+
+#include "../../util/logger.h"
+
+namespace zenith
+{
+	using namespace util;
+
+	namespace runtime
+	{
+		namespace jit
+		{
+			const size_t SLOT_BITS = offsetof(TemplateSlot, bits);
+			const size_t SLOT_TYPE = offsetof(TemplateSlot, type);
+			const size_t SLOT_BOXED = offsetof(TemplateSlot, boxed);
+
+			TemplateCompiler::TemplateCompiler(CompiledFunction &fn)
+				: fn(fn)
+			{
+				numCells = 0;
+				numValues = 0;
+			}
+
+			bool TemplateCompiler::compile(CompiledFunction &fn)
+			{
+#if defined(__x86_64__) || defined(_M_X64)
+				TemplateCompiler compiler(fn);
+				if (!compiler.prepare())
+					return false;
+
+				auto &instructions = fn.instructions;
+				auto &e = compiler.e;
+
+				e.prologue();
+
+				// the call increased the read level for the function's block
+				Level caller;
+				caller.real = 0;
+				caller.branch = CMD_INC_READ_LEVEL;
+				caller.ifKnown = false;
+				compiler.levels.push_back(caller);
+
+				for (size_t i = 0; i < instructions.size(); i++)
+				{
+					compiler.labels[i] = e.offset();
+
+					if (!compiler.compileInstruction(i))
+					{
+						debug_log("JIT: no template for instruction %d at position: %d",
+							(int)instructions[i].ins, instructions[i].position);
+						return false;
+					}
+				}
+
+				compiler.labels[instructions.size()] = e.offset();
+				compiler.exits.push_back(e.jump());
+
+				// a block that is skipped without its end decoded is where the function
+				// ends: the rest is not read, only its blocks are entered and left
+				for (auto &&tail : compiler.tails)
+				{
+					e.patch(tail.first, e.offset());
+
+					for (size_t i = tail.second; i < instructions.size(); i++)
+					{
+						switch (instructions[i].ins)
+						{
+						case CMD_INC_BLOCK_LEVEL:
+						case CMD_DEC_BLOCK_LEVEL:
+						case CMD_CREATE_BLOCK:
+						case CMD_LEAVE_FUNCTION:
+							compiler.execute(instructions[i]);
+							break;
+						default:
+							break;
+						}
+					}
+
+					compiler.exits.push_back(e.jump());
+				}
+
+				size_t exitLabel = e.offset();
+				e.epilogue();
+
+				for (auto &&branch : compiler.branches)
+					e.patch(branch.first, compiler.labels[branch.second]);
+				for (auto &&at : compiler.exits)
+					e.patch(at, exitLabel);
+
+				if (!fn.memory.load(e.code().data(), e.code().size()))
+					return false;
+
+				fn.numSlots = compiler.numCells + compiler.numValues;
+				return true;
+#else
+				return false;
+#endif
+			}
+
+			bool TemplateCompiler::prepare()
+			{
+				auto &instructions = fn.instructions;
+
+				labels.resize(instructions.size() + 1);
+				blockEnds.assign(instructions.size(), 0);
+				jumpTargets.assign(instructions.size(), false);
+
+				std::map<uint64_t, size_t> indexAtPosition;
+				for (size_t i = 0; i < instructions.size(); i++)
+					indexAtPosition[instructions[i].position] = i;
+
+				std::map<int32_t, size_t> declarations;
+				for (size_t i = 0; i < instructions.size(); i++)
+				{
+					auto &d = instructions[i];
+					if (d.ins == CMD_CREATE_BLOCK)
+					{
+						auto it = indexAtPosition.find(d.blockPos);
+						if (it != indexAtPosition.end())
+							blockIndex[d.arg0] = it->second;
+						declarations[d.arg0] = i;
+					}
+				}
+
+				std::vector<size_t> open;
+				for (size_t i = 0; i < instructions.size(); i++)
+				{
+					auto &d = instructions[i];
+
+					switch (d.ins)
+					{
+					case CMD_INC_BLOCK_LEVEL:
+						open.push_back(i);
+						numCells = std::max(numCells, open.size() + 1);
+						break;
+					case CMD_DEC_BLOCK_LEVEL:
+						if (open.empty())
+							return false;
+						blockEnds[open.back()] = i + 1;
+						open.pop_back();
+						break;
+					case CMD_GO_TO_BLOCK:
+					case CMD_GO_TO_IF_TRUE:
+					case CMD_GO_TO_IF_FALSE:
+					{
+						auto it = declarations.find(d.arg0);
+						if (it == declarations.end() || blockIndex.find(d.arg0) == blockIndex.end())
+							return false;
+						jumpTargets[it->second] = true;
+						break;
+					}
+					case CMD_LOOP_BREAK:
+					case CMD_LOOP_CONTINUE:
+					case CMD_DEC_READ_LEVEL:
+					case CMD_LEAVE_IF_STATEMENT:
+					case CMD_LEAVE_ELSE_STATEMENT:
+						// these leave blocks unread, which the templates do not track
+						return false;
+					default:
+						break;
+					}
+				}
+
+				return true;
+			}
+
+			bool TemplateCompiler::compileInstruction(size_t index)
+			{
+				auto &d = fn.instructions[index];
+				auto &level = levels.back();
+
+				// only the function's block is entered from the caller's level
+				if (levels.size() == 1 && d.ins != CMD_INC_BLOCK_LEVEL)
+					return false;
+
+				// between an if, else or read level increase and its block, blocks may only be declared
+				if (level.branch != CMD_NONE && d.ins != CMD_INC_BLOCK_LEVEL && d.ins != CMD_CREATE_BLOCK)
+					return false;
+
+				switch (d.ins)
+				{
+				case CMD_INC_BLOCK_LEVEL:
+					return enterBlock(index);
+				case CMD_DEC_BLOCK_LEVEL:
+					execute(d);
+					levels.pop_back();
+					return true;
+				case CMD_CREATE_BLOCK:
+					if (jumpTargets[index])
+					{
+						// jumps arrive after the declaration with all values on the frame
+						if (blockIndex[d.arg0] != index + 1)
+							return false;
+
+						spill();
+						if (!matchBlockState(d.arg0))
+							return false;
+
+						level.ifKnown = false;
+					}
+					execute(d);
+					return true;
+				case CMD_GO_TO_BLOCK:
+				case CMD_GO_TO_IF_TRUE:
+				case CMD_GO_TO_IF_FALSE:
+					return jump(index);
+				case CMD_IF_STATEMENT:
+					return ifStatement(index);
+				case CMD_ELSE_STATEMENT:
+					if (!level.ifKnown)
+						return false;
+					execute(d);
+					level.branch = CMD_ELSE_STATEMENT;
+					return true;
+				case CMD_INC_READ_LEVEL:
+					execute(d);
+					level.branch = CMD_INC_READ_LEVEL;
+					return true;
+				case CMD_LOAD_INTEGER:
+				{
+					Entry entry = { true, SLOT_INTEGER, (int64_t)d.intValue, false };
+					push(entry);
+					return true;
+				}
+				case CMD_LOAD_FLOAT:
+				{
+					Entry entry = { true, SLOT_FLOAT, 0, false };
+					memcpy(&entry.bits, &d.floatValue, sizeof(double));
+					push(entry);
+					return true;
+				}
+				case CMD_OP_UNARY_POS:
+					// no-op
+					return true;
+				case CMD_OP_UNARY_NEG:
+				case CMD_OP_UNARY_NOT:
+					return operation(index, 1);
+				case CMD_OP_ADD:
+				case CMD_OP_SUB:
+				case CMD_OP_MUL:
+				case CMD_OP_DIV:
+				case CMD_OP_MOD:
+				case CMD_OP_AND:
+				case CMD_OP_OR:
+				case CMD_OP_EQL:
+				case CMD_OP_NEQL:
+				case CMD_OP_LT:
+				case CMD_OP_GT:
+				case CMD_OP_LTE:
+				case CMD_OP_GTE:
+					return operation(index, 2);
+				case CMD_OP_ASSIGN:
+				case CMD_OP_ADD_ASSIGN:
+				case CMD_OP_SUB_ASSIGN:
+				case CMD_OP_MUL_ASSIGN:
+				case CMD_OP_DIV_ASSIGN:
+					return callVM(d, 2, 1, true);
+				case CMD_LOAD_VARIABLE:
+				case CMD_LOAD_STRING:
+				case CMD_LOAD_NULL:
+					return callVM(d, 0, 1, false);
+				case CMD_CALL_NATIVE_FUNCTION:
+					return callVM(d, 0, 1, true);
+				case CMD_INVOKE:
+					return callVM(d, 1, 1, true);
+				case CMD_LOAD_MEMBER:
+					return callVM(d, 1, 2, false);
+				case CMD_ADD_MEMBER:
+					return callVM(d, 1, 1, false);
+				case CMD_OP_PUSH:
+					// the top value is pushed and the rest cleared
+					if (level.values.empty())
+						execute(d);
+					else if (!callVM(d, 1, 0, false))
+						return false;
+					level.values.clear();
+					level.real = 0;
+					return true;
+				case CMD_OP_CLEAR:
+					level.values.clear();
+					if (level.real > 0)
+						execute(d);
+					level.real = 0;
+					return true;
+				case CMD_LEAVE_BLOCK:
+					// only on the way out of a function
+					if (index + 1 >= fn.instructions.size() ||
+						(fn.instructions[index + 1].ins != CMD_LEAVE_BLOCK &&
+						fn.instructions[index + 1].ins != CMD_LEAVE_FUNCTION))
+						return false;
+					execute(d);
+					return true;
+				case CMD_LEAVE_FUNCTION:
+					execute(d);
+					exits.push_back(e.jump());
+					return true;
+				case CMD_CREATE_VAR:
+				case CMD_STACK_POP_OBJECT:
+				case CMD_CREATE_FUNCTION:
+				case CMD_CLEAR_VAR:
+				case CMD_DELETE_VAR:
+				case CMD_CREATE_NATIVE_CLASS_INSTANCE:
+					execute(d);
+					return true;
+				default:
+					return false;
+				}
+			}
+
+			bool TemplateCompiler::enterBlock(size_t index)
+			{
+				auto &d = fn.instructions[index];
+
+				// the values of the enclosing block wait on its frame
+				spill();
+
+				auto &level = levels.back();
+				const size_t NO_SKIP = (size_t)-1;
+				size_t skip = NO_SKIP;
+
+				switch (level.branch)
+				{
+				case CMD_IF_STATEMENT:
+					e.compareSlotImmediate(displacement(cellSlot(), SLOT_BITS), 0);
+					skip = e.jumpIf(COND_E);
+					break;
+				case CMD_ELSE_STATEMENT:
+					e.compareSlotImmediate(displacement(cellSlot(), SLOT_BITS), 0);
+					skip = e.jumpIf(COND_NE);
+					break;
+				case CMD_INC_READ_LEVEL:
+					// the read level was increased by code that runs
+					break;
+				default:
+					// never read
+					skip = e.jump();
+					break;
+				}
+
+				if (skip != NO_SKIP)
+				{
+					if (blockEnds[index] != 0)
+						branches.push_back({ skip, blockEnds[index] });
+					else
+						tails.push_back({ skip, index });
+				}
+
+				level.branch = CMD_NONE;
+				execute(d);
+
+				Level block;
+				block.real = 0;
+				block.branch = CMD_NONE;
+				block.ifKnown = false;
+				levels.push_back(block);
+				return true;
+			}
+
+			bool TemplateCompiler::jump(size_t index)
+			{
+				auto &d = fn.instructions[index];
+
+				spill();
+				if (!matchBlockState(d.arg0))
+					return false;
+
+				auto &level = levels.back();
+				size_t target = blockIndex[d.arg0];
+				bool backward = target <= index;
+
+				if (d.ins == CMD_GO_TO_BLOCK)
+				{
+					if (backward)
+						callHelper(&backEdgeHelper, call(&d, {}, -1));
+					branches.push_back({ e.jump(), target });
+					return true;
+				}
+
+				if (!level.ifKnown)
+					return false;
+
+				e.compareSlotImmediate(displacement(cellSlot(), SLOT_BITS), 0);
+				Condition taken = (d.ins == CMD_GO_TO_IF_TRUE) ? COND_NE : COND_E;
+
+				if (backward)
+				{
+					// loops count their back-edges for the tiers
+					size_t over = e.jumpIf(taken == COND_NE ? COND_E : COND_NE);
+					callHelper(&backEdgeHelper, call(&d, {}, -1));
+					branches.push_back({ e.jump(), target });
+					e.patch(over, e.offset());
+				}
+				else
+					branches.push_back({ e.jumpIf(taken), target });
+
+				return true;
+			}
+
+			bool TemplateCompiler::ifStatement(size_t index)
+			{
+				auto &d = fn.instructions[index];
+
+				if (!take(1))
+					return false;
+
+				auto &level = levels.back();
+				auto cond = operand(level.values.size() - 1);
+				int32_t cell = displacement(cellSlot(), SLOT_BITS);
+
+				if (cond.constant)
+				{
+					bool val;
+					if (cond.type == SLOT_INTEGER)
+						val = (cond.bits != 0);
+					else
+					{
+						double value;
+						memcpy(&value, &cond.bits, sizeof(double));
+						val = (value != 0.0);
+					}
+
+					e.storeSlotImmediate(cell, val ? 1 : 0);
+				}
+				else
+				{
+					std::vector<size_t> done;
+
+					e.compareSlotImmediate(displacement(cond.slot, SLOT_TYPE), SLOT_INTEGER);
+					size_t notInteger = e.jumpIf(COND_NE);
+					e.loadSlot(RAX, displacement(cond.slot, SLOT_BITS));
+					e.test(RAX);
+					e.setIf(COND_NE, RAX);
+					done.push_back(e.jump());
+
+					e.patch(notInteger, e.offset());
+					e.compareSlotImmediate(displacement(cond.slot, SLOT_TYPE), SLOT_FLOAT);
+					size_t notFloat = e.jumpIf(COND_NE);
+					// NaN is true
+					e.loadSlotDouble(XMM0, displacement(cond.slot, SLOT_BITS));
+					e.clearXmm(XMM1);
+					e.compareDouble(XMM0, XMM1);
+					e.setIf(COND_NE, RAX);
+					e.setIf(COND_P, RCX);
+					e.orByte(RAX, RCX);
+					done.push_back(e.jump());
+
+					e.patch(notFloat, e.offset());
+					callHelper(&truthHelper, call(nullptr, {}, (int64_t)cond.slot));
+
+					for (auto &&at : done)
+						e.patch(at, e.offset());
+
+					e.zeroExtendByte(RAX, RAX);
+					e.storeSlot(cell, RAX);
+				}
+
+				level.values.pop_back();
+				callHelper(&ifHelper, call(&d, {}, (int64_t)cellSlot()));
+
+				level.branch = CMD_IF_STATEMENT;
+				level.ifKnown = true;
+				return true;
+			}
+
+			bool TemplateCompiler::operation(size_t index, size_t numOperands)
+			{
+				auto &d = fn.instructions[index];
+
+				if (!take(numOperands))
+					return false;
+
+				auto &level = levels.back();
+				size_t base = level.values.size() - numOperands;
+
+				std::vector<TemplateOperand> operands;
+				for (size_t i = 0; i < numOperands; i++)
+					operands.push_back(operand(base + i));
+
+				size_t dst = valueSlot(base);
+
+				std::vector<size_t> slow, done;
+				std::vector<SlotType> types;
+				typeSwitch(d.ins, operands, types, dst, slow, done);
+
+				if (!slow.empty())
+				{
+					for (auto &&at : slow)
+						e.patch(at, e.offset());
+
+					// other types are left to the VM
+					callHelper(&executeHelper, call(&d, operands, (int64_t)dst));
+				}
+
+				for (auto &&at : done)
+					e.patch(at, e.offset());
+
+				level.values.resize(base);
+
+				Entry result = { false, SLOT_OBJECT, 0, false };
+				push(result);
+				return true;
+			}
+
+			bool TemplateCompiler::callVM(const DecodedInstruction &d, size_t needs, size_t leaves, bool assigns)
+			{
+				// what is left below the result must stay below the values in slots
+				if (leaves > 1)
+					spill();
+
+				auto &level = levels.back();
+				size_t fromSlots = std::min(needs, level.values.size());
+				if (level.real < (int)(needs - fromSlots))
+					return false;
+
+				size_t base = level.values.size() - fromSlots;
+				std::vector<TemplateOperand> operands;
+				for (size_t i = base; i < level.values.size(); i++)
+					operands.push_back(operand(i));
+
+				level.values.resize(base);
+				level.real += (int)leaves - (int)(needs - fromSlots);
+
+				int64_t result = -1;
+				if (leaves > 0)
+				{
+					result = (int64_t)valueSlot(base);
+					level.real--;
+				}
+
+				callHelper(&executeHelper, call(&d, operands, result));
+
+				if (leaves > 0)
+				{
+					Entry entry = { false, SLOT_OBJECT, 0, true };
+					push(entry);
+				}
+
+				if (assigns)
+					reload(base);
+
+				return true;
+			}
+
+			bool TemplateCompiler::take(size_t count)
+			{
+				auto &level = levels.back();
+				if (level.values.size() >= count)
+					return true;
+
+				size_t missing = count - level.values.size();
+				if (level.real < (int)missing)
+					return false;
+
+				// the values in slots move up to make room below them
+				std::vector<TemplateOperand> operands;
+				for (size_t i = 0; i < level.values.size(); i++)
+				{
+					if (!level.values[i].constant)
+						operands.push_back(operand(i));
+				}
+
+				callHelper(&takeHelper, call(nullptr, operands, (int64_t)valueSlot(0), missing));
+
+				Entry entry = { false, SLOT_OBJECT, 0, true };
+				level.values.insert(level.values.begin(), missing, entry);
+				level.real -= (int)missing;
+
+				numValues = std::max(numValues, level.values.size());
+				return true;
+			}
+
+			void TemplateCompiler::spill()
+			{
+				auto &level = levels.back();
+				if (level.values.empty())
+					return;
+
+				std::vector<TemplateOperand> operands;
+				for (size_t i = 0; i < level.values.size(); i++)
+					operands.push_back(operand(i));
+
+				callHelper(&executeHelper, call(nullptr, operands, -1));
+
+				level.real += (int)level.values.size();
+				level.values.clear();
+			}
+
+			void TemplateCompiler::reload(size_t count)
+			{
+				auto &level = levels.back();
+
+				std::vector<TemplateOperand> operands;
+				for (size_t i = 0; i < count; i++)
+				{
+					if (!level.values[i].constant && level.values[i].reference)
+						operands.push_back(operand(i));
+				}
+
+				if (!operands.empty())
+					callHelper(&reloadHelper, call(nullptr, operands, -1));
+			}
+
+			void TemplateCompiler::push(const Entry &entry)
+			{
+				auto &level = levels.back();
+				level.values.push_back(entry);
+				numValues = std::max(numValues, level.values.size());
+			}
+
+			bool TemplateCompiler::matchBlockState(int32_t id)
+			{
+				std::pair<size_t, int> state(levels.size(), levels.back().real);
+
+				auto it = blockStates.find(id);
+				if (it == blockStates.end())
+				{
+					blockStates[id] = state;
+					return true;
+				}
+
+				return it->second == state;
+			}
+
+			void TemplateCompiler::typeSwitch(Instruction ins, const std::vector<TemplateOperand> &operands,
+				std::vector<SlotType> &types, size_t dst, std::vector<size_t> &slow, std::vector<size_t> &done)
+			{
+				if (types.size() == operands.size())
+				{
+					if (emitOperation(ins, operands, types, dst))
+						done.push_back(e.jump());
+					else
+						slow.push_back(e.jump());
+					return;
+				}
+
+				auto &operand = operands[types.size()];
+				if (operand.constant)
+				{
+					types.push_back(operand.type);
+					typeSwitch(ins, operands, types, dst, slow, done);
+					types.pop_back();
+					return;
+				}
+
+				for (SlotType type : { SLOT_INTEGER, SLOT_FLOAT })
+				{
+					e.compareSlotImmediate(displacement(operand.slot, SLOT_TYPE), (int8_t)type);
+					size_t other = e.jumpIf(COND_NE);
+
+					types.push_back(type);
+					typeSwitch(ins, operands, types, dst, slow, done);
+					types.pop_back();
+
+					e.patch(other, e.offset());
+				}
+
+				slow.push_back(e.jump());
+			}
+
+			bool TemplateCompiler::emitOperation(Instruction ins, const std::vector<TemplateOperand> &operands,
+				const std::vector<SlotType> &types, size_t dst)
+			{
+				bool integers = true;
+				for (auto &&type : types)
+					integers = integers && (type == SLOT_INTEGER);
+
+				if (operands.size() == 1)
+				{
+					auto &value = operands[0];
+
+					if (ins == CMD_OP_UNARY_NEG)
+					{
+						loadBits(RAX, value);
+						if (integers)
+						{
+							e.negate(RAX);
+							storeInteger(dst, RAX);
+						}
+						else
+						{
+							// flip the sign bit
+							e.moveImmediate(RCX, INT64_MIN);
+							e.intOp(INT_OP_XOR, RAX, RCX);
+							e.moveToXmm(XMM0, RAX);
+							storeFloat(dst);
+						}
+					}
+					else if (integers)
+					{
+						loadBits(RAX, value);
+						e.test(RAX);
+						e.setIf(COND_E, RAX);
+						e.zeroExtendByte(RAX, RAX);
+						storeInteger(dst, RAX);
+					}
+					else
+					{
+						loadDouble(XMM0, RAX, value, types[0]);
+						e.clearXmm(XMM1);
+						e.compareDouble(XMM0, XMM1);
+						e.setIf(COND_E, RAX);
+						e.setIf(COND_NP, RCX);
+						e.andByte(RAX, RCX);
+						e.zeroExtendByte(RAX, RAX);
+						e.intToDouble(XMM0, RAX);
+						storeFloat(dst);
+					}
+
+					return true;
+				}
+
+				auto &left = operands[0];
+				auto &right = operands[1];
+				bool leftInteger = (types[0] == SLOT_INTEGER);
+
+				switch (ins)
+				{
+				case CMD_OP_ADD:
+				case CMD_OP_SUB:
+				case CMD_OP_MUL:
+				case CMD_OP_DIV:
+				{
+					if (integers)
+					{
+						loadBits(RCX, right);
+						loadBits(RAX, left);
+
+						if (ins == CMD_OP_ADD)
+							e.intOp(INT_OP_ADD, RAX, RCX);
+						else if (ins == CMD_OP_SUB)
+							e.intOp(INT_OP_SUB, RAX, RCX);
+						else if (ins == CMD_OP_MUL)
+							e.intOp(INT_OP_IMUL, RAX, RCX);
+						else
+						{
+							e.signExtend();
+							e.divide(RCX);
+						}
+
+						storeInteger(dst, RAX);
+					}
+					else
+					{
+						loadDouble(XMM1, RCX, right, types[1]);
+						loadDouble(XMM0, RAX, left, types[0]);
+
+						DoubleOp op = DOUBLE_OP_ADD;
+						if (ins == CMD_OP_SUB)
+							op = DOUBLE_OP_SUB;
+						else if (ins == CMD_OP_MUL)
+							op = DOUBLE_OP_MUL;
+						else if (ins == CMD_OP_DIV)
+							op = DOUBLE_OP_DIV;
+
+						e.doubleOp(op, XMM0, XMM1);
+
+						// the result keeps the type of the left operand
+						if (leftInteger)
+						{
+							e.doubleToInt(RAX, XMM0);
+							storeInteger(dst, RAX);
+						}
+						else
+							storeFloat(dst);
+					}
+					return true;
+				}
+				case CMD_OP_MOD:
+				{
+					if (!integers)
+						return false;
+
+					loadBits(RCX, right);
+					loadBits(RAX, left);
+					e.signExtend();
+					e.divide(RCX);
+					storeInteger(dst, RDX);
+					return true;
+				}
+				case CMD_OP_AND:
+				case CMD_OP_OR:
+				{
+					if (!integers)
+						return false;
+
+					loadBits(RAX, left);
+					loadBits(RCX, right);
+					e.test(RAX);
+					e.setIf(COND_NE, RAX);
+					e.test(RCX);
+					e.setIf(COND_NE, RCX);
+
+					if (ins == CMD_OP_AND)
+						e.andByte(RAX, RCX);
+					else
+						e.orByte(RAX, RCX);
+
+					e.zeroExtendByte(RAX, RAX);
+					storeInteger(dst, RAX);
+					return true;
+				}
+				case CMD_OP_EQL:
+				case CMD_OP_NEQL:
+				case CMD_OP_LT:
+				case CMD_OP_GT:
+				case CMD_OP_LTE:
+				case CMD_OP_GTE:
+				{
+					if (integers)
+					{
+						loadBits(RCX, right);
+						loadBits(RAX, left);
+						e.intOp(INT_OP_CMP, RAX, RCX);
+
+						Condition cond = COND_E;
+						switch (ins)
+						{
+						case CMD_OP_NEQL: cond = COND_NE; break;
+						case CMD_OP_LT: cond = COND_L; break;
+						case CMD_OP_GT: cond = COND_G; break;
+						case CMD_OP_LTE: cond = COND_LE; break;
+						case CMD_OP_GTE: cond = COND_GE; break;
+						default: break;
+						}
+
+						e.setIf(cond, RAX);
+					}
+					else
+					{
+						loadDouble(XMM1, RCX, right, types[1]);
+						loadDouble(XMM0, RAX, left, types[0]);
+
+						// unordered comparisons (NaN) are false, except for !=
+						switch (ins)
+						{
+						case CMD_OP_LT:
+							e.compareDouble(XMM1, XMM0);
+							e.setIf(COND_A, RAX);
+							break;
+						case CMD_OP_LTE:
+							e.compareDouble(XMM1, XMM0);
+							e.setIf(COND_AE, RAX);
+							break;
+						case CMD_OP_GT:
+							e.compareDouble(XMM0, XMM1);
+							e.setIf(COND_A, RAX);
+							break;
+						case CMD_OP_GTE:
+							e.compareDouble(XMM0, XMM1);
+							e.setIf(COND_AE, RAX);
+							break;
+						case CMD_OP_EQL:
+							e.compareDouble(XMM0, XMM1);
+							e.setIf(COND_E, RAX);
+							e.setIf(COND_NP, RCX);
+							e.andByte(RAX, RCX);
+							break;
+						default:
+							e.compareDouble(XMM0, XMM1);
+							e.setIf(COND_NE, RAX);
+							e.setIf(COND_P, RCX);
+							e.orByte(RAX, RCX);
+							break;
+						}
+					}
+
+					e.zeroExtendByte(RAX, RAX);
+
+					if (leftInteger)
+						storeInteger(dst, RAX);
+					else
+					{
+						e.intToDouble(XMM0, RAX);
+						storeFloat(dst);
+					}
+					return true;
+				}
+				default:
+					return false;
+				}
+			}
+
+			void TemplateCompiler::loadBits(Reg dst, const TemplateOperand &operand)
+			{
+				if (operand.constant)
+					e.moveImmediate(dst, operand.bits);
+				else
+					e.loadSlot(dst, displacement(operand.slot, SLOT_BITS));
+			}
+
+			void TemplateCompiler::loadDouble(XmmReg dst, Reg scratch, const TemplateOperand &operand, SlotType type)
+			{
+				if (type == SLOT_INTEGER)
+				{
+					loadBits(scratch, operand);
+					e.intToDouble(dst, scratch);
+				}
+				else if (operand.constant)
+				{
+					e.moveImmediate(scratch, operand.bits);
+					e.moveToXmm(dst, scratch);
+				}
+				else
+					e.loadSlotDouble(dst, displacement(operand.slot, SLOT_BITS));
+			}
+
+			void TemplateCompiler::storeInteger(size_t dst, Reg src)
+			{
+				e.storeSlot(displacement(dst, SLOT_BITS), src);
+				e.storeSlotImmediate(displacement(dst, SLOT_TYPE), SLOT_INTEGER);
+				e.storeSlotImmediate(displacement(dst, SLOT_BOXED), 0);
+			}
+
+			void TemplateCompiler::storeFloat(size_t dst)
+			{
+				e.storeSlotDouble(displacement(dst, SLOT_BITS), XMM0);
+				e.storeSlotImmediate(displacement(dst, SLOT_TYPE), SLOT_FLOAT);
+				e.storeSlotImmediate(displacement(dst, SLOT_BOXED), 0);
+			}
+
+			TemplateOperand TemplateCompiler::operand(size_t index) const
+			{
+				auto &entry = levels.back().values[index];
+				TemplateOperand operand = { entry.constant, entry.type, entry.bits, valueSlot(index) };
+				return operand;
+			}
+
+			const TemplateCall *TemplateCompiler::call(const DecodedInstruction *d,
+				const std::vector<TemplateOperand> &operands, int64_t result, size_t count)
+			{
+				std::unique_ptr<TemplateCall> args(new TemplateCall());
+				args->d = d;
+				args->operands = operands;
+				args->result = result;
+				args->count = count;
+
+				fn.calls.push_back(std::move(args));
+				return fn.calls.back().get();
+			}
+
+			void TemplateCompiler::callHelper(int(*helper)(VM*, Module*, const TemplateCall*, TemplateSlot*),
+				const TemplateCall *args)
+			{
+				e.callHelper((const void*)helper, args);
+			}
+
+			void TemplateCompiler::execute(const DecodedInstruction &d)
+			{
+				callHelper(&executeHelper, call(&d, {}, -1));
+			}
+
+			void TemplateCompiler::push(Evaluator &evaluator, const TemplateOperand &operand, TemplateSlot *slots)
+			{
+				if (operand.constant)
+				{
+					if (operand.type == SLOT_INTEGER)
+						evaluator.loadInteger((long)operand.bits);
+					else
+					{
+						double value;
+						memcpy(&value, &operand.bits, sizeof(double));
+						evaluator.loadFloat(value);
+					}
+					return;
+				}
+
+				auto &slot = slots[operand.slot];
+				if (!slot.boxed)
+				{
+					// the result of an operation, which is not const
+					slot.object = std::make_shared<Object>();
+					if (slot.type == SLOT_INTEGER)
+						slot.object->assign((long)slot.bits);
+					else
+					{
+						double value;
+						memcpy(&value, &slot.bits, sizeof(double));
+						slot.object->assign(value);
+					}
+					slot.boxed = 1;
+				}
+
+				evaluator.loadObject(slot.object);
+			}
+
+			void TemplateCompiler::unbox(TemplateSlot &slot, const ObjectPtr &object)
+			{
+				slot.object = object;
+				slot.boxed = 1;
+
+				if (object != nullptr && object->isInteger())
+				{
+					slot.type = SLOT_INTEGER;
+					slot.bits = (int64_t)object->cast<long>();
+				}
+				else if (object != nullptr && object->isFloat())
+				{
+					double value = object->cast<double>();
+					slot.type = SLOT_FLOAT;
+					memcpy(&slot.bits, &value, sizeof(double));
+				}
+				else
+					slot.type = SLOT_OBJECT;
+			}
+
+			int TemplateCompiler::executeHelper(VM *vm, Module *module, const TemplateCall *call, TemplateSlot *slots)
+			{
+				if (!call->operands.empty())
+				{
+					auto &evaluator = module->getFrame(vm->blockLevel).getEvaluator();
+					for (auto &&operand : call->operands)
+						push(evaluator, operand, slots);
+				}
+
+				if (call->d != nullptr && call->d->ins == CMD_INVOKE)
+					vm->invokeCompiled(*call->d, module);
+				else if (call->d != nullptr)
+				{
+					// unread functions continue from the following instruction
+					if (call->d->ins == CMD_LEAVE_FUNCTION)
+						vm->state->stream->seek((unsigned long)call->d->next);
+
+					vm->execute(*call->d, module);
+				}
+
+				if (call->result >= 0)
+				{
+					auto &stack = module->getFrame(vm->blockLevel).getEvaluator().getStack();
+					unbox(slots[call->result], stack.top());
+					stack.pop();
+				}
+
+				return 0;
+			}
+
+			int TemplateCompiler::takeHelper(VM *vm, Module *module, const TemplateCall *call, TemplateSlot *slots)
+			{
+				for (size_t i = call->operands.size(); i-- > 0;)
+				{
+					size_t slot = call->operands[i].slot;
+					slots[slot + call->count] = std::move(slots[slot]);
+				}
+
+				auto &stack = module->getFrame(vm->blockLevel).getEvaluator().getStack();
+				for (size_t i = call->count; i-- > 0;)
+				{
+					unbox(slots[call->result + i], stack.top());
+					stack.pop();
+				}
+
+				return 0;
+			}
+
+			int TemplateCompiler::reloadHelper(VM *vm, Module *module, const TemplateCall *call, TemplateSlot *slots)
+			{
+				for (auto &&operand : call->operands)
+				{
+					auto &slot = slots[operand.slot];
+					if (slot.boxed)
+					{
+						ObjectPtr object = slot.object;
+						unbox(slot, object);
+					}
+				}
+
+				return 0;
+			}
+
+			int TemplateCompiler::truthHelper(VM *vm, Module *module, const TemplateCall *call, TemplateSlot *slots)
+			{
+				auto &object = slots[call->result].object;
+				return (object ? object->cast<bool>() : false);
+			}
+
+			int TemplateCompiler::ifHelper(VM *vm, Module *module, const TemplateCall *call, TemplateSlot *slots)
+			{
+				bool val = (slots[call->result].bits != 0);
+
+				module->getFrame(vm->blockLevel).setLastIfResult(val);
+				if (val)
+					vm->state->readLevel++;
+
+				return val;
+			}
+
+			int TemplateCompiler::backEdgeHelper(VM *vm, Module *module, const TemplateCall *call, TemplateSlot *slots)
+			{
+				vm->countBackEdge(*call->d, module->getSavedPositions()[call->d->arg0]);
+				return 0;
+			}
+		}
+	}
+}
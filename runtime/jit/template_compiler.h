@@ -0,0 +1,171 @@
+#ifndef __ZENITH_RUNTIME_JIT_TEMPLATE_COMPILER_H__
+#define __ZENITH_RUNTIME_JIT_TEMPLATE_COMPILER_H__
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "x64_emitter.h"
+#include "../instruction.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		class VM;
+		class Module;
+		class Object;
+		class Evaluator;
+
+		typedef std::shared_ptr<Object> ObjectPtr;
+
+		namespace jit
+		{
+			class CompiledFunction;
+
+			enum SlotType
+			{
+				SLOT_INTEGER = 0,
+				SLOT_FLOAT = 1,
+				SLOT_OBJECT = 2
+			};
+
+			/* A value of an expression held by compiled code. Integers and floats
+			   are unboxed into 'bits'. While 'boxed' is set, 'object' is the value
+			   itself, which keeps variables the same object for assignments. */
+			struct TemplateSlot
+			{
+				int64_t bits = 0;
+				int64_t type = SLOT_OBJECT;
+				int64_t boxed = 1;
+				ObjectPtr object;
+			};
+
+			// a constant from the code or a slot
+			struct TemplateOperand
+			{
+				bool constant;
+				SlotType type;
+				int64_t bits;
+				size_t slot;
+			};
+
+			// what generated code passes to a helper
+			struct TemplateCall
+			{
+				const DecodedInstruction *d;
+				std::vector<TemplateOperand> operands;
+				int64_t result; // slot, -1 for none
+				size_t count; // values taken from the frame's expression stack
+			};
+
+			/* Compiles a function body to native code templates. Integer and float
+			   constants are folded into the code, and arithmetic, comparisons, logical
+			   operators, if statements and jumps are generated inline on unboxed slots.
+			   Everything else, including operators on other types, calls into the VM
+			   with the values it uses pushed to the frame's expression stack first.
+			   Values of the enclosing blocks are pushed there before a block is entered,
+			   so only the innermost block has values in slots. The first slots hold the
+			   last if result of each block. */
+			class TemplateCompiler
+			{
+			private:
+				struct Entry
+				{
+					bool constant;
+					SlotType type;
+					int64_t bits;
+					// may be a variable, so it is read again after anything that assigns
+					bool reference;
+				};
+
+				struct Level
+				{
+					// above 'real' values on the frame's own expression stack
+					std::vector<Entry> values;
+					int real;
+
+					// the if, else or read level increase that the next block belongs to
+					Instruction branch;
+					// the level's condition slot holds the frame's last if result
+					bool ifKnown;
+				};
+
+				CompiledFunction &fn;
+				X64Emitter e;
+
+				std::vector<Level> levels;
+				size_t numCells;
+				size_t numValues;
+
+				std::map<int32_t, size_t> blockIndex;
+				std::map<int32_t, std::pair<size_t, int>> blockStates; // block id -> (level, values on the frame)
+				std::vector<size_t> blockEnds; // INC_BLOCK_LEVEL -> index after its DEC_BLOCK_LEVEL, 0 if not decoded
+				std::vector<bool> jumpTargets; // by CREATE_BLOCK index
+
+				std::vector<size_t> labels;
+				std::vector<std::pair<size_t, size_t>> branches; // (patch offset, target index)
+				std::vector<std::pair<size_t, size_t>> tails; // (patch offset, INC_BLOCK_LEVEL index)
+				std::vector<size_t> exits;
+
+				TemplateCompiler(CompiledFunction &fn);
+
+				bool prepare();
+				bool compileInstruction(size_t index);
+
+				bool enterBlock(size_t index);
+				bool jump(size_t index);
+				bool ifStatement(size_t index);
+				bool operation(size_t index, size_t numOperands);
+				bool callVM(const DecodedInstruction &d, size_t needs, size_t leaves, bool assigns);
+
+				bool take(size_t count);
+				void spill();
+				void reload(size_t count);
+				void push(const Entry &entry);
+				bool matchBlockState(int32_t id);
+
+				void typeSwitch(Instruction ins, const std::vector<TemplateOperand> &operands,
+					std::vector<SlotType> &types, size_t dst, std::vector<size_t> &slow, std::vector<size_t> &done);
+				bool emitOperation(Instruction ins, const std::vector<TemplateOperand> &operands,
+					const std::vector<SlotType> &types, size_t dst);
+
+				void loadBits(Reg dst, const TemplateOperand &operand);
+				void loadDouble(XmmReg dst, Reg scratch, const TemplateOperand &operand, SlotType type);
+				void storeInteger(size_t dst, Reg src);
+				void storeFloat(size_t dst);
+
+				const TemplateCall *call(const DecodedInstruction *d, const std::vector<TemplateOperand> &operands,
+					int64_t result, size_t count = 0);
+				void callHelper(int(*helper)(VM*, Module*, const TemplateCall*, TemplateSlot*), const TemplateCall *args);
+				void execute(const DecodedInstruction &d);
+
+				size_t cellSlot() const { return levels.size() - 1; }
+				size_t valueSlot(size_t index) const { return numCells + index; }
+				TemplateOperand operand(size_t index) const;
+
+				static int32_t displacement(size_t slot, size_t field) { return (int32_t)(slot * sizeof(TemplateSlot) + field); }
+
+				static void push(Evaluator &evaluator, const TemplateOperand &operand, TemplateSlot *slots);
+				static void unbox(TemplateSlot &slot, const ObjectPtr &object);
+
+				// helpers called from generated code
+				static int executeHelper(VM *vm, Module *module, const TemplateCall *call, TemplateSlot *slots);
+				static int takeHelper(VM *vm, Module *module, const TemplateCall *call, TemplateSlot *slots);
+				static int reloadHelper(VM *vm, Module *module, const TemplateCall *call, TemplateSlot *slots);
+				static int truthHelper(VM *vm, Module *module, const TemplateCall *call, TemplateSlot *slots);
+				static int ifHelper(VM *vm, Module *module, const TemplateCall *call, TemplateSlot *slots);
+				static int backEdgeHelper(VM *vm, Module *module, const TemplateCall *call, TemplateSlot *slots);
+
+			public:
+				/* Generate fn's code from its decoded instructions. Returns false if
+				   the function does something the templates do not handle. */
+				static bool compile(CompiledFunction &fn);
+			};
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,146 @@
+#include "tier_manager.h"
+
+#include "../vm.h"
+#include "../module.h"
+#include "../bytereader.h"
+#include "../experimental/vm_state.h"
+
+#include "../../util/logger.h"
+
+namespace zenith
+{
+	using namespace util;
+
+	namespace runtime
+	{
+		namespace jit
+		{
+			const char *tierName(ExecutionTier tier)
+			{
+				switch (tier)
+				{
+				case TIER_INTERPRETED:
+					return "interpreted";
+				case TIER_QUICKENED:
+					return "quickened";
+				case TIER_BASELINE:
+					return "baseline";
+				default:
+					return "unknown";
+				}
+			}
+
+			TierManager::TierManager(const JitOptions &options, BaselineJit *baseline)
+			{
+				this->options = options;
+				this->baseline = baseline;
+
+				numLoopsQuickened = 0;
+				numLoopEntries = 0;
+			}
+
+			FunctionTier *TierManager::getFunction(unsigned long location)
+			{
+				auto &fn = functions[location];
+				fn.location = location;
+				return &fn;
+			}
+
+			void TierManager::nameFunction(unsigned long location, const std::string &name)
+			{
+				auto &fn = functions[location];
+				if (fn.name.empty())
+				{
+					fn.location = location;
+					fn.name = name;
+				}
+			}
+
+			void TierManager::onCall(VMState *state, FunctionTier &fn)
+			{
+				fn.calls++;
+
+				if (baseline != nullptr && !fn.compileAttempted &&
+					baseline->shouldCompile(fn.calls, fn.backEdges))
+				{
+					fn.compileAttempted = true;
+					fn.compiled = baseline->compile(state, fn.location);
+
+					if (fn.compiled != nullptr)
+					{
+						fn.tier = TIER_BASELINE;
+						return;
+					}
+				}
+
+				if (fn.tier == TIER_INTERPRETED && !fn.quickenAttempted &&
+					(fn.calls >= options.quickenCallThreshold || fn.backEdges >= options.quickenBackEdgeThreshold))
+				{
+					fn.quickenAttempted = true;
+					fn.quickened = QuickenedCode::quickenFunction(state->stream, fn.location);
+
+					if (fn.quickened != nullptr)
+					{
+						fn.tier = TIER_QUICKENED;
+						debug_log("Tier: quickened function at position: %d (%d instructions)",
+							fn.location, fn.quickened->size());
+					}
+				}
+			}
+
+			bool TierManager::onBackEdge(VM *vm, Module *module, const DecodedInstruction &d, uint64_t target)
+			{
+				auto it = loops.find(d.position);
+				if (it == loops.end())
+				{
+					if (++backEdgeCounts[d.position] < options.quickenBackEdgeThreshold)
+						return false;
+
+					auto code = QuickenedCode::quickenLoop(vm->state->stream, target, d.next);
+					if (code != nullptr)
+					{
+						numLoopsQuickened++;
+						debug_log("Tier: quickened loop at position: %d (%d instructions)",
+							target, code->size());
+					}
+
+					it = loops.emplace(d.position, std::move(code)).first;
+				}
+
+				if (it->second == nullptr)
+					return false;
+
+				// continue the running loop from its header
+				numLoopEntries++;
+				it->second->run(vm, module, 0);
+
+				return true;
+			}
+
+			size_t TierManager::getNumFunctions(ExecutionTier tier) const
+			{
+				size_t count = 0;
+				for (auto &&it : functions)
+				{
+					if (it.second.calls != 0 && it.second.tier == tier)
+						count++;
+				}
+				return count;
+			}
+
+			void TierManager::printFunctions(std::ostream &os) const
+			{
+				for (auto &&it : functions)
+				{
+					auto &fn = it.second;
+					if (fn.calls == 0)
+						continue;
+
+					os << (fn.name.empty() ? "<anonymous>" : fn.name)
+						<< " at position " << fn.location << ": " << tierName(fn.tier)
+						<< " (calls: " << fn.calls << ", back-edges: " << fn.backEdges << ")\n";
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,100 @@
+#ifndef __ZENITH_RUNTIME_JIT_TIER_MANAGER_H__
+#define __ZENITH_RUNTIME_JIT_TIER_MANAGER_H__
+
+#include <map>
+#include <memory>
+#include <string>
+#include <ostream>
+
+#include "baseline_jit.h"
+#include "quickened_code.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		class VM;
+		class Module;
+		struct VMState;
+
+		namespace jit
+		{
+			enum ExecutionTier
+			{
+				TIER_INTERPRETED, // decoded from the loaded image as it runs
+				TIER_QUICKENED, // pre-decoded and quickened
+				TIER_BASELINE // native code from the baseline JIT
+			};
+
+			const char *tierName(ExecutionTier tier);
+
+			/* Tier state of a function, shared by every function object created
+			   from the same body. */
+			struct FunctionTier
+			{
+				std::string name;
+				unsigned long location = 0;
+
+				unsigned long calls = 0;
+				unsigned long backEdges = 0;
+
+				ExecutionTier tier = TIER_INTERPRETED;
+
+				std::unique_ptr<QuickenedCode> quickened;
+				CompiledFunction *compiled = nullptr;
+
+				bool quickenAttempted = false;
+				bool compileAttempted = false;
+			};
+
+			/* Promotes functions and loops between tiers as they get hot. Every function
+			   starts out interpreted; functions that cross the call or back-edge thresholds
+			   are quickened, and compiled by the baseline JIT when it is enabled. A loop
+			   running in the interpreter that crosses the back-edge threshold is switched
+			   over to quickened code at its back-edge. */
+			class TierManager
+			{
+			private:
+				JitOptions options;
+				BaselineJit *baseline;
+
+				// function location -> tier state
+				std::map<unsigned long, FunctionTier> functions;
+
+				// back-edge position -> times taken
+				std::map<uint64_t, unsigned long> backEdgeCounts;
+				// back-edge position -> quickened loop (nullptr when it cannot be quickened)
+				std::map<uint64_t, std::unique_ptr<QuickenedCode>> loops;
+
+				size_t numLoopsQuickened;
+				unsigned long numLoopEntries;
+
+			public:
+				TierManager(const JitOptions &options, BaselineJit *baseline);
+
+				const JitOptions &getOptions() const { return options; }
+
+				FunctionTier *getFunction(unsigned long location);
+				void nameFunction(unsigned long location, const std::string &name);
+
+				/* Called each time a function is invoked, before it runs. */
+				void onCall(VMState *state, FunctionTier &fn);
+
+				/* Called when the interpreter takes a backwards jump. Returns true if
+				   the loop was run by quickened code, in which case the stream is
+				   already positioned where execution continues. */
+				bool onBackEdge(VM *vm, Module *module, const DecodedInstruction &d, uint64_t target);
+
+				const std::map<unsigned long, FunctionTier> &getFunctions() const { return functions; }
+				size_t getNumFunctions(ExecutionTier tier) const;
+				size_t getNumLoopsQuickened() const { return numLoopsQuickened; }
+				unsigned long getNumLoopEntries() const { return numLoopEntries; }
+
+				/* Write the tier of every function that was called. */
+				void printFunctions(std::ostream &os) const;
+			};
+		}
+	}
+}
+
+#endif
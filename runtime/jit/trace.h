@@ -0,0 +1,119 @@
+#ifndef __ZENITH_RUNTIME_JIT_TRACE_H__
+#define __ZENITH_RUNTIME_JIT_TRACE_H__
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "executable_memory.h"
+#include "../instruction.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		namespace jit
+		{
+			enum TraceType
+			{
+				TRACE_TYPE_INTEGER,
+				TRACE_TYPE_FLOAT
+			};
+
+			/* An instruction as it was executed while recording a loop iteration.
+			   Levels are relative to the block level of the loop header. */
+			struct TraceOp
+			{
+				DecodedInstruction d;
+				bool active;
+
+				int blockLevel;
+				int readLevel;
+
+				// LOAD_VARIABLE: type of the variable, IF_STATEMENT: type of the condition
+				TraceType observedType;
+				// IF_STATEMENT: the condition result
+				bool condition;
+			};
+
+			struct TraceRecording
+			{
+				uint64_t header; // position jumped to by the back-edge
+				uint64_t backEdge; // position of the back-edge instruction
+				std::vector<TraceOp> ops;
+			};
+
+			/* The recorded path through the loop body. When a guard keeps failing,
+			   the rest of the iteration along the other path is recorded as well
+			   and attached as a branch at the index of the guard. */
+			struct TraceTree
+			{
+				std::vector<TraceOp> ops;
+
+				// op index of guard -> branch (nullptr when it could not be recorded)
+				std::map<size_t, std::unique_ptr<TraceTree>> branches;
+			};
+
+			struct TraceVariable
+			{
+				std::string name;
+				TraceType type; // type on entry, which is also the type at the back-edge
+				bool written;
+			};
+
+			/* A guard that failed. The interpreter continues as if the guarded
+			   IF_STATEMENT had just been executed with the opposite result. */
+			struct TraceExit
+			{
+				uint64_t resume;
+				int blockLevel;
+				int readLevel;
+				bool result;
+
+				// known if results of the frames above the loop header
+				std::vector<std::pair<int, bool>> ifResults;
+				// variable types at the point of the exit
+				std::vector<TraceType> types;
+
+				// the guard that failed
+				TraceTree *node;
+				size_t opIndex;
+
+				unsigned long taken = 0;
+			};
+
+			class Trace
+			{
+			private:
+				typedef int(*EntryPoint)(int64_t *slots);
+
+				ExecutableMemory memory;
+
+				friend class TraceCompiler;
+
+			public:
+				uint64_t header;
+				uint64_t backEdge;
+
+				TraceTree root;
+
+				std::vector<TraceVariable> variables;
+				std::vector<TraceExit> exits;
+				size_t numSlots;
+				size_t numBranches = 0;
+
+				/* Run the loop until a guard fails. Returns the index of the exit. */
+				int run(int64_t *slots) const
+				{
+					return ((EntryPoint)memory.data())(slots);
+				}
+
+				size_t codeSize() const { return memory.size(); }
+			};
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,658 @@
+#include "trace_compiler.h"
+
+#include <cstring>
+
+#include "../../util/logger.h"
+
+namespace zenith
+{
+	using namespace util;
+
+	namespace runtime
+	{
+		namespace jit
+		{
+			TraceCompiler::TraceCompiler(const Trace &trace)
+				: trace(trace)
+			{
+				top = 0;
+				numTemporaries = 0;
+			}
+
+			bool TraceCompiler::compile(Trace &trace)
+			{
+#if defined(__x86_64__) || defined(_M_X64)
+				for (;;)
+				{
+					TraceCompiler compiler(trace);
+					compiler.collectVariables(trace.root);
+
+					auto &e = compiler.e;
+					e.prologue();
+
+					compiler.top = e.offset();
+
+					if (!compiler.compileNode(trace.root))
+						return false;
+
+					bool dropped = false;
+					while (!compiler.pending.empty())
+					{
+						auto branch = compiler.pending.back();
+						compiler.pending.pop_back();
+
+						e.patch(branch.jump, e.offset());
+
+						// continue from the state at the guard, on the other path
+						compiler.stacks = branch.stacks;
+						compiler.ifResults = branch.ifResults;
+						compiler.types = branch.types;
+
+						auto &slot = branch.node->branches[branch.index];
+						if (!compiler.compileNode(*slot))
+						{
+							debug_log("Trace: dropping branch at position: %d",
+								branch.node->ops[branch.index].d.position);
+
+							slot = nullptr;
+							dropped = true;
+							break;
+						}
+					}
+
+					// start over without the branch
+					if (dropped)
+						continue;
+
+					// each exit returns its index
+					std::vector<size_t> toEpilogue;
+					for (size_t i = 0; i < compiler.exits.size(); i++)
+					{
+						compiler.exitStubs.push_back(e.offset());
+						e.moveImmediate32(RAX, (int32_t)i);
+						toEpilogue.push_back(e.jump());
+					}
+
+					for (auto &&jump : compiler.exitJumps)
+						e.patch(jump.first, compiler.exitStubs[jump.second]);
+
+					size_t epilogue = e.offset();
+					e.epilogue();
+
+					for (auto &&at : toEpilogue)
+						e.patch(at, epilogue);
+
+					if (!trace.memory.load(e.code().data(), e.code().size()))
+						return false;
+
+					trace.variables = compiler.variables;
+					trace.exits = compiler.exits;
+					trace.numSlots = compiler.variables.size() + compiler.numTemporaries;
+
+					debug_log("Trace: compiled loop at position: %d (%d exits, %d bytes)",
+						trace.header, trace.exits.size(), trace.codeSize());
+
+					return true;
+				}
+#else
+				return false;
+#endif
+			}
+
+			bool TraceCompiler::compileNode(TraceTree &node)
+			{
+				for (size_t i = 0; i < node.ops.size(); i++)
+				{
+					auto &op = node.ops[i];
+
+					if (op.active && op.d.ins == CMD_GO_TO_IF_TRUE && op.d.position == trace.backEdge)
+					{
+						// the loop must leave its variables with the types it started with
+						for (size_t j = 0; j < variables.size(); j++)
+						{
+							if (types[j] != variables[j].type)
+								return false;
+						}
+
+						if (!stacks[0].empty())
+							return false;
+
+						e.patch(e.jump(), top);
+						return true;
+					}
+
+					if (!compileOp(op, node, i))
+					{
+						debug_log("Trace: cannot compile instruction %d at position: %d",
+							(int)op.d.ins, op.d.position);
+						return false;
+					}
+				}
+
+				// the recording always ends with the back-edge
+				return false;
+			}
+
+			void TraceCompiler::collectVariables(const TraceTree &node)
+			{
+				for (auto &&op : node.ops)
+				{
+					if (op.active && op.d.ins == CMD_LOAD_VARIABLE &&
+						variableIndex.find(op.d.name) == variableIndex.end())
+					{
+						variableIndex[op.d.name] = variables.size();
+						variables.push_back({ op.d.name, op.observedType, false });
+						types.push_back(op.observedType);
+					}
+				}
+
+				for (auto &&branch : node.branches)
+				{
+					if (branch.second != nullptr)
+						collectVariables(*branch.second);
+				}
+			}
+
+			TraceCompiler::Value TraceCompiler::resolve(const Value &value) const
+			{
+				Value result = value;
+				if (value.variable != -1)
+					result.type = types[value.variable];
+				return result;
+			}
+
+			TraceCompiler::Value TraceCompiler::temporary(TraceType type)
+			{
+				Value value;
+				value.constant = false;
+				value.variable = -1;
+				value.slot = variables.size() + numTemporaries++;
+				value.type = type;
+				value.bits = 0;
+				return value;
+			}
+
+			TraceCompiler::Value TraceCompiler::variable(size_t index) const
+			{
+				Value value;
+				value.constant = false;
+				value.variable = (int)index;
+				value.slot = index;
+				value.type = types[index];
+				value.bits = 0;
+				return value;
+			}
+
+			bool TraceCompiler::pop(int level, Value &out)
+			{
+				auto &stack = stacks[level];
+				if (stack.empty())
+					return false;
+
+				out = resolve(stack.back());
+				stack.pop_back();
+				return true;
+			}
+
+			void TraceCompiler::loadBits(Reg dst, const Value &value)
+			{
+				if (value.constant)
+					e.moveImmediate(dst, value.bits);
+				else
+					e.load(dst, displacement(value.slot));
+			}
+
+			void TraceCompiler::loadDouble(XmmReg dst, Reg scratch, const Value &value)
+			{
+				if (value.type == TRACE_TYPE_INTEGER)
+				{
+					loadBits(scratch, value);
+					e.intToDouble(dst, scratch);
+				}
+				else if (value.constant)
+				{
+					e.moveImmediate(scratch, value.bits);
+					e.moveToXmm(dst, scratch);
+				}
+				else
+					e.loadDouble(dst, displacement(value.slot));
+			}
+
+			void TraceCompiler::storeResult(const Value &dst, bool inXmm)
+			{
+				if (inXmm)
+					e.storeDouble(displacement(dst.slot), XMM0);
+				else
+					e.store(displacement(dst.slot), RAX);
+			}
+
+			bool TraceCompiler::binaryOp(Instruction ins, const Value &left, const Value &right, const Value &dst)
+			{
+				bool integers = (left.type == TRACE_TYPE_INTEGER && right.type == TRACE_TYPE_INTEGER);
+				bool leftInteger = (left.type == TRACE_TYPE_INTEGER);
+
+				switch (ins)
+				{
+				case CMD_OP_ADD:
+				case CMD_OP_SUB:
+				case CMD_OP_MUL:
+				case CMD_OP_DIV:
+				{
+					if (integers)
+					{
+						loadBits(RCX, right);
+						loadBits(RAX, left);
+
+						if (ins == CMD_OP_ADD)
+							e.intOp(INT_OP_ADD, RAX, RCX);
+						else if (ins == CMD_OP_SUB)
+							e.intOp(INT_OP_SUB, RAX, RCX);
+						else if (ins == CMD_OP_MUL)
+							e.intOp(INT_OP_IMUL, RAX, RCX);
+						else
+						{
+							e.signExtend();
+							e.divide(RCX);
+						}
+
+						storeResult(dst, false);
+					}
+					else
+					{
+						loadDouble(XMM1, RCX, right);
+						loadDouble(XMM0, RAX, left);
+
+						DoubleOp op = DOUBLE_OP_ADD;
+						if (ins == CMD_OP_SUB)
+							op = DOUBLE_OP_SUB;
+						else if (ins == CMD_OP_MUL)
+							op = DOUBLE_OP_MUL;
+						else if (ins == CMD_OP_DIV)
+							op = DOUBLE_OP_DIV;
+
+						e.doubleOp(op, XMM0, XMM1);
+
+						// the result keeps the type of the left operand
+						if (leftInteger)
+						{
+							e.doubleToInt(RAX, XMM0);
+							storeResult(dst, false);
+						}
+						else
+							storeResult(dst, true);
+					}
+					return true;
+				}
+				case CMD_OP_MOD:
+				{
+					if (!integers)
+						return false;
+
+					loadBits(RCX, right);
+					loadBits(RAX, left);
+					e.signExtend();
+					e.divide(RCX);
+					e.store(displacement(dst.slot), RDX);
+					return true;
+				}
+				case CMD_OP_AND:
+				case CMD_OP_OR:
+				{
+					if (!integers)
+						return false;
+
+					loadBits(RAX, left);
+					loadBits(RCX, right);
+					e.test(RAX);
+					e.setIf(COND_NE, RAX);
+					e.test(RCX);
+					e.setIf(COND_NE, RCX);
+
+					if (ins == CMD_OP_AND)
+						e.andByte(RAX, RCX);
+					else
+						e.orByte(RAX, RCX);
+
+					e.zeroExtendByte(RAX, RAX);
+					storeResult(dst, false);
+					return true;
+				}
+				case CMD_OP_EQL:
+				case CMD_OP_NEQL:
+				case CMD_OP_LT:
+				case CMD_OP_GT:
+				case CMD_OP_LTE:
+				case CMD_OP_GTE:
+				{
+					if (integers)
+					{
+						loadBits(RCX, right);
+						loadBits(RAX, left);
+						e.intOp(INT_OP_CMP, RAX, RCX);
+
+						Condition cond = COND_E;
+						switch (ins)
+						{
+						case CMD_OP_NEQL: cond = COND_NE; break;
+						case CMD_OP_LT: cond = COND_L; break;
+						case CMD_OP_GT: cond = COND_G; break;
+						case CMD_OP_LTE: cond = COND_LE; break;
+						case CMD_OP_GTE: cond = COND_GE; break;
+						default: break;
+						}
+
+						e.setIf(cond, RAX);
+					}
+					else
+					{
+						loadDouble(XMM1, RCX, right);
+						loadDouble(XMM0, RAX, left);
+
+						// unordered comparisons (NaN) are false, except for !=
+						switch (ins)
+						{
+						case CMD_OP_LT:
+							e.compareDouble(XMM1, XMM0);
+							e.setIf(COND_A, RAX);
+							break;
+						case CMD_OP_LTE:
+							e.compareDouble(XMM1, XMM0);
+							e.setIf(COND_AE, RAX);
+							break;
+						case CMD_OP_GT:
+							e.compareDouble(XMM0, XMM1);
+							e.setIf(COND_A, RAX);
+							break;
+						case CMD_OP_GTE:
+							e.compareDouble(XMM0, XMM1);
+							e.setIf(COND_AE, RAX);
+							break;
+						case CMD_OP_EQL:
+							e.compareDouble(XMM0, XMM1);
+							e.setIf(COND_E, RAX);
+							e.setIf(COND_NP, RCX);
+							e.andByte(RAX, RCX);
+							break;
+						default:
+							e.compareDouble(XMM0, XMM1);
+							e.setIf(COND_NE, RAX);
+							e.setIf(COND_P, RCX);
+							e.orByte(RAX, RCX);
+							break;
+						}
+					}
+
+					e.zeroExtendByte(RAX, RAX);
+
+					if (leftInteger)
+						storeResult(dst, false);
+					else
+					{
+						e.intToDouble(XMM0, RAX);
+						storeResult(dst, true);
+					}
+					return true;
+				}
+				default:
+					return false;
+				}
+			}
+
+			bool TraceCompiler::unaryOp(Instruction ins, const Value &value, const Value &dst)
+			{
+				bool integer = (value.type == TRACE_TYPE_INTEGER);
+
+				if (ins == CMD_OP_UNARY_NEG)
+				{
+					loadBits(RAX, value);
+					if (integer)
+						e.negate(RAX);
+					else
+					{
+						// flip the sign bit
+						e.moveImmediate(RCX, INT64_MIN);
+						e.intOp(INT_OP_XOR, RAX, RCX);
+					}
+					storeResult(dst, false);
+				}
+				else
+				{
+					if (integer)
+					{
+						loadBits(RAX, value);
+						e.test(RAX);
+						e.setIf(COND_E, RAX);
+						e.zeroExtendByte(RAX, RAX);
+						storeResult(dst, false);
+					}
+					else
+					{
+						loadDouble(XMM0, RAX, value);
+						e.clearXmm(XMM1);
+						e.compareDouble(XMM0, XMM1);
+						e.setIf(COND_E, RAX);
+						e.setIf(COND_NP, RCX);
+						e.andByte(RAX, RCX);
+						e.zeroExtendByte(RAX, RAX);
+						e.intToDouble(XMM0, RAX);
+						storeResult(dst, true);
+					}
+				}
+
+				return true;
+			}
+
+			bool TraceCompiler::guard(const TraceOp &op, const Value &cond, TraceTree &node, size_t index)
+			{
+				if (cond.type != op.observedType)
+					return false;
+
+				if (cond.constant)
+				{
+					bool value;
+					if (cond.type == TRACE_TYPE_INTEGER)
+						value = (cond.bits != 0);
+					else
+					{
+						double d;
+						memcpy(&d, &cond.bits, sizeof(double));
+						value = (d != 0.0);
+					}
+
+					// a constant condition never needs a guard
+					return value == op.condition;
+				}
+
+				if (cond.type == TRACE_TYPE_INTEGER)
+				{
+					loadBits(RAX, cond);
+					e.test(RAX);
+				}
+				else
+				{
+					loadDouble(XMM0, RAX, cond);
+					e.clearXmm(XMM1);
+					e.compareDouble(XMM0, XMM1);
+					e.setIf(COND_NE, RAX);
+					e.setIf(COND_P, RCX);
+					e.orByte(RAX, RCX);
+					e.testByte(RAX);
+				}
+
+				size_t jump = e.jumpIf(op.condition ? COND_E : COND_NE);
+
+				auto branch = node.branches.find(index);
+				if (branch != node.branches.end() && branch->second != nullptr)
+				{
+					PendingBranch pendingBranch;
+					pendingBranch.jump = jump;
+					pendingBranch.node = &node;
+					pendingBranch.index = index;
+					pendingBranch.stacks = stacks;
+					pendingBranch.ifResults = ifResults;
+					pendingBranch.ifResults[op.blockLevel] = !op.condition;
+					pendingBranch.types = types;
+
+					pending.push_back(pendingBranch);
+					return true;
+				}
+
+				TraceExit exit;
+				exit.resume = op.d.next;
+				exit.blockLevel = op.blockLevel;
+				exit.readLevel = op.readLevel;
+				exit.result = !op.condition;
+				exit.ifResults.assign(ifResults.begin(), ifResults.end());
+				exit.types = types;
+				exit.node = &node;
+				exit.opIndex = index;
+
+				exitJumps.push_back({ jump, exits.size() });
+				exits.push_back(exit);
+
+				return true;
+			}
+
+			bool TraceCompiler::compileOp(const TraceOp &op, TraceTree &node, size_t index)
+			{
+				int level = op.blockLevel;
+
+				// structure is tracked whether or not the instruction is active
+				if (op.d.ins == CMD_INC_BLOCK_LEVEL)
+				{
+					stacks[level + 1].clear();
+					ifResults.erase(level + 1);
+					return true;
+				}
+				else if (op.d.ins == CMD_DEC_BLOCK_LEVEL)
+				{
+					stacks.erase(level);
+					ifResults.erase(level);
+					return true;
+				}
+
+				if (!op.active)
+					return true;
+
+				switch (op.d.ins)
+				{
+				case CMD_INC_READ_LEVEL:
+				case CMD_DEC_READ_LEVEL:
+				case CMD_CREATE_BLOCK:
+				case CMD_LEAVE_IF_STATEMENT:
+				case CMD_LEAVE_ELSE_STATEMENT:
+				case CMD_OP_UNARY_POS:
+					return true;
+				case CMD_GO_TO_IF_TRUE:
+					// only the back-edge is recorded, handled by compileNode()
+					return false;
+				case CMD_ELSE_STATEMENT:
+					// known from the guard of the matching if statement
+					return ifResults.find(level) != ifResults.end();
+				case CMD_OP_CLEAR:
+					stacks[level].clear();
+					return true;
+				case CMD_LOAD_INTEGER:
+				{
+					Value value = { true, -1, 0, TRACE_TYPE_INTEGER, (int64_t)op.d.intValue };
+					stacks[level].push_back(value);
+					return true;
+				}
+				case CMD_LOAD_FLOAT:
+				{
+					Value value = { true, -1, 0, TRACE_TYPE_FLOAT, 0 };
+					memcpy(&value.bits, &op.d.floatValue, sizeof(double));
+					stacks[level].push_back(value);
+					return true;
+				}
+				case CMD_LOAD_VARIABLE:
+				{
+					size_t index = variableIndex[op.d.name];
+					if (types[index] != op.observedType)
+						return false;
+
+					stacks[level].push_back(variable(index));
+					return true;
+				}
+				case CMD_IF_STATEMENT:
+				{
+					Value cond;
+					if (!pop(level, cond) || !guard(op, cond, node, index))
+						return false;
+
+					ifResults[level] = op.condition;
+					return true;
+				}
+				case CMD_OP_UNARY_NEG:
+				case CMD_OP_UNARY_NOT:
+				{
+					Value value;
+					if (!pop(level, value))
+						return false;
+
+					Value result = temporary(value.type);
+					if (!unaryOp(op.d.ins, value, result))
+						return false;
+
+					stacks[level].push_back(result);
+					return true;
+				}
+				case CMD_OP_ASSIGN:
+				{
+					Value right, left;
+					if (!pop(level, right) || !pop(level, left) || left.variable == -1)
+						return false;
+
+					loadBits(RAX, right);
+					e.store(displacement(left.slot), RAX);
+
+					// assignment copies the type of the right side
+					types[left.variable] = right.type;
+					variables[left.variable].written = true;
+
+					stacks[level].push_back(variable(left.variable));
+					return true;
+				}
+				case CMD_OP_ADD_ASSIGN:
+				case CMD_OP_SUB_ASSIGN:
+				case CMD_OP_MUL_ASSIGN:
+				case CMD_OP_DIV_ASSIGN:
+				{
+					Value right, left;
+					if (!pop(level, right) || !pop(level, left) || left.variable == -1)
+						return false;
+
+					Instruction ins = CMD_OP_ADD;
+					if (op.d.ins == CMD_OP_SUB_ASSIGN)
+						ins = CMD_OP_SUB;
+					else if (op.d.ins == CMD_OP_MUL_ASSIGN)
+						ins = CMD_OP_MUL;
+					else if (op.d.ins == CMD_OP_DIV_ASSIGN)
+						ins = CMD_OP_DIV;
+
+					if (!binaryOp(ins, left, right, left))
+						return false;
+
+					variables[left.variable].written = true;
+
+					stacks[level].push_back(variable(left.variable));
+					return true;
+				}
+				default:
+				{
+					Value right, left;
+					if (!pop(level, right) || !pop(level, left))
+						return false;
+
+					Value result = temporary(left.type);
+					if (!binaryOp(op.d.ins, left, right, result))
+						return false;
+
+					stacks[level].push_back(result);
+					return true;
+				}
+				}
+			}
+		}
+	}
+}
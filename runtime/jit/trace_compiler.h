@@ -0,0 +1,98 @@
+#ifndef __ZENITH_RUNTIME_JIT_TRACE_COMPILER_H__
+#define __ZENITH_RUNTIME_JIT_TRACE_COMPILER_H__
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "trace.h"
+#include "x64_emitter.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		namespace jit
+		{
+			/* Compiles a recorded loop iteration into a native loop over unboxed
+			   integer and float slots. Variables occupy the first slots, followed
+			   by temporaries for intermediate results. Every IF_STATEMENT becomes
+			   a guard that leaves the trace when the condition differs from the
+			   recorded one, or continues into the branch recorded for the other
+			   path. */
+			class TraceCompiler
+			{
+			private:
+				struct Value
+				{
+					bool constant;
+					int variable; // -1 for temporaries and constants
+					size_t slot;
+					TraceType type;
+					int64_t bits;
+				};
+
+				// a branch to compile after the path containing its guard
+				struct PendingBranch
+				{
+					size_t jump;
+					TraceTree *node;
+					size_t index;
+
+					std::map<int, std::vector<Value>> stacks;
+					std::map<int, bool> ifResults;
+					std::vector<TraceType> types;
+				};
+
+				const Trace &trace;
+				X64Emitter e;
+				size_t top;
+
+				std::vector<TraceVariable> variables;
+				std::map<std::string, size_t> variableIndex;
+				std::vector<TraceType> types;
+
+				// abstract expression stack for each frame above the loop header
+				std::map<int, std::vector<Value>> stacks;
+				std::map<int, bool> ifResults;
+
+				size_t numTemporaries;
+
+				std::vector<TraceExit> exits;
+				std::vector<std::pair<size_t, size_t>> exitJumps; // (patch offset, exit index)
+				std::vector<size_t> exitStubs;
+
+				std::vector<PendingBranch> pending;
+
+				TraceCompiler(const Trace &trace);
+
+				void collectVariables(const TraceTree &node);
+				bool compileNode(TraceTree &node);
+				bool compileOp(const TraceOp &op, TraceTree &node, size_t index);
+
+				bool pop(int level, Value &out);
+				Value resolve(const Value &value) const;
+				Value temporary(TraceType type);
+				Value variable(size_t index) const;
+
+				static int32_t displacement(size_t slot) { return (int32_t)(slot * sizeof(int64_t)); }
+
+				void loadBits(Reg dst, const Value &value);
+				void loadDouble(XmmReg dst, Reg scratch, const Value &value);
+				void storeResult(const Value &dst, bool inXmm);
+
+				bool binaryOp(Instruction ins, const Value &left, const Value &right, const Value &dst);
+				bool unaryOp(Instruction ins, const Value &value, const Value &dst);
+				bool guard(const TraceOp &op, const Value &cond, TraceTree &node, size_t index);
+
+			public:
+				/* Generates the code for trace.root and its branches. Branches that
+				   cannot be compiled are dropped. Returns false if the root cannot
+				   be compiled. */
+				static bool compile(Trace &trace);
+			};
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,157 @@
+#include "trace_recorder.h"
+
+#include "../vm.h"
+#include "../module.h"
+#include "../experimental/vm_state.h"
+#include "../experimental/object.h"
+
+#include "../../util/logger.h"
+
+namespace zenith
+{
+	using namespace util;
+
+	namespace runtime
+	{
+		namespace jit
+		{
+			TraceRecorder::TraceRecorder(size_t maxLength)
+			{
+				this->maxLength = maxLength;
+				recording = false;
+				baseLevel = 0;
+			}
+
+			void TraceRecorder::start(uint64_t header, uint64_t backEdge, int baseLevel)
+			{
+				this->baseLevel = baseLevel;
+
+				current = TraceRecording();
+				current.header = header;
+				current.backEdge = backEdge;
+
+				recording = true;
+			}
+
+			void TraceRecorder::stop()
+			{
+				recording = false;
+			}
+
+			Object *TraceRecorder::findVariable(VM *vm, Module *module, const std::string &name)
+			{
+				for (int level = vm->blockLevel; level >= -1; level--)
+				{
+					auto *local = module->getFrame(level).findLocal(name);
+					if (local != nullptr)
+						return local->get();
+				}
+
+				return nullptr;
+			}
+
+			RecordStatus TraceRecorder::record(VM *vm, Module *module, const DecodedInstruction &d)
+			{
+				TraceOp op;
+				op.d = d;
+				op.active = (vm->state->readLevel == vm->blockLevel);
+				op.blockLevel = vm->blockLevel - baseLevel;
+				op.readLevel = vm->state->readLevel - baseLevel;
+				op.observedType = TRACE_TYPE_INTEGER;
+				op.condition = false;
+
+				if (op.blockLevel < 0 || current.ops.size() >= maxLength)
+					return RECORD_ABORTED;
+
+				if (d.position == current.backEdge)
+				{
+					// the iteration must end by jumping back to the header
+					if (!op.active || op.blockLevel != 0 ||
+						!module->getFrame(vm->blockLevel).getLastIfResult())
+						return RECORD_ABORTED;
+
+					current.ops.push_back(op);
+					return RECORD_COMPLETED;
+				}
+
+				if (op.active)
+				{
+					switch (d.ins)
+					{
+					case CMD_INC_BLOCK_LEVEL:
+					case CMD_DEC_BLOCK_LEVEL:
+					case CMD_INC_READ_LEVEL:
+					case CMD_DEC_READ_LEVEL:
+					case CMD_CREATE_BLOCK:
+					case CMD_ELSE_STATEMENT:
+					case CMD_LEAVE_IF_STATEMENT:
+					case CMD_LEAVE_ELSE_STATEMENT:
+					case CMD_LOAD_INTEGER:
+					case CMD_LOAD_FLOAT:
+					case CMD_OP_CLEAR:
+					case CMD_OP_UNARY_NEG:
+					case CMD_OP_UNARY_POS:
+					case CMD_OP_UNARY_NOT:
+					case CMD_OP_ADD:
+					case CMD_OP_SUB:
+					case CMD_OP_MUL:
+					case CMD_OP_DIV:
+					case CMD_OP_MOD:
+					case CMD_OP_AND:
+					case CMD_OP_OR:
+					case CMD_OP_EQL:
+					case CMD_OP_NEQL:
+					case CMD_OP_LT:
+					case CMD_OP_GT:
+					case CMD_OP_LTE:
+					case CMD_OP_GTE:
+					case CMD_OP_ASSIGN:
+					case CMD_OP_ADD_ASSIGN:
+					case CMD_OP_SUB_ASSIGN:
+					case CMD_OP_MUL_ASSIGN:
+					case CMD_OP_DIV_ASSIGN:
+						break;
+					case CMD_LOAD_VARIABLE:
+					{
+						auto *object = findVariable(vm, module, d.name);
+						if (object == nullptr)
+							return RECORD_ABORTED;
+
+						if (object->isInteger())
+							op.observedType = TRACE_TYPE_INTEGER;
+						else if (object->isFloat())
+							op.observedType = TRACE_TYPE_FLOAT;
+						else
+							return RECORD_ABORTED;
+
+						break;
+					}
+					case CMD_IF_STATEMENT:
+					{
+						auto &stack = module->getFrame(vm->blockLevel).getEvaluator().getStack();
+						if (stack.empty() || stack.top() == nullptr)
+							return RECORD_ABORTED;
+
+						auto &expr = stack.top();
+						if (expr->isInteger())
+							op.observedType = TRACE_TYPE_INTEGER;
+						else if (expr->isFloat())
+							op.observedType = TRACE_TYPE_FLOAT;
+						else
+							return RECORD_ABORTED;
+
+						op.condition = expr->cast<bool>();
+						break;
+					}
+					default:
+						debug_log("Trace: abort recording at instruction %d", (int)d.ins);
+						return RECORD_ABORTED;
+					}
+				}
+
+				current.ops.push_back(op);
+				return RECORD_CONTINUE;
+			}
+		}
+	}
+}
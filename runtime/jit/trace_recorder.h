@@ -0,0 +1,58 @@
+#ifndef __ZENITH_RUNTIME_JIT_TRACE_RECORDER_H__
+#define __ZENITH_RUNTIME_JIT_TRACE_RECORDER_H__
+
+#include <string>
+
+#include "trace.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		class VM;
+		class Module;
+		class Object;
+
+		namespace jit
+		{
+			enum RecordStatus
+			{
+				RECORD_CONTINUE,
+				RECORD_COMPLETED,
+				RECORD_ABORTED
+			};
+
+			/* Records the instructions the interpreter executes for one iteration
+			   of a loop, from the loop header up to its back-edge. Recording is
+			   aborted for anything that cannot be specialized on numeric types
+			   (calls, strings, declarations, nested loops, ...). */
+			class TraceRecorder
+			{
+			private:
+				bool recording;
+				int baseLevel;
+				size_t maxLength;
+
+				TraceRecording current;
+
+			public:
+				TraceRecorder(size_t maxLength);
+
+				bool isRecording() const { return recording; }
+
+				void start(uint64_t header, uint64_t backEdge, int baseLevel);
+				void stop();
+
+				/* Called before the interpreter executes 'd'. */
+				RecordStatus record(VM *vm, Module *module, const DecodedInstruction &d);
+
+				const TraceRecording &getRecording() const { return current; }
+
+				/* Look up a variable the same way CMD_LOAD_VARIABLE does. */
+				static Object *findVariable(VM *vm, Module *module, const std::string &name);
+			};
+		}
+	}
+}
+
+#endif
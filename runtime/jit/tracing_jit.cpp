@@ -0,0 +1,228 @@
+#include "tracing_jit.h"
+#include "trace_compiler.h"
+
+#include <cstring>
+
+#include "../vm.h"
+#include "../module.h"
+#include "../bytereader.h"
+#include "../experimental/vm_state.h"
+#include "../experimental/object.h"
+
+#include "../../util/logger.h"
+
+namespace zenith
+{
+	using namespace util;
+
+	namespace runtime
+	{
+		namespace jit
+		{
+			TracingJit::TracingJit(const JitOptions &options)
+				: recorder(options.maxTraceLength)
+			{
+				this->options = options;
+				branchTrace = nullptr;
+				branchNode = nullptr;
+				branchIndex = 0;
+				numCompiled = 0;
+				numAborted = 0;
+				numBranches = 0;
+				numEntries = 0;
+				numExits = 0;
+			}
+
+			void TracingJit::record(VM *vm, Module *module, const DecodedInstruction &d)
+			{
+				auto status = recorder.record(vm, module, d);
+				if (status == RECORD_CONTINUE)
+					return;
+
+				recorder.stop();
+
+				if (branchTrace != nullptr)
+				{
+					finishBranch(status);
+					return;
+				}
+
+				auto &recording = recorder.getRecording();
+
+				std::unique_ptr<Trace> trace;
+				if (status == RECORD_COMPLETED)
+				{
+					trace = std::make_unique<Trace>();
+					trace->header = recording.header;
+					trace->backEdge = recording.backEdge;
+					trace->root.ops = recording.ops;
+
+					if (!TraceCompiler::compile(*trace))
+						trace = nullptr;
+				}
+
+				if (trace != nullptr)
+					numCompiled++;
+				else
+				{
+					numAborted++;
+					debug_log("Trace: loop at position: %d will not be traced", recording.header);
+				}
+
+				traces[recording.backEdge] = std::move(trace);
+			}
+
+			void TracingJit::finishBranch(RecordStatus status)
+			{
+				auto &branch = branchNode->branches[branchIndex];
+
+				if (status == RECORD_COMPLETED)
+				{
+					branch = std::make_unique<TraceTree>();
+					branch->ops = recorder.getRecording().ops;
+
+					// the trace keeps the code it had before, which exits at this guard
+					if (!TraceCompiler::compile(*branchTrace))
+					{
+						debug_log("Trace: could not recompile loop at position: %d with a new branch",
+							branchTrace->header);
+						branch.reset();
+					}
+				}
+
+				if (branch != nullptr)
+				{
+					branchTrace->numBranches++;
+					numBranches++;
+				}
+				else
+					numAborted++;
+
+				branchTrace = nullptr;
+				branchNode = nullptr;
+			}
+
+			bool TracingJit::onBackEdge(VM *vm, Module *module, const DecodedInstruction &d, uint64_t target)
+			{
+				auto it = traces.find(d.position);
+				if (it != traces.end())
+				{
+					if (it->second == nullptr)
+						return false;
+
+					return enter(vm, module, it->second.get());
+				}
+
+				if (!recorder.isRecording() && ++backEdgeCounts[d.position] >= options.traceThreshold)
+				{
+					debug_log("Trace: recording loop at position: %d", target);
+					recorder.start(target, d.position, vm->blockLevel);
+				}
+
+				return false;
+			}
+
+			bool TracingJit::enter(VM *vm, Module *module, Trace *trace)
+			{
+				const int base = vm->blockLevel;
+
+				slots.resize(trace->numSlots);
+				objects.resize(trace->variables.size());
+
+				// type guards on entry
+				for (size_t i = 0; i < trace->variables.size(); i++)
+				{
+					auto &var = trace->variables[i];
+
+					auto *object = TraceRecorder::findVariable(vm, module, var.name);
+					if (object == nullptr)
+						return false;
+
+					for (size_t j = 0; j < i; j++)
+					{
+						// two names for the same object
+						if (objects[j] == object)
+							return false;
+					}
+
+					if (var.type == TRACE_TYPE_INTEGER)
+					{
+						if (!object->isInteger())
+							return false;
+
+						slots[i] = object->cast<long>();
+					}
+					else
+					{
+						if (!object->isFloat())
+							return false;
+
+						double value = object->cast<double>();
+						memcpy(&slots[i], &value, sizeof(double));
+					}
+
+					objects[i] = object;
+				}
+
+				numEntries++;
+				int exitIndex = trace->run(slots.data());
+
+				auto &exit = trace->exits[exitIndex];
+				exit.taken++;
+				numExits++;
+
+				for (size_t i = 0; i < trace->variables.size(); i++)
+				{
+					if (!trace->variables[i].written)
+						continue;
+
+					if (exit.types[i] == TRACE_TYPE_INTEGER)
+						objects[i]->assign((long)slots[i]);
+					else
+					{
+						double value;
+						memcpy(&value, &slots[i], sizeof(double));
+						objects[i]->assign(value);
+					}
+				}
+
+				// rebuild the frames that were live at the failed guard
+				for (int level = 1; level <= exit.blockLevel; level++)
+					module->createFrame(base + level);
+
+				vm->blockLevel = base + exit.blockLevel;
+				vm->state->readLevel = base + exit.readLevel;
+
+				for (auto &&ifResult : exit.ifResults)
+					module->getFrame(base + ifResult.first).setLastIfResult(ifResult.second);
+
+				// finish the guarded if statement with the actual result
+				module->getFrame(vm->blockLevel).setLastIfResult(exit.result);
+				if (exit.result)
+					vm->state->readLevel++;
+
+				vm->state->stream->seek((unsigned long)exit.resume);
+
+				// record the other path once the guard has failed often enough
+				if (exit.taken >= options.branchThreshold && !recorder.isRecording() &&
+					trace->numBranches < options.maxBranches &&
+					exit.node->branches.find(exit.opIndex) == exit.node->branches.end())
+				{
+					debug_log("Trace: recording branch at position: %d", exit.resume);
+
+					branchTrace = trace;
+					branchNode = exit.node;
+					branchIndex = exit.opIndex;
+					exit.node->branches[exit.opIndex] = nullptr;
+
+					recorder.start(trace->header, trace->backEdge, base);
+				}
+
+				debug_log("Trace: left loop at position: %d through exit %d",
+					trace->header, exitIndex);
+
+				return true;
+			}
+		}
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef __ZENITH_RUNTIME_JIT_TRACING_JIT_H__
+#define __ZENITH_RUNTIME_JIT_TRACING_JIT_H__
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "baseline_jit.h"
+#include "trace.h"
+#include "trace_recorder.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		class VM;
+		class Module;
+		class Object;
+
+		namespace jit
+		{
+			/* Counts the back-edges of loops run by the interpreter. Once a loop is hot,
+			   one iteration is recorded and compiled; from then on, reaching the back-edge
+			   runs the trace until one of its guards fails, and the interpreter resumes
+			   right after the failed guard. When the same guard keeps failing, the rest
+			   of that iteration is recorded as a branch and the trace is recompiled. */
+			class TracingJit
+			{
+			private:
+				JitOptions options;
+				TraceRecorder recorder;
+
+				// back-edge position -> times taken
+				std::map<uint64_t, unsigned long> backEdgeCounts;
+				// back-edge position -> trace (nullptr when the loop cannot be traced)
+				std::map<uint64_t, std::unique_ptr<Trace>> traces;
+
+				std::vector<int64_t> slots;
+				std::vector<Object*> objects;
+
+				// the trace and guard a branch is being recorded for
+				Trace *branchTrace;
+				TraceTree *branchNode;
+				size_t branchIndex;
+
+				size_t numCompiled;
+				size_t numAborted;
+				size_t numBranches;
+				unsigned long numEntries;
+				unsigned long numExits;
+
+				void finishBranch(RecordStatus status);
+
+				bool enter(VM *vm, Module *module, Trace *trace);
+
+			public:
+				TracingJit(const JitOptions &options);
+
+				bool isRecording() const { return recorder.isRecording(); }
+
+				/* Called by the interpreter before executing each instruction while recording. */
+				void record(VM *vm, Module *module, const DecodedInstruction &d);
+
+				/* Called when a backwards jump is taken. Returns true if a trace was run,
+				   in which case the stream is already positioned where execution continues. */
+				bool onBackEdge(VM *vm, Module *module, const DecodedInstruction &d, uint64_t target);
+
+				size_t getNumCompiled() const { return numCompiled; }
+				size_t getNumAborted() const { return numAborted; }
+				size_t getNumBranches() const { return numBranches; }
+				unsigned long getNumEntries() const { return numEntries; }
+				unsigned long getNumExits() const { return numExits; }
+			};
+		}
+	}
+}
+
+#endif
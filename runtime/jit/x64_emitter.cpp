@@ -0,0 +1,290 @@
+#include "x64_emitter.h"
+
+namespace zenith
+{
+	namespace runtime
+	{
+		namespace jit
+		{
+			void X64Emitter::write8(uint8_t value)
+			{
+				bytes.push_back(value);
+			}
+
+			void X64Emitter::write32(uint32_t value)
+			{
+				for (int i = 0; i < 4; i++)
+					bytes.push_back((uint8_t)(value >> (i * 8)));
+			}
+
+			void X64Emitter::write64(uint64_t value)
+			{
+				for (int i = 0; i < 8; i++)
+					bytes.push_back((uint8_t)(value >> (i * 8)));
+			}
+
+			void X64Emitter::prologue()
+			{
+				// three pushes keep the stack 16-byte aligned for calls
+				write8(0x53); // push rbx
+				write8(0x41); write8(0x54); // push r12
+				write8(0x41); write8(0x55); // push r13
+
+#ifdef _WIN32
+				// shadow space
+				write8(0x48); write8(0x83); write8(0xEC); write8(0x20); // sub rsp, 32
+				write8(0x48); write8(0x89); write8(0xCB); // mov rbx, rcx
+				write8(0x49); write8(0x89); write8(0xD4); // mov r12, rdx
+				write8(0x4D); write8(0x89); write8(0xC5); // mov r13, r8
+#else
+				write8(0x48); write8(0x89); write8(0xFB); // mov rbx, rdi
+				write8(0x49); write8(0x89); write8(0xF4); // mov r12, rsi
+				write8(0x49); write8(0x89); write8(0xD5); // mov r13, rdx
+#endif
+			}
+
+			void X64Emitter::epilogue()
+			{
+#ifdef _WIN32
+				write8(0x48); write8(0x83); write8(0xC4); write8(0x20); // add rsp, 32
+#endif
+				write8(0x41); write8(0x5D); // pop r13
+				write8(0x41); write8(0x5C); // pop r12
+				write8(0x5B); // pop rbx
+				write8(0xC3); // ret
+			}
+
+			void X64Emitter::callHelper(const void *fn, const void *arg)
+			{
+#ifdef _WIN32
+				write8(0x48); write8(0x89); write8(0xD9); // mov rcx, rbx
+				write8(0x4C); write8(0x89); write8(0xE2); // mov rdx, r12
+				write8(0x49); write8(0xB8); write64((uint64_t)arg); // mov r8, imm64
+				write8(0x4D); write8(0x89); write8(0xE9); // mov r9, r13
+#else
+				write8(0x48); write8(0x89); write8(0xDF); // mov rdi, rbx
+				write8(0x4C); write8(0x89); write8(0xE6); // mov rsi, r12
+				write8(0x48); write8(0xBA); write64((uint64_t)arg); // mov rdx, imm64
+				write8(0x4C); write8(0x89); write8(0xE9); // mov rcx, r13
+#endif
+				write8(0x48); write8(0xB8); write64((uint64_t)fn); // mov rax, imm64
+				write8(0xFF); write8(0xD0); // call rax
+			}
+
+			size_t X64Emitter::jumpIfNonZero()
+			{
+				write8(0x85); write8(0xC0); // test eax, eax
+				write8(0x0F); write8(0x85); // jnz rel32
+				size_t at = offset();
+				write32(0);
+				return at;
+			}
+
+			size_t X64Emitter::jumpIfZero()
+			{
+				write8(0x85); write8(0xC0); // test eax, eax
+				write8(0x0F); write8(0x84); // jz rel32
+				size_t at = offset();
+				write32(0);
+				return at;
+			}
+
+			size_t X64Emitter::jump()
+			{
+				write8(0xE9); // jmp rel32
+				size_t at = offset();
+				write32(0);
+				return at;
+			}
+
+			size_t X64Emitter::jumpIf(Condition cond)
+			{
+				write8(0x0F); write8(0x80 | cond); // jcc rel32
+				size_t at = offset();
+				write32(0);
+				return at;
+			}
+
+			void X64Emitter::patch(size_t at, size_t target)
+			{
+				// relative to the end of the 4 byte operand
+				int32_t rel = (int32_t)((int64_t)target - (int64_t)(at + 4));
+				for (int i = 0; i < 4; i++)
+					bytes[at + i] = (uint8_t)((uint32_t)rel >> (i * 8));
+			}
+			void X64Emitter::load(Reg dst, int32_t disp)
+			{
+				// mov dst, [rbx + disp32]
+				write8(0x48); write8(0x8B); write8(0x80 | (dst << 3) | 3);
+				write32((uint32_t)disp);
+			}
+
+			void X64Emitter::store(int32_t disp, Reg src)
+			{
+				// mov [rbx + disp32], src
+				write8(0x48); write8(0x89); write8(0x80 | (src << 3) | 3);
+				write32((uint32_t)disp);
+			}
+
+			void X64Emitter::loadDouble(XmmReg dst, int32_t disp)
+			{
+				// movsd dst, [rbx + disp32]
+				write8(0xF2); write8(0x0F); write8(0x10); write8(0x80 | (dst << 3) | 3);
+				write32((uint32_t)disp);
+			}
+
+			void X64Emitter::storeDouble(int32_t disp, XmmReg src)
+			{
+				// movsd [rbx + disp32], src
+				write8(0xF2); write8(0x0F); write8(0x11); write8(0x80 | (src << 3) | 3);
+				write32((uint32_t)disp);
+			}
+
+			void X64Emitter::loadSlot(Reg dst, int32_t disp)
+			{
+				// mov dst, [r13 + disp32]
+				write8(0x49); write8(0x8B); write8(0x80 | (dst << 3) | 5);
+				write32((uint32_t)disp);
+			}
+
+			void X64Emitter::storeSlot(int32_t disp, Reg src)
+			{
+				// mov [r13 + disp32], src
+				write8(0x49); write8(0x89); write8(0x80 | (src << 3) | 5);
+				write32((uint32_t)disp);
+			}
+
+			void X64Emitter::loadSlotDouble(XmmReg dst, int32_t disp)
+			{
+				// movsd dst, [r13 + disp32]
+				write8(0xF2); write8(0x41); write8(0x0F); write8(0x10); write8(0x80 | (dst << 3) | 5);
+				write32((uint32_t)disp);
+			}
+
+			void X64Emitter::storeSlotDouble(int32_t disp, XmmReg src)
+			{
+				// movsd [r13 + disp32], src
+				write8(0xF2); write8(0x41); write8(0x0F); write8(0x11); write8(0x80 | (src << 3) | 5);
+				write32((uint32_t)disp);
+			}
+
+			void X64Emitter::storeSlotImmediate(int32_t disp, int32_t value)
+			{
+				// mov qword [r13 + disp32], imm32
+				write8(0x49); write8(0xC7); write8(0x85);
+				write32((uint32_t)disp);
+				write32((uint32_t)value);
+			}
+
+			void X64Emitter::compareSlotImmediate(int32_t disp, int8_t value)
+			{
+				// cmp qword [r13 + disp32], imm8
+				write8(0x49); write8(0x83); write8(0xBD);
+				write32((uint32_t)disp);
+				write8((uint8_t)value);
+			}
+
+			void X64Emitter::moveImmediate(Reg dst, int64_t value)
+			{
+				write8(0x48); write8(0xB8 + dst); write64((uint64_t)value); // mov dst, imm64
+			}
+
+			void X64Emitter::moveImmediate32(Reg dst, int32_t value)
+			{
+				write8(0xB8 + dst); write32((uint32_t)value); // mov dst32, imm32
+			}
+
+			void X64Emitter::moveToXmm(XmmReg dst, Reg src)
+			{
+				// movq dst, src
+				write8(0x66); write8(0x48); write8(0x0F); write8(0x6E); write8(0xC0 | (dst << 3) | src);
+			}
+
+			void X64Emitter::intOp(IntOp op, Reg dst, Reg src)
+			{
+				if (op == INT_OP_IMUL)
+				{
+					// imul dst, src
+					write8(0x48); write8(0x0F); write8(0xAF); write8(0xC0 | (dst << 3) | src);
+				}
+				else
+				{
+					// op dst, src
+					write8(0x48); write8(op); write8(0xC0 | (src << 3) | dst);
+				}
+			}
+
+			void X64Emitter::signExtend()
+			{
+				write8(0x48); write8(0x99); // cqo
+			}
+
+			void X64Emitter::divide(Reg divisor)
+			{
+				write8(0x48); write8(0xF7); write8(0xF8 | divisor); // idiv divisor
+			}
+
+			void X64Emitter::negate(Reg reg)
+			{
+				write8(0x48); write8(0xF7); write8(0xD8 | reg); // neg reg
+			}
+
+			void X64Emitter::test(Reg reg)
+			{
+				write8(0x48); write8(0x85); write8(0xC0 | (reg << 3) | reg); // test reg, reg
+			}
+
+			void X64Emitter::doubleOp(DoubleOp op, XmmReg dst, XmmReg src)
+			{
+				write8(0xF2); write8(0x0F); write8(op); write8(0xC0 | (dst << 3) | src);
+			}
+
+			void X64Emitter::compareDouble(XmmReg a, XmmReg b)
+			{
+				write8(0x66); write8(0x0F); write8(0x2E); write8(0xC0 | (a << 3) | b); // ucomisd a, b
+			}
+
+			void X64Emitter::clearXmm(XmmReg reg)
+			{
+				write8(0x66); write8(0x0F); write8(0x57); write8(0xC0 | (reg << 3) | reg); // xorpd reg, reg
+			}
+
+			void X64Emitter::intToDouble(XmmReg dst, Reg src)
+			{
+				// cvtsi2sd dst, src
+				write8(0xF2); write8(0x48); write8(0x0F); write8(0x2A); write8(0xC0 | (dst << 3) | src);
+			}
+
+			void X64Emitter::doubleToInt(Reg dst, XmmReg src)
+			{
+				// cvttsd2si dst, src
+				write8(0xF2); write8(0x48); write8(0x0F); write8(0x2C); write8(0xC0 | (dst << 3) | src);
+			}
+
+			void X64Emitter::setIf(Condition cond, Reg dst)
+			{
+				write8(0x0F); write8(0x90 | cond); write8(0xC0 | dst); // setcc dst8
+			}
+
+			void X64Emitter::andByte(Reg dst, Reg src)
+			{
+				write8(0x20); write8(0xC0 | (src << 3) | dst); // and dst8, src8
+			}
+
+			void X64Emitter::orByte(Reg dst, Reg src)
+			{
+				write8(0x08); write8(0xC0 | (src << 3) | dst); // or dst8, src8
+			}
+
+			void X64Emitter::zeroExtendByte(Reg dst, Reg src)
+			{
+				write8(0x0F); write8(0xB6); write8(0xC0 | (dst << 3) | src); // movzx dst32, src8
+			}
+
+			void X64Emitter::testByte(Reg reg)
+			{
+				write8(0x84); write8(0xC0 | (reg << 3) | reg); // test reg8, reg8
+			}
+		}
+	}
+}
@@ -0,0 +1,136 @@
+#ifndef __ZENITH_RUNTIME_JIT_X64_EMITTER_H__
+#define __ZENITH_RUNTIME_JIT_X64_EMITTER_H__
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace zenith
+{
+	namespace runtime
+	{
+		namespace jit
+		{
+			enum Reg
+			{
+				RAX = 0,
+				RCX = 1,
+				RDX = 2
+			};
+
+			enum XmmReg
+			{
+				XMM0 = 0,
+				XMM1 = 1
+			};
+
+			enum Condition
+			{
+				COND_B = 0x2,
+				COND_AE = 0x3,
+				COND_E = 0x4,
+				COND_NE = 0x5,
+				COND_BE = 0x6,
+				COND_A = 0x7,
+				COND_P = 0xA,
+				COND_NP = 0xB,
+				COND_L = 0xC,
+				COND_GE = 0xD,
+				COND_LE = 0xE,
+				COND_G = 0xF
+			};
+
+			enum IntOp
+			{
+				INT_OP_ADD = 0x01,
+				INT_OP_SUB = 0x29,
+				INT_OP_CMP = 0x39,
+				INT_OP_XOR = 0x31,
+				INT_OP_IMUL = 0xAF
+			};
+
+			enum DoubleOp
+			{
+				DOUBLE_OP_ADD = 0x58,
+				DOUBLE_OP_MUL = 0x59,
+				DOUBLE_OP_SUB = 0x5C,
+				DOUBLE_OP_DIV = 0x5E
+			};
+
+			/* Minimal x86-64 machine code writer. Only the handful of
+			   instructions needed by the code templates are supported.
+			   rbx, r12 and r13 hold the three context pointers passed to
+			   the generated function for its whole lifetime. */
+			class X64Emitter
+			{
+			private:
+				std::vector<uint8_t> bytes;
+
+				void write8(uint8_t value);
+				void write32(uint32_t value);
+				void write64(uint64_t value);
+
+			public:
+				const std::vector<uint8_t> &code() const { return bytes; }
+				size_t offset() const { return bytes.size(); }
+
+				/* Save callee-saved registers and store the three
+				   incoming arguments in rbx, r12 and r13. */
+				void prologue();
+				void epilogue();
+
+				/* Call fn(rbx, r12, arg, r13). The result is left in eax. */
+				void callHelper(const void *fn, const void *arg);
+
+				/* Emit a jump, returning the offset of its rel32 operand
+				   so that it can be patched once the target is known. */
+				size_t jumpIfNonZero(); // test eax, eax; jnz
+				size_t jumpIfZero(); // test eax, eax; jz
+				size_t jump();
+
+				size_t jumpIf(Condition cond);
+
+				void patch(size_t at, size_t target);
+
+				/* Memory operands are 64-bit slots addressed relative to rbx. */
+				void load(Reg dst, int32_t disp);
+				void store(int32_t disp, Reg src);
+				void loadDouble(XmmReg dst, int32_t disp);
+				void storeDouble(int32_t disp, XmmReg src);
+
+				/* The same, relative to r13. */
+				void loadSlot(Reg dst, int32_t disp);
+				void storeSlot(int32_t disp, Reg src);
+				void loadSlotDouble(XmmReg dst, int32_t disp);
+				void storeSlotDouble(int32_t disp, XmmReg src);
+				void storeSlotImmediate(int32_t disp, int32_t value);
+				void compareSlotImmediate(int32_t disp, int8_t value);
+
+				void moveImmediate(Reg dst, int64_t value);
+				void moveImmediate32(Reg dst, int32_t value);
+				void moveToXmm(XmmReg dst, Reg src);
+
+				void intOp(IntOp op, Reg dst, Reg src);
+				void signExtend(); // cqo
+				void divide(Reg divisor); // idiv
+				void negate(Reg reg);
+				void test(Reg reg);
+
+				void doubleOp(DoubleOp op, XmmReg dst, XmmReg src);
+				void compareDouble(XmmReg a, XmmReg b); // ucomisd
+				void clearXmm(XmmReg reg); // xorpd
+				void intToDouble(XmmReg dst, Reg src); // cvtsi2sd
+				void doubleToInt(Reg dst, XmmReg src); // cvttsd2si
+
+				/* Operations on the low byte of the registers. */
+				void setIf(Condition cond, Reg dst);
+				void andByte(Reg dst, Reg src);
+				void orByte(Reg dst, Reg src);
+				void zeroExtendByte(Reg dst, Reg src);
+				void testByte(Reg reg);
+			};
+		}
+	}
+}
+
+#endif
@@ -9,6 +9,7 @@ namespace zenith
 		Module::Module(const std::string &name)
 		{
 			_name = name;
+			checked = true;
 
 			// create global stack frame
 			createFrame(-1);
@@ -38,11 +39,14 @@ namespace zenith
 
 		StackFrame &Module::getFrame(int level)
 		{
-			if (level < -1)
-				Exception({ "Tried to access a frame below global" }).display();
+			if (checked)
+			{
+				if (level < -1)
+					Exception({ "Tried to access a frame below global" }).display();
 
-			if (frames.find(level) == frames.end())
-				Exception({ "Tried to access a frame that does not exist" }).display();
+				if (frames.find(level) == frames.end())
+					Exception({ "Tried to access a frame that does not exist" }).display();
+			}
 
 			return frames[level];
 		}
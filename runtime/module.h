@@ -18,6 +18,7 @@ namespace zenith
 			std::string _name;
 			std::vector<unsigned long> fnPositionChain;
 			std::map<int, unsigned long> savedPositions;
+			bool checked;
 
 		public:
 			Module(const std::string &name);
@@ -27,8 +28,12 @@ namespace zenith
 			void leaveFrame(int level);
 			StackFrame &getFrame(int level);
 
+			// verified code never asks for a frame that does not exist
+			void setChecked(bool checked) { this->checked = checked; }
+
 			void pushFunctionChain(unsigned long pos);
 			unsigned long popFunctionChain();
+			size_t functionDepth() const { return fnPositionChain.size(); }
 
 			// map block id to saved position
 			std::map<int, unsigned long> &getSavedPositions()
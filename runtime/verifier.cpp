@@ -0,0 +1,358 @@
+#include "verifier.h"
+#include "image.h"
+#include "instruction.h"
+#include "bytereader.h"
+
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+
+namespace zenith
+{
+	namespace runtime
+	{
+		static bool fail(std::string &error, const DecodedInstruction &d, const std::string &message)
+		{
+			error = "Bytecode verification failed at position " +
+				std::to_string(d.position) + ": " + message;
+			return false;
+		}
+
+		// what is known of the frame of each block level while the code is walked
+		struct BlockState
+		{
+			int values = 0; // on the expression stack of the frame
+			bool branching = false; // an if, else or read level skips to a block that is not entered yet
+			bool inIf = false; // the block of an if is entered from this level
+			bool leftIf = false; // ... and the last instruction left it
+		};
+
+		// where a block was created, for the jumps to it
+		struct BlockStart
+		{
+			int level;
+			int values;
+			bool here; // the block starts right after the instruction that creates it
+		};
+
+		struct Reference
+		{
+			DecodedInstruction d;
+			int level;
+			int values;
+		};
+
+		// 'needs' values are taken from the frame's stack and 'leaves' are put back
+		static bool useValues(std::string &error, const DecodedInstruction &d, BlockState &block,
+			int needs, int leaves)
+		{
+			// only one side of the branch would run it
+			if (block.branching)
+				return fail(error, d, "changes the stack between a branch and its block");
+
+			if (block.values < needs)
+			{
+				return fail(error, d, "needs " + std::to_string(needs) + " value(s) on the stack, it has " +
+					std::to_string(block.values));
+			}
+
+			block.values += leaves - needs;
+			return true;
+		}
+
+		// the function the failure is in, and the module it was compiled from when known
+		static std::string location(const BytecodeImage &image, const std::vector<const FunctionEntry*> &functions)
+		{
+			const ConstantPool &constants = image.getConstants();
+			std::string result;
+
+			if (!functions.empty() && functions.back() != nullptr)
+				result += " in function " + std::string(constants.get(functions.back()->name));
+
+			if (image.getDebugInfo() != nullptr)
+			{
+				result += " of module " + std::string(constants.get(image.getDebugInfo()->moduleName)) +
+					" (" + constants.get(image.getDebugInfo()->sourcePath) + ")";
+			}
+
+			return result;
+		}
+
+		bool Verifier::verify(const BytecodeImage &image, std::string &error)
+		{
+			// functions being defined, from the function table
+			std::vector<const FunctionEntry*> entries;
+
+			if (verifyCode(image, error, entries))
+				return true;
+
+			error += location(image, entries);
+			return false;
+		}
+
+		bool Verifier::verifyCode(const BytecodeImage &image, std::string &error,
+			std::vector<const FunctionEntry*> &entries)
+		{
+			auto reader = image.createReader();
+			auto *stream = reader.get();
+
+			if (!InstructionDecoder::readHeader(stream))
+			{
+				error = "Bytecode was emitted with an unsupported encoding";
+				return false;
+			}
+
+			const uint64_t end = (uint64_t)stream->max();
+
+			std::map<int32_t, BlockStart> blocks;
+			// parents and jump targets may be created further on, so they are checked at the end
+			std::vector<Reference> references;
+			// block level of each function being defined
+			std::vector<int> functions;
+			size_t numFunctions = 0;
+			int depth = 0;
+			// the global frame first, every frame starts with an empty stack
+			std::vector<BlockState> levels(1);
+
+			while ((uint64_t)stream->position() < end)
+			{
+				DecodedInstruction d;
+				if (!InstructionDecoder::next(stream, d))
+					return fail(error, d, "unrecognized instruction " + std::to_string((int)d.ins));
+
+				if (d.next > end)
+					return fail(error, d, "instruction runs past the end of the code");
+
+				bool afterIf = levels.back().leftIf;
+				levels.back().leftIf = false;
+
+				switch (d.ins)
+				{
+				case Instruction::CMD_INC_BLOCK_LEVEL:
+					levels.back().branching = false;
+					levels.push_back(BlockState());
+					depth++;
+					break;
+				case Instruction::CMD_DEC_BLOCK_LEVEL:
+					if (depth == 0)
+						return fail(error, d, "leaves a block that was not entered");
+					if (levels.back().branching)
+						return fail(error, d, "branches to a block that is never entered");
+					levels.pop_back();
+					depth--;
+
+					levels.back().leftIf = levels.back().inIf;
+					levels.back().inIf = false;
+
+					if (!functions.empty() && functions.back() == depth)
+					{
+						functions.pop_back();
+						entries.pop_back();
+					}
+					break;
+				case Instruction::CMD_INC_READ_LEVEL:
+					levels.back().branching = true;
+					break;
+				case Instruction::CMD_IF_STATEMENT:
+					if (!useValues(error, d, levels.back(), 1, 0))
+						return false;
+					levels.back().branching = true;
+					levels.back().inIf = true;
+					break;
+				case Instruction::CMD_ELSE_STATEMENT:
+					if (!afterIf)
+						return fail(error, d, "else does not follow the block of an if");
+					levels.back().branching = true;
+					break;
+				case Instruction::CMD_CREATE_BLOCK:
+					if (d.arg1 < BlockType::UNDEFINED_BLOCK || d.arg1 > BlockType::DO_WHILE_LOOP_BLOCK)
+						return fail(error, d, "unknown block type " + std::to_string(d.arg1));
+					if (d.blockPos > end)
+						return fail(error, d, "block starts past the end of the code");
+					if (d.arg0 < 0 || !blocks.insert({ d.arg0, { depth, levels.back().values, d.blockPos == d.next } }).second)
+						return fail(error, d, "bad block id " + std::to_string(d.arg0));
+					if (d.arg2 != -1)
+						references.push_back({ d, depth, levels.back().values });
+					break;
+				case Instruction::CMD_GO_TO_BLOCK:
+				case Instruction::CMD_GO_TO_IF_TRUE:
+				case Instruction::CMD_GO_TO_IF_FALSE:
+					references.push_back({ d, depth, levels.back().values });
+					break;
+				case Instruction::CMD_CREATE_FUNCTION:
+				{
+					if (d.blockPos > end)
+						return fail(error, d, "function starts past the end of the code");
+
+					// the table lists every function by where its body starts
+					auto *entry = image.findFunction(d.blockPos);
+					if (entry == nullptr || d.name != image.getConstants().get(entry->name))
+						return fail(error, d, "function " + d.name + " is not in the function table");
+
+					functions.push_back(depth);
+					entries.push_back(entry);
+					numFunctions++;
+					break;
+				}
+				case Instruction::CMD_LEAVE_FUNCTION:
+					if (functions.empty())
+						return fail(error, d, "leaves a function outside of a function body");
+					break;
+				case Instruction::CMD_STACK_POP_OBJECT:
+					if (d.arg0 < 0 || d.arg0 > StackType::STACK_OBJECTS)
+						return fail(error, d, "unknown stack " + std::to_string(d.arg0));
+					break;
+				case Instruction::CMD_OP_PUSH:
+					if (d.arg0 < 0 || d.arg0 > StackType::STACK_OBJECTS)
+						return fail(error, d, "unknown stack " + std::to_string(d.arg0));
+					// the top value is pushed and the rest cleared
+					if (!useValues(error, d, levels.back(), 1, 0))
+						return false;
+					levels.back().values = 0;
+					break;
+				case Instruction::CMD_OP_CLEAR:
+					if (!useValues(error, d, levels.back(), 0, 0))
+						return false;
+					levels.back().values = 0;
+					break;
+				case Instruction::CMD_LOAD_VARIABLE:
+				case Instruction::CMD_LOAD_INTEGER:
+				case Instruction::CMD_LOAD_FLOAT:
+				case Instruction::CMD_LOAD_STRING:
+				case Instruction::CMD_LOAD_NULL:
+					if (!useValues(error, d, levels.back(), 0, 1))
+						return false;
+					break;
+				case Instruction::CMD_LOAD_MEMBER:
+					if (!useValues(error, d, levels.back(), 1, 2))
+						return false;
+					break;
+				case Instruction::CMD_OP_UNARY_NEG:
+				case Instruction::CMD_OP_UNARY_NOT:
+				case Instruction::CMD_ADD_MEMBER:
+				// the function is replaced by what it returns
+				case Instruction::CMD_INVOKE:
+					if (!useValues(error, d, levels.back(), 1, 1))
+						return false;
+					break;
+				case Instruction::CMD_OP_POW:
+				case Instruction::CMD_OP_ADD:
+				case Instruction::CMD_OP_SUB:
+				case Instruction::CMD_OP_MUL:
+				case Instruction::CMD_OP_DIV:
+				case Instruction::CMD_OP_MOD:
+				case Instruction::CMD_OP_AND:
+				case Instruction::CMD_OP_OR:
+				case Instruction::CMD_OP_EQL:
+				case Instruction::CMD_OP_NEQL:
+				case Instruction::CMD_OP_LT:
+				case Instruction::CMD_OP_GT:
+				case Instruction::CMD_OP_LTE:
+				case Instruction::CMD_OP_GTE:
+				case Instruction::CMD_OP_ASSIGN:
+				case Instruction::CMD_OP_ADD_ASSIGN:
+				case Instruction::CMD_OP_SUB_ASSIGN:
+				case Instruction::CMD_OP_MUL_ASSIGN:
+				case Instruction::CMD_OP_DIV_ASSIGN:
+					if (!useValues(error, d, levels.back(), 2, 1))
+						return false;
+					break;
+				case Instruction::CMD_CREATE_VAR:
+					if (d.arg0 < VarType::VAR_TYPE_FUNCTION || d.arg0 > VarType::VAR_TYPE_ANY)
+						return fail(error, d, "unknown variable type " + std::to_string(d.arg0));
+					break;
+				case Instruction::CMD_LOOP_BREAK:
+				case Instruction::CMD_LOOP_CONTINUE:
+					// the VM starts at level -1, the global frame
+					if (d.arg0 < 0 || d.arg0 > depth)
+						return fail(error, d, "skips " + std::to_string(d.arg0) + " levels from level " +
+							std::to_string(depth - 1));
+					break;
+				case Instruction::CMD_CALL_NATIVE_FUNCTION:
+					if (d.arg1 < 0)
+						return fail(error, d, "negative number of arguments");
+					// the arguments are on their own stack, the result comes back on this one
+					if (!useValues(error, d, levels.back(), 0, 1))
+						return false;
+					break;
+				default:
+					break;
+				}
+			}
+
+			if (depth != 0)
+			{
+				error = "Bytecode verification failed: " + std::to_string(depth) + " block(s) are never left";
+				return false;
+			}
+
+			entries.clear();
+			if (numFunctions != image.getNumFunctions())
+			{
+				error = "Bytecode verification failed: the function table lists " +
+					std::to_string(image.getNumFunctions()) + " function(s), the code defines " +
+					std::to_string(numFunctions);
+				return false;
+			}
+
+			for (auto &&ref : references)
+			{
+				auto &d = ref.d;
+				if (d.ins == Instruction::CMD_CREATE_BLOCK)
+				{
+					if (blocks.find(d.arg2) == blocks.end())
+						return fail(error, d, "unknown parent block " + std::to_string(d.arg2));
+					continue;
+				}
+
+				auto block = blocks.find(d.arg0);
+				if (block == blocks.end())
+					return fail(error, d, "jump to unknown block " + std::to_string(d.arg0));
+
+				// a jump keeps the frame it is made from, so it has to arrive with the same stack
+				auto &start = block->second;
+				if (!start.here || start.level != ref.level)
+					return fail(error, d, "jump out of its block to block " + std::to_string(d.arg0));
+				if (start.values != ref.values)
+				{
+					return fail(error, d, "jump with " + std::to_string(ref.values) + " value(s) on the stack to block " +
+						std::to_string(d.arg0) + ", which starts with " + std::to_string(start.values));
+				}
+			}
+
+			return true;
+		}
+
+		VerifiedCache::VerifiedCache(const std::string &path)
+		{
+			this->path = path;
+
+			// one digest per line, in hex, and the version of the Verifier; anything else is ignored
+			std::ifstream file(path);
+			std::string line;
+			while (std::getline(file, line))
+			{
+				std::string digest;
+				int version = 0;
+				std::istringstream ss(line);
+				if (ss >> digest >> version && digest.size() == 64 && version == VERIFIER_VERSION)
+					digests.insert(digest);
+			}
+		}
+
+		bool VerifiedCache::contains(const std::string &digest) const
+		{
+			return digests.find(digest) != digests.end();
+		}
+
+		void VerifiedCache::add(const std::string &digest)
+		{
+			if (!digests.insert(digest).second)
+				return;
+
+			std::ofstream file(path, std::ofstream::app);
+			file << digest << " " << VERIFIER_VERSION << "\n";
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef __ZENITH_RUNTIME_VERIFIER_H__
+#define __ZENITH_RUNTIME_VERIFIER_H__
+
+#include <string>
+#include <set>
+#include <vector>
+#include <cstdint>
+
+namespace zenith
+{
+	namespace runtime
+	{
+		class BytecodeImage;
+		struct FunctionEntry;
+
+		/* Checks the code of an image once, when it is loaded, so that the VM
+		   can leave out the checks it would otherwise make on every instruction:
+		     - every instruction decodes, and its operands stay inside the code
+		     - block levels are entered before they are left, and all are left by the end
+		     - block ids are unique, parents and jumps refer to blocks that exist
+		     - every instruction finds the values it takes on its frame's expression
+		       stack; both sides of an if/else leave the stack alike, and jumps stay
+		       in their block and arrive with the stack the block starts with
+		     - stack ids, variable types and levels to skip are in range
+		     - functions are only left from inside a function body
+		     - the function table lists exactly the functions the code defines
+		   Variables are bound when the code runs, so the VM still looks them up.
+		   Problems are reported with the function they are in and, from the debug
+		   section, the module and source file. */
+		class Verifier
+		{
+		private:
+			static bool verifyCode(const BytecodeImage &image, std::string &error,
+				std::vector<const FunctionEntry*> &entries);
+
+		public:
+			/* Returns false and sets 'error' to the first problem found. */
+			static bool verify(const BytecodeImage &image, std::string &error);
+		};
+
+		// images verified before the Verifier last checked more are verified again
+		const int VERIFIER_VERSION = 2;
+
+		/* Digests of images that have already been verified, kept in a file
+		   so that an image is only verified the first time it is run. Anyone
+		   may write to the file, so images are known by their SHA-256 digest,
+		   which another image cannot be made to match. */
+		class VerifiedCache
+		{
+		private:
+			std::string path;
+			std::set<std::string> digests;
+
+		public:
+			VerifiedCache(const std::string &path);
+
+			/* 'digest' as returned by BytecodeImage::digest(). */
+			bool contains(const std::string &digest) const;
+			void add(const std::string &digest);
+		};
+	}
+}
+
+#endif
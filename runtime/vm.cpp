@@ -1,9 +1,15 @@
 #include "vm.h"
+#include "instruction.h"
 
 #include "experimental/vm_state.h"
 #include "experimental/function.h"
 #include "experimental/object.h"
+#include "aot_module.h"
+#include "jit/baseline_jit.h"
+#include "jit/tracing_jit.h"
+#include "jit/tier_manager.h"
 
+#include "../compiler/symbols.h"
 #include "../util/logger.h"
 #include "../util/timer.h"
 
@@ -22,20 +28,97 @@ namespace zenith
 				objectStacks.push_back(ObjectStack());
 
 			blockLevel = -1;
+			verified = false;
+
+			jitCompiler = nullptr;
+			tracer = nullptr;
+			tiers = nullptr;
 		}
 
 		VM::~VM()
 		{
 			objectStacks.clear();
 
+			// the functions point into the modules
+			nativeFunctions.clear();
+			aotModules.clear();
+
+			delete tiers;
+			delete jitCompiler;
+			delete tracer;
+
 			/*int startLevel = blockLevel;
 			while (startLevel >= -1)
 				leaveFrame(startLevel--);*/
 		}
 
-		void VM::handleInstruction(Instruction ins, Module *module)
+		void VM::bindModule(std::unique_ptr<AotModule> module)
+		{
+			auto *exports = module->getExports();
+
+			for (size_t i = 0; i < exports->numFunctions; i++)
+			{
+				auto &fn = exports->functions[i];
+				// the compiler calls them by the name they are declared as in their module
+				bindFunction(compiler::SymbolTable::mangle(exports->moduleName, fn.name, (int)fn.nArgs),
+					std::make_unique<AotFunction>(fn.nArgs, fn.fn));
+			}
+
+			debug_log("Bound %d functions from compiled module: %s",
+				exports->numFunctions, exports->moduleName);
+
+			module->init();
+			aotModules.push_back(std::move(module));
+		}
+
+		void VM::enableJit(const jit::JitOptions &options)
+		{
+			delete tiers;
+			tiers = nullptr;
+
+			delete jitCompiler;
+			jitCompiler = nullptr;
+
+			delete tracer;
+			tracer = nullptr;
+
+			if ((options.enabled || options.tracing) && !jit::BaselineJit::isSupported())
+				std::cout << "JIT is not supported on this platform, interpreting\n";
+			else
+			{
+				if (options.enabled)
+					jitCompiler = new jit::BaselineJit(options);
+
+				if (options.tracing)
+					tracer = new jit::TracingJit(options);
+			}
+
+			// the quickened tier does not need native code; the baseline JIT becomes the top tier
+			if (options.tiering)
+				tiers = new jit::TierManager(options, jitCompiler);
+		}
+
+		Instruction VM::handleInstruction(Module *module)
+		{
+			DecodedInstruction d;
+
+			if (!InstructionDecoder::next(state->stream, d, state->readLevel == blockLevel))
+			{
+				printf("Unrecognized instruction '%d' at position: %d\n", (int)d.ins, (int)d.position);
+				state->stream = nullptr;
+				return CMD_NONE;
+			}
+
+			if (tracer != nullptr && tracer->isRecording())
+				tracer->record(this, module, d);
+
+			execute(d, module);
+			return d.ins;
+		}
+
+		void VM::execute(const DecodedInstruction &d, Module *module)
 		{
-			switch (ins)
+			switch (d.ins)
 			{
 			case Instruction::CMD_INC_BLOCK_LEVEL:
 			{
@@ -79,49 +162,26 @@ namespace zenith
 			}
 			case Instruction::CMD_STACK_POP_OBJECT:
 			{
-				// which stack to use
-				int32_t whichStack;
-				if (state->readLevel == blockLevel)
-					state->stream->read(&whichStack);
-				else
-					state->stream->skip(sizeof(int32_t));
-
-				// load string for variable name
-				int32_t varLen;
-				state->stream->read(&varLen);
-
-				char *varName;
-				std::string varNameStr;
-				if (state->readLevel == blockLevel)
-				{
-					varName = new char[varLen];
-					state->stream->read(varName, varLen);
-					varNameStr = std::string(varName);
-					delete[] varName;
-				}
-				else
-					state->stream->skip(varLen);
-
 				// pop result into variable
 				if (state->readLevel == blockLevel)
 				{
 					debug_log("Pop into value '%s' from stack %d",
-						varNameStr.c_str(), whichStack);
+						d.name.c_str(), d.arg0);
 
 					int startLevel = blockLevel;
 					bool found = false;
 
 					while (startLevel >= -1)
 					{
-						StackFrame &frame = module->getFrame(startLevel);
-						if (frame.hasLocal(varNameStr))
+						auto *local = module->getFrame(startLevel).findLocal(d.name);
+						if (local != nullptr)
 						{
-							auto &obj = frame.getLocal(varNameStr);
-							obj = getObjectStack(whichStack).top();
-							getObjectStack(whichStack).pop();
+							auto &obj = *local;
+							obj = getObjectStack(d.arg0).top();
+							getObjectStack(d.arg0).pop();
 
 							debug_log("Set variable '%s' to value: '%s'",
-								varNameStr.c_str(), obj->str().c_str());
+								d.name.c_str(), obj->str().c_str());
 
 							found = true;
 							break;
@@ -137,50 +197,14 @@ namespace zenith
 			}
 			case Instruction::CMD_CREATE_BLOCK:
 			{
-				int32_t blockId;
-				state->stream->read(&blockId);
-
-				int32_t blockType;
-				state->stream->read(&blockType);
-
-				int32_t parentId;
-				state->stream->read(&parentId);
-
-				uint64_t blockPos;
-				state->stream->read(&blockPos);
-
-				module->getSavedPositions()[blockId] = blockPos;
+				module->getSavedPositions()[d.arg0] = d.blockPos;
 
-				debug_log("Create block: %d at position: %d", blockId, blockPos);
+				debug_log("Create block: %d at position: %d", d.arg0, d.blockPos);
 
 				break;
 			}
 			case Instruction::CMD_CREATE_FUNCTION:
 			{
-				// load string for variable name
-				int32_t varLen;
-				state->stream->read(&varLen);
-
-				char *varName;
-				std::string varNameStr;
-				if (state->readLevel == blockLevel)
-				{
-					varName = new char[varLen];
-					state->stream->read(varName, varLen);
-					varNameStr = std::string(varName);
-					delete[] varName;
-				}
-				else
-					state->stream->skip(varLen);
-
-				uint64_t blockPos;
-				if (state->readLevel == blockLevel)
-				{
-					state->stream->read(&blockPos);
-				}
-				else
-					state->stream->skip(sizeof(uint64_t));
-
 				if (state->readLevel == blockLevel)
 				{
 					// create function
@@ -193,25 +217,23 @@ namespace zenith
 						debug_log("Created function: %s at position: %d", varNameStr.c_str(), blockPos);
 					}*/
 
-					debug_log("Creating function: %s", varNameStr.c_str());
-					module->getFrame(blockLevel).createFunction(varNameStr, blockPos);
+					debug_log("Creating function: %s", d.name.c_str());
+					module->getFrame(blockLevel).createFunction(d.name, d.blockPos);
+
+					if (tiers != nullptr)
+						tiers->nameFunction((unsigned long)d.blockPos, d.name);
 				}
 
 				break;
 			}
 			case Instruction::CMD_GO_TO_BLOCK:
 			{
-				int32_t blockId;
-				if (state->readLevel == blockLevel)
-					state->stream->read(&blockId);
-				else
-					state->stream->skip(sizeof(int32_t));
-
 				if (state->readLevel == blockLevel)
 				{
-					auto position = module->getSavedPositions()[blockId];
-					debug_log("Go to block: %d at position: %d", blockId, position);
+					auto position = module->getSavedPositions()[d.arg0];
+					debug_log("Go to block: %d at position: %d", d.arg0, position);
 
+					countBackEdge(d, position);
 					state->stream->seek(position);
 				}
 
@@ -219,19 +241,25 @@ namespace zenith
 			}
 			case Instruction::CMD_GO_TO_IF_TRUE:
 			{
-				int32_t blockId;
-				if (state->readLevel == blockLevel)
-					state->stream->read(&blockId);
-				else
-					state->stream->skip(sizeof(int32_t));
-
 				if (state->readLevel == blockLevel)
 				{
 					auto lastResult = module->getFrame(blockLevel).getLastIfResult();
 					if (lastResult)
 					{
-						auto position = module->getSavedPositions()[blockId];
-						debug_log("Go to block: %d at position: %d", blockId, position);
+						auto position = module->getSavedPositions()[d.arg0];
+						debug_log("Go to block: %d at position: %d", d.arg0, position);
+
+						countBackEdge(d, position);
+
+						// run the loop's trace if it has one
+						if (tracer != nullptr && position <= d.position &&
+							tracer->onBackEdge(this, module, d, position))
+							break;
+
+						// or switch the loop over to quickened code
+						if (tiers != nullptr && position <= d.position &&
+							tiers->onBackEdge(this, module, d, position))
+							break;
 
 						state->stream->seek(position);
 					}
@@ -241,20 +269,15 @@ namespace zenith
 			}
 			case Instruction::CMD_GO_TO_IF_FALSE:
 			{
-				int32_t blockId;
-				if (state->readLevel == blockLevel)
-					state->stream->read(&blockId);
-				else
-					state->stream->skip(sizeof(int32_t));
-
 				if (state->readLevel == blockLevel)
 				{
 					auto lastResult = module->getFrame(blockLevel).getLastIfResult();
 					if (!lastResult)
 					{
-						auto position = module->getSavedPositions()[blockId];
-						debug_log("Go to block: %d at position: %d", blockId, position);
+						auto position = module->getSavedPositions()[d.arg0];
+						debug_log("Go to block: %d at position: %d", d.arg0, position);
 
+						countBackEdge(d, position);
 						state->stream->seek(position);
 					}
 				}
@@ -265,7 +288,12 @@ namespace zenith
 			{
 				if (state->readLevel == blockLevel)
 				{
-					auto pos = (std::streamoff)state->stream->position() + 8;
+					// return past the instruction that follows, whatever its encoded size
+					DecodedInstruction following;
+					InstructionDecoder::next(state->stream, following, false);
+					state->stream->seek((unsigned long)d.next);
+
+					auto pos = (std::streamoff)following.next;
 					module->pushFunctionChain(pos);
 
 					debug_log("Push position: %d", pos);
@@ -284,127 +312,55 @@ namespace zenith
 			}
 			case Instruction::CMD_CALL_NATIVE_FUNCTION:
 			{
-				int32_t blockId;
-				if (state->readLevel == blockLevel)
-					state->stream->read(&blockId);
-				else
-					state->stream->skip(sizeof(int32_t));
-
-				int32_t numArgs;
-				if (state->readLevel == blockLevel)
-					state->stream->read(&numArgs);
-				else
-					state->stream->skip(sizeof(int32_t));
-
-				int32_t varLen;
-				state->stream->read(&varLen, sizeof(int32_t));
-
-				char *varName;
-				std::string varNameStr;
-				if (state->readLevel == blockLevel)
-				{
-					varName = new char[varLen];
-					state->stream->read(varName, varLen);
-					varNameStr = std::string(varName);
-					delete[] varName;
-				}
-				else
-					state->stream->skip(varLen);
-
 				if (state->readLevel == blockLevel)
 				{
-					debug_log("Call native function: %s", varNameStr.c_str());
+					debug_log("Call native function: %s", d.name.c_str());
 
-					if (callBindedFunction(varNameStr, numArgs))
+					if (callBindedFunction(d.name, d.arg1))
 					{
 						auto obj = getObjectStack(StackType::STACK_FUNCTION_CALLBACK).top();
 						getObjectStack(StackType::STACK_FUNCTION_CALLBACK).pop();
 						module->getFrame(blockLevel).getEvaluator().loadObject(obj);
 					}
 					else
-						Exception({ "Native function '" + varNameStr + "' not bound properly" }).display();
+						Exception({ "Native function '" + d.name + "' not bound properly" }).display();
 				}
 				break;
 			}
 			case Instruction::CMD_CREATE_NATIVE_CLASS_INSTANCE:
 			{
-				int32_t classNameLen;
-				state->stream->read(&classNameLen);
-
-				char *className;
-				std::string classNameStr;
-				if (state->readLevel == blockLevel)
-				{
-					className = new char[classNameLen];
-					state->stream->read(className, classNameLen);
-					classNameStr = std::string(className);
-					delete[] className;
-				}
-				else
-					state->stream->skip(classNameLen);
-
 				if (state->readLevel == blockLevel)
 				{
-					debug_log("Create native class instance: %s", classNameStr.c_str());
+					debug_log("Create native class instance: %s", d.name.c_str());
 
-					createNativeObject(classNameStr);
+					createNativeObject(d.name);
 				}
 
 				break;
 			}
 			case Instruction::CMD_ADD_MEMBER:
 			{
-				int32_t nameLen;
-				state->stream->read(&nameLen);
-
-				char *name;
-				std::string nameStr;
-				if (state->readLevel == blockLevel)
-				{
-					name = new char[nameLen];
-					state->stream->read(name, nameLen);
-					nameStr = std::string(name);
-					delete[] name;
-				}
-				else
-					state->stream->skip(nameLen);
-
 				if (state->readLevel == blockLevel)
 				{
-					debug_log("Add member: %s", nameStr.c_str());
+					debug_log("Add member: %s", d.name.c_str());
 
 					auto object = module->getFrame(blockLevel).getEvaluator().getStack().top();
 
 					auto member = std::make_shared<Object>();
-					object->addMember(nameStr, member);
+					object->addMember(d.name, member);
 				}
 
 				break;
 			}
 			case Instruction::CMD_LOAD_MEMBER:
 			{
-				int32_t nameLen;
-				state->stream->read(&nameLen);
-
-				char *name;
-				std::string nameStr;
 				if (state->readLevel == blockLevel)
 				{
-					name = new char[nameLen];
-					state->stream->read(name, nameLen);
-					nameStr = std::string(name);
-					delete[] name;
-				}
-				else
-					state->stream->skip(nameLen);
-
-				if (state->readLevel == blockLevel)
-				{
-					debug_log("Load member: %s", nameStr.c_str());
+					debug_log("Load member: %s", d.name.c_str());
 
 					auto object = module->getFrame(blockLevel).getEvaluator().getStack().top();
 
-					auto member = object->accessMember(nameStr);
+					auto member = object->accessMember(d.name);
 					module->getFrame(blockLevel).getEvaluator().loadObject(member);
 				}
 
@@ -448,31 +404,10 @@ namespace zenith
 			}
 			case Instruction::CMD_CREATE_VAR:
 			{
-				int32_t varType;
-				if (state->readLevel == blockLevel)
-					state->stream->read(&varType);
-				else
-					state->stream->skip(sizeof(int32_t));
-
-				int32_t varLen;
-				state->stream->read(&varLen);
-
-				char *varName;
-				std::string varNameStr;
-				if (state->readLevel == blockLevel)
-				{
-					varName = new char[varLen];
-					state->stream->read(varName, varLen);
-					varNameStr = std::string(varName);
-					delete[] varName;
-				}
-				else
-					state->stream->skip(varLen);
-
 				if (blockLevel == state->readLevel)
 				{
-					debug_log("Creating variable: %s", varNameStr.c_str());
-					module->getFrame(blockLevel).createLocal(varNameStr);
+					debug_log("Creating variable: %s", d.name.c_str());
+					module->getFrame(blockLevel).createLocal(d.name);
 				}
 
 				break;
@@ -558,17 +493,9 @@ namespace zenith
 			}
 			case Instruction::CMD_CLEAR_VAR:
 			{
-				int32_t varLen;
-				state->stream->read(&varLen);
-
 				if (state->readLevel == blockLevel)
 				{
-					char *varName = new char[varLen];
-					state->stream->read(varName, varLen);
-					std::string varNameStr(varName);
-					delete[] varName;
-
-					debug_log("Clear var: %s", varNameStr.c_str());
+					debug_log("Clear var: %s", d.name.c_str());
 
 					int startLevel = blockLevel;
 					bool found = false;
@@ -576,10 +503,10 @@ namespace zenith
 					while (startLevel >= -1)
 					{
 						auto &frame = module->getFrame(blockLevel);
-						if (frame.hasLocal(varNameStr))
+						auto *local = frame.findLocal(d.name);
+						if (local != nullptr)
 						{
-							auto &obj = frame.getLocal(varNameStr);
-							frame.clearLocal(obj);
+							frame.clearLocal(*local);
 							found = true;
 							break;
 						}
@@ -590,126 +517,67 @@ namespace zenith
 					if (!found)
 						throw std::runtime_error("Could not find object");
 				}
-				else
-				{
-					// skip ahead
-					state->stream->skip(varLen);
-				}
 
 				break;
 			}
 			case Instruction::CMD_DELETE_VAR:
 			{
-				int32_t varLen;
-				state->stream->read(&varLen);
-
-				char *varName;
-				std::string varNameStr;
 				if (state->readLevel == blockLevel)
 				{
-					varName = new char[varLen];
-					state->stream->read(varName, varLen);
-					varNameStr = std::string(varName);
-					delete[] varName;
-				}
-				else
-					state->stream->skip(varLen);
-
-				if (state->readLevel == blockLevel)
-				{
-					debug_log("Delete var: %s", varNameStr.c_str());
-					module->getFrame(blockLevel).deleteLocal(varNameStr);
+					debug_log("Delete var: %s", d.name.c_str());
+					module->getFrame(blockLevel).deleteLocal(d.name);
 				}
 
 				break;
 			}
 			case Instruction::CMD_LOOP_BREAK:
 			{
-				int32_t levelsToSkip;
-				if (state->readLevel == blockLevel)
-					state->stream->read(&levelsToSkip);
-				else
-					state->stream->skip(sizeof(int32_t));
-
 				if (state->readLevel == blockLevel)
 				{
 					debug_log("Loop break");
-					module->getFrame(blockLevel - levelsToSkip).setLastIfResult(false);
-					state->readLevel -= levelsToSkip;
+					module->getFrame(blockLevel - d.arg0).setLastIfResult(false);
+					state->readLevel -= d.arg0;
 				}
 
 				break;
 			}
 			case Instruction::CMD_LOOP_CONTINUE:
 			{
-				int32_t levelsToSkip;
-				if (state->readLevel == blockLevel)
-					state->stream->read(&levelsToSkip);
-				else
-					state->stream->skip(sizeof(int32_t));
-
 				if (state->readLevel == blockLevel)
 				{
 					debug_log("Loop continue");
-					module->getFrame(blockLevel - levelsToSkip).setLastIfResult(true);
-					state->readLevel -= levelsToSkip;
+					module->getFrame(blockLevel - d.arg0).setLastIfResult(true);
+					state->readLevel -= d.arg0;
 				}
 
 				break;
 			}
 			case Instruction::CMD_LOAD_INTEGER:
 			{
-				long value;
-				if (state->readLevel == blockLevel)
-					state->stream->read(&value);
-				else
-					state->stream->skip(sizeof(long));
-
 				if (state->readLevel == blockLevel)
 				{
-					debug_log("Load integer: %d", value);
-					module->getFrame(blockLevel).getEvaluator().loadInteger(value);
+					debug_log("Load integer: %d", d.intValue);
+					module->getFrame(blockLevel).getEvaluator().loadInteger(d.intValue);
 				}
 
 				break;
 			}
 			case Instruction::CMD_LOAD_FLOAT:
 			{
-				double value;
-				if (state->readLevel == blockLevel)
-					state->stream->read(&value);
-				else
-					state->stream->skip(sizeof(double));
-
 				if (state->readLevel == blockLevel)
 				{
-					debug_log("Load float: %f", value);
-					module->getFrame(blockLevel).getEvaluator().loadFloat(value);
+					debug_log("Load float: %f", d.floatValue);
+					module->getFrame(blockLevel).getEvaluator().loadFloat(d.floatValue);
 				}
 
 				break;
 			}
 			case Instruction::CMD_LOAD_STRING:
 			{
-				int32_t varLen;
-				state->stream->read(&varLen);
-
-				char *varName;
-				std::string varNameStr;
 				if (state->readLevel == blockLevel)
 				{
-					varName = new char[varLen];
-					state->stream->read(varName, varLen);
-					varNameStr = std::string(varName);
-					delete[] varName;
-				}
-				else
-					state->stream->skip(varLen);
-
-				if (state->readLevel == blockLevel)
-				{
-					debug_log("Load string: %s", varNameStr.c_str());
-					module->getFrame(blockLevel).getEvaluator().loadString(varNameStr);
+					debug_log("Load string: %s", d.name.c_str());
+					module->getFrame(blockLevel).getEvaluator().loadString(d.name);
 				}
 
 				break;
@@ -725,24 +593,9 @@ namespace zenith
 			}
 			case Instruction::CMD_LOAD_VARIABLE:
 			{
-				int32_t varLen;
-				state->stream->read(&varLen);
-
-				char *varName;
-				std::string varNameStr;
 				if (state->readLevel == blockLevel)
 				{
-					varName = new char[varLen];
-					state->stream->read(varName, varLen);
-					varNameStr = std::string(varName);
-					delete[] varName;
-				}
-				else
-					state->stream->skip(varLen);
-
-				if (state->readLevel == blockLevel)
-				{
-					debug_log("Loading variable: '%s'", varNameStr.c_str());
+					debug_log("Loading variable: '%s'", d.name.c_str());
 
 
 					int startLevel = blockLevel;
@@ -750,14 +603,14 @@ namespace zenith
 
 					while (startLevel >= -1)
 					{
-						auto &frame = module->getFrame(startLevel);
-						if (frame.hasLocal(varNameStr))
+						auto *local = module->getFrame(startLevel).findLocal(d.name);
+						if (local != nullptr)
 						{
-							auto &obj = frame.getLocal(varNameStr);
+							auto &obj = *local;
 							module->getFrame(blockLevel).getEvaluator().loadObject(obj);
 
 							debug_log("Loaded variable: '%s', Value: '%s', From level: %d, To level: %d",
-								varNameStr.c_str(), obj->str().c_str(), startLevel, blockLevel);
+								d.name.c_str(), obj->str().c_str(), startLevel, blockLevel);
 
 							found = true;
 							break;
@@ -774,18 +627,12 @@ namespace zenith
 			}
 			case Instruction::CMD_OP_PUSH:
 			{
-				int32_t whichStack;
-				if (state->readLevel == blockLevel)
-					state->stream->read(&whichStack);
-				else
-					state->stream->skip(sizeof(int32_t));
-
 				if (state->readLevel == blockLevel)
 				{
 					debug_log("Push result from level %d to object stack %d",
-						blockLevel, whichStack);
+						blockLevel, d.arg0);
 
-					module->getFrame(blockLevel).getEvaluator().push(getObjectStack(whichStack));
+					module->getFrame(blockLevel).getEvaluator().push(getObjectStack(d.arg0), !verified);
 				}
 
 				break;
@@ -1008,8 +855,7 @@ namespace zenith
 				break;
 			}
 			default:
-				auto lastPos = (((unsigned long)state->stream->position()) - sizeof(Instruction));
-				printf("Unrecognized instruction '%d' at position: %d\n", (int)ins, lastPos);
+				printf("Unrecognized instruction '%d' at position: %d\n", (int)d.ins, (int)d.position);
 				state->stream = nullptr;
 				return;
 			}
@@ -1020,28 +866,74 @@ namespace zenith
 			Timer timer;
 			timer.start();
 
+			if (!InstructionDecoder::readHeader(state->stream))
+			{
+				std::cout << "Bytecode was emitted with an unsupported encoding\n";
+				return;
+			}
+
 			auto *module = new Module("main");
+			module->setChecked(!verified);
 			state->module = module;
 
 			while (state->stream != nullptr &&
 				(state->stream->position() < state->stream->max()))
 			{
-				int32_t ins;
-				state->stream->read(&ins);
-				handleInstruction((Instruction)ins, module);
+				handleInstruction(module);
 			}
 
 			delete module;
 
 			std::cout << "Execution completed in " << timer.elapsedTime() << "s\n";
+
+			if (jitCompiler != nullptr)
+				std::cout << "JIT compiled " << jitCompiler->numCompiled() << " function(s)\n";
+
+			if (tracer != nullptr)
+			{
+				std::cout << "Traces compiled: " << tracer->getNumCompiled()
+					<< ", aborted: " << tracer->getNumAborted()
+					<< ", branches: " << tracer->getNumBranches()
+					<< ", entered: " << tracer->getNumEntries()
+					<< ", side exits: " << tracer->getNumExits() << "\n";
+			}
+
+			if (tiers != nullptr)
+			{
+				std::cout << "Functions quickened: " << tiers->getNumFunctions(jit::TIER_QUICKENED)
+					<< ", baseline: " << tiers->getNumFunctions(jit::TIER_BASELINE)
+					<< ", interpreted: " << tiers->getNumFunctions(jit::TIER_INTERPRETED)
+					<< "; loops quickened: " << tiers->getNumLoopsQuickened()
+					<< ", entered at back-edge: " << tiers->getNumLoopEntries() << "\n";
+			}
+		}
+
+		void VM::countBackEdge(const DecodedInstruction &d, uint64_t target)
+		{
+			if (target <= d.position && state->function != nullptr)
+				state->function->countBackEdge();
+		}
+
+		void VM::invokeCompiled(const DecodedInstruction &d, Module *module)
+		{
+			// the callee returns to the following instruction
+			size_t depth = module->functionDepth();
+			state->stream->seek((unsigned long)d.next);
+			execute(d, module);
+
+			while (module->functionDepth() > depth && state->stream != nullptr &&
+				(state->stream->position() < state->stream->max()))
+			{
+				handleInstruction(module);
+			}
 		}
 
 		ObjectStack &VM::getObjectStack(int id)
 		{
-			if (id >= objectStacks.size())
+			if (!verified && id >= objectStacks.size())
 				throw std::out_of_range("Tried to access an unknown stack type");
 
-			return objectStacks.at(id);
+			return objectStacks[id];
 		}
 
 		bool VM::callBindedFunction(const std::string &identifier, size_t numArgs)
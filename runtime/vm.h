@@ -22,6 +22,20 @@ namespace zenith
 
 		class Function;
 		class Object;
+		class AotModule;
+
+		struct DecodedInstruction;
+
+		namespace jit
+		{
+			class BaselineJit;
+			class TracingJit;
+			class TraceRecorder;
+			class TierManager;
+			class QuickenedCode;
+			class TemplateCompiler;
+			struct JitOptions;
+		}
 
 		typedef std::shared_ptr<Function> FunctionPtr;
 		typedef std::shared_ptr<Object> ObjectPtr;
@@ -38,18 +52,51 @@ namespace zenith
 			std::map<std::string, std::unique_ptr<NativeFunctionBase>> nativeFunctions;
 			std::map<std::string, std::unique_ptr<NativeClassBase>> nativeClasses;
 
+			// compiled modules that native functions were bound from
+			std::vector<std::unique_ptr<AotModule>> aotModules;
+
 			VMState *state;
 
 			int blockLevel;
 
+			// the code passed the Verifier, so per instruction checks are left out
+			bool verified;
+
+			jit::BaselineJit *jitCompiler;
+			jit::TracingJit *tracer;
+			jit::TierManager *tiers;
+
 			inline ObjectStack &getObjectStack(int id);
 
+			friend class jit::BaselineJit;
+			friend class jit::TracingJit;
+			friend class jit::TraceRecorder;
+			friend class jit::TierManager;
+			friend class jit::QuickenedCode;
+			friend class jit::TemplateCompiler;
+
 		public:
 			VM(VMState *state);
 			~VM();
 
 			void exec();
-			void handleInstruction(Instruction ins, Module *module);
+			/* Read and execute the next instruction, returning which it was. */
+			Instruction handleInstruction(Module *module);
+			void execute(const DecodedInstruction &d, Module *module);
+
+			/* Run code that has been through the Verifier without checking
+			   stack ids, frame levels and for an empty expression stack again. */
+			void setVerified(bool verified) { this->verified = verified; }
+			bool isVerified() const { return verified; }
+
+			/* Compile hot functions to native code templates, and hot loops to native traces. */
+			void enableJit(const jit::JitOptions &options);
+			jit::BaselineJit *getJit() const { return jitCompiler; }
+			jit::TracingJit *getTracer() const { return tracer; }
+			jit::TierManager *getTiers() const { return tiers; }
+
+			/* Bind every function of a compiled module and run its top level statements. */
+			void bindModule(std::unique_ptr<AotModule> module);
 
 			template <typename T>
 			std::unique_ptr<NativeClass<T>> &bindClass(const std::string &classIdentifier)
@@ -90,6 +137,11 @@ namespace zenith
 			}
 
 		private:
+			void countBackEdge(const DecodedInstruction &d, uint64_t target);
+			/* Invoke from compiled code, which does not read on. A function that
+			   returns inside a block leaves the rest of its body to the caller. */
+			void invokeCompiled(const DecodedInstruction &d, Module *module);
+
 			bool callBindedFunction(const std::string &identifier, size_t numArgs);
 			bool createNativeObject(const std::string &identifier);
 		};
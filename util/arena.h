@@ -0,0 +1,61 @@
+#ifndef __ZENITH_UTIL_ARENA_H__
+#define __ZENITH_UTIL_ARENA_H__
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+namespace zenith
+{
+	namespace util
+	{
+		/* Bump allocator. Memory is taken from large blocks and only given
+		   back all at once, when the arena is destroyed. */
+		class Arena
+		{
+		private:
+			std::vector<std::unique_ptr<char[]>> blocks;
+			char *current;
+			size_t remaining;
+			size_t blockSize;
+			size_t bytesUsed;
+
+		public:
+			Arena(size_t blockSize = 64 * 1024)
+				: current(nullptr), remaining(0), blockSize(blockSize), bytesUsed(0)
+			{
+			}
+
+			Arena(const Arena &other) = delete;
+			Arena &operator=(const Arena &other) = delete;
+
+			void *allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+			{
+				size_t padding = (alignment - ((size_t)current % alignment)) % alignment;
+
+				if (current == nullptr || padding + size > remaining)
+				{
+					// big allocations get a block of their own
+					size_t newSize = (size + alignment > blockSize) ? size + alignment : blockSize;
+					blocks.push_back(std::unique_ptr<char[]>(new char[newSize]));
+
+					current = blocks.back().get();
+					remaining = newSize;
+					padding = (alignment - ((size_t)current % alignment)) % alignment;
+				}
+
+				char *result = current + padding;
+				current += padding + size;
+				remaining -= padding + size;
+				bytesUsed += size;
+
+				return result;
+			}
+
+			size_t getNumBlocks() const { return blocks.size(); }
+			size_t getBytesUsed() const { return bytesUsed; }
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef __ZENITH_UTIL_HASH_H__
+#define __ZENITH_UTIL_HASH_H__
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace zenith
+{
+	namespace util
+	{
+		const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+		const uint64_t FNV_PRIME = 1099511628211ull;
+
+		/* 64 bit FNV-1a. Pass the result of a previous call as 'hash' to
+		   hash several pieces as one. */
+		inline uint64_t fnv1a(const char *data, size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+		{
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= (uint8_t)data[i];
+				hash *= FNV_PRIME;
+			}
+
+			return hash;
+		}
+
+		inline uint64_t fnv1a(const std::string &str, uint64_t hash = FNV_OFFSET_BASIS)
+		{
+			return fnv1a(str.data(), str.size(), hash);
+		}
+	}
+}
+
+#endif
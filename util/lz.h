@@ -0,0 +1,178 @@
+#ifndef __ZENITH_UTIL_LZ_H__
+#define __ZENITH_UTIL_LZ_H__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+namespace zenith
+{
+	namespace util
+	{
+		/* Small LZ77 codec for bytecode sections, in the spirit of LZ4 block
+		   format. The stream is a series of sequences:
+
+		     token       literal length (high 4 bits), match length - 4 (low 4 bits);
+		                 15 means more length follows in bytes of 255 until a smaller one
+		     literals
+		     offset      2 bytes, little endian, back from the current output position
+		     match ext.
+
+		   The last sequence only has literals. */
+		namespace lz
+		{
+			const size_t MIN_MATCH = 4;
+			const size_t HASH_BITS = 12;
+			const size_t MAX_OFFSET = 0xFFFF;
+
+			inline uint32_t read32(const char *p)
+			{
+				uint32_t value;
+				std::memcpy(&value, p, sizeof(value));
+				return value;
+			}
+
+			inline void writeLength(std::string &out, size_t length)
+			{
+				while (length >= 255)
+				{
+					out.push_back((char)255);
+					length -= 255;
+				}
+				out.push_back((char)length);
+			}
+
+			inline void writeSequence(std::string &out, const char *literals, size_t numLiterals,
+				size_t offset, size_t matchLength)
+			{
+				size_t matchCode = (matchLength != 0) ? matchLength - MIN_MATCH : 0;
+
+				uint8_t token = (uint8_t)(((numLiterals < 15) ? numLiterals : 15) << 4);
+				token |= (uint8_t)((matchCode < 15) ? matchCode : 15);
+				out.push_back((char)token);
+
+				if (numLiterals >= 15)
+					writeLength(out, numLiterals - 15);
+				out.append(literals, numLiterals);
+
+				if (matchLength != 0)
+				{
+					out.push_back((char)(offset & 0xFF));
+					out.push_back((char)(offset >> 8));
+
+					if (matchCode >= 15)
+						writeLength(out, matchCode - 15);
+				}
+			}
+
+			inline std::string compress(const char *data, size_t size)
+			{
+				std::string out;
+				out.reserve(size / 2 + 16);
+
+				// position + 1 of the last occurrence of each hashed 4 byte sequence
+				std::vector<uint32_t> table((size_t)1 << HASH_BITS, 0);
+
+				size_t anchor = 0;
+				size_t i = 0;
+
+				while (size >= MIN_MATCH && i <= size - MIN_MATCH)
+				{
+					uint32_t sequence = read32(data + i);
+					size_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+
+					size_t candidate = table[hash];
+					table[hash] = (uint32_t)(i + 1);
+
+					if (candidate != 0 && i - (candidate - 1) <= MAX_OFFSET &&
+						read32(data + candidate - 1) == sequence)
+					{
+						size_t ref = candidate - 1;
+						size_t length = MIN_MATCH;
+						while (i + length < size && data[ref + length] == data[i + length])
+							length++;
+
+						writeSequence(out, data + anchor, i - anchor, i - ref, length);
+
+						i += length;
+						anchor = i;
+					}
+					else
+						i++;
+				}
+
+				writeSequence(out, data + anchor, size - anchor, 0, 0);
+				return out;
+			}
+
+			inline bool readLength(const uint8_t *&in, const uint8_t *end, size_t &length)
+			{
+				uint8_t byte;
+				do
+				{
+					if (in >= end)
+						return false;
+
+					byte = *in++;
+					length += byte;
+				} while (byte == 255);
+
+				return true;
+			}
+
+			/* Decompress into 'out', which must be exactly the uncompressed size.
+			   Returns false if the input is malformed. */
+			inline bool decompress(const char *data, size_t size, char *out, size_t outSize)
+			{
+				const uint8_t *in = (const uint8_t*)data;
+				const uint8_t *end = in + size;
+				size_t pos = 0;
+
+				while (in < end)
+				{
+					uint8_t token = *in++;
+
+					size_t numLiterals = token >> 4;
+					if (numLiterals == 15 && !readLength(in, end, numLiterals))
+						return false;
+
+					if (numLiterals > (size_t)(end - in) || numLiterals > outSize - pos)
+						return false;
+
+					std::memcpy(out + pos, in, numLiterals);
+					in += numLiterals;
+					pos += numLiterals;
+
+					// the last sequence has no match
+					if (in == end)
+						break;
+
+					if (end - in < 2)
+						return false;
+
+					size_t offset = in[0] | ((size_t)in[1] << 8);
+					in += 2;
+
+					size_t matchLength = token & 0x0F;
+					if (matchLength == 15 && !readLength(in, end, matchLength))
+						return false;
+					matchLength += MIN_MATCH;
+
+					if (offset == 0 || offset > pos || matchLength > outSize - pos)
+						return false;
+
+					// byte by byte, the match may overlap what it produces
+					const char *from = out + pos - offset;
+					for (size_t i = 0; i < matchLength; i++)
+						out[pos + i] = from[i];
+					pos += matchLength;
+				}
+
+				return pos == outSize;
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,37 @@
+#include "memory.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+namespace zenith
+{
+	namespace util
+	{
+		size_t peakMemoryUsage()
+		{
+#ifdef _WIN32
+			PROCESS_MEMORY_COUNTERS counters;
+			if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+				return 0;
+
+			return (size_t)counters.PeakWorkingSetSize;
+#else
+			struct rusage usage;
+			if (getrusage(RUSAGE_SELF, &usage) != 0)
+				return 0;
+
+#ifdef __APPLE__
+			return (size_t)usage.ru_maxrss;
+#else
+			// in kilobytes
+			return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+		}
+	}
+}
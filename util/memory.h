@@ -0,0 +1,16 @@
+#ifndef __ZENITH_UTIL_MEMORY_H__
+#define __ZENITH_UTIL_MEMORY_H__
+
+#include <cstddef>
+
+namespace zenith
+{
+	namespace util
+	{
+		/* The most memory the process has had resident so far, in bytes,
+		   or 0 if it can not be found out. */
+		size_t peakMemoryUsage();
+	}
+}
+
+#endif
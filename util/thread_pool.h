@@ -0,0 +1,102 @@
+#ifndef __ZENITH_UTIL_THREAD_POOL_H__
+#define __ZENITH_UTIL_THREAD_POOL_H__
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace zenith
+{
+	namespace util
+	{
+		/* Fixed number of threads running submitted tasks. Tasks may submit
+		   more tasks, wait() returns once all of them have finished. */
+		class ThreadPool
+		{
+		private:
+			std::vector<std::thread> workers;
+			std::deque<std::function<void()>> tasks;
+			std::mutex mutex;
+			std::condition_variable available;
+			std::condition_variable idle;
+			size_t numBusy;
+			bool stopping;
+
+			void run()
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+
+				while (true)
+				{
+					available.wait(lock, [this] { return stopping || !tasks.empty(); });
+					if (tasks.empty())
+						return;
+
+					auto task = std::move(tasks.front());
+					tasks.pop_front();
+					numBusy++;
+
+					lock.unlock();
+					task();
+					lock.lock();
+
+					numBusy--;
+					if (numBusy == 0 && tasks.empty())
+						idle.notify_all();
+				}
+			}
+
+		public:
+			ThreadPool(size_t numThreads)
+			{
+				numBusy = 0;
+				stopping = false;
+
+				if (numThreads == 0)
+					numThreads = 1;
+
+				for (size_t i = 0; i < numThreads; i++)
+					workers.emplace_back(&ThreadPool::run, this);
+			}
+
+			~ThreadPool()
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					stopping = true;
+				}
+				available.notify_all();
+
+				for (auto &&worker : workers)
+					worker.join();
+			}
+
+			/* Threads the machine can run at once, at least 1. */
+			static size_t defaultSize()
+			{
+				size_t numThreads = std::thread::hardware_concurrency();
+				return (numThreads != 0) ? numThreads : 1;
+			}
+
+			void submit(std::function<void()> task)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					tasks.push_back(std::move(task));
+				}
+				available.notify_one();
+			}
+
+			void wait()
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				idle.wait(lock, [this] { return numBusy == 0 && tasks.empty(); });
+			}
+		};
+	}
+}
+
+#endif